@@ -149,6 +149,16 @@
 #endif
 
 
+/* vector instruction sets that are guaranteed by the target */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CONF_SIMD_SSE2 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#define CONF_SIMD_NEON 1
+#endif
+
+
 #ifndef CONF_FAMILY_STRING
 #define CONF_FAMILY_STRING "unknown"
 #endif
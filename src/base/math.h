@@ -50,6 +50,13 @@ inline T bezier(const T p0, const T p1, const T p2, const T p3, TB amount)
 inline int random_int() { return (((rand() & 0xffff) << 16) | (rand() & 0xffff)) & 0x7FFFFFFF; };
 inline float frandom() { return rand()/(float)(RAND_MAX); }
 
+// reproducible 15 bit random numbers from a caller owned seed, for test data and scripted bots
+inline unsigned random_seeded(unsigned *pSeed)
+{
+	*pSeed = *pSeed*1103515245u + 12345u;
+	return (*pSeed>>16)&0x7fff;
+}
+
 // float to fixed
 inline int f2fx(float v) { return (int)(v*(float)(1<<10)); }
 inline float fx2f(int v) { return v*(1.0f/(1<<10)); }
@@ -64,6 +64,87 @@ IOHANDLE io_stderr() { return (IOHANDLE)stderr; }
 static DBG_LOGGER loggers[16];
 static int num_loggers = 0;
 
+/* async logging: dbg_msg puts the lines into a ring that a thread writes out
+   in batches. any thread may add lines without locking, slots carry a
+   sequence number that tells if they are free or filled (bounded queue by
+   Dmitry Vyukov). the writer side takes log_flush_lock. */
+enum
+{
+	LOG_RING_SIZE = 4096,
+	LOG_LINE_SIZE = 512
+};
+
+typedef struct
+{
+	volatile unsigned seq;
+	char line[LOG_LINE_SIZE];
+} LOG_SLOT;
+
+static LOG_SLOT log_ring[LOG_RING_SIZE];
+static volatile unsigned log_write_pos = 0;
+static unsigned log_read_pos = 0;
+static volatile unsigned log_dropped = 0;
+static unsigned log_dropped_reported = 0;
+static volatile int log_async = 0;
+static int log_flush_interval = 0;
+static LOCK log_flush_lock = 0;
+
+#if defined(__GNUC__)
+static unsigned log_compswap(volatile unsigned *value, unsigned comperand, unsigned exchange)
+{
+	return __sync_val_compare_and_swap(value, comperand, exchange);
+}
+static void log_inc(volatile unsigned *value) { __sync_add_and_fetch(value, 1); }
+static void log_barrier() { __sync_synchronize(); }
+#elif defined(_MSC_VER)
+static unsigned log_compswap(volatile unsigned *value, unsigned comperand, unsigned exchange)
+{
+	return InterlockedCompareExchange((volatile LONG *)value, (LONG)exchange, (LONG)comperand);
+}
+static void log_inc(volatile unsigned *value) { InterlockedIncrement((volatile LONG *)value); }
+static void log_barrier() { MemoryBarrier(); }
+#else
+	#error missing atomic implementation for this compiler
+#endif
+
+static void logger_call(const char *line)
+{
+	int i;
+	for(i = 0; i < num_loggers; i++)
+		loggers[i](line);
+}
+
+static void logger_flush_handles();
+static void dbg_logger_flush_locked();
+
+/* returns 0 if the ring is full */
+static int log_push(const char *line)
+{
+	LOG_SLOT *slot;
+	unsigned pos = log_write_pos;
+	while(1)
+	{
+		int diff;
+		slot = &log_ring[pos%LOG_RING_SIZE];
+		diff = (int)(slot->seq - pos);
+		log_barrier();
+		if(diff == 0)
+		{
+			if(log_compswap(&log_write_pos, pos, pos+1) == pos)
+				break;
+			pos = log_write_pos;
+		}
+		else if(diff < 0)
+			return 0;
+		else
+			pos = log_write_pos;
+	}
+	str_copy(slot->line, line, sizeof(slot->line));
+	log_barrier();
+	slot->seq = pos+1;
+	return 1;
+}
+
 static NETSTATS network_stats = {0};
 
 static NETSOCKET invalid_socket = {NETTYPE_INVALID, -1, -1};
@@ -78,6 +159,7 @@ void dbg_assert_imp(const char *filename, int line, int test, const char *msg)
 	if(!test)
 	{
 		dbg_msg("assert", "%s(%d): %s", filename, line, msg);
+		dbg_logger_flush();
 		dbg_break();
 	}
 }
@@ -110,6 +192,35 @@ void dbg_msg(const char *sys, const char *fmt, ...)
 #endif
 	va_end(args);
 
+	if(log_async)
+	{
+		len = strlen(str);
+		if(len < LOG_LINE_SIZE)
+		{
+			if(!log_push(str))
+				log_inc(&log_dropped);
+			return;
+		}
+		/* too long for the ring, write it now after the queued lines */
+		lock_wait(log_flush_lock);
+		dbg_logger_flush_locked();
+		logger_call(str);
+		logger_flush_handles();
+		lock_unlock(log_flush_lock);
+		return;
+	}
+
+	if(log_flush_lock)
+	{
+		/* back from async mode, the thread may still write lines that got
+		   queued during the switch. those go first and never at the same time */
+		lock_wait(log_flush_lock);
+		dbg_logger_flush_locked();
+		logger_call(str);
+		lock_unlock(log_flush_lock);
+		return;
+	}
+
 	for(i = 0; i < num_loggers; i++)
 		loggers[i](str);
 }
@@ -205,7 +316,8 @@ static void logger_win_console(const char *line)
 static void logger_stdout(const char *line)
 {
 	printf("%s\n", line);
-	fflush(stdout);
+	if(!log_async)
+		fflush(stdout);
 }
 
 static void logger_debugger(const char *line)
@@ -218,11 +330,140 @@ static void logger_debugger(const char *line)
 
 
 static IOHANDLE logfile = 0;
+static int logfile_fd = -1;
 static void logger_file(const char *line)
 {
 	io_write(logfile, line, strlen(line));
 	io_write_newline(logfile);
-	io_flush(logfile);
+	if(!log_async)
+		io_flush(logfile);
+}
+
+/* the loggers don't flush in async mode, it happens once per batch */
+static void logger_flush_handles()
+{
+	fflush(stdout);
+	if(logfile)
+		io_flush(logfile);
+}
+
+static void dbg_logger_flush_locked()
+{
+	unsigned dropped;
+	int num = 0;
+	while(1)
+	{
+		LOG_SLOT *slot = &log_ring[log_read_pos%LOG_RING_SIZE];
+		if(slot->seq != log_read_pos+1)
+			break;
+		log_barrier();
+		logger_call(slot->line);
+		log_barrier();
+		slot->seq = log_read_pos+LOG_RING_SIZE;
+		log_read_pos++;
+		num++;
+	}
+
+	dropped = log_dropped;
+	if(dropped != log_dropped_reported)
+	{
+		char str[128];
+		char timestr[80];
+		str_timestamp_format(timestr, sizeof(timestr), FORMAT_SPACE);
+		str_format(str, sizeof(str), "[%s][dbg/logger]: log ring full, dropped %u lines", timestr, dropped-log_dropped_reported);
+		logger_call(str);
+		log_dropped_reported = dropped;
+		num++;
+	}
+
+	if(num)
+		logger_flush_handles();
+}
+
+void dbg_logger_flush()
+{
+	if(!log_flush_lock)
+		return;
+	lock_wait(log_flush_lock);
+	dbg_logger_flush_locked();
+	lock_unlock(log_flush_lock);
+}
+
+static void logger_thread(void *user)
+{
+	while(1)
+	{
+		thread_sleep(log_flush_interval);
+		dbg_logger_flush();
+	}
+}
+
+void dbg_logger_crash()
+{
+#if defined(CONF_FAMILY_UNIX)
+	/* no locks and no stdio in a signal handler. the writer thread may be
+	   in the middle of a batch, a line may show up twice then */
+	unsigned pos;
+	if(!log_flush_lock)
+		return;
+	for(pos = log_read_pos; ; pos++)
+	{
+		LOG_SLOT *slot = &log_ring[pos%LOG_RING_SIZE];
+		size_t len;
+		if(slot->seq != pos+1)
+			break;
+		len = strlen(slot->line);
+		if(write(STDOUT_FILENO, slot->line, len) < 0 || write(STDOUT_FILENO, "\n", 1) < 0) {}
+		if(logfile_fd >= 0 && (write(logfile_fd, slot->line, len) < 0 || write(logfile_fd, "\n", 1) < 0)) {}
+	}
+#endif
+}
+
+void dbg_logger_async(int flush_interval)
+{
+	unsigned i;
+	void *thread;
+	log_flush_interval = flush_interval;
+	if(log_async)
+		return;
+	if(log_flush_lock)
+	{
+		/* back from dbg_logger_sync, the ring and the thread are still there */
+		log_barrier();
+		log_async = 1;
+		return;
+	}
+
+	for(i = 0; i < LOG_RING_SIZE; i++)
+		log_ring[i].seq = i;
+	log_flush_lock = lock_create();
+	thread = thread_init(logger_thread, 0);
+	if(!thread)
+	{
+		dbg_msg("dbg/logger", "failed to start the log thread");
+		return;
+	}
+	thread_detach(thread);
+	log_barrier();
+	log_async = 1;
+	atexit(dbg_logger_flush);
+}
+
+void dbg_logger_sync()
+{
+	if(!log_async)
+		return;
+	lock_wait(log_flush_lock);
+	log_async = 0;
+	log_barrier();
+	dbg_logger_flush_locked();
+	lock_unlock(log_flush_lock);
+	/* the thread keeps running and writes lines that got queued during the switch */
+}
+
+unsigned dbg_logger_dropped()
+{
+	return log_dropped;
 }
 
 void dbg_logger_stdout()
@@ -251,7 +492,12 @@ void dbg_logger_filehandle(IOHANDLE handle)
 {
 	logfile = handle;
 	if(logfile)
+	{
+#if defined(CONF_FAMILY_UNIX)
+		logfile_fd = fileno((FILE *)logfile);
+#endif
 		dbg_logger(logger_file);
+	}
 }
 
 #if defined(CONF_FAMILY_WINDOWS)
@@ -1026,6 +1272,15 @@ static int priv_net_create_socket(int domain, int type, struct sockaddr *addr, i
 		return -1;
 	}
 
+#if defined(CONF_FAMILY_UNIX)
+	/* tcp servers can be restarted while old connections are in TIME_WAIT */
+	if(type == SOCK_STREAM)
+	{
+		int reuse = 1;
+		setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+	}
+#endif
+
 	/* set to IPv6 only if thats what we are creating */
 #if defined(IPV6_V6ONLY)	/* windows sdk 6.1 and higher */
 	if(domain == AF_INET6)
@@ -1410,11 +1665,16 @@ int net_tcp_connect_non_blocking(NETSOCKET sock, NETADDR bindaddr)
 int net_tcp_send(NETSOCKET sock, const void *data, int size)
 {
 	int bytes = -1;
+	int flags = 0;
+#if defined(MSG_NOSIGNAL)
+	/* a closed peer should be an error and not kill the process with SIGPIPE */
+	flags = MSG_NOSIGNAL;
+#endif
 
 	if(sock.ipv4sock >= 0)
-		bytes = send((int)sock.ipv4sock, (const char*)data, size, 0);
+		bytes = send((int)sock.ipv4sock, (const char*)data, size, flags);
 	if(sock.ipv6sock >= 0)
-		bytes = send((int)sock.ipv6sock, (const char*)data, size, 0);
+		bytes = send((int)sock.ipv6sock, (const char*)data, size, flags);
 
 	return bytes;
 }
@@ -1535,6 +1535,45 @@ void dbg_logger_debugger();
 void dbg_logger_file(const char *filename);
 void dbg_logger_filehandle(IOHANDLE handle);
 
+/*
+	Function: dbg_logger_async
+		Moves the writing of the log to a background thread. <dbg_msg>
+		puts the lines into a ring without blocking and the thread writes
+		them out in batches. Lines are dropped when the ring is full.
+
+	Parameters:
+		flush_interval - Milliseconds between two batches.
+*/
+void dbg_logger_async(int flush_interval);
+
+/*
+	Function: dbg_logger_sync
+		Writes out the queued log lines and goes back to writing every
+		line in <dbg_msg> itself.
+*/
+void dbg_logger_sync();
+
+/*
+	Function: dbg_logger_flush
+		Writes out all queued log lines right away.
+*/
+void dbg_logger_flush();
+
+/*
+	Function: dbg_logger_crash
+		Writes the queued log lines straight to stdout and the log file,
+		for crash handlers. Only uses async signal safe calls, lines
+		still in the stdio buffers are lost.
+*/
+void dbg_logger_crash();
+
+/*
+	Function: dbg_logger_dropped
+		Returns the number of log lines that were dropped because the
+		ring was full.
+*/
+unsigned dbg_logger_dropped();
+
 #if defined(CONF_FAMILY_WINDOWS)
 void dbg_console_init();
 void dbg_console_cleanup();
@@ -255,6 +255,17 @@ void CCommandProcessorFragment_OpenGL::Cmd_Init(const CInitCommand *pCommand)
 		dbg_msg("render", "*** warning *** max 3D texture size is too low - using the fallback system");
 	m_TextureArraySize = IGraphics::NUMTILES_DIMENSION * IGraphics::NUMTILES_DIMENSION / minimum(m_Max3DTexSize, IGraphics::NUMTILES_DIMENSION * IGraphics::NUMTILES_DIMENSION);
 	*pCommand->m_pTextureArraySize = m_TextureArraySize;
+
+	// vertex buffer objects are core since opengl 1.5
+	m_pfnGenBuffers = (PFNGLGENBUFFERSPROC)SDL_GL_GetProcAddress("glGenBuffers");
+	m_pfnBindBuffer = (PFNGLBINDBUFFERPROC)SDL_GL_GetProcAddress("glBindBuffer");
+	m_pfnBufferData = (PFNGLBUFFERDATAPROC)SDL_GL_GetProcAddress("glBufferData");
+	m_pfnDeleteBuffers = (PFNGLDELETEBUFFERSPROC)SDL_GL_GetProcAddress("glDeleteBuffers");
+	if(!m_pfnGenBuffers || !m_pfnBindBuffer || !m_pfnBufferData || !m_pfnDeleteBuffers)
+	{
+		m_pfnGenBuffers = 0;
+		dbg_msg("render", "vertex buffer objects not supported - using client side arrays");
+	}
 }
 
 void CCommandProcessorFragment_OpenGL::Cmd_Texture_Update(const CCommandBuffer::CTextureUpdateCommand *pCommand)
@@ -436,6 +447,32 @@ void CCommandProcessorFragment_OpenGL::Cmd_Texture_Create(const CCommandBuffer::
 	mem_free(pTexData);
 }
 
+void CCommandProcessorFragment_OpenGL::Cmd_Buffer_Create(const CCommandBuffer::CBufferCreateCommand *pCommand)
+{
+	CBuffer *pBuffer = &m_aBuffers[pCommand->m_Slot];
+	if(m_pfnGenBuffers)
+	{
+		m_pfnGenBuffers(1, &pBuffer->m_Vbo);
+		m_pfnBindBuffer(GL_ARRAY_BUFFER, pBuffer->m_Vbo);
+		m_pfnBufferData(GL_ARRAY_BUFFER, sizeof(CCommandBuffer::CBufferVertex)*pCommand->m_NumVertices, pCommand->m_pVertices, GL_STATIC_DRAW);
+		m_pfnBindBuffer(GL_ARRAY_BUFFER, 0);
+		mem_free(pCommand->m_pVertices);
+	}
+	else
+		pBuffer->m_pVertices = pCommand->m_pVertices;
+}
+
+void CCommandProcessorFragment_OpenGL::Cmd_Buffer_Destroy(const CCommandBuffer::CBufferDestroyCommand *pCommand)
+{
+	CBuffer *pBuffer = &m_aBuffers[pCommand->m_Slot];
+	if(pBuffer->m_Vbo)
+		m_pfnDeleteBuffers(1, &pBuffer->m_Vbo);
+	if(pBuffer->m_pVertices)
+		mem_free(pBuffer->m_pVertices);
+	pBuffer->m_Vbo = 0;
+	pBuffer->m_pVertices = 0;
+}
+
 void CCommandProcessorFragment_OpenGL::Cmd_Clear(const CCommandBuffer::CClearCommand *pCommand)
 {
 	glClearColor(pCommand->m_Color.r, pCommand->m_Color.g, pCommand->m_Color.b, 0.0f);
@@ -466,6 +503,33 @@ void CCommandProcessorFragment_OpenGL::Cmd_Render(const CCommandBuffer::CRenderC
 	};
 }
 
+void CCommandProcessorFragment_OpenGL::Cmd_Render_Buffer(const CCommandBuffer::CRenderBufferCommand *pCommand)
+{
+	const CBuffer *pBuffer = &m_aBuffers[pCommand->m_Slot];
+	const char *pData = (const char *)pBuffer->m_pVertices;
+	if(pBuffer->m_Vbo)
+	{
+		m_pfnBindBuffer(GL_ARRAY_BUFFER, pBuffer->m_Vbo);
+		pData = 0;
+	}
+	else if(!pData)
+		return;
+
+	SetState(pCommand->m_State);
+
+	glVertexPointer(2, GL_FLOAT, sizeof(CCommandBuffer::CBufferVertex), pData);
+	glTexCoordPointer(3, GL_FLOAT, sizeof(CCommandBuffer::CBufferVertex), pData + sizeof(float)*2);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glColor4f(pCommand->m_Color.r, pCommand->m_Color.g, pCommand->m_Color.b, pCommand->m_Color.a);
+
+	glDrawArrays(GL_QUADS, pCommand->m_PrimStart*4, pCommand->m_PrimCount*4);
+
+	if(pBuffer->m_Vbo)
+		m_pfnBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 void CCommandProcessorFragment_OpenGL::Cmd_Screenshot(const CCommandBuffer::CScreenshotCommand *pCommand)
 {
 	// fetch image data
@@ -506,6 +570,11 @@ void CCommandProcessorFragment_OpenGL::Cmd_Screenshot(const CCommandBuffer::CScr
 CCommandProcessorFragment_OpenGL::CCommandProcessorFragment_OpenGL()
 {
 	mem_zero(m_aTextures, sizeof(m_aTextures));
+	mem_zero(m_aBuffers, sizeof(m_aBuffers));
+	m_pfnGenBuffers = 0;
+	m_pfnBindBuffer = 0;
+	m_pfnBufferData = 0;
+	m_pfnDeleteBuffers = 0;
 	m_pTextureMemoryUsage = 0;
 }
 
@@ -517,8 +586,11 @@ bool CCommandProcessorFragment_OpenGL::RunCommand(const CCommandBuffer::CCommand
 	case CCommandBuffer::CMD_TEXTURE_CREATE: Cmd_Texture_Create(static_cast<const CCommandBuffer::CTextureCreateCommand *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_TEXTURE_DESTROY: Cmd_Texture_Destroy(static_cast<const CCommandBuffer::CTextureDestroyCommand *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_TEXTURE_UPDATE: Cmd_Texture_Update(static_cast<const CCommandBuffer::CTextureUpdateCommand *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_BUFFER_CREATE: Cmd_Buffer_Create(static_cast<const CCommandBuffer::CBufferCreateCommand *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_BUFFER_DESTROY: Cmd_Buffer_Destroy(static_cast<const CCommandBuffer::CBufferDestroyCommand *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_CLEAR: Cmd_Clear(static_cast<const CCommandBuffer::CClearCommand *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_RENDER: Cmd_Render(static_cast<const CCommandBuffer::CRenderCommand *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_RENDER_BUFFER: Cmd_Render_Buffer(static_cast<const CCommandBuffer::CRenderBufferCommand *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_SCREENSHOT: Cmd_Screenshot(static_cast<const CCommandBuffer::CScreenshotCommand *>(pBaseCommand)); break;
 	default: return false;
 	}
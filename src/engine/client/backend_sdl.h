@@ -102,6 +102,20 @@ class CCommandProcessorFragment_OpenGL
 		int m_MemSize;
 	};
 	CTexture m_aTextures[CCommandBuffer::MAX_TEXTURES];
+
+	// falls back to client side vertex arrays if buffer objects are not available
+	class CBuffer
+	{
+	public:
+		GLuint m_Vbo;
+		CCommandBuffer::CBufferVertex *m_pVertices;
+	};
+	CBuffer m_aBuffers[CCommandBuffer::MAX_BUFFERS];
+	PFNGLGENBUFFERSPROC m_pfnGenBuffers;
+	PFNGLBINDBUFFERPROC m_pfnBindBuffer;
+	PFNGLBUFFERDATAPROC m_pfnBufferData;
+	PFNGLDELETEBUFFERSPROC m_pfnDeleteBuffers;
+
 	volatile int *m_pTextureMemoryUsage;
 	int m_MaxTexSize;
 	int m_Max3DTexSize;
@@ -131,8 +145,11 @@ private:
 	void Cmd_Texture_Update(const CCommandBuffer::CTextureUpdateCommand *pCommand);
 	void Cmd_Texture_Destroy(const CCommandBuffer::CTextureDestroyCommand *pCommand);
 	void Cmd_Texture_Create(const CCommandBuffer::CTextureCreateCommand *pCommand);
+	void Cmd_Buffer_Create(const CCommandBuffer::CBufferCreateCommand *pCommand);
+	void Cmd_Buffer_Destroy(const CCommandBuffer::CBufferDestroyCommand *pCommand);
 	void Cmd_Clear(const CCommandBuffer::CClearCommand *pCommand);
 	void Cmd_Render(const CCommandBuffer::CRenderCommand *pCommand);
+	void Cmd_Render_Buffer(const CCommandBuffer::CRenderBufferCommand *pCommand);
 	void Cmd_Screenshot(const CCommandBuffer::CScreenshotCommand *pCommand);
 
 public:
@@ -2165,6 +2165,8 @@ void CClient::Run()
 	GameClient()->OnShutdown();
 	Disconnect();
 
+	Kernel()->RequestInterface<IEngineTextRender>()->Shutdown();
+
 	m_pGraphics->Shutdown();
 	m_pSound->Shutdown();
 
@@ -2590,7 +2592,8 @@ int main(int argc, const char **argv) // ignore_convention
 
 	// create the components
 	int FlagMask = CFGFLAG_CLIENT;
-	IEngine *pEngine = CreateEngine("Teeworlds");
+	// enough workers to decode assets in parallel during startup
+	IEngine *pEngine = CreateEngine("Teeworlds", 4);
 	IConsole *pConsole = CreateConsole(FlagMask);
 	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_CLIENT, argc, argv); // ignore_convention
 	IConfigManager *pConfigManager = CreateConfigManager();
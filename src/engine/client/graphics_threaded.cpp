@@ -739,6 +739,115 @@ void CGraphics_Threaded::QuadsText(float x, float y, float Size, const char *pTe
 	}
 }
 
+IGraphics::CBufferHandle CGraphics_Threaded::CreateQuadBuffer(const CBufferQuad *pQuads, int Num)
+{
+	if(Num <= 0 || m_FirstFreeBuffer < 0)
+		return CBufferHandle();
+
+	// tiles spread over several 3d textures can't be drawn with one state
+	int Dimension = 2;
+	for(int i = 0; i < Num; i++)
+	{
+		if(pQuads[i].m_TextureIndex >= 0)
+		{
+			if(m_pBackend->GetTextureArraySize() > 1)
+				return CBufferHandle();
+			Dimension = 3;
+		}
+	}
+
+	// grab buffer
+	int Buffer = m_FirstFreeBuffer;
+	m_FirstFreeBuffer = m_aBufferIndices[Buffer];
+	m_aBufferIndices[Buffer] = -1;
+	m_aBufferDimensions[Buffer] = Dimension;
+
+	CCommandBuffer::CBufferVertex *pVertices = (CCommandBuffer::CBufferVertex *)mem_alloc(sizeof(CCommandBuffer::CBufferVertex)*Num*4, sizeof(void*));
+	for(int i = 0; i < Num; i++)
+	{
+		const CBufferQuad *pQuad = &pQuads[i];
+		CCommandBuffer::CBufferVertex *pVertex = &pVertices[i*4];
+		float TexIndex = (0.5f + pQuad->m_TextureIndex) / 256.0f;
+
+		pVertex[0].m_Pos.x = pQuad->m_X;
+		pVertex[0].m_Pos.y = pQuad->m_Y;
+		pVertex[1].m_Pos.x = pQuad->m_X + pQuad->m_Width;
+		pVertex[1].m_Pos.y = pQuad->m_Y;
+		pVertex[2].m_Pos.x = pQuad->m_X + pQuad->m_Width;
+		pVertex[2].m_Pos.y = pQuad->m_Y + pQuad->m_Height;
+		pVertex[3].m_Pos.x = pQuad->m_X;
+		pVertex[3].m_Pos.y = pQuad->m_Y + pQuad->m_Height;
+
+		for(int k = 0; k < 4; k++)
+		{
+			pVertex[k].m_Tex.u = pQuad->m_aU[k];
+			pVertex[k].m_Tex.v = pQuad->m_aV[k];
+			pVertex[k].m_Tex.i = TexIndex;
+		}
+	}
+
+	CCommandBuffer::CBufferCreateCommand Cmd;
+	Cmd.m_Slot = Buffer;
+	Cmd.m_NumVertices = Num*4;
+	Cmd.m_pVertices = pVertices;
+
+	if(!m_pCommandBuffer->AddCommand(Cmd))
+	{
+		KickCommandBuffer();
+		m_pCommandBuffer->AddCommand(Cmd);
+	}
+
+	return CreateBufferHandle(Buffer);
+}
+
+void CGraphics_Threaded::DestroyQuadBuffer(CBufferHandle *pBuffer)
+{
+	if(!pBuffer->IsValid())
+		return;
+
+	CCommandBuffer::CBufferDestroyCommand Cmd;
+	Cmd.m_Slot = pBuffer->Id();
+	if(!m_pCommandBuffer->AddCommand(Cmd))
+	{
+		KickCommandBuffer();
+		m_pCommandBuffer->AddCommand(Cmd);
+	}
+
+	m_aBufferIndices[pBuffer->Id()] = m_FirstFreeBuffer;
+	m_FirstFreeBuffer = pBuffer->Id();
+
+	pBuffer->Invalidate();
+}
+
+void CGraphics_Threaded::RenderQuadBuffer(CBufferHandle Buffer, int Start, int Num, vec4 Color)
+{
+	dbg_assert(m_Drawing == 0, "called Graphics()->RenderQuadBuffer within begin");
+
+	if(!Buffer.IsValid() || Num <= 0)
+		return;
+
+	CCommandBuffer::CRenderBufferCommand Cmd;
+	Cmd.m_State = m_State;
+	Cmd.m_State.m_Dimension = m_aBufferDimensions[Buffer.Id()];
+	Cmd.m_State.m_TextureArrayIndex = 0;
+	Cmd.m_Slot = Buffer.Id();
+	Cmd.m_PrimStart = Start;
+	Cmd.m_PrimCount = Num;
+	Cmd.m_Color.r = Color.r;
+	Cmd.m_Color.g = Color.g;
+	Cmd.m_Color.b = Color.b;
+	Cmd.m_Color.a = Color.a;
+
+	if(!m_pCommandBuffer->AddCommand(Cmd))
+	{
+		// kick command buffer and try again
+		KickCommandBuffer();
+
+		if(!m_pCommandBuffer->AddCommand(Cmd))
+			dbg_msg("graphics", "failed to allocate memory for render command");
+	}
+}
+
 int CGraphics_Threaded::IssueInit()
 {
 	int Flags = 0;
@@ -802,6 +911,12 @@ int CGraphics_Threaded::Init()
 		m_aTextureIndices[i] = i+1;
 	m_aTextureIndices[MAX_TEXTURES-1] = -1;
 
+	// init buffers
+	m_FirstFreeBuffer = 0;
+	for(int i = 0; i < MAX_BUFFERS-1; i++)
+		m_aBufferIndices[i] = i+1;
+	m_aBufferIndices[MAX_BUFFERS-1] = -1;
+
 	m_pBackend = CreateGraphicsBackend();
 	if(InitWindow() != 0)
 		return -1;
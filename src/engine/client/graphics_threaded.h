@@ -51,6 +51,7 @@ public:
 	enum
 	{
 		MAX_TEXTURES=1024*4,
+		MAX_BUFFERS=1024,
 	};
 
 	enum
@@ -74,9 +75,14 @@ public:
 		CMD_TEXTURE_DESTROY,
 		CMD_TEXTURE_UPDATE,
 
+		// buffer commands
+		CMD_BUFFER_CREATE,
+		CMD_BUFFER_DESTROY,
+
 		// rendering
 		CMD_CLEAR,
 		CMD_RENDER,
+		CMD_RENDER_BUFFER,
 
 		// swap
 		CMD_SWAP,
@@ -129,6 +135,13 @@ public:
 		CColor m_Color;
 	};
 
+	// vertices stored in a buffer are colored per draw call
+	struct CBufferVertex
+	{
+		CPoint m_Pos;
+		CTexCoord m_Tex;
+	};
+
 	struct CCommand
 	{
 	public:
@@ -183,6 +196,16 @@ public:
 		CVertex *m_pVertices; // you should use the command buffer data to allocate vertices for this command
 	};
 
+	struct CRenderBufferCommand : public CCommand
+	{
+		CRenderBufferCommand() : CCommand(CMD_RENDER_BUFFER) {}
+		CState m_State;
+		int m_Slot;
+		unsigned m_PrimStart;
+		unsigned m_PrimCount; // quads
+		CColor m_Color;
+	};
+
 	struct CScreenshotCommand : public CCommand
 	{
 		CScreenshotCommand() : CCommand(CMD_SCREENSHOT) {}
@@ -255,6 +278,22 @@ public:
 		int m_Slot;
 	};
 
+	struct CBufferCreateCommand : public CCommand
+	{
+		CBufferCreateCommand() : CCommand(CMD_BUFFER_CREATE) {}
+
+		int m_Slot;
+		int m_NumVertices;
+		CBufferVertex *m_pVertices; // will be freed by the command processor
+	};
+
+	struct CBufferDestroyCommand : public CCommand
+	{
+		CBufferDestroyCommand() : CCommand(CMD_BUFFER_DESTROY) {}
+
+		int m_Slot;
+	};
+
 	//
 	CCommandBuffer(unsigned CmdBufferSize, unsigned DataBufferSize)
 	: m_CmdBuffer(CmdBufferSize), m_DataBuffer(DataBufferSize)
@@ -346,6 +385,7 @@ class CGraphics_Threaded : public IEngineGraphics
 
 		MAX_VERTICES = 32*1024,
 		MAX_TEXTURES = 1024*4,
+		MAX_BUFFERS = 1024,
 
 		DRAWING_QUADS=1,
 		DRAWING_LINES=2
@@ -383,6 +423,10 @@ class CGraphics_Threaded : public IEngineGraphics
 	int m_FirstFreeTexture;
 	int m_TextureMemoryUsage;
 
+	int m_aBufferIndices[MAX_BUFFERS];
+	int m_aBufferDimensions[MAX_BUFFERS];
+	int m_FirstFreeBuffer;
+
 	void FlushVertices();
 	void AddVertices(int Count);
 	void Rotate4(const CCommandBuffer::CPoint &rCenter, CCommandBuffer::CVertex *pPoints);
@@ -447,6 +491,10 @@ public:
 	virtual void QuadsDrawFreeform(const CFreeformItem *pArray, int Num);
 	virtual void QuadsText(float x, float y, float Size, const char *pText);
 
+	virtual CBufferHandle CreateQuadBuffer(const CBufferQuad *pQuads, int Num);
+	virtual void DestroyQuadBuffer(CBufferHandle *pBuffer);
+	virtual void RenderQuadBuffer(CBufferHandle Buffer, int Start, int Num, vec4 Color);
+
 	virtual int GetNumScreens() const;
 	virtual void Minimize();
 	virtual void Maximize();
@@ -2,11 +2,13 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 
 #include <engine/graphics.h>
 #include <engine/storage.h>
 
 #include <engine/shared/config.h>
+#include <engine/shared/soundmix.h>
 
 #include "SDL.h"
 
@@ -18,11 +20,13 @@ extern "C"
 }
 #include <math.h>
 
+
 enum
 {
 	NUM_SAMPLES = 512,
 	NUM_VOICES = 64,
 	NUM_CHANNELS = 16,
+	NUM_COMMANDS = 256,
 };
 
 struct CSample
@@ -51,11 +55,38 @@ struct CVoice
 	int m_X, m_Y;
 };
 
+// voice events posted by the game thread, applied by the audio thread
+struct CSoundCommand
+{
+	enum
+	{
+		CMD_PLAY=0,
+		CMD_STOP,
+		CMD_STOPALL,
+		CMD_CHANNEL_VOLUME,
+	};
+
+	int m_Cmd;
+	int m_Voice;
+	int m_Sample;
+	int m_Channel;
+	int m_Flags;
+	int m_Vol;
+	int m_X, m_Y;
+};
+
 static CSample m_aSamples[NUM_SAMPLES] = {{0}};
-static CVoice m_aVoices[NUM_VOICES] = {{0}};
-static CChannel m_aChannels[NUM_CHANNELS];
+static CVoice m_aVoices[NUM_VOICES] = {{0}}; // owned by the audio thread
+static CChannel m_aChannels[NUM_CHANNELS]; // owned by the audio thread
+
+// single producer (game thread), single consumer (audio thread) command ring
+static CSoundCommand m_aCommands[NUM_COMMANDS];
+static volatile unsigned m_CommandWrite = 0;
+static volatile unsigned m_CommandRead = 0;
 
-static LOCK m_SoundLock = 0;
+// voice slots are claimed by the game thread and released by the audio thread
+static volatile unsigned m_aVoiceUsed[NUM_VOICES] = {0};
+static int m_aVoiceSample[NUM_VOICES]; // game thread view of the sample a voice plays, -1 once stopped
 
 static int m_CenterX = 0;
 static int m_CenterY = 0;
@@ -69,7 +100,7 @@ static int m_NextVoice = 0;
 static int *m_pMixBuffer = 0;	// buffer only used by the thread callback function
 static unsigned m_MaxFrames = 0;
 
-static IOHANDLE s_File;
+static LOCK m_LoadLock = 0;
 
 // TODO: there should be a faster way todo this
 static short Int2Short(int i)
@@ -81,14 +112,98 @@ static short Int2Short(int i)
 	return i;
 }
 
+static bool PushCommand(const CSoundCommand &Cmd)
+{
+	unsigned Write = m_CommandWrite;
+	if(Write - m_CommandRead >= (unsigned)NUM_COMMANDS)
+		return false;
+
+	m_aCommands[Write%NUM_COMMANDS] = Cmd;
+	sync_barrier(); // publish the command before moving the write index
+	m_CommandWrite = Write+1;
+	return true;
+}
+
+static void FreeVoice(int VoiceID)
+{
+	CVoice *v = &m_aVoices[VoiceID];
+	if(v->m_Flags&ISound::FLAG_LOOP)
+		v->m_pSample->m_PausedAt = v->m_Tick;
+	else
+		v->m_pSample->m_PausedAt = 0;
+	v->m_pSample = 0;
+}
+
+static void ReleaseVoice(int VoiceID)
+{
+	sync_barrier(); // make sure we are done with the voice before the game thread can reuse it
+	m_aVoiceUsed[VoiceID] = 0;
+}
+
+static void ProcessCommands()
+{
+	unsigned Read = m_CommandRead;
+	unsigned Write = m_CommandWrite;
+	sync_barrier();
+
+	for(; Read != Write; Read++)
+	{
+		const CSoundCommand *pCmd = &m_aCommands[Read%NUM_COMMANDS];
+		switch(pCmd->m_Cmd)
+		{
+		case CSoundCommand::CMD_PLAY:
+			{
+				CVoice *v = &m_aVoices[pCmd->m_Voice];
+				v->m_pSample = &m_aSamples[pCmd->m_Sample];
+				v->m_pChannel = &m_aChannels[pCmd->m_Channel];
+				if(pCmd->m_Flags&ISound::FLAG_LOOP)
+					v->m_Tick = v->m_pSample->m_PausedAt;
+				else
+					v->m_Tick = 0;
+				v->m_Vol = 255;
+				v->m_Flags = pCmd->m_Flags;
+				v->m_X = pCmd->m_X;
+				v->m_Y = pCmd->m_Y;
+			}
+			break;
+		case CSoundCommand::CMD_STOP:
+			for(int i = 0; i < NUM_VOICES; i++)
+			{
+				if(m_aVoices[i].m_pSample == &m_aSamples[pCmd->m_Sample])
+				{
+					FreeVoice(i);
+					ReleaseVoice(i);
+				}
+			}
+			break;
+		case CSoundCommand::CMD_STOPALL:
+			for(int i = 0; i < NUM_VOICES; i++)
+			{
+				if(m_aVoices[i].m_pSample)
+				{
+					FreeVoice(i);
+					ReleaseVoice(i);
+				}
+			}
+			break;
+		case CSoundCommand::CMD_CHANNEL_VOLUME:
+			m_aChannels[pCmd->m_Channel].m_Vol = pCmd->m_Vol;
+			break;
+		}
+	}
+
+	sync_barrier();
+	m_CommandRead = Read;
+}
+
 static void Mix(short *pFinalOut, unsigned Frames)
 {
 	int MasterVol;
 	mem_zero(m_pMixBuffer, m_MaxFrames*2*sizeof(int));
 	Frames = minimum(Frames, m_MaxFrames);
 
-	// aquire lock while we are mixing
-	lock_wait(m_SoundLock);
+	// apply the voice events the game thread posted since the last pass
+	ProcessCommands();
 
 	MasterVol = m_SoundVolume;
 
@@ -98,12 +213,8 @@ static void Mix(short *pFinalOut, unsigned Frames)
 		{
 			// mix voice
 			CVoice *v = &m_aVoices[i];
-			int *pOut = m_pMixBuffer;
 
 			int Step = v->m_pSample->m_Channels; // setup input sources
-			short *pInL = &v->m_pSample->m_pData[v->m_Tick*Step];
-			short *pInR = &v->m_pSample->m_pData[v->m_Tick*Step+1];
-
 			unsigned End = v->m_pSample->m_NumFrames-v->m_Tick;
 
 			int Rvol = v->m_pChannel->m_Vol;
@@ -113,10 +224,6 @@ static void Mix(short *pFinalOut, unsigned Frames)
 			if(Frames < End)
 				End = Frames;
 
-			// check if we have a mono sound
-			if(v->m_pSample->m_Channels == 1)
-				pInR = pInL;
-
 			// volume calculation
 			if(v->m_Flags&ISound::FLAG_POS)
 			{
@@ -151,14 +258,8 @@ static void Mix(short *pFinalOut, unsigned Frames)
 			}
 
 			// process all frames
-			for(unsigned s = 0; s < End; s++)
-			{
-				*pOut++ += (*pInL)*Lvol;
-				*pOut++ += (*pInR)*Rvol;
-				pInL += Step;
-				pInR += Step;
-				v->m_Tick++;
-			}
+			MixFrames(m_pMixBuffer, &v->m_pSample->m_pData[v->m_Tick*Step], Step, End, Lvol, Rvol);
+			v->m_Tick += End;
 
 			// free voice if not used any more
 			if(v->m_Tick == v->m_pSample->m_NumFrames)
@@ -166,15 +267,14 @@ static void Mix(short *pFinalOut, unsigned Frames)
 				if(v->m_Flags&ISound::FLAG_LOOP)
 					v->m_Tick = 0;
 				else
+				{
 					v->m_pSample = 0;
+					ReleaseVoice(i);
+				}
 			}
 		}
 	}
 
-
-	// release the lock
-	lock_unlock(m_SoundLock);
-
 	{
 		// clamp accumulated values
 		// TODO: this seams slow
@@ -205,6 +305,8 @@ int CSound::Init()
 {
 	for(int i = 0; i < NUM_CHANNELS; ++i)
 		m_aChannels[i].m_Vol = 255;
+	for(int i = 0; i < NUM_VOICES; ++i)
+		m_aVoiceSample[i] = -1;
 
 	m_SoundEnabled = 0;
 	m_pConfig = Kernel()->RequestInterface<IConfigManager>()->Values();
@@ -213,7 +315,7 @@ int CSound::Init()
 
 	SDL_AudioSpec Format;
 
-	m_SoundLock = lock_create();
+	m_LoadLock = lock_create();
 
 	if(!m_pConfig->m_SndInit)
 		return 0;
@@ -262,11 +364,7 @@ int CSound::Update()
 		WantedVolume = 0;
 
 	if(WantedVolume != m_SoundVolume)
-	{
-		lock_wait(m_SoundLock);
 		m_SoundVolume = WantedVolume;
-		lock_unlock(m_SoundLock);
-	}
 
 	return 0;
 }
@@ -275,7 +373,7 @@ int CSound::Shutdown()
 {
 	SDL_CloseAudio();
 	SDL_QuitSubSystem(SDL_INIT_AUDIO);
-	lock_destroy(m_SoundLock);
+	lock_destroy(m_LoadLock);
 	if(m_pMixBuffer)
 	{
 		mem_free(m_pMixBuffer);
@@ -296,9 +394,8 @@ int CSound::AllocID()
 	return -1;
 }
 
-void CSound::RateConvert(int SampleID)
+void CSound::RateConvert(CSample *pSample)
 {
-	CSample *pSample = &m_aSamples[SampleID];
 	int NumFrames = 0;
 	short *pNewData = 0;
 
@@ -334,16 +431,11 @@ void CSound::RateConvert(int SampleID)
 	pSample->m_NumFrames = NumFrames;
 }
 
-static int ReadDataOld(void *pBuffer, int Size)
-{
-	return io_read(s_File, pBuffer, Size);
-}
-
 #if defined(CONF_WAVPACK_OPEN_FILE_INPUT_EX)
+// the file is passed as stream id, so several samples can be decoded at once
 static int ReadData(void *pId, void *pBuffer, int Size)
 {
-	(void)pId;
-	return ReadDataOld(pBuffer, Size);
+	return io_read((IOHANDLE)pId, pBuffer, Size);
 }
 
 static int ReturnFalse(void *pId)
@@ -354,30 +446,92 @@ static int ReturnFalse(void *pId)
 
 static unsigned int GetPos(void *pId)
 {
-	(void)pId;
-	return io_tell(s_File);
+	return io_tell((IOHANDLE)pId);
 }
 
 static unsigned int GetLength(void *pId)
 {
-	(void)pId;
-	return io_length(s_File);
+	return io_length((IOHANDLE)pId);
 }
 
 static int PushBackByte(void *pId, int Char)
 {
-	(void)pId;
-	return io_unread_byte(s_File, Char);
+	return io_unread_byte((IOHANDLE)pId, Char);
+}
+#else
+// the old reader has no stream id, decoding is serialized through m_LoadLock
+static IOHANDLE s_File;
+
+static int ReadDataOld(void *pBuffer, int Size)
+{
+	return io_read(s_File, pBuffer, Size);
 }
 #endif
 
-ISound::CSampleHandle CSound::LoadWV(const char *pFilename)
+bool CSound::DecodeWV(CSample *pSample, IOHANDLE File, const char *pFilename)
 {
-	CSample *pSample;
-	int SampleID = -1;
 	char aError[100];
 	WavpackContext *pContext;
 
+#if defined(CONF_WAVPACK_OPEN_FILE_INPUT_EX)
+	WavpackStreamReader Callback = {0};
+	Callback.can_seek = ReturnFalse;
+	Callback.get_length = GetLength;
+	Callback.get_pos = GetPos;
+	Callback.push_back_byte = PushBackByte;
+	Callback.read_bytes = ReadData;
+	pContext = WavpackOpenFileInputEx(&Callback, (void *)File, 0, aError, 0, 0);
+#else
+	s_File = File;
+	pContext = WavpackOpenFileInput(ReadDataOld, aError);
+#endif
+	if(!pContext)
+	{
+		dbg_msg("sound/wv", "failed to open %s: %s", pFilename, aError);
+		return false;
+	}
+
+	int NumSamples = WavpackGetNumSamples(pContext);
+	int BitsPerSample = WavpackGetBitsPerSample(pContext);
+	unsigned int SampleRate = WavpackGetSampleRate(pContext);
+	int NumChannels = WavpackGetNumChannels(pContext);
+
+	pSample->m_Channels = NumChannels;
+	pSample->m_Rate = SampleRate;
+
+	if(pSample->m_Channels > 2)
+	{
+		dbg_msg("sound/wv", "file is not mono or stereo. filename='%s'", pFilename);
+		return false;
+	}
+
+	if(BitsPerSample != 16)
+	{
+		dbg_msg("sound/wv", "bps is %d, not 16, filname='%s'", BitsPerSample, pFilename);
+		return false;
+	}
+
+	int *pData = (int *)mem_alloc(4*NumSamples*NumChannels, 1);
+	WavpackUnpackSamples(pContext, pData, NumSamples); // TODO: check return value
+	int *pSrc = pData;
+
+	pSample->m_pData = (short *)mem_alloc(2*NumSamples*NumChannels, 1);
+	short *pDst = pSample->m_pData;
+
+	for(int i = 0; i < NumSamples*NumChannels; i++)
+		*pDst++ = (short)*pSrc++;
+
+	mem_free(pData);
+
+	pSample->m_NumFrames = NumSamples;
+	pSample->m_LoopStart = -1;
+	pSample->m_LoopEnd = -1;
+	pSample->m_PausedAt = 0;
+	return true;
+}
+
+ISound::CSampleHandle CSound::LoadWV(const char *pFilename)
+{
 	// don't waste memory on sound when we are stress testing
 	if(m_pConfig->m_DbgStress)
 		return CSampleHandle();
@@ -389,105 +543,48 @@ ISound::CSampleHandle CSound::LoadWV(const char *pFilename)
 	if(!m_pStorage)
 		return CSampleHandle();
 
-	lock_wait(m_SoundLock);
-	s_File = m_pStorage->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ALL);
-	if(!s_File)
+	IOHANDLE File = m_pStorage->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(!File)
 	{
 		dbg_msg("sound/wv", "failed to open file. filename='%s'", pFilename);
-		lock_unlock(m_SoundLock);
-		return CSampleHandle();
-	}
-
-	SampleID = AllocID();
-	if(SampleID < 0)
-	{
-		io_close(s_File);
-		s_File = 0;
-		lock_unlock(m_SoundLock);
 		return CSampleHandle();
 	}
-	pSample = &m_aSamples[SampleID];
 
+	// decode and resample outside of the sample table, this can run on several job threads
+	CSample Sample = {0};
 #if defined(CONF_WAVPACK_OPEN_FILE_INPUT_EX)
-	WavpackStreamReader Callback = {0};
-	Callback.can_seek = ReturnFalse;
-	Callback.get_length = GetLength;
-	Callback.get_pos = GetPos;
-	Callback.push_back_byte = PushBackByte;
-	Callback.read_bytes = ReadData;
-	pContext = WavpackOpenFileInputEx(&Callback, (void *)1, 0, aError, 0, 0);
+	bool Decoded = DecodeWV(&Sample, File, pFilename);
 #else
-	pContext = WavpackOpenFileInput(ReadDataOld, aError);
+	lock_wait(m_LoadLock);
+	bool Decoded = DecodeWV(&Sample, File, pFilename);
+	lock_unlock(m_LoadLock);
 #endif
-	if (pContext)
-	{
-		int m_aSamples = WavpackGetNumSamples(pContext);
-		int BitsPerSample = WavpackGetBitsPerSample(pContext);
-		unsigned int SampleRate = WavpackGetSampleRate(pContext);
-		int m_aChannels = WavpackGetNumChannels(pContext);
-		int *pData;
-		int *pSrc;
-		short *pDst;
-		int i;
-
-		pSample->m_Channels = m_aChannels;
-		pSample->m_Rate = SampleRate;
-
-		if(pSample->m_Channels > 2)
-		{
-			dbg_msg("sound/wv", "file is not mono or stereo. filename='%s'", pFilename);
-			io_close(s_File);
-			s_File = 0;
-			lock_unlock(m_SoundLock);
-			return CSampleHandle();
-		}
-
-		/*
-		if(snd->rate != 44100)
-		{
-			dbg_msg("sound/wv", "file is %d Hz, not 44100 Hz. filename='%s'", snd->rate, filename);
-			return -1;
-		}*/
-
-		if(BitsPerSample != 16)
-		{
-			dbg_msg("sound/wv", "bps is %d, not 16, filname='%s'", BitsPerSample, pFilename);
-			io_close(s_File);
-			s_File = 0;
-			lock_unlock(m_SoundLock);
-			return CSampleHandle();
-		}
-
-		pData = (int *)mem_alloc(4*m_aSamples*m_aChannels, 1);
-		WavpackUnpackSamples(pContext, pData, m_aSamples); // TODO: check return value
-		pSrc = pData;
+	io_close(File);
 
-		pSample->m_pData = (short *)mem_alloc(2*m_aSamples*m_aChannels, 1);
-		pDst = pSample->m_pData;
+	if(!Decoded)
+	{
+		if(Sample.m_pData)
+			mem_free(Sample.m_pData);
+		return CSampleHandle();
+	}
 
-		for (i = 0; i < m_aSamples*m_aChannels; i++)
-			*pDst++ = (short)*pSrc++;
+	RateConvert(&Sample);
 
-		mem_free(pData);
+	lock_wait(m_LoadLock);
+	int SampleID = AllocID();
+	if(SampleID >= 0)
+		m_aSamples[SampleID] = Sample;
+	lock_unlock(m_LoadLock);
 
-		pSample->m_NumFrames = m_aSamples;
-		pSample->m_LoopStart = -1;
-		pSample->m_LoopEnd = -1;
-		pSample->m_PausedAt = 0;
-	}
-	else
+	if(SampleID < 0)
 	{
-		dbg_msg("sound/wv", "failed to open %s: %s", pFilename, aError);
+		mem_free(Sample.m_pData);
+		return CSampleHandle();
 	}
 
-	io_close(s_File);
-	s_File = NULL;
-
 	if(m_pConfig->m_Debug)
 		dbg_msg("sound/wv", "loaded %s", pFilename);
 
-	RateConvert(SampleID);
-	lock_unlock(m_SoundLock);
 	return CreateSampleHandle(SampleID);
 }
 
@@ -504,24 +601,34 @@ void CSound::SetMaxDistance(float Distance)
 
 void CSound::SetChannelVolume(int ChannelID, float Vol)
 {
-	m_aChannels[ChannelID].m_Vol = (int)(Vol*255.0f);
+	// no mixer running, nothing to synchronize with
+	if(!m_SoundEnabled)
+	{
+		m_aChannels[ChannelID].m_Vol = (int)(Vol*255.0f);
+		return;
+	}
+
+	CSoundCommand Cmd;
+	Cmd.m_Cmd = CSoundCommand::CMD_CHANNEL_VOLUME;
+	Cmd.m_Channel = ChannelID;
+	Cmd.m_Vol = (int)(Vol*255.0f);
+	if(!PushCommand(Cmd))
+		dbg_msg("client/sound", "command queue full, dropping channel volume change");
 }
 
 int CSound::Play(int ChannelID, CSampleHandle SampleID, int Flags, float x, float y)
 {
-	if(!SampleID.IsValid())
+	if(!SampleID.IsValid() || !m_SoundEnabled)
 		return -1;
 
 	int VoiceID = -1;
 	int i;
 
-	lock_wait(m_SoundLock);
-
 	// search for voice
 	for(i = 0; i < NUM_VOICES; i++)
 	{
 		int id = (m_NextVoice + i) % NUM_VOICES;
-		if(!m_aVoices[id].m_pSample)
+		if(!m_aVoiceUsed[id])
 		{
 			VoiceID = id;
 			m_NextVoice = id+1;
@@ -529,22 +636,28 @@ int CSound::Play(int ChannelID, CSampleHandle SampleID, int Flags, float x, floa
 		}
 	}
 
-	// voice found, use it
+	// voice found, hand it to the mixer
 	if(VoiceID != -1)
 	{
-		m_aVoices[VoiceID].m_pSample = &m_aSamples[SampleID.Id()];
-		m_aVoices[VoiceID].m_pChannel = &m_aChannels[ChannelID];
-		if(Flags & FLAG_LOOP)
-			m_aVoices[VoiceID].m_Tick = m_aSamples[SampleID.Id()].m_PausedAt;
-		else
-			m_aVoices[VoiceID].m_Tick = 0;
-		m_aVoices[VoiceID].m_Vol = 255;
-		m_aVoices[VoiceID].m_Flags = Flags;
-		m_aVoices[VoiceID].m_X = (int)x;
-		m_aVoices[VoiceID].m_Y = (int)y;
+		CSoundCommand Cmd;
+		Cmd.m_Cmd = CSoundCommand::CMD_PLAY;
+		Cmd.m_Voice = VoiceID;
+		Cmd.m_Sample = SampleID.Id();
+		Cmd.m_Channel = ChannelID;
+		Cmd.m_Flags = Flags;
+		Cmd.m_X = (int)x;
+		Cmd.m_Y = (int)y;
+
+		m_aVoiceUsed[VoiceID] = 1;
+		m_aVoiceSample[VoiceID] = SampleID.Id();
+		if(!PushCommand(Cmd))
+		{
+			m_aVoiceUsed[VoiceID] = 0;
+			m_aVoiceSample[VoiceID] = -1;
+			VoiceID = -1;
+		}
 	}
 
-	lock_unlock(m_SoundLock);
 	return VoiceID;
 }
 
@@ -561,54 +674,51 @@ int CSound::Play(int ChannelID, CSampleHandle SampleID, int Flags)
 void CSound::Stop(CSampleHandle SampleID)
 {
 	// TODO: a nice fade out
-	lock_wait(m_SoundLock);
-	CSample *pSample = &m_aSamples[SampleID.Id()];
+	if(!m_SoundEnabled)
+		return;
+
+	CSoundCommand Cmd;
+	Cmd.m_Cmd = CSoundCommand::CMD_STOP;
+	Cmd.m_Sample = SampleID.Id();
+	if(!PushCommand(Cmd))
+	{
+		dbg_msg("client/sound", "command queue full, dropping stop");
+		return;
+	}
+
 	for(int i = 0; i < NUM_VOICES; i++)
 	{
-		if(m_aVoices[i].m_pSample == pSample)
-		{
-			if(m_aVoices[i].m_Flags & FLAG_LOOP)
-				m_aVoices[i].m_pSample->m_PausedAt = m_aVoices[i].m_Tick;
-			else
-				m_aVoices[i].m_pSample->m_PausedAt = 0;
-			m_aVoices[i].m_pSample = 0;
-		}
+		if(m_aVoiceSample[i] == SampleID.Id())
+			m_aVoiceSample[i] = -1;
 	}
-	lock_unlock(m_SoundLock);
 }
 
 void CSound::StopAll()
 {
 	// TODO: a nice fade out
-	lock_wait(m_SoundLock);
-	for(int i = 0; i < NUM_VOICES; i++)
+	if(!m_SoundEnabled)
+		return;
+
+	CSoundCommand Cmd;
+	Cmd.m_Cmd = CSoundCommand::CMD_STOPALL;
+	if(!PushCommand(Cmd))
 	{
-		if(m_aVoices[i].m_pSample)
-		{
-			if(m_aVoices[i].m_Flags & FLAG_LOOP)
-				m_aVoices[i].m_pSample->m_PausedAt = m_aVoices[i].m_Tick;
-			else
-				m_aVoices[i].m_pSample->m_PausedAt = 0;
-		}
-		m_aVoices[i].m_pSample = 0;
+		dbg_msg("client/sound", "command queue full, dropping stop");
+		return;
 	}
-	lock_unlock(m_SoundLock);
+
+	for(int i = 0; i < NUM_VOICES; i++)
+		m_aVoiceSample[i] = -1;
 }
 
 bool CSound::IsPlaying(CSampleHandle SampleID)
 {
-	bool Ret = false;
-	lock_wait(m_SoundLock);
-	CSample *pSample = &m_aSamples[SampleID.Id()];
 	for(int i = 0; i < NUM_VOICES; i++)
 	{
-		if(m_aVoices[i].m_pSample == pSample)
-		{
-			Ret = true;
-		}
+		if(m_aVoiceUsed[i] && m_aVoiceSample[i] == SampleID.Id())
+			return true;
 	}
-	lock_unlock(m_SoundLock);
-	return Ret;
+	return false;
 }
 
 IEngineSound *CreateEngineSound() { return new CSound; }
@@ -20,7 +20,8 @@ public:
 	int Shutdown();
 	int AllocID();
 
-	static void RateConvert(int SampleID);
+	static void RateConvert(struct CSample *pSample);
+	static bool DecodeWV(struct CSample *pSample, IOHANDLE File, const char *pFilename);
 
 	virtual bool IsSoundEnabled() { return m_SoundEnabled != 0; }
 
@@ -1,10 +1,18 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/hash.h>
 #include <base/system.h>
 #include <base/math.h>
 #include <engine/graphics.h>
+#include <engine/storage.h>
 #include <engine/textrender.h>
 
+#if defined(CONF_SIMD_SSE2)
+	#include <emmintrin.h>
+#elif defined(CONF_SIMD_NEON)
+	#include <arm_neon.h>
+#endif
+
 #ifdef CONF_FAMILY_WINDOWS
 	#include <windows.h>
 #endif
@@ -17,6 +25,13 @@
 enum
 {
 	MAX_CHARACTERS = 64,
+	CHAR_LOOKUP_SIZE = 1024,
+	WIDTH_CACHE_SIZE = 256,
+	WIDTH_CACHE_MAX_TEXT = 64,
+	FONT_CACHE_VERSION = 1,
+	GLYPH_CACHE_VERSION = 1,
+	MAX_GLYPH_CELL = 1024/8, // glyph scratch buffers are MAX_GLYPH_CELL*MAX_GLYPH_CELL
+	MAX_CACHED_GLYPHS = 1<<16,
 };
 
 
@@ -37,6 +52,37 @@ struct CFontChar
 
 	float m_aUvs[4];
 	int64 m_TouchTime;
+
+	int m_NextInBucket;
+};
+
+// a rasterised glyph bitmap, kept in memory and in the on-disk glyph cache
+struct CCachedGlyph
+{
+	int m_Chr;
+	int m_Width;
+	int m_Rows;
+	int m_Left;
+	int m_Top;
+	int m_AdvanceX;
+	int m_DataOffset;
+	int m_NextInBucket;
+};
+
+// rasterised glyphs of one font size, 8 bit coverage
+struct CGlyphCache
+{
+	CCachedGlyph *m_pGlyphs;
+	int m_NumGlyphs;
+	int m_GlyphCapacity;
+
+	unsigned char *m_pData;
+	int m_DataSize;
+	int m_DataCapacity;
+
+	int m_aLookup[CHAR_LOOKUP_SIZE];
+	bool m_Loaded;
+	bool m_Dirty;
 };
 
 struct CFontSizeData
@@ -55,6 +101,7 @@ struct CFontSizeData
 	int m_CharMaxHeight;
 
 	CFontChar m_aCharacters[MAX_CHARACTERS*MAX_CHARACTERS];
+	int m_aCharLookup[CHAR_LOOKUP_SIZE]; // first slot of each bucket, -1 if empty
 
 	int m_CurrentCharacter;
 };
@@ -65,6 +112,46 @@ public:
 	char m_aFilename[IO_MAX_PATH_LENGTH];
 	FT_Face m_FtFace;
 	CFontSizeData m_aSizes[NUM_FONT_SIZES];
+
+	// cell sizes of each font size, persisted so that the face does not have to be scanned again
+	SHA256_DIGEST m_Hash;
+	int m_aCellWidth[NUM_FONT_SIZES];
+	int m_aCellHeight[NUM_FONT_SIZES];
+
+	// glyph bitmaps of each font size, persisted so that glyphs do not have to be rasterised again
+	CGlyphCache m_aGlyphCache[NUM_FONT_SIZES];
+};
+
+// on-disk layout of the font cell cache
+struct CFontCacheHeader
+{
+	char m_aMagic[4];
+	int m_Version;
+	int m_NumSizes;
+};
+
+// on-disk layout of a glyph cache, followed by the glyphs and their bitmaps
+struct CGlyphCacheHeader
+{
+	char m_aMagic[4];
+	int m_Version;
+	int m_FreetypeVersion;
+	int m_FontSize;
+	int m_NumGlyphs;
+	int m_DataSize;
+};
+
+// result of a previous TextWidth call
+struct CTextWidthEntry
+{
+	char m_aText[WIDTH_CACHE_MAX_TEXT];
+	int m_Length;
+	CFont *m_pFont;
+	float m_Size;
+	float m_LineWidth;
+	float m_ScreenScaleX;
+	float m_ScreenScaleY;
+	float m_Width;
 };
 
 struct CQuadChar
@@ -76,7 +163,9 @@ struct CQuadChar
 class CTextRender : public IEngineTextRender
 {
 	IGraphics *m_pGraphics;
+	IStorage *m_pStorage;
 	IGraphics *Graphics() { return m_pGraphics; }
+	IStorage *Storage() { return m_pStorage; }
 
 	int WordLength(const char *pText)
 	{
@@ -108,6 +197,8 @@ class CTextRender : public IEngineTextRender
 
 	FT_Library m_FTLibrary;
 
+	CTextWidthEntry m_aWidthCache[WIDTH_CACHE_SIZE];
+
 	int GetFontSizeIndex(int Pixelsize)
 	{
 		for(unsigned i = 0; i < NUM_FONT_SIZES; i++)
@@ -121,28 +212,53 @@ class CTextRender : public IEngineTextRender
 
 
 
+	// 3x3 max filter, done as a vertical and a horizontal pass
 	void Grow(unsigned char *pIn, unsigned char *pOut, int w, int h)
 	{
+		unsigned char *pTmp = ms_aGlyphDataGrow;
+
 		for(int y = 0; y < h; y++)
-			for(int x = 0; x < w; x++)
+		{
+			const unsigned char *pAbove = &pIn[maximum(y-1, 0)*w];
+			const unsigned char *pRow = &pIn[y*w];
+			const unsigned char *pBelow = &pIn[minimum(y+1, h-1)*w];
+			unsigned char *pDst = &pTmp[y*w];
+			int x = 0;
+#if defined(CONF_SIMD_SSE2)
+			for(; x+16 <= w; x += 16)
 			{
-				int c = pIn[y*w+x];
-
-				for(int sy = -1; sy <= 1; sy++)
-					for(int sx = -1; sx <= 1; sx++)
-					{
-						int GetX = x+sx;
-						int GetY = y+sy;
-						if (GetX >= 0 && GetY >= 0 && GetX < w && GetY < h)
-						{
-							int Index = GetY*w+GetX;
-							if(pIn[Index] > c)
-								c = pIn[Index];
-						}
-					}
+				__m128i Max = _mm_max_epu8(_mm_loadu_si128((const __m128i *)(pAbove+x)), _mm_loadu_si128((const __m128i *)(pRow+x)));
+				_mm_storeu_si128((__m128i *)(pDst+x), _mm_max_epu8(Max, _mm_loadu_si128((const __m128i *)(pBelow+x))));
+			}
+#elif defined(CONF_SIMD_NEON)
+			for(; x+16 <= w; x += 16)
+				vst1q_u8(pDst+x, vmaxq_u8(vmaxq_u8(vld1q_u8(pAbove+x), vld1q_u8(pRow+x)), vld1q_u8(pBelow+x)));
+#endif
+			for(; x < w; x++)
+				pDst[x] = maximum(maximum(pAbove[x], pRow[x]), pBelow[x]);
+		}
 
-				pOut[y*w+x] = c;
+		for(int y = 0; y < h; y++)
+		{
+			const unsigned char *pRow = &pTmp[y*w];
+			unsigned char *pDst = &pOut[y*w];
+			pDst[0] = w > 1 ? maximum(pRow[0], pRow[1]) : pRow[0];
+			int x = 1;
+#if defined(CONF_SIMD_SSE2)
+			for(; x+17 <= w; x += 16)
+			{
+				__m128i Max = _mm_max_epu8(_mm_loadu_si128((const __m128i *)(pRow+x-1)), _mm_loadu_si128((const __m128i *)(pRow+x)));
+				_mm_storeu_si128((__m128i *)(pDst+x), _mm_max_epu8(Max, _mm_loadu_si128((const __m128i *)(pRow+x+1))));
 			}
+#elif defined(CONF_SIMD_NEON)
+			for(; x+17 <= w; x += 16)
+				vst1q_u8(pDst+x, vmaxq_u8(vmaxq_u8(vld1q_u8(pRow+x-1), vld1q_u8(pRow+x)), vld1q_u8(pRow+x+1)));
+#endif
+			for(; x < w-1; x++)
+				pDst[x] = maximum(maximum(pRow[x-1], pRow[x]), pRow[x+1]);
+			if(w > 1)
+				pDst[w-1] = maximum(pRow[w-2], pRow[w-1]);
+		}
 	}
 
 	void InitTexture(CFontSizeData *pSizeData, int CharWidth, int CharHeight, int Xchars, int Ychars)
@@ -170,6 +286,8 @@ class CTextRender : public IEngineTextRender
 		pSizeData->m_TextureWidth = Width;
 		pSizeData->m_TextureHeight = Height;
 		pSizeData->m_CurrentCharacter = 0;
+		for(int i = 0; i < CHAR_LOOKUP_SIZE; i++)
+			pSizeData->m_aCharLookup[i] = -1;
 
 		dbg_msg("pFont", "memory usage: %d", FontMemoryUsage);
 
@@ -205,6 +323,12 @@ class CTextRender : public IEngineTextRender
 
 		int OutlineThickness = AdjustOutlineThicknessToFontSize(1, pSizeData->m_FontSize);
 
+		if(pFont->m_aCellWidth[Index] > 0 && pFont->m_aCellHeight[Index] > 0)
+		{
+			pSizeData->m_CharMaxWidth = pFont->m_aCellWidth[Index];
+			pSizeData->m_CharMaxHeight = pFont->m_aCellHeight[Index];
+		}
+		else
 		{
 			unsigned GlyphIndex;
 			int MaxH = 0;
@@ -226,13 +350,278 @@ class CTextRender : public IEngineTextRender
 
 			for(pSizeData->m_CharMaxWidth = 1; pSizeData->m_CharMaxWidth < MaxW; pSizeData->m_CharMaxWidth <<= 1);
 			for(pSizeData->m_CharMaxHeight = 1; pSizeData->m_CharMaxHeight < MaxH; pSizeData->m_CharMaxHeight <<= 1);
+
+			pFont->m_aCellWidth[Index] = pSizeData->m_CharMaxWidth;
+			pFont->m_aCellHeight[Index] = pSizeData->m_CharMaxHeight;
+			SaveFontCache(pFont);
 		}
 
+		LoadGlyphCache(pFont, Index);
+
 		//dbg_msg("pFont", "init size %d, texture size %d %d", pFont->sizes[index].font_size, w, h);
 		//FT_New_Face(m_FTLibrary, "data/fonts/vera.ttf", 0, &pFont->ft_face);
 		InitTexture(pSizeData, pSizeData->m_CharMaxWidth, pSizeData->m_CharMaxHeight, 8, 8);
 	}
 
+	void GetFontCacheFilename(CFont *pFont, char *pBuf, int BufSize)
+	{
+		char aHash[SHA256_MAXSTRSIZE];
+		sha256_str(pFont->m_Hash, aHash, sizeof(aHash));
+		str_format(pBuf, BufSize, "fontcache/%s.dat", aHash);
+	}
+
+	void LoadFontCache(CFont *pFont)
+	{
+		if(!Storage())
+			return;
+
+		char aFilename[IO_MAX_PATH_LENGTH];
+		GetFontCacheFilename(pFont, aFilename, sizeof(aFilename));
+		IOHANDLE File = Storage()->OpenFile(aFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+		if(!File)
+			return;
+
+		CFontCacheHeader Header;
+		int aCells[NUM_FONT_SIZES*2];
+		if(io_read(File, &Header, sizeof(Header)) == sizeof(Header) && mem_comp(Header.m_aMagic, "TWFC", 4) == 0 &&
+			Header.m_Version == FONT_CACHE_VERSION && Header.m_NumSizes == (int)NUM_FONT_SIZES &&
+			io_read(File, aCells, sizeof(aCells)) == sizeof(aCells))
+		{
+			// cells have to be powers of two that fit the glyph buffers, otherwise the face gets scanned again
+			bool Valid = true;
+			for(unsigned i = 0; i < NUM_FONT_SIZES*2; i++)
+			{
+				if(aCells[i] != 0 && (aCells[i] < 0 || aCells[i] > MAX_GLYPH_CELL || (aCells[i]&(aCells[i]-1)) != 0))
+					Valid = false;
+			}
+			if(Valid)
+			{
+				for(unsigned i = 0; i < NUM_FONT_SIZES; i++)
+				{
+					pFont->m_aCellWidth[i] = aCells[i*2];
+					pFont->m_aCellHeight[i] = aCells[i*2+1];
+				}
+			}
+			else
+				dbg_msg("textrender", "ignoring invalid font cache '%s'", aFilename);
+		}
+		io_close(File);
+	}
+
+	void SaveFontCache(CFont *pFont)
+	{
+		if(!Storage() || pFont->m_Hash == SHA256_ZEROED)
+			return;
+
+		char aFilename[IO_MAX_PATH_LENGTH];
+		GetFontCacheFilename(pFont, aFilename, sizeof(aFilename));
+		Storage()->CreateFolder("fontcache", IStorage::TYPE_SAVE);
+		IOHANDLE File = Storage()->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		if(!File)
+			return;
+
+		CFontCacheHeader Header;
+		mem_copy(Header.m_aMagic, "TWFC", 4);
+		Header.m_Version = FONT_CACHE_VERSION;
+		Header.m_NumSizes = NUM_FONT_SIZES;
+		int aCells[NUM_FONT_SIZES*2];
+		for(unsigned i = 0; i < NUM_FONT_SIZES; i++)
+		{
+			aCells[i*2] = pFont->m_aCellWidth[i];
+			aCells[i*2+1] = pFont->m_aCellHeight[i];
+		}
+		io_write(File, &Header, sizeof(Header));
+		io_write(File, aCells, sizeof(aCells));
+		io_close(File);
+	}
+
+	static int FreetypeVersion() { return FREETYPE_MAJOR*10000 + FREETYPE_MINOR*100 + FREETYPE_PATCH; }
+
+	void GetGlyphCacheFilename(CFont *pFont, int Index, char *pBuf, int BufSize)
+	{
+		char aHash[SHA256_MAXSTRSIZE];
+		sha256_str(pFont->m_Hash, aHash, sizeof(aHash));
+		str_format(pBuf, BufSize, "fontcache/%s_%d.glyphs", aHash, aFontSizes[Index]);
+	}
+
+	void ClearGlyphCache(CGlyphCache *pCache)
+	{
+		mem_free(pCache->m_pGlyphs);
+		mem_free(pCache->m_pData);
+		mem_zero(pCache, sizeof(*pCache));
+		for(int i = 0; i < CHAR_LOOKUP_SIZE; i++)
+			pCache->m_aLookup[i] = -1;
+	}
+
+	void LinkCachedGlyph(CGlyphCache *pCache, int GlyphIndex)
+	{
+		CCachedGlyph *pGlyph = &pCache->m_pGlyphs[GlyphIndex];
+		pGlyph->m_NextInBucket = pCache->m_aLookup[CharBucket(pGlyph->m_Chr)];
+		pCache->m_aLookup[CharBucket(pGlyph->m_Chr)] = GlyphIndex;
+	}
+
+	void LoadGlyphCache(CFont *pFont, int Index)
+	{
+		CGlyphCache *pCache = &pFont->m_aGlyphCache[Index];
+		if(pCache->m_Loaded)
+			return;
+		ClearGlyphCache(pCache);
+		pCache->m_Loaded = true;
+		if(!Storage() || pFont->m_Hash == SHA256_ZEROED)
+			return;
+
+		char aFilename[IO_MAX_PATH_LENGTH];
+		GetGlyphCacheFilename(pFont, Index, aFilename, sizeof(aFilename));
+		IOHANDLE File = Storage()->OpenFile(aFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+		if(!File)
+			return;
+
+		CGlyphCacheHeader Header;
+		if(io_read(File, &Header, sizeof(Header)) != sizeof(Header) || mem_comp(Header.m_aMagic, "TWFG", 4) != 0 ||
+			Header.m_Version != GLYPH_CACHE_VERSION || Header.m_FreetypeVersion != FreetypeVersion() || Header.m_FontSize != aFontSizes[Index] ||
+			Header.m_NumGlyphs < 0 || Header.m_NumGlyphs > MAX_CACHED_GLYPHS ||
+			Header.m_DataSize < 0 || Header.m_DataSize > MAX_CACHED_GLYPHS*MAX_GLYPH_CELL*MAX_GLYPH_CELL)
+		{
+			io_close(File);
+			return;
+		}
+
+		CCachedGlyph *pGlyphs = (CCachedGlyph *)mem_alloc(maximum(Header.m_NumGlyphs, 1)*sizeof(CCachedGlyph), 1);
+		unsigned char *pData = (unsigned char *)mem_alloc(maximum(Header.m_DataSize, 1), 1);
+		bool Valid = io_read(File, pGlyphs, Header.m_NumGlyphs*sizeof(CCachedGlyph)) == Header.m_NumGlyphs*sizeof(CCachedGlyph) &&
+			io_read(File, pData, Header.m_DataSize) == (unsigned)Header.m_DataSize;
+		io_close(File);
+
+		// every bitmap has to fit the glyph buffers and lie inside the data block
+		for(int i = 0; Valid && i < Header.m_NumGlyphs; i++)
+		{
+			const CCachedGlyph *pGlyph = &pGlyphs[i];
+			if(pGlyph->m_Width < 0 || pGlyph->m_Width > MAX_GLYPH_CELL || pGlyph->m_Rows < 0 || pGlyph->m_Rows > MAX_GLYPH_CELL ||
+				pGlyph->m_DataOffset < 0 || pGlyph->m_DataOffset > Header.m_DataSize - pGlyph->m_Width*pGlyph->m_Rows)
+				Valid = false;
+		}
+		if(!Valid)
+		{
+			dbg_msg("textrender", "ignoring invalid glyph cache '%s'", aFilename);
+			mem_free(pGlyphs);
+			mem_free(pData);
+			return;
+		}
+
+		pCache->m_pGlyphs = pGlyphs;
+		pCache->m_NumGlyphs = Header.m_NumGlyphs;
+		pCache->m_GlyphCapacity = maximum(Header.m_NumGlyphs, 1);
+		pCache->m_pData = pData;
+		pCache->m_DataSize = Header.m_DataSize;
+		pCache->m_DataCapacity = maximum(Header.m_DataSize, 1);
+		for(int i = 0; i < pCache->m_NumGlyphs; i++)
+			LinkCachedGlyph(pCache, i);
+	}
+
+	void SaveGlyphCache(CFont *pFont, int Index)
+	{
+		CGlyphCache *pCache = &pFont->m_aGlyphCache[Index];
+		if(!pCache->m_Dirty || !Storage() || pFont->m_Hash == SHA256_ZEROED)
+			return;
+		pCache->m_Dirty = false;
+
+		char aFilename[IO_MAX_PATH_LENGTH];
+		GetGlyphCacheFilename(pFont, Index, aFilename, sizeof(aFilename));
+		Storage()->CreateFolder("fontcache", IStorage::TYPE_SAVE);
+		IOHANDLE File = Storage()->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		if(!File)
+			return;
+
+		CGlyphCacheHeader Header;
+		mem_copy(Header.m_aMagic, "TWFG", 4);
+		Header.m_Version = GLYPH_CACHE_VERSION;
+		Header.m_FreetypeVersion = FreetypeVersion();
+		Header.m_FontSize = aFontSizes[Index];
+		Header.m_NumGlyphs = pCache->m_NumGlyphs;
+		Header.m_DataSize = pCache->m_DataSize;
+		io_write(File, &Header, sizeof(Header));
+		io_write(File, pCache->m_pGlyphs, pCache->m_NumGlyphs*sizeof(CCachedGlyph));
+		io_write(File, pCache->m_pData, pCache->m_DataSize);
+		io_close(File);
+	}
+
+	const CCachedGlyph *FindCachedGlyph(CGlyphCache *pCache, int Chr)
+	{
+		for(int i = pCache->m_aLookup[CharBucket(Chr)]; i != -1; i = pCache->m_pGlyphs[i].m_NextInBucket)
+		{
+			if(pCache->m_pGlyphs[i].m_Chr == Chr)
+				return &pCache->m_pGlyphs[i];
+		}
+		return 0;
+	}
+
+	// rasterises a glyph and keeps its bitmap, clipped to the glyph buffers
+	const CCachedGlyph *RasteriseGlyph(CFont *pFont, CGlyphCache *pCache, int Chr)
+	{
+		if(pCache->m_NumGlyphs >= MAX_CACHED_GLYPHS)
+			return 0;
+		if(FT_Load_Char(pFont->m_FtFace, Chr, FT_LOAD_RENDER|FT_LOAD_NO_BITMAP))
+		{
+			dbg_msg("pFont", "error loading glyph %d", Chr);
+			return 0;
+		}
+
+		FT_GlyphSlot pSlot = pFont->m_FtFace->glyph;
+		FT_Bitmap *pBitmap = &pSlot->bitmap; // ignore_convention
+		int Width = minimum((int)pBitmap->width, (int)MAX_GLYPH_CELL); // ignore_convention
+		int Rows = minimum((int)pBitmap->rows, (int)MAX_GLYPH_CELL); // ignore_convention
+
+		if(pCache->m_NumGlyphs == pCache->m_GlyphCapacity)
+		{
+			int NewCapacity = maximum(pCache->m_GlyphCapacity*2, 64);
+			CCachedGlyph *pNew = (CCachedGlyph *)mem_alloc(NewCapacity*sizeof(CCachedGlyph), 1);
+			if(pCache->m_NumGlyphs)
+				mem_copy(pNew, pCache->m_pGlyphs, pCache->m_NumGlyphs*sizeof(CCachedGlyph));
+			mem_free(pCache->m_pGlyphs);
+			pCache->m_pGlyphs = pNew;
+			pCache->m_GlyphCapacity = NewCapacity;
+		}
+		if(pCache->m_DataSize + Width*Rows > pCache->m_DataCapacity)
+		{
+			int NewCapacity = maximum(maximum(pCache->m_DataCapacity*2, pCache->m_DataSize + Width*Rows), 16*1024);
+			unsigned char *pNew = (unsigned char *)mem_alloc(NewCapacity, 1);
+			if(pCache->m_DataSize)
+				mem_copy(pNew, pCache->m_pData, pCache->m_DataSize);
+			mem_free(pCache->m_pData);
+			pCache->m_pData = pNew;
+			pCache->m_DataCapacity = NewCapacity;
+		}
+
+		CCachedGlyph *pGlyph = &pCache->m_pGlyphs[pCache->m_NumGlyphs];
+		pGlyph->m_Chr = Chr;
+		pGlyph->m_Width = Width;
+		pGlyph->m_Rows = Rows;
+		pGlyph->m_Left = pSlot->bitmap_left; // ignore_convention
+		pGlyph->m_Top = pSlot->bitmap_top; // ignore_convention
+		pGlyph->m_AdvanceX = pSlot->advance.x; // ignore_convention
+		pGlyph->m_DataOffset = pCache->m_DataSize;
+
+		unsigned char *pDst = &pCache->m_pData[pCache->m_DataSize];
+		if(pBitmap->pixel_mode == FT_PIXEL_MODE_GRAY) // ignore_convention
+		{
+			for(int py = 0; py < Rows; py++)
+				mem_copy(&pDst[py*Width], &pBitmap->buffer[py*pBitmap->pitch], Width); // ignore_convention
+		}
+		else if(pBitmap->pixel_mode == FT_PIXEL_MODE_MONO) // ignore_convention
+		{
+			for(int py = 0; py < Rows; py++)
+				for(int px = 0; px < Width; px++)
+					pDst[py*Width+px] = (pBitmap->buffer[py*pBitmap->pitch+px/8]&(1<<(7-(px%8)))) ? 255 : 0; // ignore_convention
+		}
+		else
+			mem_zero(pDst, Width*Rows);
+
+		pCache->m_DataSize += Width*Rows;
+		LinkCachedGlyph(pCache, pCache->m_NumGlyphs++);
+		pCache->m_Dirty = true;
+		return pGlyph;
+	}
+
 	CFontSizeData *GetSize(CFont *pFont, int Pixelsize)
 	{
 		int Index = GetFontSizeIndex(Pixelsize);
@@ -259,9 +648,26 @@ class CTextRender : public IEngineTextRender
 			m_FontTextureFormat, GL_UNSIGNED_BYTE, pData);*/
 	}
 
-	// 32k of data used for rendering glyphs
+	// 48k of data used for rendering glyphs
 	unsigned char ms_aGlyphData[(1024/8) * (1024/8)];
 	unsigned char ms_aGlyphDataOutlined[(1024/8) * (1024/8)];
+	unsigned char ms_aGlyphDataGrow[(1024/8) * (1024/8)];
+
+	static unsigned CharBucket(int Chr) { return ((unsigned)Chr*2654435761u)%CHAR_LOOKUP_SIZE; }
+
+	void UnlinkChar(CFontSizeData *pSizeData, int SlotID)
+	{
+		int *pLink = &pSizeData->m_aCharLookup[CharBucket(pSizeData->m_aCharacters[SlotID].m_ID)];
+		while(*pLink != -1)
+		{
+			if(*pLink == SlotID)
+			{
+				*pLink = pSizeData->m_aCharacters[SlotID].m_NextInBucket;
+				return;
+			}
+			pLink = &pSizeData->m_aCharacters[*pLink].m_NextInBucket;
+		}
+	}
 
 	int GetSlot(CFontSizeData *pSizeData)
 	{
@@ -296,29 +702,29 @@ class CTextRender : public IEngineTextRender
 
 	int RenderGlyph(CFont *pFont, CFontSizeData *pSizeData, int Chr)
 	{
-		FT_Bitmap *pBitmap;
 		int SlotID = 0;
 		int SlotW = pSizeData->m_TextureWidth / pSizeData->m_NumXChars;
 		int SlotH = pSizeData->m_TextureHeight / pSizeData->m_NumYChars;
 		int SlotSize = SlotW*SlotH;
 		int x = 1;
 		int y = 1;
-		unsigned int px, py;
 
-		FT_Set_Pixel_Sizes(pFont->m_FtFace, 0, pSizeData->m_FontSize);
-
-		if(FT_Load_Char(pFont->m_FtFace, Chr, FT_LOAD_RENDER|FT_LOAD_NO_BITMAP))
+		// glyphs seen before come from the glyph cache, everything else is rasterised once
+		CGlyphCache *pCache = &pFont->m_aGlyphCache[GetFontSizeIndex(pSizeData->m_FontSize)];
+		const CCachedGlyph *pGlyph = FindCachedGlyph(pCache, Chr);
+		if(!pGlyph)
 		{
-			dbg_msg("pFont", "error loading glyph %d", Chr);
-			return -1;
+			FT_Set_Pixel_Sizes(pFont->m_FtFace, 0, pSizeData->m_FontSize);
+			pGlyph = RasteriseGlyph(pFont, pCache, Chr);
+			if(!pGlyph)
+				return -1;
 		}
 
-		pBitmap = &pFont->m_FtFace->glyph->bitmap; // ignore_convention
-
 		// fetch slot
 		SlotID = GetSlot(pSizeData);
 		if(SlotID < 0)
 			return -1;
+		UnlinkChar(pSizeData, SlotID);
 
 		// adjust spacing
 		int OutlineThickness = AdjustOutlineThicknessToFontSize(1, pSizeData->m_FontSize);
@@ -328,21 +734,11 @@ class CTextRender : public IEngineTextRender
 		// prepare glyph data
 		mem_zero(ms_aGlyphData, SlotSize);
 
-		if(pBitmap->pixel_mode == FT_PIXEL_MODE_GRAY) // ignore_convention
-		{
-			for(py = 0; py < pBitmap->rows; py++) // ignore_convention
-				for(px = 0; px < pBitmap->width; px++) // ignore_convention
-					ms_aGlyphData[(py+y)*SlotW+px+x] = pBitmap->buffer[py*pBitmap->pitch+px]; // ignore_convention
-		}
-		else if(pBitmap->pixel_mode == FT_PIXEL_MODE_MONO) // ignore_convention
-		{
-			for(py = 0; py < pBitmap->rows; py++) // ignore_convention
-				for(px = 0; px < pBitmap->width; px++) // ignore_convention
-				{
-					if(pBitmap->buffer[py*pBitmap->pitch+px/8]&(1<<(7-(px%8)))) // ignore_convention
-						ms_aGlyphData[(py+y)*SlotW+px+x] = 255;
-				}
-		}
+		const unsigned char *pSrc = &pCache->m_pData[pGlyph->m_DataOffset];
+		int CopyW = clamp(SlotW-x, 0, pGlyph->m_Width);
+		int CopyH = clamp(SlotH-y, 0, pGlyph->m_Rows);
+		for(int py = 0; py < CopyH; py++)
+			mem_copy(&ms_aGlyphData[(py+y)*SlotW+x], &pSrc[py*pGlyph->m_Width], CopyW);
 
 		/*for(py = 0; py < SlotW; py++)
 			for(px = 0; px < SlotH; px++)
@@ -372,15 +768,17 @@ class CTextRender : public IEngineTextRender
 			float Scale = 1.0f/pSizeData->m_FontSize;
 			float Uscale = 1.0f/pSizeData->m_TextureWidth;
 			float Vscale = 1.0f/pSizeData->m_TextureHeight;
-			int Height = pBitmap->rows + OutlineThickness*2 + 2; // ignore_convention
-			int Width = pBitmap->width + OutlineThickness*2 + 2; // ignore_convention
+			int Height = pGlyph->m_Rows + OutlineThickness*2 + 2;
+			int Width = pGlyph->m_Width + OutlineThickness*2 + 2;
 
 			pFontchr->m_ID = Chr;
+			pFontchr->m_NextInBucket = pSizeData->m_aCharLookup[CharBucket(Chr)];
+			pSizeData->m_aCharLookup[CharBucket(Chr)] = SlotID;
 			pFontchr->m_Height = Height * Scale;
 			pFontchr->m_Width = Width * Scale;
-			pFontchr->m_OffsetX = (pFont->m_FtFace->glyph->bitmap_left-2) * Scale; // ignore_convention
-			pFontchr->m_OffsetY = (pSizeData->m_FontSize - pFont->m_FtFace->glyph->bitmap_top) * Scale; // ignore_convention
-			pFontchr->m_AdvanceX = (pFont->m_FtFace->glyph->advance.x>>6) * Scale; // ignore_convention
+			pFontchr->m_OffsetX = (pGlyph->m_Left-2) * Scale;
+			pFontchr->m_OffsetY = (pSizeData->m_FontSize - pGlyph->m_Top) * Scale;
+			pFontchr->m_AdvanceX = (pGlyph->m_AdvanceX>>6) * Scale;
 
 			pFontchr->m_aUvs[0] = (SlotID%pSizeData->m_NumXChars) / (float)(pSizeData->m_NumXChars);
 			pFontchr->m_aUvs[1] = (SlotID/pSizeData->m_NumXChars) / (float)(pSizeData->m_NumYChars);
@@ -396,9 +794,7 @@ class CTextRender : public IEngineTextRender
 		CFontChar *pFontchr = NULL;
 
 		// search for the character
-		// TODO: remove this linear search
-		int i;
-		for(i = 0; i < pSizeData->m_CurrentCharacter; i++)
+		for(int i = pSizeData->m_aCharLookup[CharBucket(Chr)]; i != -1; i = pSizeData->m_aCharacters[i].m_NextInBucket)
 		{
 			if(pSizeData->m_aCharacters[i].m_ID == Chr)
 			{
@@ -441,6 +837,8 @@ public:
 	CTextRender()
 	{
 		m_pGraphics = 0;
+		m_pStorage = 0;
+		mem_zero(m_aWidthCache, sizeof(m_aWidthCache));
 
 		m_TextR = 1.0f;
 		m_TextG = 1.0f;
@@ -460,10 +858,23 @@ public:
 	virtual void Init()
 	{
 		m_pGraphics = Kernel()->RequestInterface<IGraphics>();
+		m_pStorage = Kernel()->RequestInterface<IStorage>();
 		FT_Init_FreeType(&m_FTLibrary);
 	}
 
 
+	virtual void Shutdown()
+	{
+		if(!m_pDefaultFont)
+			return;
+		for(unsigned i = 0; i < NUM_FONT_SIZES; i++)
+		{
+			SaveGlyphCache(m_pDefaultFont, i);
+			ClearGlyphCache(&m_pDefaultFont->m_aGlyphCache[i]);
+			m_pDefaultFont->m_aGlyphCache[i].m_Loaded = false;
+		}
+	}
+
 	virtual int LoadFont(const char *pFilename)
 	{
 		CFont *pFont = (CFont *)mem_alloc(sizeof(CFont), 1);
@@ -480,6 +891,21 @@ public:
 		for(unsigned i = 0; i < NUM_FONT_SIZES; i++)
 			pFont->m_aSizes[i].m_FontSize = -1;
 
+		// the cell cache is keyed by the font contents
+		IOHANDLE File = io_open(pFont->m_aFilename, IOFLAG_READ);
+		if(File)
+		{
+			unsigned Length = io_length(File);
+			void *pData = mem_alloc(Length, 1);
+			if(io_read(File, pData, Length) == Length)
+			{
+				pFont->m_Hash = sha256(pData, Length);
+				LoadFontCache(pFont);
+			}
+			mem_free(pData);
+			io_close(File);
+		}
+
 		dbg_msg("textrender", "loaded pFont from '%s'", pFilename);
 		m_pDefaultFont = pFont;
 
@@ -515,10 +941,45 @@ public:
 
 	virtual float TextWidth(void *pFontSetV, float Size, const char *pText, int StrLength, float LineWidth)
 	{
+		// widths of short strings like names get measured every frame, remember them
+		int Length = StrLength < 0 ? str_length(pText) : minimum(StrLength, str_length(pText));
+		float ScreenX0, ScreenY0, ScreenX1, ScreenY1;
+		Graphics()->GetScreen(&ScreenX0, &ScreenY0, &ScreenX1, &ScreenY1);
+		float ScreenScaleX = Graphics()->ScreenWidth()/(ScreenX1-ScreenX0);
+		float ScreenScaleY = Graphics()->ScreenHeight()/(ScreenY1-ScreenY0);
+
+		CTextWidthEntry *pEntry = 0;
+		if(Length < WIDTH_CACHE_MAX_TEXT)
+		{
+			// only the measured part, same as str_quickhash
+			unsigned Hash = 5381;
+			for(int i = 0; i < Length; i++)
+				Hash = ((Hash << 5) + Hash) + pText[i];
+			Hash ^= (unsigned)Length;
+			pEntry = &m_aWidthCache[Hash%WIDTH_CACHE_SIZE];
+			if(pEntry->m_pFont == m_pDefaultFont && pEntry->m_Length == Length && pEntry->m_Size == Size &&
+				pEntry->m_LineWidth == LineWidth && pEntry->m_ScreenScaleX == ScreenScaleX && pEntry->m_ScreenScaleY == ScreenScaleY &&
+				mem_comp(pEntry->m_aText, pText, Length) == 0 && pEntry->m_aText[Length] == 0)
+				return pEntry->m_Width;
+		}
+
 		CTextCursor Cursor;
 		SetCursor(&Cursor, 0, 0, Size, 0);
 		Cursor.m_LineWidth = LineWidth;
-		TextEx(&Cursor, pText, StrLength);
+		TextEx(&Cursor, pText, Length);
+
+		if(pEntry && m_pDefaultFont)
+		{
+			mem_copy(pEntry->m_aText, pText, Length);
+			pEntry->m_aText[Length] = 0;
+			pEntry->m_Length = Length;
+			pEntry->m_pFont = m_pDefaultFont;
+			pEntry->m_Size = Size;
+			pEntry->m_LineWidth = LineWidth;
+			pEntry->m_ScreenScaleX = ScreenScaleX;
+			pEntry->m_ScreenScaleY = ScreenScaleY;
+			pEntry->m_Width = Cursor.m_X;
+		}
 		return Cursor.m_X;
 	}
 
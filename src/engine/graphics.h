@@ -95,6 +95,20 @@ public:
 		void Invalidate() { m_Id = -1; }
 	};
 
+	class CBufferHandle
+	{
+		friend class IGraphics;
+		int m_Id;
+	public:
+		CBufferHandle()
+		: m_Id(-1)
+		{}
+
+		bool IsValid() const { return Id() >= 0; }
+		int Id() const { return m_Id; }
+		void Invalidate() { m_Id = -1; }
+	};
+
 	int ScreenWidth() const { return m_ScreenWidth; }
 	int ScreenHeight() const { return m_ScreenHeight; }
 	float ScreenAspect() const { return (float)ScreenWidth()/(float)ScreenHeight(); }
@@ -163,6 +177,18 @@ public:
 	virtual void QuadsDrawFreeform(const CFreeformItem *pArray, int Num) = 0;
 	virtual void QuadsText(float x, float y, float Size, const char *pText) = 0;
 
+	/* Quad buffers keep static geometry on the gpu. They are filled once and
+		drawn with the current texture, blend, wrap and clip state. */
+	struct CBufferQuad
+	{
+		float m_X, m_Y, m_Width, m_Height;
+		float m_aU[4], m_aV[4]; // top left, top right, bottom right, bottom left
+		int m_TextureIndex;
+	};
+	virtual CBufferHandle CreateQuadBuffer(const CBufferQuad *pQuads, int Num) = 0;
+	virtual void DestroyQuadBuffer(CBufferHandle *pBuffer) = 0;
+	virtual void RenderQuadBuffer(CBufferHandle Buffer, int Start, int Num, vec4 Color) = 0;
+
 	struct CColorVertex
 	{
 		int m_Index;
@@ -194,6 +220,13 @@ protected:
 		Tex.m_Id = Index;
 		return Tex;
 	}
+
+	inline CBufferHandle CreateBufferHandle(int Index)
+	{
+		CBufferHandle Buffer;
+		Buffer.m_Id = Index;
+		return Buffer;
+	}
 };
 
 class IEngineGraphics : public IGraphics
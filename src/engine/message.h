@@ -8,7 +8,10 @@
 class CMsgPacker : public CPacker
 {
 public:
-	CMsgPacker(int Type, bool System=false)
+	int m_Type;
+	bool m_System;
+
+	CMsgPacker(int Type, bool System=false) : m_Type(Type), m_System(System)
 	{
 		Reset();
 		AddInt((Type<<1)|(System?1:0));
@@ -2,6 +2,8 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #ifndef ENGINE_SERVER_H
 #define ENGINE_SERVER_H
+#include <base/hash.h>
+
 #include "kernel.h"
 #include "message.h"
 
@@ -52,6 +54,11 @@ public:
 	virtual int SnapNewID() = 0;
 	virtual void SnapFreeID(int ID) = 0;
 	virtual void *SnapNewItem(int Type, int ID, int Size) = 0;
+	// adds the item with the data it had in the last snapshot sent to the client, 0 if it wasn't in there
+	// or that snapshot is older than MinTick
+	virtual void *SnapRepeatItem(int ClientID, int Type, int ID, int Size, int MinTick) = 0;
+	// bytes of off-screen items the client's link allows per snapshot, -1 for no limit
+	virtual int SnapBudget(int ClientID) const = 0;
 
 	virtual void SnapSetStaticsize(int ItemType, int Size) = 0;
 
@@ -69,6 +76,14 @@ public:
 
 	virtual void DemoRecorder_HandleAutoStart() = 0;
 	virtual bool DemoRecorder_IsRecording() = 0;
+
+	// per tick timings of the main thread, see the perf command
+	virtual class CProfiler *Profiler() = 0;
+
+	// loads a map on a worker thread, so that changing to it later only swaps it in
+	virtual void PreloadMap(const char *pMapName) = 0;
+	// name and sha256 of the current map
+	virtual void GetMapInfo(char *pMapName, int MapNameSize, SHA256_DIGEST *pSha256) const = 0;
 };
 
 class IGameServer : public IInterface
@@ -79,6 +94,10 @@ public:
 	virtual void OnInit() = 0;
 	virtual void OnConsoleInit() = 0;
 	virtual void OnShutdown() = 0;
+	// runs on a worker thread with the map that PreloadMap loaded, before it becomes the current map
+	virtual void OnMapPreload(class IMap *pMap, const char *pMapName, SHA256_DIGEST Sha256) = 0;
+	// the preloaded map gets replaced, no preload job is running while this is called
+	virtual void OnMapPreloadDrop() = 0;
 
 	virtual void OnTick() = 0;
 	virtual void OnPreSnap() = 0;
@@ -103,6 +122,8 @@ public:
 	virtual const char *NetVersion() const = 0;
 	virtual const char *NetVersionHashUsed() const = 0;
 	virtual const char *NetVersionHashReal() const = 0;
+	virtual const char *GetItemName(int Type) const = 0;
+	virtual const char *GetMsgName(int Type) const = 0;
 
 	virtual bool TimeScore() const { return false; }
 
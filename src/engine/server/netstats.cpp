@@ -0,0 +1,58 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+
+#include "netstats.h"
+
+CNetStats::CNetStats()
+{
+	Reset();
+}
+
+void CNetStats::Reset()
+{
+	mem_zero(&m_Current, sizeof(m_Current));
+	m_NumSamples = 0;
+	m_LastSample = -1;
+	m_NextSample = time_get();
+}
+
+void CNetStats::ResetClient(int ClientID)
+{
+	mem_zero(m_Current.m_aaClient[ClientID], sizeof(m_Current.m_aaClient[ClientID]));
+	for(int i = 0; i < m_NumSamples; i++)
+		mem_zero(m_aSamples[i].m_aaClient[ClientID], sizeof(m_aSamples[i].m_aaClient[ClientID]));
+}
+
+void CNetStats::Sample()
+{
+	int64 Now = time_get();
+	m_LastSample = (m_LastSample+1)%MAX_WINDOW;
+	m_NumSamples = minimum(m_NumSamples+1, (int)MAX_WINDOW);
+	mem_copy(&m_aSamples[m_LastSample], &m_Current, sizeof(m_Current));
+	m_aSampleTimes[m_LastSample] = Now;
+	m_NextSample = Now+time_freq();
+}
+
+int64 CNetStats::Window(int Seconds, CCounters *pOut) const
+{
+	if(!m_NumSamples)
+	{
+		mem_zero(pOut, sizeof(*pOut));
+		return 0;
+	}
+
+	// the current counters may be older than the last sample for the parts the owner copies in,
+	// so measure against the last sample
+	int Back = clamp(Seconds, 1, m_NumSamples-1);
+	if(m_NumSamples == 1)
+		Back = 0;
+	int From = (m_LastSample-Back+MAX_WINDOW)%MAX_WINDOW;
+	const unsigned *pNew = (const unsigned *)&m_aSamples[m_LastSample];
+	const unsigned *pOld = (const unsigned *)&m_aSamples[From];
+	unsigned *pDst = (unsigned *)pOut;
+	for(unsigned i = 0; i < sizeof(CCounters)/sizeof(unsigned); i++)
+		pDst[i] = pNew[i]-pOld[i];
+
+	return m_aSampleTimes[m_LastSample]-m_aSampleTimes[From];
+}
@@ -0,0 +1,78 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SERVER_NETSTATS_H
+#define ENGINE_SERVER_NETSTATS_H
+
+#include <base/system.h>
+#include <engine/shared/protocol.h>
+
+// traffic counters of the server. a copy of them is kept every second,
+// so the change over any window up to a minute can be queried
+class CNetStats
+{
+public:
+	enum
+	{
+		CLIENT_SENT_BYTES=0,
+		CLIENT_SENT_PACKETS,
+		CLIENT_RECV_BYTES,
+		CLIENT_RECV_PACKETS,
+		CLIENT_RESENT_CHUNKS,
+		CLIENT_SNAP_BYTES,
+		NUM_CLIENT_COUNTERS,
+
+		DIR_IN=0,
+		DIR_OUT,
+		NUM_DIRS,
+
+		MAX_MSG_TYPES=64,
+		MAX_ITEM_TYPES=64,
+
+		MAX_WINDOW=60, // seconds
+	};
+
+	class CCounters
+	{
+	public:
+		// the counters wrap around, only the difference of two samples means something
+		unsigned m_aaClient[MAX_CLIENTS][NUM_CLIENT_COUNTERS];
+		unsigned m_aaaMsgCount[NUM_DIRS][2][MAX_MSG_TYPES]; // the second index is the system flag
+		unsigned m_aaaMsgBytes[NUM_DIRS][2][MAX_MSG_TYPES];
+		unsigned m_aItemBits[MAX_ITEM_TYPES];
+		unsigned m_aItemUpdates[MAX_ITEM_TYPES];
+	};
+
+	CNetStats();
+
+	void Reset();
+	// call when a new client takes the slot, its counters start from zero
+	void ResetClient(int ClientID);
+
+	void AddMsg(int Dir, bool System, int Msg, int Size)
+	{
+		if(Msg < 0 || Msg >= MAX_MSG_TYPES)
+			return;
+		m_Current.m_aaaMsgCount[Dir][System][Msg]++;
+		m_Current.m_aaaMsgBytes[Dir][System][Msg] += Size;
+	}
+	void AddSnap(int ClientID, int Size) { m_Current.m_aaClient[ClientID][CLIENT_SNAP_BYTES] += Size; }
+
+	// the owner copies the counters it doesn't feed through AddMsg and AddSnap in here before sampling
+	CCounters *Current() { return &m_Current; }
+
+	bool SampleDue() const { return time_get() >= m_NextSample; }
+	void Sample();
+
+	// writes the change over the last Seconds seconds to pOut and returns the time it covers
+	int64 Window(int Seconds, CCounters *pOut) const;
+
+private:
+	CCounters m_Current;
+	CCounters m_aSamples[MAX_WINDOW];
+	int64 m_aSampleTimes[MAX_WINDOW];
+	int m_NumSamples;
+	int m_LastSample;
+	int64 m_NextSample;
+};
+
+#endif
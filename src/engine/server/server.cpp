@@ -18,6 +18,7 @@
 #include <engine/shared/demo.h>
 #include <engine/shared/econ.h>
 #include <engine/shared/filecollection.h>
+#include <engine/shared/jsonwriter.h>
 #include <engine/shared/mapchecker.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
@@ -263,9 +264,21 @@ void CServer::CClient::Reset()
 	m_Snapshots.PurgeAll();
 	m_LastAckedSnapshot = -1;
 	m_LastInputTick = -1;
-	m_SnapRate = CClient::SNAPRATE_INIT;
+	m_SnapRate.Reset();
+	m_SnapRtt.Reset();
+	m_SnapSkip = 0;
+	m_SnapsSent = 0;
+	m_SnapsAcked = 0;
+	m_LastInputTime = 0;
+	m_NumVitalChunks = 0;
+	m_NumResentChunks = 0;
+	m_SnapRateTick = 0;
 	m_Score = 0;
 	m_MapChunk = 0;
+	m_MapDownload = false;
+	m_MapWindow = 0;
+	m_MapWindowFull = false;
+	m_MapWindowTick = 0;
 }
 
 CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
@@ -277,8 +290,14 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 	m_CurrentGameTick = 0;
 	m_RunServer = 1;
 
-	m_pCurrentMapData = 0;
-	m_CurrentMapSize = 0;
+	mem_zero(&m_CurrentMap, sizeof(m_CurrentMap));
+	mem_zero(&m_NextMap, sizeof(m_NextMap));
+	m_pNextMap = 0;
+	m_pAllocatedMap = 0;
+	CMsgPacker MapDataHeader(NETMSG_MAP_DATA, true);
+	m_MapChunkHeaderSize = MapDataHeader.Size();
+	m_MapDownloadBudget = -1;
+	m_NextMapDownload = 0;
 
 	m_NumMapEntries = 0;
 	m_pFirstMapEntry = 0;
@@ -293,6 +312,11 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 	m_RconPasswordSet = 0;
 	m_GeneratedRconPassword = 0;
 
+	// registered in the order of the PROF_* ids
+	static const char *s_apProfZones[NUM_PROF_ZONES] = { "net", "tick", "snap", "snap_build", "snap_delta", "snap_compress", "snap_send" };
+	for(int i = 0; i < NUM_PROF_ZONES; i++)
+		m_Profiler.RegisterZone(s_apProfZones[i]);
+
 	Init();
 }
 
@@ -580,16 +604,54 @@ int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 				{
 					Packet.m_ClientID = i;
 					m_NetServer.Send(&Packet);
+					m_NetStats.AddMsg(CNetStats::DIR_OUT, pMsg->m_System, pMsg->m_Type, pMsg->Size());
 				}
 		}
 		else
+		{
 			m_NetServer.Send(&Packet);
+			m_NetStats.AddMsg(CNetStats::DIR_OUT, pMsg->m_System, pMsg->m_Type, pMsg->Size());
+		}
 	}
 	return 0;
 }
 
+void CServer::UpdateSnapRate(int ClientID)
+{
+	CClient *pClient = &m_aClients[ClientID];
+	if(Tick() < pClient->m_SnapRateTick)
+		return;
+	pClient->m_SnapRateTick = Tick() + SERVER_TICK_SPEED/2;
+
+	// snapshots that never got acked, and resent vital chunks if there were enough to tell
+	const CNetConnection *pConnection = m_NetServer.ClientConnection(ClientID);
+	int Loss = pClient->m_SnapsSent ? maximum(0, pClient->m_SnapsSent-pClient->m_SnapsAcked)*100/pClient->m_SnapsSent : 0;
+	int NumVital = pConnection->NumVitalChunks()-pClient->m_NumVitalChunks;
+	int NumResent = pConnection->NumResentChunks()-pClient->m_NumResentChunks;
+	if(NumVital >= 4)
+		Loss = maximum(Loss, minimum(100, NumResent*100/NumVital));
+	pClient->m_SnapsSent = 0;
+	pClient->m_SnapsAcked = 0;
+	pClient->m_NumVitalChunks = pConnection->NumVitalChunks();
+	pClient->m_NumResentChunks = pConnection->NumResentChunks();
+
+	// stay at the initial rate until the first ack
+	pClient->m_SnapRate.Update(Loss, LinkQueueing(ClientID), pClient->m_LastAckedSnapshot > 0);
+}
+
+bool CServer::LinkQueueing(int ClientID) const
+{
+	// the snapshot acks give samples all the time, vital chunks are rare in game
+	const CClient *pClient = &m_aClients[ClientID];
+	if(pClient->m_SnapRtt.Rtt() >= 0)
+		return pClient->m_SnapRtt.Queueing();
+	return m_NetServer.ClientConnection(ClientID)->RttEstimator()->Queueing();
+}
+
 void CServer::DoSnapshot()
 {
+	CProfiler::CScope ProfSnap(&m_Profiler, PROF_SNAP);
+
 	GameServer()->OnPreSnap();
 
 	// create snapshot for demo recording
@@ -614,13 +676,15 @@ void CServer::DoSnapshot()
 		if(m_aClients[i].m_State != CClient::STATE_INGAME)
 			continue;
 
-		// this client is trying to recover, don't spam snapshots
-		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_RECOVER && (Tick()%50) != 0)
-			continue;
-
-		// this client is trying to recover, don't spam snapshots
-		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_INIT && (Tick()%10) != 0)
+		// the governor spreads the snapshots out for clients on bad links
+		UpdateSnapRate(i);
+		if(m_aClients[i].m_SnapSkip > 0)
+		{
+			m_aClients[i].m_SnapSkip--;
 			continue;
+		}
+		m_aClients[i].m_SnapSkip = m_aClients[i].m_SnapRate.Interval()-1;
+		m_aClients[i].m_SnapsSent++;
 
 		{
 			char aData[CSnapshot::MAX_SIZE];
@@ -635,13 +699,17 @@ void CServer::DoSnapshot()
 			int DeltaTick = -1;
 			int DeltaSize;
 
-			m_SnapshotBuilder.Init();
+			{
+				CProfiler::CScope ProfBuild(&m_Profiler, PROF_SNAP_BUILD);
 
-			GameServer()->OnSnap(i);
+				m_SnapshotBuilder.Init();
 
-			// finish snapshot
-			SnapshotSize = m_SnapshotBuilder.Finish(pData);
-			Crc = pData->Crc();
+				GameServer()->OnSnap(i);
+
+				// finish snapshot
+				SnapshotSize = m_SnapshotBuilder.Finish(pData);
+				Crc = pData->Crc();
+			}
 
 			// remove old snapshos
 			// keep 3 seconds worth of snapshots
@@ -657,16 +725,19 @@ void CServer::DoSnapshot()
 				DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
 				if(DeltashotSize >= 0)
 					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
-				else
+				else if(m_aClients[i].m_LastAckedSnapshot > 0)
 				{
-					// no acked package found, force client to recover rate
-					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
-						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
+					// no acked package found, don't spam full snapshots until the client catches up
+					m_aClients[i].m_SnapRate.MissingDeltaBase();
+					m_aClients[i].m_SnapSkip = m_aClients[i].m_SnapRate.Interval()-1;
 				}
 			}
 
 			// create delta
-			DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+			{
+				CProfiler::CScope ProfDelta(&m_Profiler, PROF_SNAP_DELTA);
+				DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData, Config()->m_SvNetStatsItems);
+			}
 
 			if(DeltaSize)
 			{
@@ -675,8 +746,14 @@ void CServer::DoSnapshot()
 				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
 				int NumPackets;
 
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
+				{
+					CProfiler::CScope ProfCompress(&m_Profiler, PROF_SNAP_COMPRESS);
+					SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
+				}
 				NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
+				m_NetStats.AddSnap(i, SnapshotSize);
+
+				CProfiler::CScope ProfSend(&m_Profiler, PROF_SNAP_SEND);
 
 				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
 				{
@@ -742,6 +819,7 @@ int CServer::NewClientCallback(int ClientID, void *pUser)
 	pThis->m_aClients[ClientID].m_NoRconNote = false;
 	pThis->m_aClients[ClientID].m_Quitting = false;
 	pThis->m_aClients[ClientID].Reset();
+	pThis->m_NetStats.ResetClient(ClientID);
 
 	return 0;
 }
@@ -781,14 +859,97 @@ void CServer::SendMap(int ClientID)
 {
 	CMsgPacker Msg(NETMSG_MAP_CHANGE, true);
 	Msg.AddString(GetMapName(), 0);
-	Msg.AddInt(m_CurrentMapCrc);
-	Msg.AddInt(m_CurrentMapSize);
+	Msg.AddInt(m_CurrentMap.m_Crc);
+	Msg.AddInt(m_CurrentMap.m_Size);
 	Msg.AddInt(m_MapChunksPerRequest);
 	Msg.AddInt(MAP_CHUNK_SIZE);
-	Msg.AddRaw(&m_CurrentMapSha256, sizeof(m_CurrentMapSha256));
+	Msg.AddRaw(&m_CurrentMap.m_Sha256, sizeof(m_CurrentMap.m_Sha256));
 	SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID);
 }
 
+void CServer::SendMapChunk(int ClientID, int Chunk)
+{
+	// the message is ready in m_CurrentMap.m_pChunks, no packing needed. map data
+	// doesn't go to the demo, the demo has the map already
+	const int Size = minimum((int)MAP_CHUNK_SIZE, m_CurrentMap.m_Size-Chunk*MAP_CHUNK_SIZE);
+	CNetChunk Packet;
+	mem_zero(&Packet, sizeof(CNetChunk));
+	Packet.m_ClientID = ClientID;
+	Packet.m_pData = m_CurrentMap.m_pChunks + Chunk*(m_MapChunkHeaderSize+MAP_CHUNK_SIZE);
+	Packet.m_DataSize = m_MapChunkHeaderSize+Size;
+	Packet.m_Flags = NETSENDFLAG_VITAL|NETSENDFLAG_FLUSH;
+	m_NetServer.Send(&Packet);
+	m_NetStats.AddMsg(CNetStats::DIR_OUT, true, NETMSG_MAP_DATA, Packet.m_DataSize);
+
+	if(Config()->m_Debug)
+	{
+		char aBuf[64];
+		str_format(aBuf, sizeof(aBuf), "sending chunk %d with size %d", Chunk, Size);
+		Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "server", aBuf);
+	}
+}
+
+void CServer::UpdateMapWindow(int ClientID)
+{
+	CClient *pClient = &m_aClients[ClientID];
+	if(Tick() < pClient->m_MapWindowTick)
+		return;
+	pClient->m_MapWindowTick = Tick() + SERVER_TICK_SPEED/2;
+
+	const CNetConnection *pConnection = m_NetServer.ClientConnection(ClientID);
+	int NumVital = pConnection->NumVitalChunks()-pClient->m_NumVitalChunks;
+	int NumResent = pConnection->NumResentChunks()-pClient->m_NumResentChunks;
+	pClient->m_NumVitalChunks = pConnection->NumVitalChunks();
+	pClient->m_NumResentChunks = pConnection->NumResentChunks();
+
+	// same signals as the snapshot rate governor: resends, or a round trip
+	// time that grows because the packets queue up somewhere
+	if(LinkQueueing(ClientID) || (NumVital >= 4 && NumResent*10 >= NumVital))
+		pClient->m_MapWindow = maximum(1, pClient->m_MapWindow/2);
+	else if(pClient->m_MapWindowFull)
+		pClient->m_MapWindow = minimum(pClient->m_MapWindow+1, (int)CClient::MAP_WINDOW_MAX);
+	pClient->m_MapWindowFull = false;
+}
+
+void CServer::SendMapData()
+{
+	// the clients take turns, so that a limited budget doesn't always go to the same ones
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		int ClientID = (m_NextMapDownload+i)%MAX_CLIENTS;
+		CClient *pClient = &m_aClients[ClientID];
+		if(!pClient->m_MapDownload)
+			continue;
+		if(pClient->m_State != CClient::STATE_CONNECTING && pClient->m_State != CClient::STATE_CONNECTING_AS_SPEC)
+		{
+			pClient->m_MapDownload = false;
+			continue;
+		}
+
+		UpdateMapWindow(ClientID);
+		const CNetConnection *pConnection = m_NetServer.ClientConnection(ClientID);
+		while(pClient->m_MapChunk >= 0 && pConnection->NumBufferedChunks() < pClient->m_MapWindow)
+		{
+			if(m_MapDownloadBudget == 0)
+			{
+				m_NextMapDownload = ClientID;
+				return;
+			}
+			if(m_MapDownloadBudget > 0)
+				m_MapDownloadBudget--;
+
+			SendMapChunk(ClientID, pClient->m_MapChunk);
+			if(++pClient->m_MapChunk == m_CurrentMap.m_NumChunks)
+			{
+				pClient->m_MapChunk = -1;
+				pClient->m_MapDownload = false;
+			}
+		}
+		if(pClient->m_MapDownload)
+			pClient->m_MapWindowFull = true;
+	}
+}
+
 void CServer::SendConnectionReady(int ClientID)
 {
 	CMsgPacker Msg(NETMSG_CON_READY, true);
@@ -896,6 +1057,8 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 	if(Unpacker.Error())
 		return;
 
+	m_NetStats.AddMsg(CNetStats::DIR_IN, Sys, Msg, pPacket->m_DataSize);
+
 	if(Sys)
 	{
 		// system message
@@ -931,33 +1094,18 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 		{
 			if((pPacket->m_Flags&NET_CHUNKFLAG_VITAL) != 0 && (m_aClients[ClientID].m_State == CClient::STATE_CONNECTING || m_aClients[ClientID].m_State == CClient::STATE_CONNECTING_AS_SPEC))
 			{
-				int ChunkSize = MAP_CHUNK_SIZE;
-
-				// send map chunks
-				for(int i = 0; i < m_MapChunksPerRequest && m_aClients[ClientID].m_MapChunk >= 0; ++i)
+				// the first request starts the download, the chunks then go out
+				// as the acks come in. later requests need no answer
+				CClient *pClient = &m_aClients[ClientID];
+				if(!pClient->m_MapDownload && pClient->m_MapChunk == 0)
 				{
-					int Chunk = m_aClients[ClientID].m_MapChunk;
-					int Offset = Chunk * ChunkSize;
-
-					// check for last part
-					if(Offset+ChunkSize >= m_CurrentMapSize)
-					{
-						ChunkSize = m_CurrentMapSize-Offset;
-						m_aClients[ClientID].m_MapChunk = -1;
-					}
-					else
-						m_aClients[ClientID].m_MapChunk++;
-
-					CMsgPacker Msg(NETMSG_MAP_DATA, true);
-					Msg.AddRaw(&m_pCurrentMapData[Offset], ChunkSize);
-					SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID);
-
-					if(Config()->m_Debug)
-					{
-						char aBuf[64];
-						str_format(aBuf, sizeof(aBuf), "sending chunk %d with size %d", Chunk, ChunkSize);
-						Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "server", aBuf);
-					}
+					const CNetConnection *pConnection = m_NetServer.ClientConnection(ClientID);
+					pClient->m_MapDownload = true;
+					pClient->m_MapWindow = m_MapChunksPerRequest;
+					pClient->m_MapWindowFull = false;
+					pClient->m_MapWindowTick = Tick() + SERVER_TICK_SPEED/2;
+					pClient->m_NumVitalChunks = pConnection->NumVitalChunks();
+					pClient->m_NumResentChunks = pConnection->NumResentChunks();
 				}
 			}
 		}
@@ -999,6 +1147,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 			int64 TagTime;
 			int64 Now = time_get();
 
+			int LastAckedSnapshot = m_aClients[ClientID].m_LastAckedSnapshot;
 			m_aClients[ClientID].m_LastAckedSnapshot = Unpacker.GetInt();
 			int IntendedTick = Unpacker.GetInt();
 			int Size = Unpacker.GetInt();
@@ -1007,9 +1156,6 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 			if(Unpacker.Error() || Size/4 > MAX_INPUT_SIZE)
 				return;
 
-			if(m_aClients[ClientID].m_LastAckedSnapshot > 0)
-				m_aClients[ClientID].m_SnapRate = CClient::SNAPRATE_FULL;
-
 			// add message to report the input timing
 			// skip packets that are old
 			if(IntendedTick > m_aClients[ClientID].m_LastInputTick)
@@ -1039,8 +1185,26 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 			{
 				m_aClients[ClientID].m_Latency = (int)(((Now-TagTime)*1000)/time_freq());
 				m_aClients[ClientID].m_Latency = maximum(0, m_aClients[ClientID].m_Latency - PingCorrection);
+				if(m_aClients[ClientID].m_LastAckedSnapshot > LastAckedSnapshot)
+					m_aClients[ClientID].m_SnapRtt.AddSample(m_aClients[ClientID].m_Latency, Now);
 			}
 
+			if(m_aClients[ClientID].m_LastAckedSnapshot > LastAckedSnapshot)
+			{
+				// the client only acks the latest snapshot it has. the ones before
+				// count as received unless they were due before its previous input
+				int64 Due = m_aClients[ClientID].m_LastInputTime;
+				if(m_aClients[ClientID].m_SnapRtt.Rtt() >= 0)
+					Due -= m_aClients[ClientID].m_SnapRtt.Rtt()*time_freq()/1000 + time_freq()/SERVER_TICK_SPEED;
+				for(CSnapshotStorage::CHolder *pHolder = m_aClients[ClientID].m_Snapshots.m_pFirst; pHolder; pHolder = pHolder->m_pNext)
+				{
+					if(pHolder->m_Tick > LastAckedSnapshot && pHolder->m_Tick <= m_aClients[ClientID].m_LastAckedSnapshot &&
+						(pHolder->m_Tick == m_aClients[ClientID].m_LastAckedSnapshot || pHolder->m_Tagtime >= Due))
+						m_aClients[ClientID].m_SnapsAcked++;
+				}
+			}
+			m_aClients[ClientID].m_LastInputTime = Now;
+
 			mem_copy(m_aClients[ClientID].m_LatestInput.m_aData, pInput->m_aData, MAX_INPUT_SIZE*sizeof(int));
 
 			m_aClients[ClientID].m_CurrentInput++;
@@ -1299,20 +1463,114 @@ const char *CServer::GetMapName()
 	return pMapShortName;
 }
 
-int CServer::LoadMap(const char *pMapName)
+// reads the map m_aName of pData into pMap, also from the preload job
+bool CServer::ReadMap(IEngineMap *pMap, CMapData *pData)
 {
+	pData->m_Loaded = false;
 	char aBuf[IO_MAX_PATH_LENGTH];
-	str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
+	str_format(aBuf, sizeof(aBuf), "maps/%s.map", pData->m_aName);
 
-	// check for valid standard map
+	// check for valid standard map. the server never changes the list, so this is fine off the main thread
 	if(!m_MapChecker.ReadAndValidateMap(Storage(), aBuf, IStorage::TYPE_ALL))
 	{
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mapchecker", "invalid standard map");
-		return 0;
+		dbg_msg("mapchecker", "invalid standard map");
+		return false;
 	}
 
-	if(!m_pMap->Load(aBuf))
-		return 0;
+	pMap->Unload();
+	if(!pMap->Load(aBuf, Storage()))
+		return false;
+
+	// get the sha256 and crc of the map
+	pData->m_Sha256 = pMap->Sha256();
+	pData->m_Crc = pMap->Crc();
+
+	// load complete map into memory for download, already split into the messages
+	{
+		IOHANDLE File = Storage()->OpenFile(aBuf, IOFLAG_READ, IStorage::TYPE_ALL);
+		if(!File)
+			return false;
+		pData->m_Size = (int)io_length(File);
+		pData->m_NumChunks = (pData->m_Size+MAP_CHUNK_SIZE-1)/MAP_CHUNK_SIZE;
+		CMsgPacker Header(NETMSG_MAP_DATA, true);
+		if(pData->m_pChunks)
+			mem_free(pData->m_pChunks);
+		pData->m_pChunks = (unsigned char *)mem_alloc(maximum(pData->m_NumChunks, 1)*(m_MapChunkHeaderSize+MAP_CHUNK_SIZE), 1);
+		for(int i = 0; i < pData->m_NumChunks; i++)
+		{
+			unsigned char *pChunk = pData->m_pChunks + i*(m_MapChunkHeaderSize+MAP_CHUNK_SIZE);
+			mem_copy(pChunk, Header.Data(), m_MapChunkHeaderSize);
+			io_read(File, pChunk+m_MapChunkHeaderSize, minimum((int)MAP_CHUNK_SIZE, pData->m_Size-i*MAP_CHUNK_SIZE));
+		}
+		io_close(File);
+	}
+	pData->m_Loaded = true;
+	return true;
+}
+
+int CServer::PreloadMapJob(void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	int64 Start = time_get();
+	pThis->GameServer()->OnMapPreloadDrop();
+	if(!pThis->ReadMap(pThis->m_pNextMap, &pThis->m_NextMap))
+		return -1;
+	pThis->GameServer()->OnMapPreload(pThis->m_pNextMap, pThis->m_NextMap.m_aName, pThis->m_NextMap.m_Sha256);
+	dbg_msg("server", "preloaded map '%s' in %.2fms", pThis->m_NextMap.m_aName, (time_get()-Start)*1000.0f/time_freq());
+	return 0;
+}
+
+void CServer::PreloadMap(const char *pMapName)
+{
+	if(!m_pNextMap || !pMapName[0] || str_comp(pMapName, m_CurrentMap.m_aName) == 0)
+		return;
+	// one preload at a time, LoadMap waits for it
+	if(m_PreloadJob.Status() != CJob::STATE_DONE || str_comp(pMapName, m_NextMap.m_aName) == 0)
+		return;
+
+	str_copy(m_NextMap.m_aName, pMapName, sizeof(m_NextMap.m_aName));
+	m_NextMap.m_Loaded = false;
+	Kernel()->RequestInterface<IEngine>()->AddJob(&m_PreloadJob, PreloadMapJob, this);
+}
+
+void CServer::GetMapInfo(char *pMapName, int MapNameSize, SHA256_DIGEST *pSha256) const
+{
+	str_copy(pMapName, m_CurrentMap.m_aName, MapNameSize);
+	*pSha256 = m_CurrentMap.m_Sha256;
+}
+
+void CServer::WaitPreload()
+{
+	while(m_PreloadJob.Status() != CJob::STATE_DONE)
+		thread_sleep(1);
+}
+
+int CServer::LoadMap(const char *pMapName)
+{
+	// read the map now unless the preload job has it already
+	WaitPreload();
+	if(!m_NextMap.m_Loaded || str_comp(m_NextMap.m_aName, pMapName) != 0)
+	{
+		str_copy(m_NextMap.m_aName, pMapName, sizeof(m_NextMap.m_aName));
+		GameServer()->OnMapPreloadDrop();
+		if(!ReadMap(m_pNextMap, &m_NextMap))
+		{
+			m_NextMap.m_aName[0] = 0;
+			return 0;
+		}
+	}
+
+	// switch to it, the old map stays loaded until the next preload replaces it
+	IEngineMap *pOldMap = m_pMap;
+	m_pMap = m_pNextMap;
+	m_pNextMap = pOldMap;
+	Kernel()->ReregisterInterface(static_cast<IEngineMap*>(m_pMap));
+	Kernel()->ReregisterInterface(static_cast<IMap*>(m_pMap));
+	CMapData OldMap = m_CurrentMap;
+	m_CurrentMap = m_NextMap;
+	m_NextMap = OldMap;
+	m_NextMap.m_aName[0] = 0;
+	m_NextMap.m_Loaded = false;
 
 	// stop recording when we change map
 	m_DemoRecorder.Stop();
@@ -1320,29 +1578,13 @@ int CServer::LoadMap(const char *pMapName)
 	// reinit snapshot ids
 	m_IDPool.TimeoutIDs();
 
-	// get the sha256 and crc of the map
-	m_CurrentMapSha256 = m_pMap->Sha256();
-	m_CurrentMapCrc = m_pMap->Crc();
 	char aSha256[SHA256_MAXSTRSIZE];
-	sha256_str(m_CurrentMapSha256, aSha256, sizeof(aSha256));
+	sha256_str(m_CurrentMap.m_Sha256, aSha256, sizeof(aSha256));
 	char aBufMsg[256];
-	str_format(aBufMsg, sizeof(aBufMsg), "%s sha256 is %s", aBuf, aSha256);
+	str_format(aBufMsg, sizeof(aBufMsg), "maps/%s.map sha256 is %s", pMapName, aSha256);
 	Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBufMsg);
-	str_format(aBufMsg, sizeof(aBufMsg), "%s crc is %08x", aBuf, m_CurrentMapCrc);
+	str_format(aBufMsg, sizeof(aBufMsg), "maps/%s.map crc is %08x", pMapName, m_CurrentMap.m_Crc);
 	Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBufMsg);
-
-	str_copy(m_aCurrentMap, pMapName, sizeof(m_aCurrentMap));
-
-	// load complete map into memory for download
-	{
-		IOHANDLE File = Storage()->OpenFile(aBuf, IOFLAG_READ, IStorage::TYPE_ALL);
-		m_CurrentMapSize = (int)io_length(File);
-		if(m_pCurrentMapData)
-			mem_free(m_pCurrentMapData);
-		m_pCurrentMapData = (unsigned char *)mem_alloc(m_CurrentMapSize, 1);
-		io_read(File, m_pCurrentMapData, m_CurrentMapSize);
-		io_close(File);
-	}
 	return 1;
 }
 
@@ -1353,16 +1595,34 @@ void CServer::InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterS
 
 #include "signal.h"
 #include "stdio.h"
+#if defined(CONF_FAMILY_UNIX)
+#include <unistd.h>
+#else
+#include <stdlib.h>
+#endif
+
+static volatile sig_atomic_t s_StopSignal = 0;
 
-static class IGameServer *sp_GameServer;
+static void OnStopSignal(int Sig)
+{
+	// the main loop stops like on the shutdown command, the dropped clients save their stats.
+	// a second one doesn't wait for that
+	if(s_StopSignal)
+		_exit(1);
+	s_StopSignal = 1;
+}
 
 static void OnCrash(int sig)
 {
-	printf("[stats] caught signal=%d saving stats...\n", sig);
-	sp_GameServer->EndRound();
-	if (sig == SIGSEGV)
-		exit(1);
-	exit(0);
+	// a fatal signal, the unsaved round stats are in sv_stats_journal if it is
+	// set and get saved on the next start. nothing that isn't signal safe may run here
+	static const char s_aMsg[] = "[stats] caught fatal signal, round stats stay in the journal if there is one\n";
+	// the lines before the crash are the interesting ones, write out what the log thread didn't yet
+	dbg_logger_crash();
+#if defined(CONF_FAMILY_UNIX)
+	if(write(STDOUT_FILENO, s_aMsg, sizeof(s_aMsg)-1)) {}
+#endif
+	_exit(sig == SIGSEGV ? 1 : 0);
 }
 
 void CServer::InitInterfaces(CConfig *pConfig, IConsole *pConsole, IGameServer *pGameServer, IEngineMap *pMap, IStorage *pStorage)
@@ -1387,6 +1647,8 @@ int CServer::Run()
 	m_pStorage->ListDirectory(IStorage::TYPE_ALL, "maps/", MapListEntryCallback, &Userdata);
 
 	// load map
+	m_pAllocatedMap = CreateEngineMap();
+	m_pNextMap = m_pAllocatedMap;
 	if(!LoadMap(Config()->m_SvMap))
 	{
 		dbg_msg("server", "failed to load map. mapname='%s'", Config()->m_SvMap);
@@ -1430,10 +1692,10 @@ int CServer::Run()
 		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "WARNING: netversion hash differs");
 	}
 
-	sp_GameServer = GameServer();
 	if (Config()->m_SvSaveOnSignal)
 	{
-		signal(SIGINT, OnCrash);
+		signal(SIGINT, OnStopSignal);
+		signal(SIGTERM, OnStopSignal);
 		signal(SIGILL, OnCrash);
 		signal(SIGFPE, OnCrash);
 		signal(SIGABRT, OnCrash);
@@ -1453,8 +1715,7 @@ int CServer::Run()
 
 	// start game
 	{
-		int64 ReportTime = time_get();
-		int ReportInterval = 3;
+		int64 ReportTime = time_get()+time_freq()*Config()->m_SvPerfDumpInterval;
 
 		m_Lastheartbeat = 0;
 		m_GameStartTime = time_get();
@@ -1465,9 +1726,10 @@ int CServer::Run()
 			int NewTicks = 0;
 
 			// load new map TODO: don't poll this
-			if(str_comp(Config()->m_SvMap, m_aCurrentMap) != 0 || m_MapReload || m_CurrentGameTick >= 0x6FFFFFFF) //	force reload to make sure the ticks stay within a valid range
+			if(str_comp(Config()->m_SvMap, m_CurrentMap.m_aName) != 0 || m_MapReload || m_CurrentGameTick >= 0x6FFFFFFF) //	force reload to make sure the ticks stay within a valid range
 			{
 				m_MapReload = 0;
+				int64 MapChangeStart = time_get();
 
 				// load map
 				if(LoadMap(Config()->m_SvMap))
@@ -1493,12 +1755,15 @@ int CServer::Run()
 					m_CurrentGameTick = 0;
 					Kernel()->ReregisterInterface(GameServer());
 					GameServer()->OnInit();
+
+					str_format(aBuf, sizeof(aBuf), "changed map in %.2fms", (time_get()-MapChangeStart)*1000.0f/time_freq());
+					Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBuf);
 				}
 				else
 				{
 					str_format(aBuf, sizeof(aBuf), "failed to load map. mapname='%s'", Config()->m_SvMap);
 					Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
-					str_copy(Config()->m_SvMap, m_aCurrentMap, sizeof(Config()->m_SvMap));
+					str_copy(Config()->m_SvMap, m_CurrentMap.m_aName, sizeof(Config()->m_SvMap));
 				}
 			}
 
@@ -1507,6 +1772,8 @@ int CServer::Run()
 				m_CurrentGameTick++;
 				NewTicks++;
 
+				CProfiler::CScope ProfTick(&m_Profiler, PROF_TICK);
+
 				// apply new input
 				for(int c = 0; c < MAX_CLIENTS; c++)
 				{
@@ -1526,6 +1793,9 @@ int CServer::Run()
 				GameServer()->OnTick();
 			}
 
+			if(NewTicks)
+				m_MapDownloadBudget = Config()->m_SvMapDownloadLimit ? Config()->m_SvMapDownloadLimit : -1;
+
 			// snap game
 			if(NewTicks)
 			{
@@ -1539,48 +1809,58 @@ int CServer::Run()
 			// master server stuff
 			m_Register.RegisterUpdate(m_NetServer.NetType());
 
-			PumpNetwork();
-
-			if(ReportTime < time_get())
 			{
-				if(Config()->m_Debug)
-				{
-					/*
-					static NETSTATS prev_stats;
-					NETSTATS stats;
-					netserver_stats(net, &stats);
-
-					perf_next();
-
-					if(config.dbg_pref)
-						perf_dump(&rootscope);
-
-					dbg_msg("server", "send=%8d recv=%8d",
-						(stats.send_bytes - prev_stats.send_bytes)/reportinterval,
-						(stats.recv_bytes - prev_stats.recv_bytes)/reportinterval);
+				CProfiler::CScope ProfNet(&m_Profiler, PROF_NET);
+				PumpNetwork();
+				SendMapData();
+			}
 
-					prev_stats = stats;
-					*/
-				}
+			UpdateNetStats();
 
-				ReportTime += time_freq()*ReportInterval;
+			if(Config()->m_SvPerfDumpInterval && ReportTime < time_get())
+			{
+				DumpProfile();
+				ReportTime = time_get()+time_freq()*Config()->m_SvPerfDumpInterval;
 			}
 
 			// wait for incomming data
 			m_NetServer.Wait(5);
+
+			if(s_StopSignal)
+			{
+				Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "caught signal, shutting down");
+				m_RunServer = 0;
+			}
 		}
 	}
 	// disconnect all clients on shutdown
 	m_NetServer.Close();
 	m_Econ.Shutdown();
 
+	WaitPreload();
 	GameServer()->OnShutdown();
 	m_pMap->Unload();
+	m_pNextMap->Unload();
+	if(m_pMap == m_pAllocatedMap)
+	{
+		// leave the map object of InitInterfaces registered, main() deletes that one
+		m_pMap = m_pNextMap;
+		Kernel()->ReregisterInterface(static_cast<IEngineMap*>(m_pMap));
+		Kernel()->ReregisterInterface(static_cast<IMap*>(m_pMap));
+	}
+	delete m_pAllocatedMap;
+	m_pAllocatedMap = 0;
+	m_pNextMap = 0;
 
-	if(m_pCurrentMapData)
+	if(m_CurrentMap.m_pChunks)
+	{
+		mem_free(m_CurrentMap.m_pChunks);
+		m_CurrentMap.m_pChunks = 0;
+	}
+	if(m_NextMap.m_pChunks)
 	{
-		mem_free(m_pCurrentMapData);
-		m_pCurrentMapData = 0;
+		mem_free(m_NextMap.m_pChunks);
+		m_NextMap.m_pChunks = 0;
 	}
 	if(m_pMapListHeap)
 	{
@@ -1663,8 +1943,16 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 			{
 				const char *pAuthStr = pThis->m_aClients[i].m_Authed == CServer::AUTHED_ADMIN ? "(Admin)" :
 										pThis->m_aClients[i].m_Authed == CServer::AUTHED_MOD ? "(Mod)" : "";
-				str_format(aBuf, sizeof(aBuf), "id=%d addr=%s client=%x name='%s' score=%d %s", i, aAddrStr,
-					pThis->m_aClients[i].m_Version, pThis->m_aClients[i].m_aName, pThis->m_aClients[i].m_Score, pAuthStr);
+				const CClient *pClient = &pThis->m_aClients[i];
+				int SnapsPerSecond = SERVER_TICK_SPEED/(pThis->Config()->m_SvHighBandwidth ? 1 : 2)/pClient->m_SnapRate.Interval();
+				char aBudget[16];
+				if(pClient->m_SnapRate.Budget() == -1)
+					str_copy(aBudget, "full", sizeof(aBudget));
+				else
+					str_format(aBudget, sizeof(aBudget), "%d", pClient->m_SnapRate.Budget());
+				str_format(aBuf, sizeof(aBuf), "id=%d addr=%s client=%x name='%s' score=%d snaps=%d/s budget=%s rtt=%d loss=%d%% %s", i, aAddrStr,
+					pClient->m_Version, pClient->m_aName, pClient->m_Score, SnapsPerSecond, aBudget,
+					pThis->m_NetServer.ClientConnection(i)->Rtt(), pClient->m_SnapRate.Loss(), pAuthStr);
 			}
 			else
 				str_format(aBuf, sizeof(aBuf), "id=%d addr=%s connecting", i, aAddrStr);
@@ -1673,6 +1961,175 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 	}
 }
 
+void CServer::ConPerf(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	const CProfiler *pProfiler = &pThis->m_Profiler;
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "timings of the last %d seconds in microseconds", (int)((time_get()-pProfiler->WindowStart())/time_freq()));
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "perf", aBuf);
+	for(int i = 0; i < pProfiler->NumZones(); i++)
+	{
+		int Count = pProfiler->Count(i);
+		str_format(aBuf, sizeof(aBuf), "%-14s count=%d avg=%d p50=%d p99=%d max=%d", pProfiler->ZoneName(i), Count,
+			Count ? (int)(pProfiler->Total(i)/Count) : 0, (int)pProfiler->Percentile(i, 50), (int)pProfiler->Percentile(i, 99), (int)pProfiler->Max(i));
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "perf", aBuf);
+	}
+}
+
+void CServer::ConPerfReset(IConsole::IResult *pResult, void *pUser)
+{
+	static_cast<CServer *>(pUser)->m_Profiler.Reset();
+}
+
+void CServer::DumpProfile()
+{
+	IOHANDLE File = Storage()->OpenFile("perf.json", IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(File)
+	{
+		CJsonWriter Writer(File);
+		m_Profiler.WriteJson(&Writer);
+	}
+	else
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "perf", "failed to open perf.json for writing");
+
+	// every dump covers one interval
+	m_Profiler.Reset();
+}
+
+void CServer::UpdateNetStats()
+{
+	if(!m_NetStats.SampleDue())
+		return;
+
+	// copy the counters kept elsewhere
+	CNetStats::CCounters *pCurrent = m_NetStats.Current();
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(m_aClients[i].m_State == CClient::STATE_EMPTY)
+			continue;
+		const CNetConnection *pConnection = m_NetServer.ClientConnection(i);
+		const NETSTATS *pStats = pConnection->Stats();
+		unsigned *pClient = pCurrent->m_aaClient[i];
+		pClient[CNetStats::CLIENT_SENT_BYTES] = pStats->sent_bytes;
+		pClient[CNetStats::CLIENT_SENT_PACKETS] = pStats->sent_packets;
+		pClient[CNetStats::CLIENT_RECV_BYTES] = pStats->recv_bytes;
+		pClient[CNetStats::CLIENT_RECV_PACKETS] = pStats->recv_packets;
+		pClient[CNetStats::CLIENT_RESENT_CHUNKS] = pConnection->NumResentChunks();
+	}
+	for(int i = 0; i < CNetStats::MAX_ITEM_TYPES; i++)
+	{
+		pCurrent->m_aItemBits[i] = m_SnapshotDelta.GetDataRate(i);
+		pCurrent->m_aItemUpdates[i] = m_SnapshotDelta.GetDataUpdates(i);
+	}
+
+	m_NetStats.Sample();
+}
+
+// counters per second over the last Seconds seconds, 0 if there's no data yet
+static int64 NetStatsWindow(const CNetStats *pNetStats, IConsole::IResult *pResult, CNetStats::CCounters *pOut, IConsole *pConsole)
+{
+	int Seconds = pResult->NumArguments() ? pResult->GetInteger(0) : 10;
+	int64 Span = pNetStats->Window(Seconds, pOut);
+	if(!Span)
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_stats", "no samples yet");
+	return Span;
+}
+
+static int PerSecond(unsigned Value, int64 Span)
+{
+	return (int)((int64)Value*time_freq()/Span);
+}
+
+void CServer::ConNetStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	static CNetStats::CCounters s_Window;
+	int64 Span = NetStatsWindow(&pThis->m_NetStats, pResult, &s_Window, pThis->Console());
+	if(!Span)
+		return;
+
+	char aBuf[256];
+	unsigned aTotal[CNetStats::NUM_CLIENT_COUNTERS] = {0};
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(pThis->m_aClients[i].m_State == CClient::STATE_EMPTY)
+			continue;
+
+		const unsigned *pClient = s_Window.m_aaClient[i];
+		for(int c = 0; c < CNetStats::NUM_CLIENT_COUNTERS; c++)
+			aTotal[c] += pClient[c];
+		str_format(aBuf, sizeof(aBuf), "id=%d name='%s' in=%dB/s %dp/s out=%dB/s %dp/s snap=%dB/s resent=%d/s queued=%d",
+			i, pThis->ClientName(i),
+			PerSecond(pClient[CNetStats::CLIENT_RECV_BYTES], Span), PerSecond(pClient[CNetStats::CLIENT_RECV_PACKETS], Span),
+			PerSecond(pClient[CNetStats::CLIENT_SENT_BYTES], Span), PerSecond(pClient[CNetStats::CLIENT_SENT_PACKETS], Span),
+			PerSecond(pClient[CNetStats::CLIENT_SNAP_BYTES], Span), PerSecond(pClient[CNetStats::CLIENT_RESENT_CHUNKS], Span),
+			pThis->m_NetServer.ClientConnection(i)->NumBufferedChunks());
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_stats", aBuf);
+	}
+
+	str_format(aBuf, sizeof(aBuf), "total over %dms: in=%dB/s %dp/s out=%dB/s %dp/s snap=%dB/s resent=%d/s",
+		(int)(Span*1000/time_freq()),
+		PerSecond(aTotal[CNetStats::CLIENT_RECV_BYTES], Span), PerSecond(aTotal[CNetStats::CLIENT_RECV_PACKETS], Span),
+		PerSecond(aTotal[CNetStats::CLIENT_SENT_BYTES], Span), PerSecond(aTotal[CNetStats::CLIENT_SENT_PACKETS], Span),
+		PerSecond(aTotal[CNetStats::CLIENT_SNAP_BYTES], Span), PerSecond(aTotal[CNetStats::CLIENT_RESENT_CHUNKS], Span));
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_stats", aBuf);
+}
+
+void CServer::ConNetStatsMsgs(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	static CNetStats::CCounters s_Window;
+	int64 Span = NetStatsWindow(&pThis->m_NetStats, pResult, &s_Window, pThis->Console());
+	if(!Span)
+		return;
+
+	static const char *s_apDirs[CNetStats::NUM_DIRS] = { "in", "out" };
+	char aBuf[256];
+	char aName[64];
+	for(int Dir = 0; Dir < CNetStats::NUM_DIRS; Dir++)
+		for(int Sys = 0; Sys < 2; Sys++)
+			for(int Msg = 0; Msg < CNetStats::MAX_MSG_TYPES; Msg++)
+			{
+				unsigned Count = s_Window.m_aaaMsgCount[Dir][Sys][Msg];
+				if(!Count)
+					continue;
+				if(Sys)
+					str_format(aName, sizeof(aName), "sys %d", Msg);
+				else
+					str_format(aName, sizeof(aName), "%s", pThis->GameServer()->GetMsgName(Msg));
+				str_format(aBuf, sizeof(aBuf), "%-3s %-24s %6d/s %8dB/s", s_apDirs[Dir], aName,
+					PerSecond(Count, Span), PerSecond(s_Window.m_aaaMsgBytes[Dir][Sys][Msg], Span));
+				pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_stats", aBuf);
+			}
+}
+
+void CServer::ConNetStatsItems(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	static CNetStats::CCounters s_Window;
+	if(!pThis->Config()->m_SvNetStatsItems)
+	{
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_stats", "the item types aren't counted, set sv_net_stats_items 1");
+		return;
+	}
+	int64 Span = NetStatsWindow(&pThis->m_NetStats, pResult, &s_Window, pThis->Console());
+	if(!Span)
+		return;
+
+	// the sizes are of the packed deltas, before the huffman compression of the packets
+	char aBuf[256];
+	for(int i = 0; i < CNetStats::MAX_ITEM_TYPES; i++)
+	{
+		unsigned Updates = s_Window.m_aItemUpdates[i];
+		if(!Updates)
+			continue;
+		str_format(aBuf, sizeof(aBuf), "%-24s %6d updates/s %8dB/s %5dB/update", pThis->GameServer()->GetItemName(i),
+			PerSecond(Updates, Span), PerSecond(s_Window.m_aItemBits[i]/8, Span), (int)(s_Window.m_aItemBits[i]/8/Updates));
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_stats", aBuf);
+	}
+}
+
 void CServer::ConShutdown(IConsole::IResult *pResult, void *pUser)
 {
 	((CServer *)pUser)->m_RunServer = 0;
@@ -1687,7 +2144,7 @@ void CServer::DemoRecorder_HandleAutoStart()
 		char aDate[20];
 		str_timestamp(aDate, sizeof(aDate));
 		str_format(aFilename, sizeof(aFilename), "demos/%s_%s.demo", "auto/autorecord", aDate);
-		m_DemoRecorder.Start(Storage(), m_pConsole, aFilename, GameServer()->NetVersion(), m_aCurrentMap, m_CurrentMapSha256, m_CurrentMapCrc, "server");
+		m_DemoRecorder.Start(Storage(), m_pConsole, aFilename, GameServer()->NetVersion(), m_CurrentMap.m_aName, m_CurrentMap.m_Sha256, m_CurrentMap.m_Crc, "server");
 		if(Config()->m_SvAutoDemoMax)
 		{
 			// clean up auto recorded demos
@@ -1714,7 +2171,7 @@ void CServer::ConRecord(IConsole::IResult *pResult, void *pUser)
 		str_timestamp(aDate, sizeof(aDate));
 		str_format(aFilename, sizeof(aFilename), "demos/demo_%s.demo", aDate);
 	}
-	pServer->m_DemoRecorder.Start(pServer->Storage(), pServer->Console(), aFilename, pServer->GameServer()->NetVersion(), pServer->m_aCurrentMap, pServer->m_CurrentMapSha256, pServer->m_CurrentMapCrc, "server");
+	pServer->m_DemoRecorder.Start(pServer->Storage(), pServer->Console(), aFilename, pServer->GameServer()->NetVersion(), pServer->m_CurrentMap.m_aName, pServer->m_CurrentMap.m_Sha256, pServer->m_CurrentMap.m_Crc, "server");
 }
 
 void CServer::ConStopRecord(IConsole::IResult *pResult, void *pUser)
@@ -1842,6 +2299,11 @@ void CServer::RegisterCommands()
 	// register console commands
 	Console()->Register("kick", "i[id] ?r[reason]", CFGFLAG_SERVER, ConKick, this, "Kick player with specified id for any reason");
 	Console()->Register("status", "", CFGFLAG_SERVER, ConStatus, this, "List players");
+	Console()->Register("perf", "", CFGFLAG_SERVER, ConPerf, this, "Show the per tick timings of the server");
+	Console()->Register("perf_reset", "", CFGFLAG_SERVER, ConPerfReset, this, "Reset the per tick timings");
+	Console()->Register("net_stats", "?i[seconds]", CFGFLAG_SERVER, ConNetStats, this, "Show the traffic of each client");
+	Console()->Register("net_stats_msgs", "?i[seconds]", CFGFLAG_SERVER, ConNetStatsMsgs, this, "Show the traffic of each message type");
+	Console()->Register("net_stats_items", "?i[seconds]", CFGFLAG_SERVER, ConNetStatsItems, this, "Show the snapshot data of each item type");
 	Console()->Register("shutdown", "", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("logout", "", CFGFLAG_SERVER|CFGFLAG_BASICACCESS, ConLogout, this, "Logout of rcon");
 
@@ -1885,6 +2347,17 @@ void *CServer::SnapNewItem(int Type, int ID, int Size)
 	return ID < 0 ? 0 : m_SnapshotBuilder.NewItem(Type, ID, Size);
 }
 
+void *CServer::SnapRepeatItem(int ClientID, int Type, int ID, int Size, int MinTick)
+{
+	dbg_assert(ClientID >= 0 && ClientID < MAX_CLIENTS, "incorrect client id");
+	return m_SnapshotBuilder.RepeatItem(&m_aClients[ClientID].m_Snapshots, Type, ID, Size, MinTick);
+}
+
+int CServer::SnapBudget(int ClientID) const
+{
+	return m_aClients[ClientID].m_SnapRate.Budget();
+}
+
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
@@ -1926,7 +2399,8 @@ int main(int argc, const char **argv) // ignore_convention
 
 	// create the components
 	int FlagMask = CFGFLAG_SERVER|CFGFLAG_ECON;
-	IEngine *pEngine = CreateEngine("Teeworlds_Server");
+	// a second worker, so that record loads don't wait for the stats builds or the map preload
+	IEngine *pEngine = CreateEngine("Teeworlds_Server", 2);
 	IEngineMap *pEngineMap = CreateEngineMap();
 	IGameServer *pGameServer = CreateGameServer();
 	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER|CFGFLAG_ECON);
@@ -1985,12 +2459,12 @@ int main(int argc, const char **argv) // ignore_convention
 	dbg_msg("server", "starting...");
 	int Ret = pServer->Run();
 
-	// free
+	// free, the game server writes its last stats on the engine's jobs
 	delete pServer;
+	delete pGameServer;
 	delete pKernel;
 	delete pEngine;
 	delete pEngineMap;
-	delete pGameServer;
 	delete pConsole;
 	delete pEngineMasterServer;
 	delete pStorage;
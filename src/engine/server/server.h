@@ -4,7 +4,12 @@
 #define ENGINE_SERVER_SERVER_H
 
 #include <engine/server.h>
+#include <engine/shared/jobs.h>
+#include <engine/shared/linkquality.h>
 #include <engine/shared/memheap.h>
+#include <engine/shared/profiler.h>
+
+#include "netstats.h"
 
 class CSnapIDPool
 {
@@ -98,9 +103,8 @@ public:
 			STATE_READY,
 			STATE_INGAME,
 
-			SNAPRATE_INIT=0,
-			SNAPRATE_FULL,
-			SNAPRATE_RECOVER
+			// map data chunks in flight, keeps well clear of the resend buffer size
+			MAP_WINDOW_MAX=16,
 		};
 
 		class CInput
@@ -113,7 +117,17 @@ public:
 		// connection state info
 		int m_State;
 		int m_Latency;
-		int m_SnapRate;
+
+		// snapshot rate governor, see UpdateSnapRate
+		CSnapRateGovernor m_SnapRate;
+		CRttEstimator m_SnapRtt; // from the snapshot acks, vital chunks are rare in game
+		int m_SnapSkip;
+		int m_SnapsSent;
+		int m_SnapsAcked;
+		int64 m_LastInputTime;
+		int m_NumVitalChunks;
+		int m_NumResentChunks;
+		int m_SnapRateTick;
 
 		int m_LastAckedSnapshot;
 		int m_LastInputTick;
@@ -131,7 +145,12 @@ public:
 		int m_Authed;
 		int m_AuthTries;
 
-		int m_MapChunk;
+		// map download, see SendMapData
+		int m_MapChunk; // next chunk to send, -1 when all are sent
+		bool m_MapDownload;
+		int m_MapWindow; // vital chunks that may wait for their ack
+		bool m_MapWindowFull;
+		int m_MapWindowTick;
 		bool m_NoRconNote;
 		bool m_Quitting;
 		const IConsole::CCommandInfo *m_pRconCmdToSend;
@@ -151,6 +170,20 @@ public:
 
 	IEngineMap *m_pMap;
 
+	enum
+	{
+		PROF_NET=0,
+		PROF_TICK,
+		PROF_SNAP,
+		PROF_SNAP_BUILD,
+		PROF_SNAP_DELTA,
+		PROF_SNAP_COMPRESS,
+		PROF_SNAP_SEND,
+		NUM_PROF_ZONES
+	};
+	CProfiler m_Profiler;
+	CNetStats m_NetStats;
+
 	int64 m_GameStartTime;
 	int m_RunServer;
 	int m_MapReload;
@@ -165,12 +198,31 @@ public:
 	{
 		MAP_CHUNK_SIZE=NET_MAX_PAYLOAD-NET_MAX_CHUNKHEADERSIZE-4, // msg type
 	};
-	char m_aCurrentMap[64];
-	SHA256_DIGEST m_CurrentMapSha256;
-	unsigned m_CurrentMapCrc;
-	unsigned char *m_pCurrentMapData;
-	int m_CurrentMapSize;
+	// a loaded map with everything its download needs, see ReadMap
+	struct CMapData
+	{
+		char m_aName[64];
+		SHA256_DIGEST m_Sha256;
+		unsigned m_Crc;
+		int m_Size;
+		// the map split into ready to send NETMSG_MAP_DATA messages, each is the
+		// message header followed by MAP_CHUNK_SIZE bytes of the map
+		unsigned char *m_pChunks;
+		int m_NumChunks;
+		bool m_Loaded;
+	};
+	CMapData m_CurrentMap;
+	// the next map gets read into m_pNextMap ahead of time by the preload job,
+	// or by LoadMap if there was none. the map change swaps it with m_pMap
+	IEngineMap *m_pNextMap;
+	IEngineMap *m_pAllocatedMap; // the one of the two that Run created
+	CMapData m_NextMap;
+	CJob m_PreloadJob;
+	int m_MapChunkHeaderSize;
 	int m_MapChunksPerRequest;
+	// chunks that may still go out this tick, -1 for no limit
+	int m_MapDownloadBudget;
+	int m_NextMapDownload;
 
 	//maplist
 	struct CMapListEntry
@@ -233,12 +285,17 @@ public:
 
 	virtual int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID);
 
+	void UpdateSnapRate(int ClientID);
+	bool LinkQueueing(int ClientID) const;
 	void DoSnapshot();
 
 	static int NewClientCallback(int ClientID, void *pUser);
 	static int DelClientCallback(int ClientID, const char *pReason, void *pUser);
 
 	void SendMap(int ClientID);
+	void SendMapChunk(int ClientID, int Chunk);
+	void UpdateMapWindow(int ClientID);
+	void SendMapData();
 	void SendConnectionReady(int ClientID);
 	void SendRconLine(int ClientID, const char *pLine);
 	static void SendRconLineAuthed(const char *pLine, void *pUser, bool Highlighted);
@@ -257,7 +314,16 @@ public:
 
 	void PumpNetwork();
 
+	virtual CProfiler *Profiler() { return &m_Profiler; }
+	void DumpProfile();
+	void UpdateNetStats();
+
 	const char *GetMapName();
+	bool ReadMap(IEngineMap *pMap, CMapData *pData);
+	static int PreloadMapJob(void *pUser);
+	virtual void PreloadMap(const char *pMapName);
+	virtual void GetMapInfo(char *pMapName, int MapNameSize, SHA256_DIGEST *pSha256) const;
+	void WaitPreload();
 	int LoadMap(const char *pMapName);
 
 	void InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterServer, CConfig *pConfig, IConsole *pConsole);
@@ -268,6 +334,11 @@ public:
 
 	static void ConKick(IConsole::IResult *pResult, void *pUser);
 	static void ConStatus(IConsole::IResult *pResult, void *pUser);
+	static void ConPerf(IConsole::IResult *pResult, void *pUser);
+	static void ConPerfReset(IConsole::IResult *pResult, void *pUser);
+	static void ConNetStats(IConsole::IResult *pResult, void *pUser);
+	static void ConNetStatsMsgs(IConsole::IResult *pResult, void *pUser);
+	static void ConNetStatsItems(IConsole::IResult *pResult, void *pUser);
 	static void ConShutdown(IConsole::IResult *pResult, void *pUser);
 	static void ConRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConStopRecord(IConsole::IResult *pResult, void *pUser);
@@ -288,6 +359,8 @@ public:
 	virtual int SnapNewID();
 	virtual void SnapFreeID(int ID);
 	virtual void *SnapNewItem(int Type, int ID, int Size);
+	virtual void *SnapRepeatItem(int ClientID, int Type, int ID, int Size, int MinTick);
+	virtual int SnapBudget(int ClientID) const;
 	void SnapSetStaticsize(int ItemType, int Size);
 };
 
@@ -4,6 +4,12 @@
 
 #include "compression.h"
 
+#if defined(CONF_SIMD_SSE2)
+	#include <emmintrin.h>
+#elif defined(CONF_SIMD_NEON)
+	#include <arm_neon.h>
+#endif
+
 // Format: ESDDDDDD EDDDDDDD EDD... Extended, Data, Sign
 unsigned char *CVariableInt::Pack(unsigned char *pDst, int i)
 {
@@ -60,18 +66,97 @@ const unsigned char *CVariableInt::Unpack(const unsigned char *pSrc, int *pInOut
 }
 
 
+// the batch paths below handle runs of 16 ints that fit into a single byte each,
+// which is what most of the snapshot deltas are made of. everything else goes
+// through Pack and Unpack, so the output is identical to the plain loop.
+// a batch is only tried once the plain loop has seen a run of BATCH_SIZE single
+// byte ints, so mixed data stays in the plain loop
+#if defined(CONF_SIMD_SSE2) || defined(CONF_SIMD_NEON)
+	#define VARINT_BATCH
+#endif
+
+enum
+{
+	BATCH_SIZE = 16,
+};
+
 long CVariableInt::Decompress(const void *pSrc_, int SrcSize, void *pDst_, int DstSize)
 {
 	const unsigned char *pSrc = (unsigned char *)pSrc_;
 	const unsigned char *pEnd = pSrc + SrcSize;
 	int *pDst = (int *)pDst_;
 	int *pDstEnd = pDst + DstSize/4;
+	int Run = 0; // single byte ints in a row
 	while(pSrc < pEnd)
 	{
-		if(pDst >= pDstEnd)
-			return -1;
-		pSrc = CVariableInt::Unpack(pSrc, pDst);
-		pDst++;
+#if defined(CONF_SIMD_SSE2)
+		while(Run >= BATCH_SIZE && pEnd - pSrc >= BATCH_SIZE && pDstEnd - pDst >= BATCH_SIZE)
+		{
+			__m128i Bytes = _mm_loadu_si128((const __m128i *)pSrc);
+			if(_mm_movemask_epi8(Bytes))
+			{
+				Run = 0; // an extended int in this batch
+				break;
+			}
+
+			const __m128i Zero = _mm_setzero_si128();
+			__m128i aWords[2] = { _mm_unpacklo_epi8(Bytes, Zero), _mm_unpackhi_epi8(Bytes, Zero) };
+			for(int w = 0; w < 2; w++)
+			{
+				__m128i aInts[2] = { _mm_unpacklo_epi16(aWords[w], Zero), _mm_unpackhi_epi16(aWords[w], Zero) };
+				for(int i = 0; i < 2; i++)
+				{
+					__m128i Sign = _mm_srai_epi32(_mm_slli_epi32(aInts[i], 25), 31);
+					__m128i Value = _mm_and_si128(aInts[i], _mm_set1_epi32(0x3F));
+					_mm_storeu_si128((__m128i *)(pDst+w*8+i*4), _mm_xor_si128(Value, Sign));
+				}
+			}
+			pSrc += BATCH_SIZE;
+			pDst += BATCH_SIZE;
+		}
+		if(pSrc >= pEnd)
+			break;
+#elif defined(CONF_SIMD_NEON)
+		while(Run >= BATCH_SIZE && pEnd - pSrc >= BATCH_SIZE && pDstEnd - pDst >= BATCH_SIZE)
+		{
+			uint8x16_t Bytes = vld1q_u8(pSrc);
+			uint64x2_t Extended = vreinterpretq_u64_u8(vandq_u8(Bytes, vdupq_n_u8(0x80)));
+			if(vgetq_lane_u64(Extended, 0) | vgetq_lane_u64(Extended, 1))
+			{
+				Run = 0; // an extended int in this batch
+				break;
+			}
+
+			uint16x8_t aWords[2] = { vmovl_u8(vget_low_u8(Bytes)), vmovl_u8(vget_high_u8(Bytes)) };
+			for(int w = 0; w < 2; w++)
+			{
+				int32x4_t aInts[2] = { vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(aWords[w]))), vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(aWords[w]))) };
+				for(int i = 0; i < 2; i++)
+				{
+					int32x4_t Sign = vshrq_n_s32(vshlq_n_s32(aInts[i], 25), 31);
+					int32x4_t Value = vandq_s32(aInts[i], vdupq_n_s32(0x3F));
+					vst1q_s32(pDst+w*8+i*4, veorq_s32(Value, Sign));
+				}
+			}
+			pSrc += BATCH_SIZE;
+			pDst += BATCH_SIZE;
+		}
+		if(pSrc >= pEnd)
+			break;
+#endif
+		// plain loop until a run of single byte ints starts
+		do
+		{
+			if(pDst >= pDstEnd)
+				return -1;
+			const unsigned char *pNext = CVariableInt::Unpack(pSrc, pDst);
+#if defined(VARINT_BATCH)
+			Run = pNext == pSrc+1 ? Run+1 : 0;
+#endif
+			pSrc = pNext;
+			pDst++;
+		}
+		while(pSrc < pEnd && Run < BATCH_SIZE);
 	}
 	return (long)((unsigned char *)pDst-(unsigned char *)pDst_);
 }
@@ -82,14 +167,78 @@ long CVariableInt::Compress(const void *pSrc_, int SrcSize, void *pDst_, int Dst
 	unsigned char *pDst = (unsigned char *)pDst_;
 	unsigned char *pDstEnd = pDst + DstSize;
 	SrcSize /= 4;
+	int Run = 0; // single byte ints in a row
 	while(SrcSize)
 	{
-		if(pDstEnd - pDst < 6)
-			return -1;
-		pDst = CVariableInt::Pack(pDst, *pSrc);
-		SrcSize--;
-		pSrc++;
+		// each int checks for room for a full one, so a batch needs five bytes more to fail at the same point
+#if defined(CONF_SIMD_SSE2)
+		while(Run >= BATCH_SIZE && SrcSize >= BATCH_SIZE && pDstEnd - pDst >= BATCH_SIZE+5)
+		{
+			__m128i aBytes[4];
+			__m128i Large = _mm_setzero_si128();
+			for(int i = 0; i < 4; i++)
+			{
+				__m128i Int = _mm_loadu_si128((const __m128i *)(pSrc+i*4));
+				__m128i Sign = _mm_srai_epi32(Int, 31);
+				__m128i Value = _mm_xor_si128(Int, Sign);
+				Large = _mm_or_si128(Large, _mm_cmpgt_epi32(Value, _mm_set1_epi32(0x3F)));
+				aBytes[i] = _mm_or_si128(Value, _mm_and_si128(Sign, _mm_set1_epi32(0x40)));
+			}
+			if(_mm_movemask_epi8(Large))
+			{
+				Run = 0; // an int in this batch needs more than one byte
+				break;
+			}
+
+			_mm_storeu_si128((__m128i *)pDst, _mm_packus_epi16(_mm_packs_epi32(aBytes[0], aBytes[1]), _mm_packs_epi32(aBytes[2], aBytes[3])));
+			pSrc += BATCH_SIZE;
+			pDst += BATCH_SIZE;
+			SrcSize -= BATCH_SIZE;
+		}
+		if(!SrcSize)
+			break;
+#elif defined(CONF_SIMD_NEON)
+		while(Run >= BATCH_SIZE && SrcSize >= BATCH_SIZE && pDstEnd - pDst >= BATCH_SIZE+5)
+		{
+			uint16x4_t aBytes[4];
+			uint32x4_t Large = vdupq_n_u32(0);
+			for(int i = 0; i < 4; i++)
+			{
+				int32x4_t Int = vld1q_s32(pSrc+i*4);
+				int32x4_t Sign = vshrq_n_s32(Int, 31);
+				int32x4_t Value = veorq_s32(Int, Sign);
+				Large = vorrq_u32(Large, vcgtq_s32(Value, vdupq_n_s32(0x3F)));
+				aBytes[i] = vmovn_u32(vreinterpretq_u32_s32(vorrq_s32(Value, vandq_s32(Sign, vdupq_n_s32(0x40)))));
+			}
+			if(vgetq_lane_u32(Large, 0) | vgetq_lane_u32(Large, 1) | vgetq_lane_u32(Large, 2) | vgetq_lane_u32(Large, 3))
+			{
+				Run = 0; // an int in this batch needs more than one byte
+				break;
+			}
+
+			vst1_u8(pDst, vmovn_u16(vcombine_u16(aBytes[0], aBytes[1])));
+			vst1_u8(pDst+8, vmovn_u16(vcombine_u16(aBytes[2], aBytes[3])));
+			pSrc += BATCH_SIZE;
+			pDst += BATCH_SIZE;
+			SrcSize -= BATCH_SIZE;
+		}
+		if(!SrcSize)
+			break;
+#endif
+		// plain loop until a run of single byte ints starts
+		do
+		{
+			if(pDstEnd - pDst < 6)
+				return -1;
+			unsigned char *pNext = CVariableInt::Pack(pDst, *pSrc);
+#if defined(VARINT_BATCH)
+			Run = pNext == pDst+1 ? Run+1 : 0;
+#endif
+			pDst = pNext;
+			SrcSize--;
+			pSrc++;
+		}
+		while(SrcSize && Run < BATCH_SIZE);
 	}
 	return (long)(pDst-(unsigned char *)pDst_);
 }
-
@@ -14,6 +14,7 @@ MACRO_CONFIG_INT(PlayerCountry, player_country, -1, -1, 1000, CFGFLAG_SAVE|CFGFL
 MACRO_CONFIG_STR(Password, password, 32, "", CFGFLAG_SAVE|CFGFLAG_CLIENT|CFGFLAG_SERVER, "Password to the server")
 MACRO_CONFIG_STR(Logfile, logfile, 128, "", CFGFLAG_SAVE|CFGFLAG_CLIENT|CFGFLAG_SERVER, "Filename to log all output to")
 MACRO_CONFIG_INT(LogfileTimestamp, logfile_timestamp, 0, 0, 1, CFGFLAG_SAVE|CFGFLAG_CLIENT|CFGFLAG_SERVER, "Add a time stamp to the log file's name")
+MACRO_CONFIG_INT(LogFlushInterval, log_flush_interval, 20, 0, 1000, CFGFLAG_SAVE|CFGFLAG_CLIENT|CFGFLAG_SERVER, "Write the log from a background thread every that many milliseconds (0=write every line right away)")
 MACRO_CONFIG_INT(ConsoleOutputLevel, console_output_level, 0, 0, 2, CFGFLAG_SAVE|CFGFLAG_CLIENT|CFGFLAG_SERVER, "Adjusts the amount of information in the console")
 MACRO_CONFIG_INT(ShowConsoleWindow, show_console_window, 1, 0, 3, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Show console window (0 = never, 1 = debug, 2 = release, 3 = always")
 
@@ -85,7 +86,8 @@ MACRO_CONFIG_INT(SvExternalPort, sv_external_port, 0, 0, 0, CFGFLAG_SAVE|CFGFLAG
 MACRO_CONFIG_STR(SvMap, sv_map, 128, "ctf5_solofng", CFGFLAG_SAVE|CFGFLAG_SERVER, "Map to use on the server")
 MACRO_CONFIG_INT(SvMaxClients, sv_max_clients, 64, 1, MAX_CLIENTS, CFGFLAG_SAVE|CFGFLAG_SERVER, "Maximum number of clients that are allowed on a server")
 MACRO_CONFIG_INT(SvMaxClientsPerIP, sv_max_clients_per_ip, 4, 1, MAX_CLIENTS, CFGFLAG_SAVE|CFGFLAG_SERVER, "Maximum number of clients with the same IP that can connect to the server")
-MACRO_CONFIG_INT(SvMapDownloadSpeed, sv_map_download_speed, 8, 1, 16, CFGFLAG_SAVE|CFGFLAG_SERVER, "Number of map data packages a client gets on each request")
+MACRO_CONFIG_INT(SvMapDownloadSpeed, sv_map_download_speed, 8, 1, 16, CFGFLAG_SAVE|CFGFLAG_SERVER, "Number of map data packages in flight to a client when its download starts, adapts to the connection after that")
+MACRO_CONFIG_INT(SvMapDownloadLimit, sv_map_download_limit, 64, 0, 1024, CFGFLAG_SAVE|CFGFLAG_SERVER, "Number of map data packages sent to all clients together per tick (0 for no limit)")
 MACRO_CONFIG_INT(SvHighBandwidth, sv_high_bandwidth, 0, 0, 1, CFGFLAG_SAVE|CFGFLAG_SERVER, "Use high bandwidth mode. Doubles the bandwidth required for the server. LAN use only")
 MACRO_CONFIG_INT(SvRegister, sv_register, 1, 0, 1, CFGFLAG_SAVE|CFGFLAG_SERVER, "Register server with master server for public listing")
 MACRO_CONFIG_STR(SvRconPassword, sv_rcon_password, 32, "", CFGFLAG_SAVE|CFGFLAG_SERVER, "Remote console password (full access)")
@@ -94,6 +96,8 @@ MACRO_CONFIG_INT(SvRconMaxTries, sv_rcon_max_tries, 3, 0, 100, CFGFLAG_SAVE|CFGF
 MACRO_CONFIG_INT(SvRconBantime, sv_rcon_bantime, 5, 0, 1440, CFGFLAG_SAVE|CFGFLAG_SERVER, "The time a client gets banned if remote console authentication fails. 0 makes it just use kick")
 MACRO_CONFIG_INT(SvAutoDemoRecord, sv_auto_demo_record, 0, 0, 1, CFGFLAG_SAVE|CFGFLAG_SERVER, "Automatically record demos")
 MACRO_CONFIG_INT(SvAutoDemoMax, sv_auto_demo_max, 10, 0, 1000, CFGFLAG_SAVE|CFGFLAG_SERVER, "Maximum number of automatically recorded demos (0 = no limit)")
+MACRO_CONFIG_INT(SvNetStatsItems, sv_net_stats_items, 0, 0, 1, CFGFLAG_SAVE|CFGFLAG_SERVER, "Count the snapshot data of each item type for net_stats_items, costs some time per snapshot")
+MACRO_CONFIG_INT(SvPerfDumpInterval, sv_perf_dump_interval, 0, 0, 3600, CFGFLAG_SAVE|CFGFLAG_SERVER, "Seconds between dumps of the profiler to perf.json (0 = off)")
 
 MACRO_CONFIG_STR(EcBindaddr, ec_bindaddr, 128, "localhost", CFGFLAG_SAVE|CFGFLAG_ECON, "Address to bind the external console to. Anything but 'localhost' is dangerous")
 MACRO_CONFIG_INT(EcPort, ec_port, 0, 0, 0, CFGFLAG_SAVE|CFGFLAG_ECON, "Port to use for the external console")
@@ -120,8 +124,14 @@ MACRO_CONFIG_INT(SvMeltHammerScaleY, sv_melt_hammer_scale_y, 50, 1, 1000, CFGFLA
 MACRO_CONFIG_INT(SvFreezeDelay, sv_freeze_delay, 9, 1, 30, CFGFLAG_SERVER, "How many seconds the players will remain frozen")
 MACRO_CONFIG_STR(SvStatsPath, sv_stats_path, 512, "stats", CFGFLAG_SERVER, "path to solofng stats directory")
 MACRO_CONFIG_STR(SvStatsFailPath, sv_stats_fail_path, 512, "stats_failed", CFGFLAG_SERVER, "path to solofng failed stats directory")
+MACRO_CONFIG_STR(SvStatsJournal, sv_stats_journal, 512, "auto", CFGFLAG_SERVER, "file that keeps the unsaved round stats over a crash, each server needs its own (auto=journal_<sv_port>.dat in sv_stats_path, empty=off)")
+MACRO_CONFIG_STR(SvStatsSnapshot, sv_stats_snapshot, 512, "", CFGFLAG_SERVER, "file the columnar stats snapshot for stats_tool gets written to (empty=off)")
+MACRO_CONFIG_INT(SvStatsSnapshotInterval, sv_stats_snapshot_interval, 10, 1, 1440, CFGFLAG_SERVER, "minutes between two stats snapshots")
+MACRO_CONFIG_STR(SvStatsServer, sv_stats_server, 128, "", CFGFLAG_SERVER, "address of a stats server (statssrv) that saves the stats of several servers (empty=write the stats files directly, sv_stats_path must still point to its directory)")
+MACRO_CONFIG_STR(SvStatsSeasonStart, sv_stats_season_start, 16, "", CFGFLAG_SERVER, "first day (YYYY-MM-DD, utc) of the season leaderboard of /top5, rounded to the monday of its week (empty=off)")
+MACRO_CONFIG_STR(SvRankFormula, sv_rank_formula, 256, "freezes + kills*3 + gold_spikes*5 + green_spikes*3 + purple_spikes*7", CFGFLAG_SERVER, "score formula of /rank and /top5, a sum of stats columns times numbers")
 MACRO_CONFIG_INT(SvSpreePlayers, sv_spree_players, 5, 1, 60, CFGFLAG_SERVER, "how many players have to be online to count killingsprees")
-MACRO_CONFIG_INT(SvSaveOnSignal, sv_save_on_signal, 1, 0, 2, CFGFLAG_SERVER, "0=off 1=int/ill/fpe/abrt 2=1/segv")
+MACRO_CONFIG_INT(SvSaveOnSignal, sv_save_on_signal, 1, 0, 2, CFGFLAG_SERVER, "0=off 1=int/term shut down cleanly and save the stats, ill/fpe/abrt exit and leave the round stats in sv_stats_journal 2=1/segv")
 MACRO_CONFIG_INT(SvStats, sv_stats, 1, 0, 1, CFGFLAG_SERVER, "0=off 1=use file stats (sv_stats_path is related)")
 MACRO_CONFIG_INT(SvAllowRankCmds, sv_allow_rank_cmds, 1, 0, 1, CFGFLAG_SERVER, "0=off allows threaded ranking commands that could mess up things")
 MACRO_CONFIG_INT(SvEmoticonDelay, sv_emoticon_delay, 3, 0, 9999, CFGFLAG_SERVER, "The time in seconds between over-head emoticons")
@@ -240,16 +240,21 @@ void CConsole::SetPrintOutputLevel(int Index, int OutputLevel)
 
 void CConsole::Print(int Level, const char *pFrom, const char *pStr, bool Highlighted)
 {
-	char aTimeBuf[80];
-	str_timestamp_format(aTimeBuf, sizeof(aTimeBuf), FORMAT_TIME);
+	dbg_msg(pFrom ,"%s", pStr);
 
+	// the line for the callbacks is only formatted when one of them wants it
 	char aBuf[1024];
-	str_format(aBuf, sizeof(aBuf), "[%s][%s]: %s", aTimeBuf, pFrom, pStr);
-	dbg_msg(pFrom ,"%s", pStr);
+	aBuf[0] = 0;
 	for(int i = 0; i < m_NumPrintCB; ++i)
 	{
 		if(Level <= m_aPrintCB[i].m_OutputLevel && m_aPrintCB[i].m_pfnPrintCallback)
 		{
+			if(!aBuf[0])
+			{
+				char aTimeBuf[80];
+				str_timestamp_format(aTimeBuf, sizeof(aTimeBuf), FORMAT_TIME);
+				str_format(aBuf, sizeof(aBuf), "[%s][%s]: %s", aTimeBuf, pFrom, pStr);
+			}
 			m_aPrintCB[i].m_pfnPrintCallback(aBuf, m_aPrintCB[i].m_pPrintCallbackUserdata, Highlighted);
 		}
 	}
@@ -440,10 +440,6 @@ void CDemoPlayer::ScanFile()
 
 void CDemoPlayer::DoTick()
 {
-	static char aCompressedData[CSnapshot::MAX_SIZE];
-	static char aDecompressed[CSnapshot::MAX_SIZE];
-	static char aData[CSnapshot::MAX_SIZE];
-	static char aNewSnap[CSnapshot::MAX_SIZE];
 	bool GotSnapshot = false;
 
 	// update ticks
@@ -472,7 +468,7 @@ void CDemoPlayer::DoTick()
 		// read the chunk
 		if(ChunkSize)
 		{
-			if(io_read(m_File, aCompressedData, ChunkSize) != (unsigned)ChunkSize)
+			if(io_read(m_File, m_aCompressedData, ChunkSize) != (unsigned)ChunkSize)
 			{
 				// stop on error or eof
 				m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "error reading chunk");
@@ -480,7 +476,7 @@ void CDemoPlayer::DoTick()
 				break;
 			}
 
-			DataSize = m_Huffman.Decompress(aCompressedData, ChunkSize, aDecompressed, sizeof(aDecompressed));
+			DataSize = m_Huffman.Decompress(m_aCompressedData, ChunkSize, m_aDecompressed, sizeof(m_aDecompressed));
 			if(DataSize < 0)
 			{
 				// stop on error or eof
@@ -489,7 +485,7 @@ void CDemoPlayer::DoTick()
 				break;
 			}
 
-			DataSize = CVariableInt::Decompress(aDecompressed, DataSize, aData, sizeof(aData));
+			DataSize = CVariableInt::Decompress(m_aDecompressed, DataSize, m_aData, sizeof(m_aData));
 			if(DataSize < 0)
 			{
 				m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "error during intpack decompression");
@@ -507,14 +503,14 @@ void CDemoPlayer::DoTick()
 			if(m_LastSnapshotDataSize == -1)
 				continue;
 
-			DataSize = m_pSnapshotDelta->UnpackDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)aNewSnap, aData, DataSize);
+			DataSize = m_pSnapshotDelta->UnpackDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)m_aNewSnap, m_aData, DataSize);
 			if(DataSize >= 0)
 			{
 				if(m_pListener)
-					m_pListener->OnDemoPlayerSnapshot(aNewSnap, DataSize);
+					m_pListener->OnDemoPlayerSnapshot(m_aNewSnap, DataSize);
 
 				m_LastSnapshotDataSize = DataSize;
-				mem_copy(m_aLastSnapshotData, aNewSnap, DataSize);
+				mem_copy(m_aLastSnapshotData, m_aNewSnap, DataSize);
 			}
 			else
 			{
@@ -529,17 +525,17 @@ void CDemoPlayer::DoTick()
 			CSnapshotBuilder Builder;
 			GotSnapshot = true;
 
-			if(Builder.UnserializeSnap(aData, DataSize))
-				DataSize = Builder.Finish(aNewSnap);
+			if(Builder.UnserializeSnap(m_aData, DataSize))
+				DataSize = Builder.Finish(m_aNewSnap);
 			else
 				DataSize = -1;
 
 			if(DataSize >= 0)
 			{
 				m_LastSnapshotDataSize = DataSize;
-				mem_copy(m_aLastSnapshotData, aNewSnap, DataSize);
+				mem_copy(m_aLastSnapshotData, m_aNewSnap, DataSize);
 				if(m_pListener)
-					m_pListener->OnDemoPlayerSnapshot(aNewSnap, DataSize);
+					m_pListener->OnDemoPlayerSnapshot(m_aNewSnap, DataSize);
 			}
 			else
 			{
@@ -566,7 +562,7 @@ void CDemoPlayer::DoTick()
 			else if(ChunkType == CHUNKTYPE_MESSAGE)
 			{
 				if(m_pListener)
-					m_pListener->OnDemoPlayerMessage(aData, DataSize);
+					m_pListener->OnDemoPlayerMessage(m_aData, DataSize);
 			}
 		}
 	}
@@ -668,8 +664,11 @@ const char *CDemoPlayer::Load(class IStorage *pStorage, class IConsole *pConsole
 
 		// save map
 		MapFile = pStorage->OpenFile(aMapFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
-		io_write(MapFile, pMapData, MapSize);
-		io_close(MapFile);
+		if(MapFile)
+		{
+			io_write(MapFile, pMapData, MapSize);
+			io_close(MapFile);
+		}
 
 		// free data
 		mem_free(pMapData);
@@ -98,10 +98,15 @@ private:
 	int m_LastSnapshotDataSize;
 	class CSnapshotDelta *m_pSnapshotDelta;
 
+	// chunk buffers, members so several players can run on different threads
+	char m_aCompressedData[CSnapshot::MAX_SIZE];
+	char m_aDecompressed[CSnapshot::MAX_SIZE];
+	char m_aData[CSnapshot::MAX_SIZE];
+	char m_aNewSnap[CSnapshot::MAX_SIZE];
+
 	int ReadChunkHeader(int *pType, int *pSize, int *pTick);
 	void DoTick();
 	void ScanFile();
-	int NextFrame();
 
 public:
 
@@ -122,6 +127,9 @@ public:
 	int GetDemoType() const;
 
 	int Update();
+	// plays the next tick right away, for going through a demo as fast as possible.
+	// the player pauses at the end of the demo
+	int NextFrame();
 
 	const CPlaybackInfo *Info() const { return &m_Info; }
 	int IsPlaying() const { return m_File != 0; }
@@ -48,7 +48,7 @@ public:
 		}
 	}
 
-	CEngine(const char *pAppname)
+	CEngine(const char *pAppname, int NumJobThreads)
 	{
 		srand(time_get());
 		dbg_logger_stdout();
@@ -65,7 +65,7 @@ public:
 	#endif
 
 		
-		m_JobPool.Init(1);
+		m_JobPool.Init(NumJobThreads);
 
 		m_DataLogSent = 0;
 		m_DataLogRecv = 0;
@@ -108,6 +108,9 @@ public:
 			else
 				dbg_msg("engine/logfile", "failed to open '%s' for logging", aLogFilename);
 		}
+
+		if(m_pConfig->m_LogFlushInterval)
+			dbg_logger_async(m_pConfig->m_LogFlushInterval);
 	}
 
 	void QueryNetLogHandles(IOHANDLE *pHDLSend, IOHANDLE *pHDLRecv)
@@ -167,6 +170,11 @@ public:
 			dbg_msg("engine", "job added");
 		m_JobPool.Add(pJob, pfnFunc, pData);
 	}
+
+	bool RemoveJob(CJob *pJob)
+	{
+		return m_JobPool.Remove(pJob);
+	}
 };
 
-IEngine *CreateEngine(const char *pAppname) { return new CEngine(pAppname); }
+IEngine *CreateEngine(const char *pAppname, int NumJobThreads) { return new CEngine(pAppname, NumJobThreads); }
@@ -87,3 +87,28 @@ int CJobPool::Add(CJob *pJob, JOBFUNC pfnFunc, void *pData)
 	return 0;
 }
 
+bool CJobPool::Remove(CJob *pJob)
+{
+	bool Removed = false;
+	lock_wait(m_Lock);
+	for(CJob *pQueued = m_pFirstJob; pQueued; pQueued = pQueued->m_pNext)
+	{
+		if(pQueued != pJob)
+			continue;
+
+		if(pJob->m_pPrev)
+			pJob->m_pPrev->m_pNext = pJob->m_pNext;
+		else
+			m_pFirstJob = pJob->m_pNext;
+		if(pJob->m_pNext)
+			pJob->m_pNext->m_pPrev = pJob->m_pPrev;
+		else
+			m_pLastJob = pJob->m_pPrev;
+		pJob->m_Status = CJob::STATE_DONE;
+		Removed = true;
+		break;
+	}
+	lock_unlock(m_Lock);
+	return Removed;
+}
+
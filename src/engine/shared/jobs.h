@@ -58,5 +58,7 @@ public:
 
 	int Init(int NumThreads);
 	int Add(CJob *pJob, JOBFUNC pfnFunc, void *pData);
+	// takes the job out of the queue, false if a worker started it already
+	bool Remove(CJob *pJob);
 };
 #endif
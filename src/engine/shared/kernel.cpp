@@ -75,13 +75,15 @@ public:
 
 	virtual bool ReregisterInterfaceImpl(const char *pName, IInterface *pInterface)
 	{
-		if(FindInterfaceInfo(pName) == 0)
+		CInterfaceInfo *pInfo = FindInterfaceInfo(pName);
+		if(pInfo == 0)
 		{
 			dbg_msg("kernel", "ERROR: couldn't reregister interface '%s'. interface doesn't exist", pName);
 			return false;
 		}
 
 		pInterface->m_pKernel = this;
+		pInfo->m_pInterface = pInterface;
 
 		return true;
 	}
@@ -0,0 +1,73 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+
+#include "linkquality.h"
+
+void CRttEstimator::Reset()
+{
+	m_Rtt = -1;
+	m_MinRtt = -1;
+	m_PrevMinRtt = -1;
+	m_WindowStart = 0;
+}
+
+void CRttEstimator::AddSample(int Rtt, int64 Now)
+{
+	int64 Window = MIN_WINDOW*time_freq();
+	if(m_MinRtt < 0 || Now-m_WindowStart >= Window)
+	{
+		// a window without samples in between leaves nothing worth keeping
+		m_PrevMinRtt = m_MinRtt >= 0 && Now-m_WindowStart < 2*Window ? m_MinRtt : -1;
+		m_MinRtt = -1;
+		m_WindowStart = Now;
+	}
+
+	if(m_MinRtt < 0 || Rtt < m_MinRtt)
+		m_MinRtt = Rtt;
+	m_Rtt = m_Rtt < 0 ? Rtt : (m_Rtt*7+Rtt)/8;
+}
+
+int CRttEstimator::MinRtt() const
+{
+	if(m_PrevMinRtt < 0)
+		return m_MinRtt;
+	return minimum(m_MinRtt, m_PrevMinRtt);
+}
+
+void CSnapRateGovernor::Reset()
+{
+	m_Interval = INTERVAL_INIT;
+	m_Budget = -1;
+	m_Loss = 0;
+}
+
+void CSnapRateGovernor::Update(int Loss, bool Queueing, bool Acked)
+{
+	m_Loss = (m_Loss+Loss)/2;
+	if(!Acked)
+		return;
+
+	if(m_Loss >= LOSS_BACKOFF || Queueing)
+	{
+		// back off quickly
+		m_Interval = minimum(m_Interval+(m_Interval+1)/2, (int)INTERVAL_MAX);
+		m_Budget = m_Budget == -1 ? BUDGET_MAX/2 : maximum(m_Budget/2, (int)BUDGET_MIN);
+	}
+	else if(m_Loss < LOSS_RECOVER)
+	{
+		// and recover in steps
+		m_Interval = maximum(1, minimum(m_Interval-1, m_Interval*2/3));
+		if(m_Budget != -1)
+		{
+			m_Budget *= 2;
+			if(m_Budget >= BUDGET_MAX)
+				m_Budget = -1;
+		}
+	}
+}
+
+void CSnapRateGovernor::MissingDeltaBase()
+{
+	m_Interval = clamp(m_Interval*2, 4, (int)INTERVAL_MAX);
+}
@@ -0,0 +1,70 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_LINKQUALITY_H
+#define ENGINE_SHARED_LINKQUALITY_H
+
+#include <base/system.h>
+
+// round trip time in ms. the minimum only covers the last one to two windows,
+// so a quiet moment long ago or a route change doesn't read as queueing forever
+class CRttEstimator
+{
+	int m_Rtt;
+	int m_MinRtt;
+	int m_PrevMinRtt;
+	int64 m_WindowStart;
+
+public:
+	enum
+	{
+		MIN_WINDOW=10, // seconds
+		QUEUEING_DELAY=150, // ms above the minimum
+	};
+
+	CRttEstimator() { Reset(); }
+	void Reset();
+	void AddSample(int Rtt, int64 Now);
+
+	// -1 until the first sample
+	int Rtt() const { return m_Rtt; }
+	int MinRtt() const;
+	// the packets queue up somewhere on the way
+	bool Queueing() const { return m_Rtt >= 0 && m_Rtt-MinRtt() > QUEUEING_DELAY; }
+};
+
+// spreads the snapshots out and limits the off-screen items for clients on bad links
+class CSnapRateGovernor
+{
+	int m_Interval;
+	int m_Budget;
+	int m_Loss;
+
+public:
+	enum
+	{
+		INTERVAL_INIT=5,
+		INTERVAL_MAX=25,
+		BUDGET_MIN=512,
+		BUDGET_MAX=16384,
+
+		// smoothed loss in percent
+		LOSS_BACKOFF=20,
+		LOSS_RECOVER=5,
+	};
+
+	CSnapRateGovernor() { Reset(); }
+	void Reset();
+
+	// Loss is in percent over the last period. stays at the initial rate until the client acked a snapshot
+	void Update(int Loss, bool Queueing, bool Acked);
+	// the client acked a snapshot that is gone, don't spam full snapshots until it catches up
+	void MissingDeltaBase();
+
+	// the client gets every nth snapshot
+	int Interval() const { return m_Interval; }
+	// bytes of off-screen items refreshed per snapshot, -1 for no limit
+	int Budget() const { return m_Budget; }
+	int Loss() const { return m_Loss; }
+};
+
+#endif
@@ -112,6 +112,7 @@ CNetBase::CNetBase()
 	m_pEngine = 0;
 	m_DataLogSent = 0;
 	m_DataLogRecv = 0;
+	m_LastRecvSize = 0;
 }
 
 CNetBase::~CNetBase()
@@ -168,7 +169,7 @@ void CNetBase::SendPacketConnless(const NETADDR *pAddr, TOKEN Token, TOKEN Respo
 	net_udp_send(m_Socket, pAddr, aBuffer, i+DataSize);
 }
 
-void CNetBase::SendPacket(const NETADDR *pAddr, CNetPacketConstruct *pPacket)
+int CNetBase::SendPacket(const NETADDR *pAddr, CNetPacketConstruct *pPacket)
 {
 	unsigned char aBuffer[NET_MAX_PACKETSIZE];
 	int CompressedSize = -1;
@@ -232,6 +233,7 @@ void CNetBase::SendPacket(const NETADDR *pAddr, CNetPacketConstruct *pPacket)
 			io_flush(m_DataLogSent);
 		}
 	}
+	return FinalSize;
 }
 
 // TODO: rename this function
@@ -241,6 +243,7 @@ int CNetBase::UnpackPacket(NETADDR *pAddr, unsigned char *pBuffer, CNetPacketCon
 	// no more packets for now
 	if(Size <= 0)
 		return 1;
+	m_LastRecvSize = Size;
 
 	// log the data
 	if(m_DataLogRecv)
@@ -351,7 +354,7 @@ int CNetBase::UnpackPacket(NETADDR *pAddr, unsigned char *pBuffer, CNetPacketCon
 }
 
 
-void CNetBase::SendControlMsg(const NETADDR *pAddr, TOKEN Token, int Ack, int ControlMsg, const void *pExtra, int ExtraSize)
+int CNetBase::SendControlMsg(const NETADDR *pAddr, TOKEN Token, int Ack, int ControlMsg, const void *pExtra, int ExtraSize)
 {
 	CNetPacketConstruct Construct;
 	Construct.m_Token = Token;
@@ -363,7 +366,7 @@ void CNetBase::SendControlMsg(const NETADDR *pAddr, TOKEN Token, int Ack, int Co
 	mem_copy(&Construct.m_aChunkData[1], pExtra, ExtraSize);
 
 	// send the control message
-	SendPacket(pAddr, &Construct);
+	return SendPacket(pAddr, &Construct);
 }
 
 
@@ -5,6 +5,7 @@
 
 #include "ringbuffer.h"
 #include "huffman.h"
+#include "linkquality.h"
 
 /*
 
@@ -206,6 +207,7 @@ class CNetBase
 	IOHANDLE m_DataLogRecv;
 	CHuffman m_Huffman;
 	unsigned char m_aRequestTokenBuf[NET_TOKENREQUEST_DATASIZE];
+	int m_LastRecvSize; // size on the wire of the packet UnpackPacket returned last
 
 public:
 	CNetBase();
@@ -219,11 +221,13 @@ public:
 	void UpdateLogHandles();
 	void Wait(int Time);
 
-	void SendControlMsg(const NETADDR *pAddr, TOKEN Token, int Ack, int ControlMsg, const void *pExtra, int ExtraSize);
+	int SendControlMsg(const NETADDR *pAddr, TOKEN Token, int Ack, int ControlMsg, const void *pExtra, int ExtraSize);
 	void SendControlMsgWithToken(const NETADDR *pAddr, TOKEN Token, int Ack, int ControlMsg, TOKEN MyToken, bool Extended);
 	void SendPacketConnless(const NETADDR *pAddr, TOKEN Token, TOKEN ResponseToken, const void *pData, int DataSize);
-	void SendPacket(const NETADDR *pAddr, CNetPacketConstruct *pPacket);
+	// returns the number of bytes put on the wire, -1 on failure
+	int SendPacket(const NETADDR *pAddr, CNetPacketConstruct *pPacket);
 	int UnpackPacket(NETADDR *pAddr, unsigned char *pBuffer, CNetPacketConstruct *pPacket);
+	int LastRecvSize() const { return m_LastRecvSize; }
 };
 
 class CNetTokenManager
@@ -344,6 +348,12 @@ private:
 	NETSTATS m_Stats;
 	CNetBase *m_pNetBase;
 
+	// link quality, measured from the vital chunks
+	CRttEstimator m_Rtt;
+	int m_NumVitalChunks;
+	int m_NumResentChunks;
+	int m_NumBufferedChunks;
+
 	//
 	void Reset();
 	void ResetStats();
@@ -389,6 +399,17 @@ public:
 	int64 ConnectTime() const { return m_LastUpdateTime; }
 
 	int AckSequence() const { return m_Ack; }
+
+	// smoothed and recent lowest round trip time in ms, -1 until the first vital chunk got acked
+	int Rtt() const { return m_Rtt.Rtt(); }
+	int MinRtt() const { return m_Rtt.MinRtt(); }
+	const CRttEstimator *RttEstimator() const { return &m_Rtt; }
+	int NumVitalChunks() const { return m_NumVitalChunks; }
+	int NumResentChunks() const { return m_NumResentChunks; }
+	// vital chunks waiting for their ack
+	int NumBufferedChunks() const { return m_NumBufferedChunks; }
+	const NETSTATS *Stats() const { return &m_Stats; }
+
 	// The backroom is ack-NET_MAX_SEQUENCE/2. Used for knowing if we acked a packet or not
 	static int IsSeqInBackroom(int Seq, int Ack);
 };
@@ -483,6 +504,7 @@ public:
 
 	// status requests
 	const NETADDR *ClientAddr(int ClientID) const { return m_aSlots[ClientID].m_Connection.PeerAddress(); }
+	const CNetConnection *ClientConnection(int ClientID) const { return &m_aSlots[ClientID].m_Connection; }
 	class CNetBan *NetBan() const { return m_pNetBan; }
 
 	//
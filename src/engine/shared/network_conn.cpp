@@ -29,6 +29,12 @@ void CNetConnection::Reset()
 	m_Buffer.Init();
 
 	mem_zero(&m_Construct, sizeof(m_Construct));
+
+	m_Rtt.Reset();
+	m_NumVitalChunks = 0;
+	m_NumResentChunks = 0;
+	m_NumBufferedChunks = 0;
+	ResetStats();
 }
 
 void CNetConnection::SetToken(TOKEN Token)
@@ -57,7 +63,6 @@ void CNetConnection::SetError(const char *pString)
 void CNetConnection::Init(CNetBase *pNetBase, bool BlockCloseMsg)
 {
 	Reset();
-	ResetStats();
 
 	m_pNetBase = pNetBase;
 	m_BlockCloseMsg = BlockCloseMsg;
@@ -66,6 +71,7 @@ void CNetConnection::Init(CNetBase *pNetBase, bool BlockCloseMsg)
 
 void CNetConnection::AckChunks(int Ack)
 {
+	int64 Now = time_get();
 	while(1)
 	{
 		CNetChunkResend *pResend = m_Buffer.First();
@@ -73,7 +79,15 @@ void CNetConnection::AckChunks(int Ack)
 			break;
 
 		if(IsSeqInBackroom(pResend->m_Sequence, Ack))
+		{
+			// resent chunks can't tell which send got acked
+			if(pResend->m_FirstSendTime == pResend->m_LastSendTime)
+			{
+				m_Rtt.AddSample((int)((Now-pResend->m_FirstSendTime)*1000/time_freq()), Now);
+			}
 			m_Buffer.PopFirst();
+			m_NumBufferedChunks--;
+		}
 		else
 			break;
 	}
@@ -93,7 +107,12 @@ int CNetConnection::Flush()
 	// send of the packets
 	m_Construct.m_Ack = m_Ack;
 	m_Construct.m_Token = m_PeerToken;
-	m_pNetBase->SendPacket(&m_PeerAddr, &m_Construct);
+	int Size = m_pNetBase->SendPacket(&m_PeerAddr, &m_Construct);
+	if(Size > 0)
+	{
+		m_Stats.sent_packets++;
+		m_Stats.sent_bytes += Size;
+	}
 
 	// update send times
 	m_LastSendTime = time_get();
@@ -140,6 +159,8 @@ int CNetConnection::QueueChunkEx(int Flags, int DataSize, const void *pData, int
 			pResend->m_FirstSendTime = time_get();
 			pResend->m_LastSendTime = pResend->m_FirstSendTime;
 			mem_copy(pResend->m_pData, pData, DataSize);
+			m_NumVitalChunks++;
+			m_NumBufferedChunks++;
 		}
 		else
 		{
@@ -163,7 +184,12 @@ void CNetConnection::SendControl(int ControlMsg, const void *pExtra, int ExtraSi
 {
 	// send the control message
 	m_LastSendTime = time_get();
-	m_pNetBase->SendControlMsg(&m_PeerAddr, m_PeerToken, m_Ack, ControlMsg, pExtra, ExtraSize);
+	int Size = m_pNetBase->SendControlMsg(&m_PeerAddr, m_PeerToken, m_Ack, ControlMsg, pExtra, ExtraSize);
+	if(Size > 0)
+	{
+		m_Stats.sent_packets++;
+		m_Stats.sent_bytes += Size;
+	}
 }
 
 void CNetConnection::SendPacketConnless(const char *pData, int DataSize)
@@ -181,6 +207,7 @@ void CNetConnection::ResendChunk(CNetChunkResend *pResend)
 {
 	QueueChunkEx(pResend->m_Flags|NET_CHUNKFLAG_RESEND, pResend->m_DataSize, pResend->m_pData, pResend->m_Sequence);
 	pResend->m_LastSendTime = time_get();
+	m_NumResentChunks++;
 }
 
 void CNetConnection::Resend()
@@ -250,6 +277,9 @@ int CNetConnection::Feed(CNetPacketConstruct *pPacket, NETADDR *pAddr)
 	if(pPacket->m_Token == NET_TOKEN_NONE || pPacket->m_Token != m_Token)
 		return 0;
 
+	m_Stats.recv_packets++;
+	m_Stats.recv_bytes += m_pNetBase->LastRecvSize();
+
 	// check if resend is requested
 	if(pPacket->m_Flags&NET_PACKETFLAG_RESEND)
 		Resend();
@@ -0,0 +1,128 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+
+#include "jsonwriter.h"
+#include "profiler.h"
+
+CProfiler::CProfiler()
+{
+	m_NumZones = 0;
+	Reset();
+}
+
+int CProfiler::RegisterZone(const char *pName)
+{
+	for(int i = 0; i < m_NumZones; i++)
+		if(str_comp(m_aZones[i].m_aName, pName) == 0)
+			return i;
+
+	if(m_NumZones == MAX_ZONES)
+		return -1;
+
+	CZone *pZone = &m_aZones[m_NumZones];
+	mem_zero(pZone, sizeof(*pZone));
+	str_copy(pZone->m_aName, pName, sizeof(pZone->m_aName));
+	return m_NumZones++;
+}
+
+int CProfiler::Bucket(int64 Microseconds)
+{
+	if(Microseconds <= 0)
+		return 0;
+
+	int Log = 0;
+	while(Log < 62 && (Microseconds>>(Log+1)))
+		Log++;
+
+	// the two bits after the leading one pick the quarter
+	int Quarter = Log >= 2 ? (int)(Microseconds>>(Log-2))&3 : (int)(Microseconds<<(2-Log))&3;
+	int Bucket = 1 + Log*4 + Quarter;
+	return Bucket < NUM_BUCKETS ? Bucket : NUM_BUCKETS-1;
+}
+
+int64 CProfiler::BucketLimit(int Bucket)
+{
+	if(Bucket == 0)
+		return 0;
+
+	int Log = (Bucket-1)/4;
+	int Quarter = (Bucket-1)%4;
+	return (((int64)(4+Quarter+1))<<Log)/4;
+}
+
+void CProfiler::Add(int Zone, int64 Time)
+{
+	if(Zone < 0 || Zone >= m_NumZones)
+		return;
+
+	CZone *pZone = &m_aZones[Zone];
+	int64 Microseconds = Time*1000000/time_freq();
+	pZone->m_Count++;
+	pZone->m_Total += Microseconds;
+	if(Microseconds > pZone->m_Max)
+		pZone->m_Max = Microseconds;
+	pZone->m_aBuckets[Bucket(Microseconds)]++;
+}
+
+void CProfiler::Reset()
+{
+	for(int i = 0; i < m_NumZones; i++)
+	{
+		CZone *pZone = &m_aZones[i];
+		pZone->m_Count = 0;
+		pZone->m_Total = 0;
+		pZone->m_Max = 0;
+		mem_zero(pZone->m_aBuckets, sizeof(pZone->m_aBuckets));
+	}
+	m_WindowStart = time_get();
+}
+
+int64 CProfiler::Percentile(int Zone, int Percent) const
+{
+	const CZone *pZone = &m_aZones[Zone];
+	if(!pZone->m_Count)
+		return 0;
+
+	// the rank of the sample, rounded up
+	int64 Rank = ((int64)pZone->m_Count*Percent+99)/100;
+	if(Rank < 1)
+		Rank = 1;
+
+	int64 Seen = 0;
+	for(int b = 0; b < NUM_BUCKETS; b++)
+	{
+		Seen += pZone->m_aBuckets[b];
+		if(Seen >= Rank)
+			return minimum(BucketLimit(b), pZone->m_Max);
+	}
+	return pZone->m_Max;
+}
+
+void CProfiler::WriteJson(CJsonWriter *pWriter) const
+{
+	pWriter->BeginObject();
+	pWriter->WriteAttribute("window_ms");
+	pWriter->WriteIntValue((int)((time_get()-m_WindowStart)*1000/time_freq()));
+	pWriter->WriteAttribute("zones");
+	pWriter->BeginArray();
+	for(int i = 0; i < m_NumZones; i++)
+	{
+		pWriter->BeginObject();
+		pWriter->WriteAttribute("name");
+		pWriter->WriteStrValue(ZoneName(i));
+		pWriter->WriteAttribute("count");
+		pWriter->WriteIntValue(Count(i));
+		pWriter->WriteAttribute("total_us");
+		pWriter->WriteIntValue((int)minimum(Total(i), (int64)0x7fffffff));
+		pWriter->WriteAttribute("p50_us");
+		pWriter->WriteIntValue((int)Percentile(i, 50));
+		pWriter->WriteAttribute("p99_us");
+		pWriter->WriteIntValue((int)Percentile(i, 99));
+		pWriter->WriteAttribute("max_us");
+		pWriter->WriteIntValue((int)minimum(Max(i), (int64)0x7fffffff));
+		pWriter->EndObject();
+	}
+	pWriter->EndArray();
+	pWriter->EndObject();
+}
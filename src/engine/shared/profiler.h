@@ -0,0 +1,69 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_PROFILER_H
+#define ENGINE_SHARED_PROFILER_H
+
+#include <base/system.h>
+
+// keeps a log scale histogram of the time spent in each zone.
+// not thread safe, only profile code that runs on the main thread
+class CProfiler
+{
+public:
+	enum
+	{
+		MAX_ZONES=32,
+		MAX_ZONE_NAME=32,
+
+		// four buckets per power of two microseconds, up to about an hour
+		NUM_BUCKETS=1+4*32,
+	};
+
+	class CScope
+	{
+		CProfiler *m_pProfiler;
+		int m_Zone;
+		int64 m_Start;
+
+	public:
+		CScope(CProfiler *pProfiler, int Zone) : m_pProfiler(pProfiler), m_Zone(Zone), m_Start(time_get()) {}
+		~CScope() { m_pProfiler->Add(m_Zone, time_get()-m_Start); }
+	};
+
+	CProfiler();
+
+	// returns the zone with this name, registers it if needed. -1 if there's no room
+	int RegisterZone(const char *pName);
+	void Add(int Zone, int64 Time);
+	void Reset();
+
+	int NumZones() const { return m_NumZones; }
+	const char *ZoneName(int Zone) const { return m_aZones[Zone].m_aName; }
+	int Count(int Zone) const { return m_aZones[Zone].m_Count; }
+	int64 Total(int Zone) const { return m_aZones[Zone].m_Total; }
+	int64 Max(int Zone) const { return m_aZones[Zone].m_Max; }
+	// upper bound of the histogram bucket the percentile falls into, in microseconds
+	int64 Percentile(int Zone, int Percent) const;
+	int64 WindowStart() const { return m_WindowStart; }
+
+	void WriteJson(class CJsonWriter *pWriter) const;
+
+private:
+	struct CZone
+	{
+		char m_aName[MAX_ZONE_NAME];
+		int m_Count;
+		int64 m_Total; // microseconds
+		int64 m_Max;
+		int m_aBuckets[NUM_BUCKETS];
+	};
+
+	CZone m_aZones[MAX_ZONES];
+	int m_NumZones;
+	int64 m_WindowStart;
+
+	static int Bucket(int64 Microseconds);
+	static int64 BucketLimit(int Bucket);
+};
+
+#endif
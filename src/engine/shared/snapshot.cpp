@@ -1,10 +1,17 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/tl/base.h>
 #include <base/tl/algorithm.h>
 #include "snapshot.h"
 #include "compression.h"
 
+#if defined(CONF_SIMD_SSE2)
+	#include <emmintrin.h>
+#elif defined(CONF_SIMD_NEON)
+	#include <arm_neon.h>
+#endif
+
 // CSnapshot
 
 const CSnapshotItem *CSnapshot::GetItem(int Index) const
@@ -81,84 +88,155 @@ void CSnapshot::DebugDump() const
 
 // CSnapshotDelta
 
-struct CItemList
-{
-	int m_Num;
-	int m_aKeys[64];
-	int m_aIndex[64];
-};
-
-enum
+void CSnapshotDelta::CItemHash::Clear(int NumItems)
 {
-	HASHLIST_SIZE = 256,
-};
+	// keep the load factor at or below one half
+	int Slots = 32;
+	m_Shift = 27;
+	while(Slots < NumItems*2 && Slots < MAX_SLOTS)
+	{
+		Slots <<= 1;
+		m_Shift--;
+	}
+	m_Mask = Slots-1;
+	for(int i = 0; i < Slots; i++)
+		m_aSlots[i].m_Index = -1;
+}
 
-static void GenerateHash(CItemList *pHashlist, const CSnapshot *pSnapshot)
+void CSnapshotDelta::CItemHash::Insert(int Key, int Index)
 {
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
+	if(Index < 0 || Index >= MAX_ITEMS)
+		return;
 
-	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	m_aNext[Index] = -1;
+	for(int Slot = ((unsigned)Key*0x9E3779B1u)>>m_Shift; ; Slot = (Slot+1)&m_Mask)
 	{
-		int Key = pSnapshot->GetItem(i)->Key();
-		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
-		if(pHashlist[HashID].m_Num != 64)
+		CSlot *pSlot = &m_aSlots[Slot];
+		if(pSlot->m_Index == -1)
+		{
+			pSlot->m_Key = Key;
+			pSlot->m_Index = Index;
+			return;
+		}
+		if(pSlot->m_Key == Key)
 		{
-			pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
-			pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
-			pHashlist[HashID].m_Num++;
+			// duplicated keys are rare, append to the chain
+			int Last = pSlot->m_Index;
+			while(m_aNext[Last] != -1)
+				Last = m_aNext[Last];
+			m_aNext[Last] = Index;
+			return;
 		}
 	}
 }
 
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
+int CSnapshotDelta::CItemHash::Find(int Key) const
 {
-		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
-		for(int i = 0; i < pHashlist[HashID].m_Num; i++)
-		{
-			if(pHashlist[HashID].m_aKeys[i] == Key)
-				return pHashlist[HashID].m_aIndex[i];
+	for(int Slot = ((unsigned)Key*0x9E3779B1u)>>m_Shift; ; Slot = (Slot+1)&m_Mask)
+	{
+		const CSlot *pSlot = &m_aSlots[Slot];
+		if(pSlot->m_Index == -1 || pSlot->m_Key == Key)
+			return pSlot->m_Index;
 	}
+}
 
-	return -1;
+// number of bits the packed diff costs on the wire, see CVariableInt::Pack
+static int DiffBits(int Diff)
+{
+	if(Diff == 0)
+		return 1;
+	unsigned Value = Diff^(Diff>>31);
+	int Bytes = 1 + (Value >= (1u<<6)) + (Value >= (1u<<13)) + (Value >= (1u<<20)) + (Value >= (1u<<27));
+	return Bytes*8;
 }
 
+// writes pCurrent-pPast to pOut, returns non zero if anything changed
 static int DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
 {
 	int Needed = 0;
-	while(Size)
+	int i = 0;
+
+#if defined(CONF_SIMD_SSE2)
+	__m128i Changed = _mm_setzero_si128();
+	for(; i+4 <= Size; i += 4)
+	{
+		__m128i Diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(pCurrent+i)), _mm_loadu_si128((const __m128i *)(pPast+i)));
+		_mm_storeu_si128((__m128i *)(pOut+i), Diff);
+		Changed = _mm_or_si128(Changed, Diff);
+	}
+	Needed = _mm_movemask_epi8(_mm_cmpeq_epi32(Changed, _mm_setzero_si128())) != 0xffff;
+#elif defined(CONF_SIMD_NEON)
+	uint32x4_t Changed = vdupq_n_u32(0);
+	for(; i+4 <= Size; i += 4)
+	{
+		int32x4_t Diff = vsubq_s32(vld1q_s32(pCurrent+i), vld1q_s32(pPast+i));
+		vst1q_s32(pOut+i, Diff);
+		Changed = vorrq_u32(Changed, vreinterpretq_u32_s32(Diff));
+	}
+	Needed = (vgetq_lane_u32(Changed, 0) | vgetq_lane_u32(Changed, 1) | vgetq_lane_u32(Changed, 2) | vgetq_lane_u32(Changed, 3)) != 0;
+#endif
+
+	for(; i < Size; i++)
 	{
-		*pOut = *pCurrent-*pPast;
-		Needed |= *pOut;
-		pOut++;
-		pPast++;
-		pCurrent++;
-		Size--;
+		pOut[i] = pCurrent[i]-pPast[i];
+		Needed |= pOut[i];
 	}
 
 	return Needed;
 }
 
-void CSnapshotDelta::UndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size)
+// writes pPast+pDiff to pOut, returns the number of bits the diff took on the wire
+static int UndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size)
 {
-	while(Size)
+	int Bits = 0;
+	int i = 0;
+
+#if defined(CONF_SIMD_SSE2)
+	const __m128i Zero = _mm_setzero_si128();
+	const __m128i One = _mm_set1_epi32(1);
+	__m128i Sum = Zero;
+	for(; i+4 <= Size; i += 4)
 	{
-		*pOut = *pPast+*pDiff;
-
-		if(*pDiff == 0)
-			m_aSnapshotDataRate[m_SnapshotCurrent] += 1;
-		else
-		{
-			unsigned char aBuf[16];
-			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff);
-			m_aSnapshotDataRate[m_SnapshotCurrent] += (int)(pEnd - (unsigned char*)aBuf) * 8;
-		}
+		__m128i Diff = _mm_loadu_si128((const __m128i *)(pDiff+i));
+		_mm_storeu_si128((__m128i *)(pOut+i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pPast+i)), Diff));
+
+		// the magnitudes stay below 2^31, so the signed compares count the extra bytes as -1 each
+		__m128i Value = _mm_xor_si128(Diff, _mm_srai_epi32(Diff, 31));
+		__m128i Extra = _mm_add_epi32(
+			_mm_add_epi32(_mm_cmpgt_epi32(Value, _mm_set1_epi32((1<<6)-1)), _mm_cmpgt_epi32(Value, _mm_set1_epi32((1<<13)-1))),
+			_mm_add_epi32(_mm_cmpgt_epi32(Value, _mm_set1_epi32((1<<20)-1)), _mm_cmpgt_epi32(Value, _mm_set1_epi32((1<<27)-1))));
+		__m128i Packed = _mm_slli_epi32(_mm_sub_epi32(One, Extra), 3);
+		__m128i IsZero = _mm_cmpeq_epi32(Diff, Zero);
+		Sum = _mm_add_epi32(Sum, _mm_or_si128(_mm_andnot_si128(IsZero, Packed), _mm_and_si128(IsZero, One)));
+	}
+	Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	Bits = _mm_cvtsi128_si32(Sum);
+#elif defined(CONF_SIMD_NEON)
+	const int32x4_t One = vdupq_n_s32(1);
+	int32x4_t Sum = vdupq_n_s32(0);
+	for(; i+4 <= Size; i += 4)
+	{
+		int32x4_t Diff = vld1q_s32(pDiff+i);
+		vst1q_s32(pOut+i, vaddq_s32(vld1q_s32(pPast+i), Diff));
+
+		int32x4_t Value = veorq_s32(Diff, vshrq_n_s32(Diff, 31));
+		int32x4_t Extra = vaddq_s32(
+			vaddq_s32(vreinterpretq_s32_u32(vcgtq_s32(Value, vdupq_n_s32((1<<6)-1))), vreinterpretq_s32_u32(vcgtq_s32(Value, vdupq_n_s32((1<<13)-1)))),
+			vaddq_s32(vreinterpretq_s32_u32(vcgtq_s32(Value, vdupq_n_s32((1<<20)-1))), vreinterpretq_s32_u32(vcgtq_s32(Value, vdupq_n_s32((1<<27)-1)))));
+		int32x4_t Packed = vshlq_n_s32(vsubq_s32(One, Extra), 3);
+		Sum = vaddq_s32(Sum, vbslq_s32(vceqq_s32(Diff, vdupq_n_s32(0)), One, Packed));
+	}
+	Bits = vgetq_lane_s32(Sum, 0) + vgetq_lane_s32(Sum, 1) + vgetq_lane_s32(Sum, 2) + vgetq_lane_s32(Sum, 3);
+#endif
 
-		pOut++;
-		pPast++;
-		pDiff++;
-		Size--;
+	for(; i < Size; i++)
+	{
+		pOut[i] = pPast[i]+pDiff[i];
+		Bits += DiffBits(pDiff[i]);
 	}
+
+	return Bits;
 }
 
 CSnapshotDelta::CSnapshotDelta()
@@ -180,8 +258,7 @@ CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta()
 	return &m_Empty;
 }
 
-// TODO: OPT: this should be made much faster
-int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, CSnapshot *pTo, void *pDstData)
+int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, CSnapshot *pTo, void *pDstData, bool CountStats)
 {
 	CData *pDelta = (CData *)pDstData;
 	int *pData = (int *)pDelta->m_pData;
@@ -195,14 +272,15 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, CSnapshot *pTo, void *pD
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList Hashlist[HASHLIST_SIZE];
-	GenerateHash(Hashlist, pTo);
+	m_ToHash.Clear(pTo->NumItems());
+	for(i = 0; i < pTo->NumItems(); i++)
+		m_ToHash.Insert(pTo->GetItem(i)->Key(), i);
 
 	// pack deleted stuff
 	for(i = 0; i < pFrom->NumItems(); i++)
 	{
 		pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), Hashlist) == -1)
+		if(m_ToHash.Find(pFromItem->Key()) == -1)
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
@@ -211,16 +289,18 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, CSnapshot *pTo, void *pD
 		}
 	}
 
-	GenerateHash(Hashlist, pFrom);
-	int aPastIndecies[1024];
+	m_FromHash.Clear(pFrom->NumItems());
+	for(i = 0; i < pFrom->NumItems(); i++)
+		m_FromHash.Insert(pFrom->GetItem(i)->Key(), i);
+	int aPastIndecies[CItemHash::MAX_ITEMS];
 
 	// fetch previous indices
 	// we do this as a separate pass because it helps the cache
 	const int NumItems = pTo->NumItems();
 	for(i = 0; i < NumItems; i++)
 	{
-		pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndecies[i] = GetItemIndexHashed(pCurItem->Key(), Hashlist); // O(n) .. O(n^n)
+		pCurItem = pTo->GetItem(i);
+		aPastIndecies[i] = m_FromHash.Find(pCurItem->Key());
 	}
 
 	for(i = 0; i < NumItems; i++)
@@ -241,6 +321,14 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, CSnapshot *pTo, void *pD
 
 			if(DiffItem(pPastItem->Data(), (int*)pCurItem->Data(), pItemDataDst, ItemSize/4))
 			{
+				if(CountStats)
+				{
+					int Bits = 0;
+					for(int d = 0; d < ItemSize/4; d++)
+						Bits += DiffBits(pItemDataDst[d]);
+					m_aSnapshotDataRate[pCurItem->Type()] += Bits;
+					m_aSnapshotDataUpdates[pCurItem->Type()]++;
+				}
 
 				*pData++ = pCurItem->Type();
 				*pData++ = pCurItem->ID();
@@ -258,6 +346,11 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, CSnapshot *pTo, void *pD
 				*pData++ = ItemSize/4;
 
 			mem_copy(pData, pCurItem->Data(), ItemSize);
+			if(CountStats)
+			{
+				m_aSnapshotDataRate[pCurItem->Type()] += ItemSize*8;
+				m_aSnapshotDataUpdates[pCurItem->Type()]++;
+			}
 			SizeCount += ItemSize;
 			pData += ItemSize/4;
 			pDelta->m_NumUpdateItems++;
@@ -304,7 +397,7 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 	const int *pEnd = (const int *)(((const char *)pSrcData + DataSize));
 
 	const CSnapshotItem *pFromItem;
-	int Keep, ItemSize;
+	int ItemSize;
 	const int *pDeleted;
 	int ID, Type, Key;
 	int FromIndex;
@@ -318,29 +411,35 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 	if(pData > pEnd)
 		return -1;
 
-	// copy all non deleted stuff
-	for(int i = 0; i < pFrom->NumItems(); i++)
+	// mark the deleted items, every item sharing a deleted key goes
+	int NumFromItems = clamp(pFrom->NumItems(), 0, (int)CItemHash::MAX_ITEMS);
+	bool aDeleted[CItemHash::MAX_ITEMS];
+	mem_zero(aDeleted, sizeof(bool)*NumFromItems);
+	m_FromHash.Clear(NumFromItems);
+	for(int i = 0; i < NumFromItems; i++)
+		m_FromHash.Insert(pFrom->GetItem(i)->Key(), i);
+	for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
+	{
+		for(int Index = m_FromHash.Find(pDeleted[d]); Index != -1; Index = m_FromHash.Next(Index))
+			aDeleted[Index] = true;
+	}
+
+	// copy all non deleted stuff, the builder items are looked up by key below
+	m_ToHash.Clear(NumFromItems + clamp(pDelta->m_NumUpdateItems, 0, (int)(DataSize/sizeof(int))));
+	int NumBuilderItems = 0;
+	for(int i = 0; i < NumFromItems; i++)
 	{
-		// dbg_assert(0, "fail!");
+		if(aDeleted[i])
+			continue;
+
+		// keep it
 		pFromItem = pFrom->GetItem(i);
 		ItemSize = pFrom->GetItemSize(i);
-		Keep = 1;
-		for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
-		{
-			if(pDeleted[d] == pFromItem->Key())
-			{
-				Keep = 0;
-				break;
-			}
-		}
-
-		if(Keep)
-		{
-			// keep it
-			mem_copy(
-				Builder.NewItem(pFromItem->Type(), pFromItem->ID(), ItemSize),
-				pFromItem->Data(), ItemSize);
-		}
+		pNewData = (int *)Builder.NewItem(pFromItem->Type(), pFromItem->ID(), ItemSize);
+		if(!pNewData)
+			return -4;
+		mem_copy(pNewData, pFromItem->Data(), ItemSize);
+		m_ToHash.Insert(pFromItem->Key(), NumBuilderItems++);
 	}
 
 	// unpack updated stuff
@@ -368,17 +467,22 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 		Key = (Type<<16)|(ID&0xffff);
 
 		// create the item if needed
-		pNewData = Builder.GetItemData(Key);
-		if(!pNewData)
+		int BuilderIndex = m_ToHash.Find(Key);
+		if(BuilderIndex != -1)
+			pNewData = Builder.GetItem(BuilderIndex)->Data();
+		else
+		{
 			pNewData = (int *)Builder.NewItem(Key>>16, Key&0xffff, ItemSize);
+			if(!pNewData)
+				return -4;
+			m_ToHash.Insert(Key, NumBuilderItems++);
+		}
 
-		//if(range_check(pEnd, pNewData, ItemSize)) return -4;
-
-		FromIndex = pFrom->GetItemIndex(Key);
+		FromIndex = m_FromHash.Find(Key);
 		if(FromIndex != -1)
 		{
 			// we got an update so we need to apply the diff
-			UndiffItem(pFrom->GetItem(FromIndex)->Data(), pData, pNewData, ItemSize/4);
+			m_aSnapshotDataRate[m_SnapshotCurrent] += UndiffItem(pFrom->GetItem(FromIndex)->Data(), pData, pNewData, ItemSize/4);
 			m_aSnapshotDataUpdates[m_SnapshotCurrent]++;
 		}
 		else // no previous, just copy the pData
@@ -594,45 +698,56 @@ int CSnapshotBuilder::Finish(void *pSnapdata)
 	pSnap->m_NumItems = m_NumItems;
 
 	const int NumItems = m_NumItems;
+
+	// radix sort the item indices by key, one byte per pass. the sort is stable
+	// so items with equal keys keep the order in which they were added.
+	// keys are flipped at the sign bit to sort signed keys as unsigned.
+	unsigned aKeys[CSnapshotBuilder::MAX_ITEMS];
+	unsigned aCounts[4][256];
+	mem_zero(aCounts, sizeof(aCounts));
 	for(int i = 0; i < NumItems; i++)
 	{
-		pSnap->SortedKeys()[i] = GetItem(i)->Key();
+		unsigned Key = (unsigned)GetItem(i)->Key() ^ 0x80000000u;
+		aKeys[i] = Key;
+		for(int Pass = 0; Pass < 4; Pass++)
+			aCounts[Pass][(Key>>(Pass*8))&0xff]++;
 	}
 
-	// get full item sizes
-	int aItemSizes[CSnapshotBuilder::MAX_ITEMS];
-
-	for(int i = 0; i < NumItems-1; i++)
-	{
-		aItemSizes[i] = m_aOffsets[i+1] - m_aOffsets[i];
-	}
-	aItemSizes[NumItems-1] = m_DataSize - m_aOffsets[NumItems-1];
+	short aaOrder[2][CSnapshotBuilder::MAX_ITEMS];
+	short *pOrder = aaOrder[0];
+	short *pSorted = aaOrder[1];
+	for(int i = 0; i < NumItems; i++)
+		pOrder[i] = i;
 
-	// bubble sort by keys
-	bool Sorting = true;
-	while(Sorting)
+	for(int Pass = 0; Pass < 4; Pass++)
 	{
-		Sorting = false;
+		// skip passes where all keys share the same byte
+		unsigned *pCounts = aCounts[Pass];
+		if(NumItems == 0 || pCounts[(aKeys[0]>>(Pass*8))&0xff] == (unsigned)NumItems)
+			continue;
 
-		for(int i = 1; i < NumItems; i++)
+		unsigned Start = 0;
+		for(int b = 0; b < 256; b++)
 		{
-			if(pSnap->SortedKeys()[i-1] > pSnap->SortedKeys()[i])
-			{
-				Sorting = true;
-				tl_swap(pSnap->SortedKeys()[i], pSnap->SortedKeys()[i-1]);
-				tl_swap(m_aOffsets[i], m_aOffsets[i-1]);
-				tl_swap(aItemSizes[i], aItemSizes[i-1]);
-			}
+			unsigned Count = pCounts[b];
+			pCounts[b] = Start;
+			Start += Count;
 		}
+		for(int i = 0; i < NumItems; i++)
+			pSorted[pCounts[(aKeys[pOrder[i]]>>(Pass*8))&0xff]++] = pOrder[i];
+		tl_swap(pOrder, pSorted);
 	}
 
 	// copy sorted items
 	int OffsetCur = 0;
 	for(int i = 0; i < NumItems; i++)
 	{
+		int Index = pOrder[i];
+		int ItemSize = (Index == NumItems-1 ? m_DataSize : m_aOffsets[Index+1]) - m_aOffsets[Index];
+		pSnap->SortedKeys()[i] = (int)(aKeys[Index] ^ 0x80000000u);
 		pSnap->Offsets()[i] = OffsetCur;
-		mem_copy(pSnap->DataStart()+OffsetCur, m_aData + m_aOffsets[i], aItemSizes[i]);
-		OffsetCur += aItemSizes[i];
+		mem_copy(pSnap->DataStart()+OffsetCur, m_aData + m_aOffsets[Index], ItemSize);
+		OffsetCur += ItemSize;
 	}
 
 	return sizeof(CSnapshot) + KeySize + OffsetSize + m_DataSize;
@@ -659,3 +774,20 @@ void *CSnapshotBuilder::NewItem(int Type, int ID, int Size)
 
 	return pObj->Data();
 }
+
+void *CSnapshotBuilder::RepeatItem(const CSnapshotStorage *pStorage, int Type, int ID, int Size, int MinTick)
+{
+	// the snapshot being built is only added to the storage after the snap
+	const CSnapshotStorage::CHolder *pLast = pStorage->m_pLast;
+	if(!pLast || pLast->m_Tick < MinTick)
+		return 0;
+
+	int Index = pLast->m_pSnap->GetItemIndex((Type<<16)|(ID&0xffff));
+	if(Index == -1 || pLast->m_pSnap->GetItemSize(Index) != Size)
+		return 0;
+
+	void *pItem = NewItem(Type, ID, Size);
+	if(pItem)
+		mem_copy(pItem, pLast->m_pSnap->GetItem(Index)->Data(), Size);
+	return pItem;
+}
@@ -10,6 +10,7 @@
 class CSnapshotItem
 {
 	friend class CSnapshotBuilder;
+	friend class CSnapshotDelta;
 	int m_TypeAndID;
 
 	int *Data() { return (int *)(this+1); }
@@ -70,22 +71,53 @@ public:
 	};
 
 private:
+	// open addressing map from item keys to item indices, sized to the snapshot on Clear.
+	// indices inserted with the same key are chained in insertion order
+	class CItemHash
+	{
+	public:
+		enum
+		{
+			MAX_ITEMS = CSnapshot::MAX_SIZE/(3*sizeof(int)), // key, offset and item header
+			MAX_SLOTS = 16384,
+		};
+
+		void Clear(int NumItems);
+		void Insert(int Key, int Index);
+		int Find(int Key) const;
+		int Next(int Index) const { return m_aNext[Index]; }
+
+	private:
+		struct CSlot
+		{
+			int m_Key;
+			int m_Index;
+		};
+
+		int m_Mask;
+		int m_Shift;
+		CSlot m_aSlots[MAX_SLOTS];
+		int m_aNext[MAX_ITEMS];
+	};
+
 	// TODO: strange arbitrary number
 	short m_aItemSizes[64];
-	int m_aSnapshotDataRate[0xffff];
-	int m_aSnapshotDataUpdates[0xffff];
+	// bits and updates per item type, wrap around
+	unsigned m_aSnapshotDataRate[0xffff];
+	unsigned m_aSnapshotDataUpdates[0xffff];
 	int m_SnapshotCurrent;
 	CData m_Empty;
-
-	void UndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size);
+	CItemHash m_FromHash;
+	CItemHash m_ToHash;
 
 public:
 	CSnapshotDelta();
-	int GetDataRate(int Index) const { return m_aSnapshotDataRate[Index]; }
-	int GetDataUpdates(int Index) const { return m_aSnapshotDataUpdates[Index]; }
+	unsigned GetDataRate(int Index) const { return m_aSnapshotDataRate[Index]; }
+	unsigned GetDataUpdates(int Index) const { return m_aSnapshotDataUpdates[Index]; }
 	void SetStaticsize(int ItemType, int Size);
 	CData *EmptyDelta();
-	int CreateDelta(const class CSnapshot *pFrom, class CSnapshot *pTo, void *pData);
+	// CountStats adds the packed size of the items to the data rate, only for deltas that go out over the network
+	int CreateDelta(const class CSnapshot *pFrom, class CSnapshot *pTo, void *pData, bool CountStats = false);
 	int UnpackDelta(const class CSnapshot *pFrom, class CSnapshot *pTo, const void *pData, int DataSize);
 };
 
@@ -139,6 +171,9 @@ public:
 	bool UnserializeSnap(const char *pSrcData, int SrcSize);
 
 	void *NewItem(int Type, int ID, int Size);
+	// adds the item with the data it had in the last snapshot of pStorage, 0 if it wasn't
+	// in there with that size or that snapshot is older than MinTick
+	void *RepeatItem(const CSnapshotStorage *pStorage, int Type, int ID, int Size, int MinTick);
 
 	CSnapshotItem *GetItem(int Index);
 	int *GetItemData(int Key);
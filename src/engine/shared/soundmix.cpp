@@ -0,0 +1,81 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+
+#include "soundmix.h"
+
+#if defined(CONF_SIMD_SSE2)
+	#include <emmintrin.h>
+#elif defined(CONF_SIMD_NEON)
+	#include <arm_neon.h>
+#endif
+
+void MixFrames(int *pOut, const short *pIn, int Step, unsigned Frames, int Lvol, int Rvol)
+{
+	unsigned s = 0;
+
+#if defined(CONF_SIMD_SSE2)
+	// madd of (sample, 0) pairs with (volume, 0) pairs gives exact 32 bit products
+	if(Lvol >= 0 && Lvol <= 0x7fff && Rvol >= 0 && Rvol <= 0x7fff)
+	{
+		const __m128i Zero = _mm_setzero_si128();
+		const __m128i Vol = _mm_setr_epi16(Lvol, 0, Rvol, 0, Lvol, 0, Rvol, 0);
+		if(Step == 1)
+		{
+			for(; s+8 <= Frames; s += 8)
+			{
+				__m128i In = _mm_loadu_si128((const __m128i *)(pIn+s));
+				__m128i Lo = _mm_unpacklo_epi16(In, In);
+				__m128i Hi = _mm_unpackhi_epi16(In, In);
+				__m128i *pDst = (__m128i *)(pOut+s*2);
+				_mm_storeu_si128(pDst+0, _mm_add_epi32(_mm_loadu_si128(pDst+0), _mm_madd_epi16(_mm_unpacklo_epi16(Lo, Zero), Vol)));
+				_mm_storeu_si128(pDst+1, _mm_add_epi32(_mm_loadu_si128(pDst+1), _mm_madd_epi16(_mm_unpackhi_epi16(Lo, Zero), Vol)));
+				_mm_storeu_si128(pDst+2, _mm_add_epi32(_mm_loadu_si128(pDst+2), _mm_madd_epi16(_mm_unpacklo_epi16(Hi, Zero), Vol)));
+				_mm_storeu_si128(pDst+3, _mm_add_epi32(_mm_loadu_si128(pDst+3), _mm_madd_epi16(_mm_unpackhi_epi16(Hi, Zero), Vol)));
+			}
+		}
+		else
+		{
+			for(; s+4 <= Frames; s += 4)
+			{
+				__m128i In = _mm_loadu_si128((const __m128i *)(pIn+s*2));
+				__m128i *pDst = (__m128i *)(pOut+s*2);
+				_mm_storeu_si128(pDst+0, _mm_add_epi32(_mm_loadu_si128(pDst+0), _mm_madd_epi16(_mm_unpacklo_epi16(In, Zero), Vol)));
+				_mm_storeu_si128(pDst+1, _mm_add_epi32(_mm_loadu_si128(pDst+1), _mm_madd_epi16(_mm_unpackhi_epi16(In, Zero), Vol)));
+			}
+		}
+	}
+#elif defined(CONF_SIMD_NEON)
+	if(Lvol >= 0 && Lvol <= 0x7fff && Rvol >= 0 && Rvol <= 0x7fff)
+	{
+		const int16_t aVol[4] = { (int16_t)Lvol, (int16_t)Rvol, (int16_t)Lvol, (int16_t)Rvol };
+		const int16x4_t Vol = vld1_s16(aVol);
+		if(Step == 1)
+		{
+			for(; s+4 <= Frames; s += 4)
+			{
+				int16x4x2_t In = vzip_s16(vld1_s16(pIn+s), vld1_s16(pIn+s));
+				vst1q_s32(pOut+s*2, vmlal_s16(vld1q_s32(pOut+s*2), In.val[0], Vol));
+				vst1q_s32(pOut+s*2+4, vmlal_s16(vld1q_s32(pOut+s*2+4), In.val[1], Vol));
+			}
+		}
+		else
+		{
+			for(; s+2 <= Frames; s += 2)
+				vst1q_s32(pOut+s*2, vmlal_s16(vld1q_s32(pOut+s*2), vld1_s16(pIn+s*2), Vol));
+		}
+	}
+#endif
+
+	// remaining frames
+	const short *pInL = pIn+s*Step;
+	const short *pInR = Step == 1 ? pInL : pInL+1;
+	pOut += s*2;
+	for(; s < Frames; s++)
+	{
+		*pOut++ += (*pInL)*Lvol;
+		*pOut++ += (*pInR)*Rvol;
+		pInL += Step;
+		pInR += Step;
+	}
+}
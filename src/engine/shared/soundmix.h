@@ -0,0 +1,10 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_SOUNDMIX_H
+#define ENGINE_SHARED_SOUNDMIX_H
+
+// accumulates Frames frames of a mono (Step 1) or stereo (Step 2) sample into the
+// interleaved stereo output. the vector paths give the same sums as the scalar loop
+void MixFrames(int *pOut, const short *pIn, int Step, unsigned Frames, int Lvol, int Rvol);
+
+#endif
@@ -30,7 +30,11 @@ void CMapImages::LoadMapImages(IMap *pMap, class CLayers *pLayers, int MapType)
 	pMap->GetType(MAPITEMTYPE_IMAGE, &Start, &m_Info[MapType].m_Count);
 	m_Info[MapType].m_Count = clamp(m_Info[MapType].m_Count, 0, int(MAX_TEXTURES));
 
-	// load new textures
+	// external images are decoded on the job threads, embedded ones are uploaded as they are
+	int aTextureFlags[MAX_TEXTURES];
+	int aExternal[MAX_TEXTURES];
+	CGameClient::CPNGLoad *pLoads = (CGameClient::CPNGLoad *)mem_alloc(maximum(m_Info[MapType].m_Count, 1)*sizeof(CGameClient::CPNGLoad), 1);
+	int NumLoads = 0;
 	for(int i = 0; i < m_Info[MapType].m_Count; i++)
 	{
 		int TextureFlags = 0;
@@ -46,22 +50,43 @@ void CMapImages::LoadMapImages(IMap *pMap, class CLayers *pLayers, int MapType)
 		}
 		if(FoundTileLayer)
 			TextureFlags = FoundQuadLayer ? IGraphics::TEXLOAD_MULTI_DIMENSION : IGraphics::TEXLOAD_ARRAY_256;
+		aTextureFlags[i] = TextureFlags;
 
+		aExternal[i] = -1;
 		CMapItemImage *pImg = (CMapItemImage *)pMap->GetItem(Start+i, 0, 0);
 		if(pImg->m_External || (pImg->m_Version > 1 && pImg->m_Format != CImageInfo::FORMAT_RGB && pImg->m_Format != CImageInfo::FORMAT_RGBA))
 		{
-			char Buf[IO_MAX_PATH_LENGTH];
 			char *pName = (char *)pMap->GetData(pImg->m_ImageName);
-			str_format(Buf, sizeof(Buf), "mapres/%s.png", pName);
-			m_Info[MapType].m_aTextures[i] = Graphics()->LoadTexture(Buf, IStorage::TYPE_ALL, CImageInfo::FORMAT_AUTO, TextureFlags);
+			str_format(pLoads[NumLoads].m_aFilename, sizeof(pLoads[NumLoads].m_aFilename), "mapres/%s.png", pName);
+			pLoads[NumLoads].m_StorageType = IStorage::TYPE_ALL;
+			aExternal[i] = NumLoads++;
+		}
+	}
+	m_pClient->LoadPNGs(pLoads, NumLoads);
+
+	// load new textures
+	for(int i = 0; i < m_Info[MapType].m_Count; i++)
+	{
+		if(aExternal[i] >= 0)
+		{
+			CGameClient::CPNGLoad *pLoad = &pLoads[aExternal[i]];
+			if(pLoad->m_Loaded)
+			{
+				m_Info[MapType].m_aTextures[i] = Graphics()->LoadTextureRaw(pLoad->m_Info.m_Width, pLoad->m_Info.m_Height, pLoad->m_Info.m_Format, pLoad->m_Info.m_pData, pLoad->m_Info.m_Format, aTextureFlags[i]);
+				mem_free(pLoad->m_Info.m_pData);
+			}
+			else
+				m_Info[MapType].m_aTextures[i] = Graphics()->LoadTexture(pLoad->m_aFilename, IStorage::TYPE_ALL, CImageInfo::FORMAT_AUTO, aTextureFlags[i]); // gives the invalid texture
 		}
 		else
 		{
+			CMapItemImage *pImg = (CMapItemImage *)pMap->GetItem(Start+i, 0, 0);
 			void *pData = pMap->GetData(pImg->m_ImageData);
-			m_Info[MapType].m_aTextures[i] = Graphics()->LoadTextureRaw(pImg->m_Width, pImg->m_Height, pImg->m_Version == 1 ? CImageInfo::FORMAT_RGBA : pImg->m_Format, pData, CImageInfo::FORMAT_RGBA, TextureFlags);
+			m_Info[MapType].m_aTextures[i] = Graphics()->LoadTextureRaw(pImg->m_Width, pImg->m_Height, pImg->m_Version == 1 ? CImageInfo::FORMAT_RGBA : pImg->m_Format, pData, CImageInfo::FORMAT_RGBA, aTextureFlags[i]);
 			pMap->UnloadData(pImg->m_ImageData);
 		}
 	}
+	mem_free(pLoads);
 
 	// easter time, preload easter tileset
 	if(m_pClient->IsEaster())
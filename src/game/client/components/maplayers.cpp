@@ -34,6 +34,8 @@ void CMapLayers::OnStateChange(int NewState, int OldState)
 {
 	if(NewState == IClient::STATE_ONLINE)
 		m_OnlineStartTime = Client()->LocalTime(); // reset time for non-scynchronized envelopes
+	else if(NewState == IClient::STATE_OFFLINE)
+		DestroyTileLayerBuffers(m_lTileLayerBuffers);
 }
 
 void CMapLayers::LoadBackgroundMap()
@@ -68,6 +70,47 @@ void CMapLayers::LoadBackgroundMap()
 	m_pMenuLayers->Init(Kernel(), m_pMenuMap);
 	m_pClient->m_pMapimages->OnMenuMapLoad(m_pMenuMap);
 	LoadEnvPoints(m_pMenuLayers, m_lEnvPointsMenu);
+	CreateTileLayerBuffers(m_pMenuLayers, m_lTileLayerBuffersMenu, true);
+}
+
+void CMapLayers::CreateTileLayerBuffers(CLayers *pLayers, array<CTileLayerBuffer>& lBuffers, bool AllLayers)
+{
+	DestroyTileLayerBuffers(lBuffers);
+
+	bool PassedGameLayer = false;
+	for(int i = 0; i < pLayers->NumLayers(); i++)
+		lBuffers.add(CTileLayerBuffer());
+
+	for(int g = 0; g < pLayers->NumGroups(); g++)
+	{
+		CMapItemGroup *pGroup = pLayers->GetGroup(g);
+		for(int l = 0; l < pGroup->m_NumLayers; l++)
+		{
+			int LayerIndex = pGroup->m_StartLayer+l;
+			CMapItemLayer *pLayer = pLayers->GetLayer(LayerIndex);
+			if(pLayer == (CMapItemLayer*)pLayers->GameLayer())
+			{
+				PassedGameLayer = true;
+				continue;
+			}
+
+			// same split as in OnRender
+			if(pLayer->m_Type != LAYERTYPE_TILES || LayerIndex < 0 || LayerIndex >= lBuffers.size() ||
+				(!AllLayers && PassedGameLayer != (m_Type == TYPE_FOREGROUND)))
+				continue;
+
+			CMapItemLayerTilemap *pTMap = (CMapItemLayerTilemap *)pLayer;
+			CTile *pTiles = (CTile *)pLayers->Map()->GetData(pTMap->m_Data);
+			RenderTools()->CreateTileLayerBuffer(&lBuffers[LayerIndex], pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f);
+		}
+	}
+}
+
+void CMapLayers::DestroyTileLayerBuffers(array<CTileLayerBuffer>& lBuffers)
+{
+	for(int i = 0; i < lBuffers.size(); i++)
+		RenderTools()->DestroyTileLayerBuffer(&lBuffers[i]);
+	lBuffers.clear();
 }
 
 int CMapLayers::GetInitAmount() const
@@ -148,7 +191,10 @@ static void PlaceEggDoodads(int LayerWidth, int LayerHeight, CTile* aOutTiles, C
 void CMapLayers::OnMapLoad()
 {
 	if(Layers())
+	{
 		LoadEnvPoints(Layers(), m_lEnvPoints);
+		CreateTileLayerBuffers(Layers(), m_lTileLayerBuffers, false);
+	}
 
 	// easter time, place eggs
 	if(m_pClient->IsEaster())
@@ -203,6 +249,9 @@ void CMapLayers::OnMapLoad()
 
 void CMapLayers::OnShutdown()
 {
+	DestroyTileLayerBuffers(m_lTileLayerBuffers);
+	DestroyTileLayerBuffers(m_lTileLayerBuffersMenu);
+
 	if(m_pEggTiles)
 	{
 		mem_free(m_pEggTiles);
@@ -360,10 +409,17 @@ void CMapLayers::OnRender()
 		return;
 
 	CLayers *pLayers = 0;
+	array<CTileLayerBuffer> *plBuffers = 0;
 	if(Client()->State() == IClient::STATE_ONLINE || Client()->State() == IClient::STATE_DEMOPLAYBACK)
+	{
 		pLayers = Layers();
+		plBuffers = &m_lTileLayerBuffers;
+	}
 	else if(m_pMenuMap->IsLoaded())
+	{
 		pLayers = m_pMenuLayers;
+		plBuffers = &m_lTileLayerBuffersMenu;
+	}
 
 	if(!pLayers)
 		return;
@@ -463,13 +519,27 @@ void CMapLayers::OnRender()
 							Graphics()->TextureSet(m_pClient->m_pMapimages->Get(pTMap->m_Image));
 
 						CTile *pTiles = (CTile *)pLayers->Map()->GetData(pTMap->m_Data);
-						Graphics()->BlendNone();
 						vec4 Color = vec4(pTMap->m_Color.r/255.0f, pTMap->m_Color.g/255.0f, pTMap->m_Color.b/255.0f, pTMap->m_Color.a/255.0f);
-						RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
-														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
-						Graphics()->BlendNormal();
-						RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
-														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+						int LayerIndex = pGroup->m_StartLayer+l;
+						if(LayerIndex < plBuffers->size() && (*plBuffers)[LayerIndex].IsValid())
+						{
+							const CTileLayerBuffer *pBuffer = &(*plBuffers)[LayerIndex];
+							Graphics()->BlendNone();
+							RenderTools()->RenderTileLayerBuffer(pBuffer, pTiles, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
+															EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+							Graphics()->BlendNormal();
+							RenderTools()->RenderTileLayerBuffer(pBuffer, pTiles, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
+															EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+						}
+						else
+						{
+							Graphics()->BlendNone();
+							RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
+															EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+							Graphics()->BlendNormal();
+							RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
+															EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+						}
 					}
 					else if(pLayer->m_Type == LAYERTYPE_QUADS)
 					{
@@ -530,6 +600,7 @@ void CMapLayers::BackgroundMapUpdate()
 	if(m_Type == TYPE_BACKGROUND && m_pMenuMap)
 	{
 		// unload map
+		DestroyTileLayerBuffers(m_lTileLayerBuffersMenu);
 		m_pMenuMap->Unload();
 
 		LoadBackgroundMap();
@@ -4,6 +4,7 @@
 #define GAME_CLIENT_COMPONENTS_MAPLAYERS_H
 #include <base/tl/array.h>
 #include <game/client/component.h>
+#include <game/client/render.h>
 
 class CMapLayers : public CComponent
 {
@@ -19,6 +20,10 @@ class CMapLayers : public CComponent
 	array<CEnvPoint> m_lEnvPoints;
 	array<CEnvPoint> m_lEnvPointsMenu;
 
+	// indexed by layer, only for the tile layers this component renders
+	array<CTileLayerBuffer> m_lTileLayerBuffers;
+	array<CTileLayerBuffer> m_lTileLayerBuffersMenu;
+
 	CTile* m_pEggTiles;
 	int m_EggLayerWidth;
 	int m_EggLayerHeight;
@@ -28,6 +33,9 @@ class CMapLayers : public CComponent
 	void LoadEnvPoints(const CLayers *pLayers, array<CEnvPoint>& lEnvPoints);
 	void LoadBackgroundMap();
 
+	void CreateTileLayerBuffers(CLayers *pLayers, array<CTileLayerBuffer>& lBuffers, bool AllLayers);
+	void DestroyTileLayerBuffers(array<CTileLayerBuffer>& lBuffers);
+
 public:
 	enum
 	{
@@ -5,7 +5,9 @@
 #include <base/color.h>
 #include <base/system.h>
 #include <base/math.h>
+#include <base/tl/threading.h>
 
+#include <engine/engine.h>
 #include <engine/graphics.h>
 #include <engine/storage.h>
 #include <engine/external/json-parser/json.h>
@@ -31,76 +33,117 @@ int CSkins::SkinPartScan(const char *pName, int IsDir, int DirType, void *pUser)
 	if(IsDir || !str_endswith(pName, ".png"))
 		return 0;
 
-	char aBuf[IO_MAX_PATH_LENGTH];
-	str_format(aBuf, sizeof(aBuf), "skins/%s/%s", CSkins::ms_apSkinPartNames[pSelf->m_ScanningPart], pName);
-	CImageInfo Info;
-	if(!pSelf->Graphics()->LoadPNG(&Info, aBuf, DirType))
-	{
-		str_format(aBuf, sizeof(aBuf), "failed to load skin part '%s'", pName);
-		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "skins", aBuf);
-		return 0;
-	}
+	// only remember the file, decoding is done by LoadSkinPartsThread
+	CSkinPartLoad Load;
+	mem_zero(&Load, sizeof(Load));
+	Load.m_Part = pSelf->m_ScanningPart;
+	Load.m_DirType = DirType;
+	str_copy(Load.m_aName, pName, sizeof(Load.m_aName));
+	pSelf->m_lPartLoads.add(Load);
 
-	CSkinPart Part;
-	Part.m_OrgTexture = pSelf->Graphics()->LoadTextureRaw(Info.m_Width, Info.m_Height, Info.m_Format, Info.m_pData, Info.m_Format, 0);
-	Part.m_BloodColor = vec3(1.0f, 1.0f, 1.0f);
+	return 0;
+}
 
-	unsigned char *d = (unsigned char *)Info.m_pData;
-	int Pitch = Info.m_Width*4;
+int CSkins::LoadSkinPartsThread(void *pUser)
+{
+	CSkins *pSelf = (CSkins *)pUser;
 
-	// dig out blood color
-	if(pSelf->m_ScanningPart == SKINPART_BODY)
+	while(1)
 	{
-		int PartX = Info.m_Width/2;
-		int PartY = 0;
-		int PartWidth = Info.m_Width/2;
-		int PartHeight = Info.m_Height/2;
-
-		int aColors[3] = {0};
-		for(int y = PartY; y < PartY+PartHeight; y++)
-			for(int x = PartX; x < PartX+PartWidth; x++)
+		int Index = atomic_inc(&pSelf->m_NextPartLoad)-1;
+		if(Index >= pSelf->m_NumPartLoads)
+			break;
+
+		CSkinPartLoad *pLoad = &pSelf->m_lPartLoads[Index];
+		char aBuf[IO_MAX_PATH_LENGTH];
+		str_format(aBuf, sizeof(aBuf), "skins/%s/%s", CSkins::ms_apSkinPartNames[pLoad->m_Part], pLoad->m_aName);
+		pLoad->m_Loaded = pSelf->Graphics()->LoadPNG(&pLoad->m_Info, aBuf, pLoad->m_DirType) != 0;
+		if(pLoad->m_Loaded)
+		{
+			CImageInfo *pInfo = &pLoad->m_Info;
+			unsigned char *d = (unsigned char *)pInfo->m_pData;
+			int Pitch = pInfo->m_Width*4;
+			pLoad->m_BloodColor = vec3(1.0f, 1.0f, 1.0f);
+
+			// dig out blood color
+			if(pLoad->m_Part == SKINPART_BODY)
 			{
-				if(d[y*Pitch+x*4+3] > 128)
-				{
-					aColors[0] += d[y*Pitch+x*4+0];
-					aColors[1] += d[y*Pitch+x*4+1];
-					aColors[2] += d[y*Pitch+x*4+2];
-				}
+				int PartX = pInfo->m_Width/2;
+				int PartY = 0;
+				int PartWidth = pInfo->m_Width/2;
+				int PartHeight = pInfo->m_Height/2;
+
+				int aColors[3] = {0};
+				for(int y = PartY; y < PartY+PartHeight; y++)
+					for(int x = PartX; x < PartX+PartWidth; x++)
+					{
+						if(d[y*Pitch+x*4+3] > 128)
+						{
+							aColors[0] += d[y*Pitch+x*4+0];
+							aColors[1] += d[y*Pitch+x*4+1];
+							aColors[2] += d[y*Pitch+x*4+2];
+						}
+					}
+
+				pLoad->m_BloodColor = normalize(vec3(aColors[0], aColors[1], aColors[2]));
+			}
+
+			// create colorless version
+			int Step = pInfo->m_Format == CImageInfo::FORMAT_RGBA ? 4 : 3;
+			int DataSize = pInfo->m_Width*pInfo->m_Height*Step;
+			unsigned char *pGray = (unsigned char *)mem_alloc(DataSize, 1);
+			mem_copy(pGray, d, DataSize);
+
+			// make the texture gray scale
+			for(int i = 0; i < pInfo->m_Width*pInfo->m_Height; i++)
+			{
+				int v = (pGray[i*Step]+pGray[i*Step+1]+pGray[i*Step+2])/3;
+				pGray[i*Step] = v;
+				pGray[i*Step+1] = v;
+				pGray[i*Step+2] = v;
 			}
+			pLoad->m_pGrayData = pGray;
+		}
 
-		Part.m_BloodColor = normalize(vec3(aColors[0], aColors[1], aColors[2]));
+		atomic_inc(&pSelf->m_NumPartLoadsDone);
 	}
 
-	// create colorless version
-	int Step = Info.m_Format == CImageInfo::FORMAT_RGBA ? 4 : 3;
+	return 0;
+}
 
-	// make the texture gray scale
-	for(int i = 0; i < Info.m_Width*Info.m_Height; i++)
+void CSkins::AddSkinPart(CSkinPartLoad *pLoad)
+{
+	char aBuf[IO_MAX_PATH_LENGTH];
+	if(!pLoad->m_Loaded)
 	{
-		int v = (d[i*Step]+d[i*Step+1]+d[i*Step+2])/3;
-		d[i*Step] = v;
-		d[i*Step+1] = v;
-		d[i*Step+2] = v;
+		str_format(aBuf, sizeof(aBuf), "failed to load skin part '%s'", pLoad->m_aName);
+		Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "skins", aBuf);
+		return;
 	}
 
-	Part.m_ColorTexture = pSelf->Graphics()->LoadTextureRaw(Info.m_Width, Info.m_Height, Info.m_Format, Info.m_pData, Info.m_Format, 0);
-	mem_free(Info.m_pData);
+	// texture uploads have to stay on this thread
+	CImageInfo *pInfo = &pLoad->m_Info;
+	CSkinPart Part;
+	Part.m_OrgTexture = Graphics()->LoadTextureRaw(pInfo->m_Width, pInfo->m_Height, pInfo->m_Format, pInfo->m_pData, pInfo->m_Format, 0);
+	Part.m_ColorTexture = Graphics()->LoadTextureRaw(pInfo->m_Width, pInfo->m_Height, pInfo->m_Format, pLoad->m_pGrayData, pInfo->m_Format, 0);
+	Part.m_BloodColor = pLoad->m_BloodColor;
+	mem_free(pInfo->m_pData);
+	mem_free(pLoad->m_pGrayData);
 
 	// set skin part data
+	const char *pName = pLoad->m_aName;
 	Part.m_Flags = 0;
 	if(pName[0] == 'x' && pName[1] == '_')
 		Part.m_Flags |= SKINFLAG_SPECIAL;
-	if(DirType != IStorage::TYPE_SAVE)
+	if(pLoad->m_DirType != IStorage::TYPE_SAVE)
 		Part.m_Flags |= SKINFLAG_STANDARD;
 	str_truncate(Part.m_aName, sizeof(Part.m_aName), pName, str_length(pName) - 4);
-	if(pSelf->Config()->m_Debug)
+	if(Config()->m_Debug)
 	{
 		str_format(aBuf, sizeof(aBuf), "load skin part %s", Part.m_aName);
-		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "skins", aBuf);
+		Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "skins", aBuf);
 	}
-	pSelf->m_aaSkinParts[pSelf->m_ScanningPart].add(Part);
-
-	return 0;
+	m_aaSkinParts[pLoad->m_Part].add(Part);
 }
 
 int CSkins::SkinScan(const char *pName, int IsDir, int DirType, void *pUser)
@@ -236,6 +279,25 @@ void CSkins::OnInit()
 	ms_apColorVariables[SKINPART_FEET] = &Config()->m_PlayerColorFeet;
 	ms_apColorVariables[SKINPART_EYES] = &Config()->m_PlayerColorEyes;
 
+	// collect the skin part files and decode them on the job threads, this thread helps out
+	m_lPartLoads.clear();
+	for(int p = 0; p < NUM_SKINPARTS; p++)
+	{
+		char aBuf[64];
+		str_format(aBuf, sizeof(aBuf), "skins/%s", ms_apSkinPartNames[p]);
+		m_ScanningPart = p;
+		Storage()->ListDirectory(IStorage::TYPE_ALL, aBuf, SkinPartScan, this);
+	}
+
+	m_NumPartLoads = m_lPartLoads.size();
+	m_NextPartLoad = 0;
+	m_NumPartLoadsDone = 0;
+	for(int i = 0; i < NUM_LOAD_JOBS; i++)
+		m_pClient->Engine()->AddJob(&m_aLoadJobs[i], LoadSkinPartsThread, this);
+	LoadSkinPartsThread(this);
+	while((int)m_NumPartLoadsDone < m_NumPartLoads)
+		thread_sleep(1);
+
 	for(int p = 0; p < NUM_SKINPARTS; p++)
 	{
 		m_aaSkinParts[p].clear();
@@ -251,10 +313,11 @@ void CSkins::OnInit()
 		}
 
 		// load skin parts
-		char aBuf[64];
-		str_format(aBuf, sizeof(aBuf), "skins/%s", ms_apSkinPartNames[p]);
-		m_ScanningPart = p;
-		Storage()->ListDirectory(IStorage::TYPE_ALL, aBuf, SkinPartScan, this);
+		for(int i = 0; i < m_lPartLoads.size(); i++)
+		{
+			if(m_lPartLoads[i].m_Part == p)
+				AddSkinPart(&m_lPartLoads[i]);
+		}
 
 		// add dummy skin part
 		if(!m_aaSkinParts[p].size())
@@ -267,6 +330,7 @@ void CSkins::OnInit()
 		}
 		m_pClient->m_pMenus->RenderLoading(2);
 	}
+	m_lPartLoads.clear();
 
 	// create dummy skin
 	m_DummySkin.m_Flags = SKINFLAG_STANDARD;
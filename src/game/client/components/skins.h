@@ -3,7 +3,9 @@
 #ifndef GAME_CLIENT_COMPONENTS_SKINS_H
 #define GAME_CLIENT_COMPONENTS_SKINS_H
 #include <base/vmath.h>
+#include <base/tl/array.h>
 #include <base/tl/sorted_array.h>
+#include <engine/shared/jobs.h>
 #include <game/client/component.h>
 
 // todo: fix duplicate skins (different paths)
@@ -78,13 +80,39 @@ public:
 	void SaveSkinfile(const char *pSaveSkinName);
 
 private:
+	enum
+	{
+		NUM_LOAD_JOBS=3,
+	};
+
+	// a skin part file that gets decoded on a job thread
+	struct CSkinPartLoad
+	{
+		int m_Part;
+		int m_DirType;
+		char m_aName[IO_MAX_PATH_LENGTH];
+		bool m_Loaded;
+		CImageInfo m_Info;
+		void *m_pGrayData;
+		vec3 m_BloodColor;
+	};
+
 	int m_ScanningPart;
 	sorted_array<CSkinPart> m_aaSkinParts[NUM_SKINPARTS];
 	sorted_array<CSkin> m_aSkins;
 	CSkin m_DummySkin;
 
+	array<CSkinPartLoad> m_lPartLoads;
+	int m_NumPartLoads;
+	volatile unsigned m_NextPartLoad;
+	volatile unsigned m_NumPartLoadsDone;
+	CJob m_aLoadJobs[NUM_LOAD_JOBS];
+
+	void AddSkinPart(CSkinPartLoad *pLoad);
+
 	static int SkinPartScan(const char *pName, int IsDir, int DirType, void *pUser);
 	static int SkinScan(const char *pName, int IsDir, int DirType, void *pUser);
+	static int LoadSkinPartsThread(void *pUser);
 };
 
 #endif
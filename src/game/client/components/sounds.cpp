@@ -1,5 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/tl/threading.h>
+
 #include <engine/engine.h>
 #include <engine/sound.h>
 #include <engine/shared/config.h>
@@ -13,23 +15,28 @@
 struct CUserData
 {
 	CGameClient *m_pGameClient;
-	bool m_Render;
+	volatile unsigned m_NextSet;
+	volatile unsigned m_NumLoaded;
 } g_UserData;
 
+// every job takes the next sound set until all are loaded
 static int LoadSoundsThread(void *pUser)
 {
 	CUserData *pData = static_cast<CUserData *>(pUser);
 
-	for(int s = 0; s < g_pData->m_NumSounds; s++)
+	while(1)
 	{
+		int s = atomic_inc(&pData->m_NextSet)-1;
+		if(s >= g_pData->m_NumSounds)
+			break;
+
 		for(int i = 0; i < g_pData->m_aSounds[s].m_NumSounds; i++)
 		{
 			ISound::CSampleHandle Id = pData->m_pGameClient->Sound()->LoadWV(g_pData->m_aSounds[s].m_aSounds[i].m_pFilename);
 			g_pData->m_aSounds[s].m_aSounds[i].m_Id = Id;
 		}
 
-		if(pData->m_Render)
-			pData->m_pGameClient->m_pMenus->RenderLoading(1);
+		atomic_inc(&pData->m_NumLoaded);
 	}
 
 	return 0;
@@ -78,18 +85,30 @@ void CSounds::OnInit()
 	ClearQueue();
 
 	// load sounds
+	g_UserData.m_pGameClient = m_pClient;
+	g_UserData.m_NextSet = 0;
+	g_UserData.m_NumLoaded = 0;
+	for(int i = 0; i < NUM_SOUND_JOBS; i++)
+		m_pClient->Engine()->AddJob(&m_aSoundJobs[i], LoadSoundsThread, &g_UserData);
+
 	if(Config()->m_SndAsyncLoading)
-	{
-		g_UserData.m_pGameClient = m_pClient;
-		g_UserData.m_Render = false;
-		m_pClient->Engine()->AddJob(&m_SoundJob, LoadSoundsThread, &g_UserData);
 		m_WaitForSoundJob = true;
-	}
 	else
 	{
-		g_UserData.m_pGameClient = m_pClient;
-		g_UserData.m_Render = true;
+		// help out and wait for the jobs while keeping the loading screen updated
 		LoadSoundsThread(&g_UserData);
+		int Reported = 0;
+		while(Reported < g_pData->m_NumSounds)
+		{
+			int Loaded = g_UserData.m_NumLoaded;
+			if(Loaded > Reported)
+			{
+				m_pClient->m_pMenus->RenderLoading(Loaded-Reported);
+				Reported = Loaded;
+			}
+			else
+				thread_sleep(1);
+		}
 		m_WaitForSoundJob = false;
 	}
 }
@@ -114,7 +133,7 @@ void CSounds::OnRender()
 	// check for sound initialisation
 	if(m_WaitForSoundJob)
 	{
-		if(m_SoundJob.Status() == CJob::STATE_DONE)
+		if((int)g_UserData.m_NumLoaded == g_pData->m_NumSounds)
 			m_WaitForSoundJob = false;
 		else
 			return;
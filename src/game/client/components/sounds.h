@@ -12,6 +12,7 @@ class CSounds : public CComponent
 	enum
 	{
 		QUEUE_SIZE = 32,
+		NUM_SOUND_JOBS = 4,
 	};
 	struct QueueEntry
 	{
@@ -20,7 +21,7 @@ class CSounds : public CComponent
 	} m_aQueue[QUEUE_SIZE];
 	int m_QueuePos;
 	int64 m_QueueWaitTime;
-	class CJob m_SoundJob;
+	class CJob m_aSoundJobs[NUM_SOUND_JOBS];
 	bool m_WaitForSoundJob;
 	
 	ISound::CSampleHandle GetSampleId(int SetId);
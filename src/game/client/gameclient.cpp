@@ -1,5 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/tl/threading.h>
+
 #include <engine/editor.h>
 #include <engine/engine.h>
 #include <engine/contacts.h>
@@ -334,6 +336,46 @@ void CGameClient::OnConsoleInit()
 	m_SuppressEvents = false;
 }
 
+int CGameClient::LoadPNGsThread(void *pUser)
+{
+	CGameClient *pSelf = (CGameClient *)pUser;
+	while(1)
+	{
+		int Index = atomic_inc(&pSelf->m_NextPNGLoad)-1;
+		if(Index >= pSelf->m_NumPNGLoads)
+			break;
+		CPNGLoad *pLoad = &pSelf->m_pPNGLoads[Index];
+		pLoad->m_Loaded = pSelf->Graphics()->LoadPNG(&pLoad->m_Info, pLoad->m_aFilename, pLoad->m_StorageType) != 0;
+	}
+	return 0;
+}
+
+void CGameClient::LoadPNGs(CPNGLoad *pLoads, int NumLoads)
+{
+	if(NumLoads <= 0)
+		return;
+
+	m_pPNGLoads = pLoads;
+	m_NumPNGLoads = NumLoads;
+	m_NextPNGLoad = 0;
+	int NumJobs = minimum(NumLoads-1, (int)NUM_PNG_JOBS);
+	for(int i = 0; i < NumJobs; i++)
+		Engine()->AddJob(&m_aPNGJobs[i], LoadPNGsThread, this);
+
+	// help out, then wait for the jobs so they can be queued again on the next call.
+	// the ones still queued behind other work like the sound decoding are taken out
+	LoadPNGsThread(this);
+	for(int i = 0; i < NumJobs; i++)
+	{
+		if(Engine()->RemoveJob(&m_aPNGJobs[i]))
+			continue;
+		while(m_aPNGJobs[i].Status() != CJob::STATE_DONE)
+			thread_sleep(1);
+	}
+	m_pPNGLoads = 0;
+	m_NumPNGLoads = 0;
+}
+
 void CGameClient::OnInit()
 {
 	m_pGraphics = Kernel()->RequestInterface<IGraphics>();
@@ -381,13 +423,30 @@ void CGameClient::OnInit()
 	// init all components
 	for(int i = m_All.m_Num-1; i >= 0; --i)
 		m_All.m_paComponents[i]->OnInit();
+	int64 ComponentsEnd = time_get();
 
-	// load textures
+	// load textures, the PNGs are decoded on the job threads
+	CPNGLoad *pImageLoads = (CPNGLoad *)mem_alloc(g_pData->m_NumImages*sizeof(CPNGLoad), 1);
+	for(int i = 0; i < g_pData->m_NumImages; i++)
+	{
+		str_copy(pImageLoads[i].m_aFilename, g_pData->m_aImages[i].m_pFilename, sizeof(pImageLoads[i].m_aFilename));
+		pImageLoads[i].m_StorageType = IStorage::TYPE_ALL;
+	}
+	LoadPNGs(pImageLoads, g_pData->m_NumImages);
 	for(int i = 0; i < g_pData->m_NumImages; i++)
 	{
-		g_pData->m_aImages[i].m_Id = Graphics()->LoadTexture(g_pData->m_aImages[i].m_pFilename, IStorage::TYPE_ALL, CImageInfo::FORMAT_AUTO, g_pData->m_aImages[i].m_Flag ? IGraphics::TEXLOAD_LINEARMIPMAPS : 0);
+		CImageInfo *pInfo = &pImageLoads[i].m_Info;
+		if(pImageLoads[i].m_Loaded)
+		{
+			g_pData->m_aImages[i].m_Id = Graphics()->LoadTextureRaw(pInfo->m_Width, pInfo->m_Height, pInfo->m_Format, pInfo->m_pData, pInfo->m_Format, g_pData->m_aImages[i].m_Flag ? IGraphics::TEXLOAD_LINEARMIPMAPS : 0);
+			mem_free(pInfo->m_pData);
+		}
+		else
+			g_pData->m_aImages[i].m_Id = Graphics()->LoadTexture(pImageLoads[i].m_aFilename, IStorage::TYPE_ALL, CImageInfo::FORMAT_AUTO, 0); // gives the invalid texture
 		m_pMenus->RenderLoading(1);
 	}
+	mem_free(pImageLoads);
+	int64 TexturesEnd = time_get();
 
 	// init the editor
 	m_pEditor->Init();
@@ -397,7 +456,9 @@ void CGameClient::OnInit()
 
 	int64 End = time_get();
 	char aBuf[256];
-	str_format(aBuf, sizeof(aBuf), "initialisation finished after %.2fms", ((End-Start)*1000)/(float)time_freq());
+	str_format(aBuf, sizeof(aBuf), "initialisation finished after %.2fms (components %.2fms, textures %.2fms, editor %.2fms)",
+		((End-Start)*1000)/(float)time_freq(), ((ComponentsEnd-Start)*1000)/(float)time_freq(),
+		((TexturesEnd-ComponentsEnd)*1000)/(float)time_freq(), ((End-TexturesEnd)*1000)/(float)time_freq());
 	Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "gameclient", aBuf);
 
 	m_ServerMode = SERVERMODE_PURE;
@@ -445,6 +506,7 @@ void CGameClient::OnConnected()
 {
 	m_Layers.Init(Kernel());
 	m_Collision.Init(Layers());
+	InvalidatePrediction();
 
 	for(int i = 0; i < m_All.m_Num; i++)
 	{
@@ -462,6 +524,8 @@ void CGameClient::OnReset()
 {
 	// clear out the invalid pointers
 	m_LastNewPredictedTick = -1;
+	m_PredictionBaseTick = -1;
+	InvalidatePrediction();
 	mem_zero(&m_Snap, sizeof(m_Snap));
 
 	for(int i = 0; i < MAX_CLIENTS; i++)
@@ -1461,6 +1525,75 @@ void CGameClient::OnDemoRecSnap()
 	pGameInfo->m_MatchCurrent = m_GameInfo.m_MatchCurrent;
 }
 
+bool CGameClient::CanReusePrediction()
+{
+	if(m_PredictionWorldTick == -1 || m_PredictionWorldTick > Client()->PredGameTick() ||
+		mem_comp(&m_PredictionWorld.m_Tuning, &m_Tuning, sizeof(m_Tuning)) != 0)
+		return false;
+
+	// no new snapshot, the cached world is still based on the current one
+	if(m_PredictionBaseTick == Client()->GameTick())
+		return true;
+
+	// a new snapshot arrived, the cache stays valid only if it matches what we predicted for its tick
+	int Tick = Client()->GameTick();
+	if(Tick < m_PredictionBaseTick || Tick > m_PredictionWorldTick)
+		return false;
+	const CPredictionTick *pHistory = &m_aPredictionHistory[Tick%PREDICTION_HISTORY_SIZE];
+	if(pHistory->m_Tick != Tick)
+		return false;
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(m_Snap.m_aCharacters[i].m_Active != (m_PredictionWorld.m_apCharacters[i] != 0))
+			return false;
+		if(!m_Snap.m_aCharacters[i].m_Active)
+			continue;
+
+		// run the snapshot data through the core so both sides are quantized the same way
+		CCharacterCore Core;
+		CNetObj_CharacterCore Snapped;
+		mem_zero(&Snapped, sizeof(Snapped));
+		Core.Read(&m_Snap.m_aCharacters[i].m_Cur);
+		Core.Write(&Snapped);
+		if(mem_comp(&Snapped, &pHistory->m_aCores[i], sizeof(Snapped)) != 0)
+			return false;
+	}
+	return true;
+}
+
+void CGameClient::RebuildPredictionWorld()
+{
+	m_PredictionWorld = CWorldCore();
+	m_PredictionWorld.m_Tuning = m_Tuning;
+
+	// search for players
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(!m_Snap.m_aCharacters[i].m_Active)
+			continue;
+
+		m_aClients[i].m_Predicted.Init(&m_PredictionWorld, Collision());
+		m_PredictionWorld.m_apCharacters[i] = &m_aClients[i].m_Predicted;
+		m_aClients[i].m_Predicted.Read(&m_Snap.m_aCharacters[i].m_Cur);
+	}
+
+	m_PredictionWorldTick = Client()->GameTick();
+}
+
+void CGameClient::StorePredictionTick(int Tick)
+{
+	CPredictionTick *pHistory = &m_aPredictionHistory[Tick%PREDICTION_HISTORY_SIZE];
+	pHistory->m_Tick = Tick;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(!m_PredictionWorld.m_apCharacters[i])
+			continue;
+		mem_zero(&pHistory->m_aCores[i], sizeof(pHistory->m_aCores[i]));
+		m_PredictionWorld.m_apCharacters[i]->Write(&pHistory->m_aCores[i]);
+	}
+}
+
 void CGameClient::OnPredict()
 {
 	// store the previous values so we can detect prediction errors
@@ -1469,7 +1602,10 @@ void CGameClient::OnPredict()
 
 	// we can't predict without our own id or own character
 	if(m_LocalClientID == -1 || !m_Snap.m_aCharacters[m_LocalClientID].m_Active)
+	{
+		InvalidatePrediction();
 		return;
+	}
 
 	// don't predict anything if we are paused or round/game is over
 	if(m_Snap.m_pGameData && m_Snap.m_pGameData->m_GameStateFlags&(GAMESTATEFLAG_PAUSED|GAMESTATEFLAG_ROUNDOVER|GAMESTATEFLAG_GAMEOVER))
@@ -1478,26 +1614,22 @@ void CGameClient::OnPredict()
 			m_PredictedChar.Read(m_Snap.m_pLocalCharacter);
 		if(m_Snap.m_pLocalPrevCharacter)
 			m_PredictedPrevChar.Read(m_Snap.m_pLocalPrevCharacter);
+		InvalidatePrediction();
 		return;
 	}
 
-	// repredict character
-	CWorldCore World;
-	World.m_Tuning = m_Tuning;
-
-	// search for players
-	for(int i = 0; i < MAX_CLIENTS; i++)
+	// continue from the cached world if possible, otherwise repredict from the snapshot
+	int StartTick = m_PredictionWorldTick+1;
+	if(!CanReusePrediction())
 	{
-		if(!m_Snap.m_aCharacters[i].m_Active)
-			continue;
-
-		m_aClients[i].m_Predicted.Init(&World, Collision());
-		World.m_apCharacters[i] = &m_aClients[i].m_Predicted;
-		m_aClients[i].m_Predicted.Read(&m_Snap.m_aCharacters[i].m_Cur);
+		RebuildPredictionWorld();
+		StartTick = Client()->GameTick()+1;
 	}
+	m_PredictionBaseTick = Client()->GameTick();
+	CWorldCore &World = m_PredictionWorld;
 
 	// predict
-	for(int Tick = Client()->GameTick()+1; Tick <= Client()->PredGameTick(); Tick++)
+	for(int Tick = StartTick; Tick <= Client()->PredGameTick(); Tick++)
 	{
 		// fetch the local
 		if(Tick == Client()->PredGameTick() && World.m_apCharacters[m_LocalClientID])
@@ -1533,6 +1665,9 @@ void CGameClient::OnPredict()
 			World.m_apCharacters[c]->Quantize();
 		}
 
+		StorePredictionTick(Tick);
+		m_PredictionWorldTick = Tick;
+
 		// check if we want to trigger effects
 		if(Tick > m_LastNewPredictedTick)
 		{
@@ -6,6 +6,7 @@
 #include <base/vmath.h>
 #include <engine/client.h>
 #include <engine/console.h>
+#include <engine/shared/jobs.h>
 #include <game/layers.h>
 #include <game/gamecore.h>
 #include "render.h"
@@ -58,6 +59,28 @@ class CGameClient : public IGameClient
 	int m_PredictedTick;
 	int m_LastNewPredictedTick;
 
+	// prediction cache
+	enum
+	{
+		PREDICTION_HISTORY_SIZE=64,
+	};
+
+	struct CPredictionTick
+	{
+		int m_Tick;
+		CNetObj_CharacterCore m_aCores[MAX_CLIENTS];
+	};
+
+	CWorldCore m_PredictionWorld;
+	CPredictionTick m_aPredictionHistory[PREDICTION_HISTORY_SIZE];
+	int m_PredictionBaseTick; // snapshot tick the cached world was built from
+	int m_PredictionWorldTick; // last tick simulated into the cached world, -1 when invalid
+
+	void InvalidatePrediction() { m_PredictionWorldTick = -1; }
+	bool CanReusePrediction();
+	void RebuildPredictionWorld();
+	void StorePredictionTick(int Tick);
+
 	int m_LastGameStartTick;
 	int m_LastFlagCarrierRed;
 	int m_LastFlagCarrierBlue;
@@ -72,6 +95,31 @@ class CGameClient : public IGameClient
 
 	void EvolveCharacter(CNetObj_Character *pCharacter, int Tick);
 
+public:
+	// a PNG file that gets decoded on the job threads by LoadPNGs
+	struct CPNGLoad
+	{
+		char m_aFilename[IO_MAX_PATH_LENGTH];
+		int m_StorageType;
+		bool m_Loaded;
+		CImageInfo m_Info;
+	};
+
+	void LoadPNGs(CPNGLoad *pLoads, int NumLoads);
+
+private:
+	enum
+	{
+		NUM_PNG_JOBS=3,
+	};
+
+	CJob m_aPNGJobs[NUM_PNG_JOBS];
+	CPNGLoad *m_pPNGLoads;
+	int m_NumPNGLoads;
+	volatile unsigned m_NextPNGLoad;
+
+	static int LoadPNGsThread(void *pUser);
+
 public:
 	IKernel *Kernel() { return IInterface::Kernel(); }
 	IEngine *Engine() const { return m_pEngine; }
@@ -20,6 +20,7 @@ enum
 	LAYERRENDERFLAG_TRANSPARENT = 2,
 
 	TILERENDERFLAG_EXTEND = 4,
+	TILERENDERFLAG_EXTEND_ONLY = 8, // only the extended border outside of the layer
 };
 
 class CTeeRenderInfo
@@ -43,6 +44,34 @@ public:
 	int m_GotAirJump;
 };
 
+// static tile layer kept in a quad buffer, split into chunks for culling
+class CTileLayerBuffer
+{
+public:
+	enum
+	{
+		CHUNK_SIZE=32,
+	};
+
+	// opaque tiles are stored in front of the transparent ones
+	struct CChunk
+	{
+		int m_Start;
+		int m_NumOpaque;
+		int m_NumTransparent;
+	};
+
+	IGraphics::CBufferHandle m_Buffer;
+	int m_Width;
+	int m_Height;
+	int m_NumChunksX;
+	int m_NumChunksY;
+	CChunk *m_pChunks;
+
+	CTileLayerBuffer() : m_Width(0), m_Height(0), m_NumChunksX(0), m_NumChunksY(0), m_pChunks(0) {}
+	bool IsValid() const { return m_Buffer.IsValid(); }
+};
+
 typedef void (*ENVELOPE_EVAL)(float TimeOffset, int Env, float *pChannels, void *pUser);
 class CTextCursor;
 
@@ -82,6 +111,9 @@ public:
 	static void RenderEvalEnvelope(CEnvPoint *pPoints, int NumPoints, int Channels, float Time, float *pResult);
 	void RenderQuads(CQuad *pQuads, int NumQuads, int Flags, ENVELOPE_EVAL pfnEval, void *pUser);
 	void RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags, ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset);
+	bool CreateTileLayerBuffer(CTileLayerBuffer *pBuffer, CTile *pTiles, int w, int h, float Scale);
+	void DestroyTileLayerBuffer(CTileLayerBuffer *pBuffer);
+	void RenderTileLayerBuffer(const CTileLayerBuffer *pBuffer, CTile *pTiles, float Scale, vec4 Color, int RenderFlags, ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset);
 
 	// helpers
 	void MapScreenToWorld(float CenterX, float CenterY, float ParallaxX, float ParallaxY,
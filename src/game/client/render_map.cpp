@@ -330,6 +330,53 @@ void CRenderTools::RenderQuads(CQuad *pQuads, int NumQuads, int RenderFlags, ENV
 	Graphics()->WrapNormal();
 }
 
+static void TileTexCoords(int Flags, float *pU, float *pV)
+{
+	float x0 = 0;
+	float y0 = 0;
+	float x1 = 1;
+	float y1 = 0;
+	float x2 = 1;
+	float y2 = 1;
+	float x3 = 0;
+	float y3 = 1;
+
+	if(Flags&TILEFLAG_VFLIP)
+	{
+		x0 = x2;
+		x1 = x3;
+		x2 = x3;
+		x3 = x0;
+	}
+
+	if(Flags&TILEFLAG_HFLIP)
+	{
+		y0 = y3;
+		y2 = y1;
+		y3 = y1;
+		y1 = y0;
+	}
+
+	if(Flags&TILEFLAG_ROTATE)
+	{
+		float Tmp = x0;
+		x0 = x3;
+		x3 = x2;
+		x2 = x1;
+		x1 = Tmp;
+		Tmp = y0;
+		y0 = y3;
+		y3 = y2;
+		y2 = y1;
+		y1 = Tmp;
+	}
+
+	pU[0] = x0; pV[0] = y0;
+	pU[1] = x1; pV[1] = y1;
+	pU[2] = x2; pV[2] = y2;
+	pU[3] = x3; pV[3] = y3;
+}
+
 void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags,
 									ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset)
 {
@@ -364,6 +411,13 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 
 			if(RenderFlags&TILERENDERFLAG_EXTEND)
 			{
+				if(RenderFlags&TILERENDERFLAG_EXTEND_ONLY && mx >= 0 && mx < w && my >= 0 && my < h)
+				{
+					// skip the inside of the layer
+					x = w-1;
+					continue;
+				}
+
 				if(mx<0)
 					mx = 0;
 				if(mx>=w)
@@ -406,46 +460,9 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 
 				if(Render)
 				{
-					float x0 = 0;
-					float y0 = 0;
-					float x1 = 1;
-					float y1 = 0;
-					float x2 = 1;
-					float y2 = 1;
-					float x3 = 0;
-					float y3 = 1;
-
-					if(Flags&TILEFLAG_VFLIP)
-					{
-						x0 = x2;
-						x1 = x3;
-						x2 = x3;
-						x3 = x0;
-					}
-
-					if(Flags&TILEFLAG_HFLIP)
-					{
-						y0 = y3;
-						y2 = y1;
-						y3 = y1;
-						y1 = y0;
-					}
-
-					if(Flags&TILEFLAG_ROTATE)
-					{
-						float Tmp = x0;
-						x0 = x3;
-						x3 = x2;
-						x2 = x1;
-						x1 = Tmp;
-						Tmp = y0;
-						y0 = y3;
-						y3 = y2;
-						y2 = y1;
-						y1 = Tmp;
-					}
-
-					Graphics()->QuadsSetSubsetFree(x0, y0, x1, y1, x2, y2, x3, y3, Index);
+					float aU[4], aV[4];
+					TileTexCoords(Flags, aU, aV);
+					Graphics()->QuadsSetSubsetFree(aU[0], aV[0], aU[1], aV[1], aU[2], aV[2], aU[3], aV[3], Index);
 					IGraphics::CQuadItem QuadItem(x*Scale, y*Scale, Scale, Scale);
 					Graphics()->QuadsDrawTL(&QuadItem, 1);
 				}
@@ -456,3 +473,148 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 	Graphics()->QuadsEnd();
 	Graphics()->MapScreen(ScreenX0, ScreenY0, ScreenX1, ScreenY1);
 }
+
+bool CRenderTools::CreateTileLayerBuffer(CTileLayerBuffer *pBuffer, CTile *pTiles, int w, int h, float Scale)
+{
+	pBuffer->m_Width = w;
+	pBuffer->m_Height = h;
+	pBuffer->m_NumChunksX = (w+CTileLayerBuffer::CHUNK_SIZE-1)/CTileLayerBuffer::CHUNK_SIZE;
+	pBuffer->m_NumChunksY = (h+CTileLayerBuffer::CHUNK_SIZE-1)/CTileLayerBuffer::CHUNK_SIZE;
+
+	int NumTiles = 0;
+	for(int i = 0; i < w*h; i++)
+	{
+		if(pTiles[i].m_Index)
+			NumTiles++;
+	}
+	if(!NumTiles)
+		return false;
+
+	IGraphics::CBufferQuad *pQuads = (IGraphics::CBufferQuad *)mem_alloc(sizeof(IGraphics::CBufferQuad)*NumTiles, 1);
+	pBuffer->m_pChunks = (CTileLayerBuffer::CChunk *)mem_alloc(sizeof(CTileLayerBuffer::CChunk)*pBuffer->m_NumChunksX*pBuffer->m_NumChunksY, 1);
+
+	int NumQuads = 0;
+	for(int cy = 0; cy < pBuffer->m_NumChunksY; cy++)
+		for(int cx = 0; cx < pBuffer->m_NumChunksX; cx++)
+		{
+			CTileLayerBuffer::CChunk *pChunk = &pBuffer->m_pChunks[cy*pBuffer->m_NumChunksX+cx];
+			pChunk->m_Start = NumQuads;
+			pChunk->m_NumOpaque = 0;
+			pChunk->m_NumTransparent = 0;
+
+			int EndX = minimum((cx+1)*(int)CTileLayerBuffer::CHUNK_SIZE, w);
+			int EndY = minimum((cy+1)*(int)CTileLayerBuffer::CHUNK_SIZE, h);
+
+			// first pass opaque tiles, second pass the rest
+			for(int Pass = 0; Pass < 2; Pass++)
+				for(int y = cy*CTileLayerBuffer::CHUNK_SIZE; y < EndY; y++)
+					for(int x = cx*CTileLayerBuffer::CHUNK_SIZE; x < EndX; x++)
+					{
+						const CTile *pTile = &pTiles[y*w+x];
+						if(!pTile->m_Index || ((pTile->m_Flags&TILEFLAG_OPAQUE) != 0) != (Pass == 0))
+							continue;
+
+						IGraphics::CBufferQuad *pQuad = &pQuads[NumQuads++];
+						pQuad->m_X = x*Scale;
+						pQuad->m_Y = y*Scale;
+						pQuad->m_Width = Scale;
+						pQuad->m_Height = Scale;
+						pQuad->m_TextureIndex = pTile->m_Index;
+						TileTexCoords(pTile->m_Flags, pQuad->m_aU, pQuad->m_aV);
+
+						if(Pass == 0)
+							pChunk->m_NumOpaque++;
+						else
+							pChunk->m_NumTransparent++;
+					}
+		}
+
+	pBuffer->m_Buffer = Graphics()->CreateQuadBuffer(pQuads, NumQuads);
+	mem_free(pQuads);
+
+	if(!pBuffer->IsValid())
+	{
+		DestroyTileLayerBuffer(pBuffer);
+		return false;
+	}
+	return true;
+}
+
+void CRenderTools::DestroyTileLayerBuffer(CTileLayerBuffer *pBuffer)
+{
+	Graphics()->DestroyQuadBuffer(&pBuffer->m_Buffer);
+	if(pBuffer->m_pChunks)
+	{
+		mem_free(pBuffer->m_pChunks);
+		pBuffer->m_pChunks = 0;
+	}
+}
+
+void CRenderTools::RenderTileLayerBuffer(const CTileLayerBuffer *pBuffer, CTile *pTiles, float Scale, vec4 Color, int RenderFlags,
+									ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset)
+{
+	float ScreenX0, ScreenY0, ScreenX1, ScreenY1;
+	Graphics()->GetScreen(&ScreenX0, &ScreenY0, &ScreenX1, &ScreenY1);
+
+	float r=1, g=1, b=1, a=1;
+	if(ColorEnv >= 0)
+	{
+		float aChannels[4];
+		pfnEval(ColorEnvOffset/1000.0f, ColorEnv, aChannels, pUser);
+		r = aChannels[0];
+		g = aChannels[1];
+		b = aChannels[2];
+		a = aChannels[3];
+	}
+
+	const float Alpha = Color.a*a;
+	const vec4 DrawColor = vec4(Color.r*r*Alpha, Color.g*g*Alpha, Color.b*b*Alpha, Alpha);
+	const bool Opaque = Alpha > 254.0f/255.0f;
+
+	int StartY = (int)(ScreenY0/Scale)-1;
+	int StartX = (int)(ScreenX0/Scale)-1;
+	int EndY = (int)(ScreenY1/Scale)+1;
+	int EndX = (int)(ScreenX1/Scale)+1;
+
+	// draw the visible chunks, merging ranges that follow each other in the buffer
+	int ChunkX0 = maximum(StartX, 0)/CTileLayerBuffer::CHUNK_SIZE;
+	int ChunkY0 = maximum(StartY, 0)/CTileLayerBuffer::CHUNK_SIZE;
+	int ChunkX1 = minimum(EndX, pBuffer->m_Width)/CTileLayerBuffer::CHUNK_SIZE;
+	int ChunkY1 = minimum(EndY, pBuffer->m_Height)/CTileLayerBuffer::CHUNK_SIZE;
+	ChunkX1 = minimum(ChunkX1, pBuffer->m_NumChunksX-1);
+	ChunkY1 = minimum(ChunkY1, pBuffer->m_NumChunksY-1);
+	if(EndX <= 0 || EndY <= 0)
+		ChunkY1 = -1;
+
+	int DrawStart = 0;
+	int DrawNum = 0;
+	for(int cy = ChunkY0; cy <= ChunkY1; cy++)
+		for(int cx = ChunkX0; cx <= ChunkX1; cx++)
+		{
+			const CTileLayerBuffer::CChunk *pChunk = &pBuffer->m_pChunks[cy*pBuffer->m_NumChunksX+cx];
+			int Start = pChunk->m_Start;
+			int Num = 0;
+			if(RenderFlags&LAYERRENDERFLAG_OPAQUE && Opaque)
+				Num += pChunk->m_NumOpaque;
+			else if(Opaque)
+				Start += pChunk->m_NumOpaque;
+			if(RenderFlags&LAYERRENDERFLAG_TRANSPARENT)
+				Num += Opaque ? pChunk->m_NumTransparent : pChunk->m_NumOpaque+pChunk->m_NumTransparent;
+
+			if(!Num)
+				continue;
+			if(DrawNum && DrawStart+DrawNum == Start)
+			{
+				DrawNum += Num;
+				continue;
+			}
+			Graphics()->RenderQuadBuffer(pBuffer->m_Buffer, DrawStart, DrawNum, DrawColor);
+			DrawStart = Start;
+			DrawNum = Num;
+		}
+	Graphics()->RenderQuadBuffer(pBuffer->m_Buffer, DrawStart, DrawNum, DrawColor);
+
+	// tiles stretched over the layer border aren't part of the buffer
+	if(RenderFlags&TILERENDERFLAG_EXTEND && (StartX < 0 || StartY < 0 || EndX > pBuffer->m_Width || EndY > pBuffer->m_Height))
+		RenderTilemap(pTiles, pBuffer->m_Width, pBuffer->m_Height, Scale, Color, RenderFlags|TILERENDERFLAG_EXTEND_ONLY, pfnEval, pUser, ColorEnv, ColorEnvOffset);
+}
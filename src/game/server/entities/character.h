@@ -123,6 +123,7 @@ private:
 
 	// info for dead reckoning
 	int m_ReckoningTick; // tick that we are performing dead reckoning From
+	int m_SpawnTick; // snapshots from before are not repeated from
 	CCharacterCore m_SendCore; // core that we should send
 	CCharacterCore m_ReckoningCore; // the dead reckoning core
 
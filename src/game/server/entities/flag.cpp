@@ -83,11 +83,13 @@ void CFlag::TickPaused()
 
 void CFlag::Snap(int SnappingClient)
 {
-	if(NetworkClipped(SnappingClient))
+	int Relevance = GameWorld()->NetworkRelevance(SnappingClient, m_Pos);
+	if(Relevance == CGameWorld::RELEVANCE_NONE)
 		return;
 
-	CNetObj_Flag *pFlag = (CNetObj_Flag *)Server()->SnapNewItem(NETOBJTYPE_FLAG, m_Team, sizeof(CNetObj_Flag));
-	if(!pFlag)
+	bool Repeated;
+	CNetObj_Flag *pFlag = (CNetObj_Flag *)GameWorld()->SnapNewItem(SnappingClient, Relevance, NETOBJTYPE_FLAG, m_Team, sizeof(CNetObj_Flag), 0, &Repeated);
+	if(!pFlag || Repeated)
 		return;
 
 	pFlag->m_X = (int)m_Pos.x;
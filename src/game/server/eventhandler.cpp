@@ -49,7 +49,15 @@ void CEventHandler::Snap(int SnappingClient)
 		if(SnappingClient == -1 || CmaskIsSet(m_aClientMasks[i], SnappingClient))
 		{
 			CNetEvent_Common *ev = (CNetEvent_Common *)&m_aData[m_aOffsets[i]];
-			if(SnappingClient == -1 || distance(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, vec2(ev->m_X, ev->m_Y)) < 1500.0f)
+			vec2 Pos = vec2(ev->m_X, ev->m_Y);
+			bool Relevant;
+			if(SnappingClient == -1)
+				Relevant = true;
+			else if(m_aTypes[i] == NETEVENTTYPE_SOUNDWORLD)
+				Relevant = distance(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, Pos) < 1500.0f; // the client's hearing range
+			else
+				Relevant = GameServer()->m_World.NetworkRelevance(SnappingClient, Pos) != CGameWorld::RELEVANCE_NONE;
+			if(Relevant)
 			{
 				void *d = GameServer()->Server()->SnapNewItem(m_aTypes[i], i, m_aSizes[i]);
 				if(d)
@@ -9,6 +9,8 @@
 
 #include <engine/shared/config.h>
 #include <engine/shared/memheap.h>
+#include <engine/shared/profiler.h>
+#include <engine/engine.h>
 #include <engine/map.h>
 
 #include <generated/server_data.h>
@@ -16,13 +18,6 @@
 #include <game/gamecore.h>
 #include <game/version.h>
 
-#if defined(CONF_FAMILY_UNIX)
-#include <fcntl.h>
-#include <sys/file.h>
-#include <unistd.h>
-#include <sys/stat.h>
-#endif
-
 #include "entities/character.h"
 #include "entities/projectile.h"
 #include "gamemodes/ctf.h"
@@ -57,12 +52,25 @@ void CGameContext::Construct(int Resetting)
 	m_LockTeams = 0;
 
 	if(Resetting==NO_RESET)
+	{
 		m_pVoteOptionHeap = new CHeap();
+		m_pStats = new CStatsService();
+	}
 
 	// solofng
 
-	m_StatSaveFails = 0;
-	m_StatSaveCriticalFails = 0;
+	m_ProfStatsIO = -1;
+	m_ProfTickStats = -1;
+	m_ProfTickWorld = -1;
+	m_ProfTickController = -1;
+	m_ProfTickPlayers = -1;
+	m_ProfTickVotes = -1;
+	m_ProfKillLog = -1;
+	m_pEngine = 0;
+	m_aPreloadMap[0] = 0;
+	m_PreloadSha256 = SHA256_ZEROED;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		m_aStatsRequests[i].m_Type = STATS_REQUEST_NONE;
 }
 
 CGameContext::CGameContext(int Resetting)
@@ -80,16 +88,25 @@ CGameContext::~CGameContext()
 	for(int i = 0; i < MAX_CLIENTS; i++)
 		delete m_apPlayers[i];
 	if(!m_Resetting)
+	{
 		delete m_pVoteOptionHeap;
+		// writes the queued round stats
+		delete m_pStats;
+	}
 }
 
 void CGameContext::Clear()
 {
 	CHeap *pVoteOptionHeap = m_pVoteOptionHeap;
+	CStatsService *pStats = m_pStats;
 	CVoteOptionServer *pVoteOptionFirst = m_pVoteOptionFirst;
 	CVoteOptionServer *pVoteOptionLast = m_pVoteOptionLast;
 	int NumVoteOptions = m_NumVoteOptions;
 	CTuningParams Tuning = m_Tuning;
+	CLayers PreloadLayers = m_PreloadLayers;
+	char aPreloadMap[sizeof(m_aPreloadMap)];
+	str_copy(aPreloadMap, m_aPreloadMap, sizeof(aPreloadMap));
+	SHA256_DIGEST PreloadSha256 = m_PreloadSha256;
 
 	m_Resetting = true;
 	this->~CGameContext();
@@ -97,10 +114,14 @@ void CGameContext::Clear()
 	new (this) CGameContext(RESET);
 
 	m_pVoteOptionHeap = pVoteOptionHeap;
+	m_pStats = pStats;
 	m_pVoteOptionFirst = pVoteOptionFirst;
 	m_pVoteOptionLast = pVoteOptionLast;
 	m_NumVoteOptions = NumVoteOptions;
 	m_Tuning = Tuning;
+	m_PreloadLayers = PreloadLayers;
+	str_copy(m_aPreloadMap, aPreloadMap, sizeof(m_aPreloadMap));
+	m_PreloadSha256 = PreloadSha256;
 }
 
 
@@ -567,32 +588,61 @@ void CGameContext::RankThreadTick()
 void CGameContext::SolofngTick()
 {
 	RankThreadTick();
+	m_pStats->m_Cache.Update();
+	m_pStats->m_RankIndex.Update();
+	m_pStats->m_Windows.Update();
+
+	for (int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CStatsRequest *pRequest = &m_aStatsRequests[i];
+		if (pRequest->m_Type != STATS_REQUEST_NONE && AnswerStatsRequest(i, pRequest->m_Type, pRequest->m_aName, time_get() > pRequest->m_Timeout))
+			pRequest->m_Type = STATS_REQUEST_NONE;
+	}
+
+	if (m_pEngine && Config()->m_SvStatsSnapshot[0] && time_get() > m_pStats->m_NextSnapshot)
+	{
+		m_pStats->m_SnapshotJob.Start(m_pEngine, Config()->m_SvStatsPath, Config()->m_SvStatsSnapshot);
+		m_pStats->m_NextSnapshot = time_get() + Config()->m_SvStatsSnapshotInterval*60*time_freq();
+	}
 }
 
 void CGameContext::OnTick()
 {
-	SolofngTick();
+	{
+		CProfiler::CScope Prof(Server()->Profiler(), m_ProfTickStats);
+		SolofngTick();
+	}
 
 	// check tuning
 	CheckPureTuning();
 
 	// copy tuning
 	m_World.m_Core.m_Tuning = m_Tuning;
-	m_World.Tick();
+	{
+		CProfiler::CScope Prof(Server()->Profiler(), m_ProfTickWorld);
+		m_World.Tick();
+	}
 
 	//if(world.paused) // make sure that the game object always updates
-	m_pController->Tick();
+	{
+		CProfiler::CScope Prof(Server()->Profiler(), m_ProfTickController);
+		m_pController->Tick();
+	}
 
-	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
-		if(m_apPlayers[i])
+		CProfiler::CScope Prof(Server()->Profiler(), m_ProfTickPlayers);
+		for(int i = 0; i < MAX_CLIENTS; i++)
 		{
-			m_apPlayers[i]->Tick();
-			m_apPlayers[i]->PostTick();
+			if(m_apPlayers[i])
+			{
+				m_apPlayers[i]->Tick();
+				m_apPlayers[i]->PostTick();
+			}
 		}
 	}
 
 	// update voting
+	CProfiler::CScope ProfVotes(Server()->Profiler(), m_ProfTickVotes);
 	if(m_VoteCloseTime)
 	{
 		// abort the kick-vote on player-leave
@@ -711,6 +761,9 @@ void CGameContext::OnClientPredictedInput(int ClientID, void *pInput)
 
 void CGameContext::OnClientEnter(int ClientID)
 {
+	if (Config()->m_SvStats)
+		m_pStats->m_Cache.Prefetch(Server()->ClientName(ClientID));
+
 	// send chat commands
 	SendChatCommands(ClientID);
 
@@ -816,7 +869,8 @@ void CGameContext::OnClientTeamChange(int ClientID)
 
 void CGameContext::OnClientDrop(int ClientID, const char *pReason)
 {
-	SaveStats(ClientID);
+	SaveStats(ClientID, true);
+	m_aStatsRequests[ClientID].m_Type = STATS_REQUEST_NONE;
 	AbortVoteOnDisconnect(ClientID);
 	m_pController->OnPlayerDisconnect(m_apPlayers[ClientID]);
 
@@ -1590,6 +1644,31 @@ void CGameContext::ConchainGameinfoUpdate(IConsole::IResult *pResult, void *pUse
 	}
 }
 
+void CGameContext::ConchainRankFormula(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	char aOld[sizeof(pSelf->Config()->m_SvRankFormula)];
+	str_copy(aOld, pSelf->Config()->m_SvRankFormula, sizeof(aOld));
+	pfnCallback(pResult, pCallbackUserData);
+	if(!pResult->NumArguments() || !str_comp(aOld, pSelf->Config()->m_SvRankFormula))
+		return;
+
+	char aError[128];
+	CRankFormula Formula;
+	if(!Formula.Compile(pSelf->Config()->m_SvRankFormula, aError, sizeof(aError)))
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "invalid rank formula: %s", aError);
+		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "stats", aBuf);
+		str_copy(pSelf->Config()->m_SvRankFormula, aOld, sizeof(pSelf->Config()->m_SvRankFormula));
+		return;
+	}
+	pSelf->m_RankFormula = Formula;
+	pSelf->m_pStats->m_RankIndex.SetFormula(Formula);
+	pSelf->m_pStats->m_Windows.SetFormula(Formula);
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "stats", "rank formula changed, rebuilding the ranking");
+}
+
 void CGameContext::OnConsoleInit()
 {
 	m_pServer = Kernel()->RequestInterface<IServer>();
@@ -1639,6 +1718,13 @@ void CGameContext::OnInit()
 	m_World.SetGameServer(this);
 	m_Events.SetGameServer(this);
 	m_CommandManager.Init(m_pConsole, this, NewCommandHook, RemoveCommandHook);
+	m_ProfStatsIO = Server()->Profiler()->RegisterZone("stats_io");
+	m_ProfTickStats = Server()->Profiler()->RegisterZone("tick_stats");
+	m_ProfTickWorld = Server()->Profiler()->RegisterZone("tick_world");
+	m_ProfTickController = Server()->Profiler()->RegisterZone("tick_controller");
+	m_ProfTickPlayers = Server()->Profiler()->RegisterZone("tick_players");
+	m_ProfTickVotes = Server()->Profiler()->RegisterZone("tick_votes");
+	m_ProfKillLog = Server()->Profiler()->RegisterZone("kill_log");
 
 	// HACK: only set static size for items, which were available in the first 0.7 release
 	// so new items don't break the snapshot delta
@@ -1646,7 +1732,15 @@ void CGameContext::OnInit()
 	for(int i = 0; i < OLD_NUM_NETOBJTYPES; i++)
 		Server()->SnapSetStaticsize(i, m_NetObjHandler.GetObjSize(i));
 
-	m_Layers.Init(Kernel());
+	// the layers of a preloaded map are ready, the collision pass only checks the game layer again
+	char aMap[64];
+	SHA256_DIGEST Sha256;
+	Server()->GetMapInfo(aMap, sizeof(aMap), &Sha256);
+	if(m_PreloadLayers.Map() && str_comp(m_aPreloadMap, aMap) == 0 && m_PreloadSha256 == Sha256)
+		m_Layers = m_PreloadLayers;
+	else
+		m_Layers.Init(Kernel());
+	OnMapPreloadDrop();
 	m_Collision.Init(&m_Layers);
 
 	// select gametype
@@ -1696,11 +1790,45 @@ void CGameContext::OnInit()
 	Console()->Chain("sv_scorelimit", ConchainGameinfoUpdate, this);
 	Console()->Chain("sv_timelimit", ConchainGameinfoUpdate, this);
 	Console()->Chain("sv_matches_per_map", ConchainGameinfoUpdate, this);
+	Console()->Chain("sv_rank_formula", ConchainRankFormula, this);
 
 	// clamp sv_player_slots to 0..MaxClients
 	if(Config()->m_SvMaxClients < Config()->m_SvPlayerSlots)
 		Config()->m_SvPlayerSlots = Config()->m_SvMaxClients;
 
+	// solofng
+
+	if (Config()->m_SvStats)
+		m_pEngine = Kernel()->RequestInterface<IEngine>();
+	// the stats service outlives the map, its settings are the ones of the first map with sv_stats
+	if (Config()->m_SvStats && !m_pStats->IsInited())
+	{
+		// the default journal is per port, so the servers of a host don't share it
+		char aJournal[1024];
+		str_copy(aJournal, Config()->m_SvStatsJournal, sizeof(aJournal));
+		if (str_comp(aJournal, "auto") == 0)
+		{
+			aJournal[0] = 0;
+			if (Config()->m_SvPort)
+			{
+				fs_makedir(Config()->m_SvStatsPath);
+				str_format(aJournal, sizeof(aJournal), "%s/journal_%d.dat", Config()->m_SvStatsPath, Config()->m_SvPort);
+			}
+		}
+		if (!aJournal[0] && Config()->m_SvSaveOnSignal)
+			dbg_msg("stats", "WARNING: no sv_stats_journal, the unsaved round stats are lost if the server crashes");
+		m_pStats->Init(m_pEngine, Config()->m_SvStatsPath, Config()->m_SvStatsFailPath, Config()->m_SvStatsServer, aJournal);
+	}
+	if (Config()->m_SvStats)
+	{
+		ReplayStatsJournal();
+		char aError[128];
+		if(!m_RankFormula.Compile(Config()->m_SvRankFormula, aError, sizeof(aError)))
+			dbg_msg("stats", "invalid rank formula, using the default: %s", aError);
+		m_pStats->m_RankIndex.Init(m_pEngine, Config()->m_SvStatsPath, m_RankFormula);
+		m_pStats->m_Windows.Init(m_pEngine, Config()->m_SvStatsPath, Config()->m_SvStatsSeasonStart, m_RankFormula);
+	}
+
 #ifdef CONF_DEBUG
 	// clamp dbg_dummies to 0..MAX_CLIENTS-1
 	if(MAX_CLIENTS <= Config()->m_DbgDummies)
@@ -1725,6 +1853,24 @@ void CGameContext::OnShutdown()
 	Clear();
 }
 
+void CGameContext::OnMapPreload(IMap *pMap, const char *pMapName, SHA256_DIGEST Sha256)
+{
+	// the server's preload job, only m_PreloadLayers may change here. layers
+	// and collision fix up the map data in place, which is the expensive part
+	m_PreloadLayers.Init(Kernel(), pMap);
+	CCollision Collision;
+	Collision.Init(&m_PreloadLayers);
+	str_copy(m_aPreloadMap, pMapName, sizeof(m_aPreloadMap));
+	m_PreloadSha256 = Sha256;
+}
+
+void CGameContext::OnMapPreloadDrop()
+{
+	m_PreloadLayers = CLayers();
+	m_aPreloadMap[0] = 0;
+	m_PreloadSha256 = SHA256_ZEROED;
+}
+
 void CGameContext::OnSnap(int ClientID)
 {
 	// add tuning to demo
@@ -1777,18 +1923,7 @@ bool CGameContext::IsClientSpectator(int ClientID) const
 
 void CGameContext::ShowStatsMeta(int ClientID, const char *pName)
 {
-	char aBuf[128];
-	char aName[64];
-	str_copy(aName, pName, sizeof(aName));
-	str_clean_whitespaces_simple(aName);
-	CFngStats Stats;
-	if (LoadStats(ClientID, aName, &Stats) != 0)
-	{
-		str_format(aBuf, sizeof(aBuf), "[stats] player '%s' not found.", aName);
-		SendChatTarget(ClientID, aBuf);
-		return;
-	}
-	PrintStatsMeta(ClientID, &Stats);
+	StartStatsRequest(ClientID, STATS_REQUEST_META, pName);
 }
 
 void CGameContext::PrintStatsMeta(int ClientID, const CFngStats *pStats)
@@ -1798,7 +1933,7 @@ void CGameContext::PrintStatsMeta(int ClientID, const CFngStats *pStats)
 	SendChatTarget(ClientID, aBuf);
 	str_format(aBuf, sizeof(aBuf), "Clan: %s", pStats->m_aClan);
 	SendChatTarget(ClientID, aBuf);
-	str_format(aBuf, sizeof(aBuf), "Config: %d", pStats->m_CfgFlags);
+	str_format(aBuf, sizeof(aBuf), "Config: %d", pStats->m_CfgFlags&~CFG_KNOWN);
 	SendChatTarget(ClientID, aBuf);
 	str_format(aBuf, sizeof(aBuf), "- hammertune: %s", pStats->m_CfgFlags&CFG_VANILLA_HAMMER ? "vanilla" : "fng");
 	SendChatTarget(ClientID, aBuf);
@@ -1863,18 +1998,7 @@ void CGameContext::ShowRoundStats(int ClientID, const char *pName)
 
 void CGameContext::ShowStats(int ClientID, const char *pName)
 {
-	char aBuf[128];
-	char aName[64];
-	str_copy(aName, pName, sizeof(aName));
-	str_clean_whitespaces_simple(aName);
-	CFngStats Stats;
-	if (LoadStats(ClientID, aName, &Stats) != 0)
-	{
-		str_format(aBuf, sizeof(aBuf), "[stats] player '%s' not found.", aName);
-		SendChatTarget(ClientID, aBuf);
-		return;
-	}
-	PrintStats(ClientID, &Stats);
+	StartStatsRequest(ClientID, STATS_REQUEST_STATS, pName);
 }
 
 /*
@@ -1952,7 +2076,7 @@ void CGameContext::TopThread(void *pArg)
 			free(pStats);
 			err = 1; goto end;
 		}
-		pStats->m_Tmp = pGS->CalcScore(pStats);
+		pStats->m_Tmp = pGS->m_RankThreadFormula.Score(pStats);
 		m_vpStats.push_back(pStats);
 		// dbg_msg("top_thread", "pushing back '%s' kills: %d", pStats->m_aName, pStats->m_Kills);
 	}
@@ -1977,7 +2101,7 @@ void CGameContext::TopThread(void *pArg)
 			str_format(
 				pGS->m_aRankThreadResult[row_index], sizeof(pGS->m_aRankThreadResult[row_index]),
 				"%lu. '%s' score %d",
-				i+1, m_vpStats[i]->m_aName, pGS->CalcScore(m_vpStats[i])
+				i+1, m_vpStats[i]->m_aName, pGS->m_RankThreadFormula.Score(m_vpStats[i])
 			);
 			row_index++;
 		}
@@ -1991,7 +2115,7 @@ void CGameContext::TopThread(void *pArg)
 			str_format(
 				pGS->m_aRankThreadResult[row_index], sizeof(pGS->m_aRankThreadResult[row_index]),
 				"%d. '%s' score %d",
-				r, m_vpStats[i]->m_aName, pGS->CalcScore(m_vpStats[i])
+				r, m_vpStats[i]->m_aName, pGS->m_RankThreadFormula.Score(m_vpStats[i])
 			);
 			row_index++;
 		}
@@ -2068,7 +2192,7 @@ void CGameContext::RankThread(void *pArg)
 			free(pStats);
 			err = 1; goto end;
 		}
-		pStats->m_Tmp = pGS->CalcScore(pStats);
+		pStats->m_Tmp = pGS->m_RankThreadFormula.Score(pStats);
 		m_vpStats.push_back(pStats);
 		// dbg_msg("rank_thread", "pushing back '%s' kills: %d", pStats->m_aName, pStats->m_Kills);
 	}
@@ -2091,7 +2215,7 @@ void CGameContext::RankThread(void *pArg)
 		}
 	}
 
-	Score = pGS->CalcScore(&Stats);
+	Score = pGS->m_RankThreadFormula.Score(&Stats);
 	str_format(pGS->m_aRankThreadResult[0], sizeof(pGS->m_aRankThreadResult[0]), "%d. '%s' score %d (requested by '%s')",
 		Rank, pGS->m_aRankThreadName, Score, pGS->m_aRankThreadRequestName);
 
@@ -2102,8 +2226,37 @@ void CGameContext::RankThread(void *pArg)
 	pGS->m_RankThreadState = err ? RT_ERR : RT_DONE;
 }
 
-void CGameContext::ShowTopScore(int ClientID, int Top)
+void CGameContext::ShowTopScore(int ClientID, int Top, int Window)
 {
+	if (Window != -1)
+	{
+		ShowWindowTopScore(ClientID, Top, Window);
+		return;
+	}
+	if (m_pStats->m_RankIndex.IsReady())
+	{
+		// same rows as TopThread, negative tops count from the worst
+		int Start = maximum(Top-1, 0);
+		if (Top < 0)
+		{
+			Start = m_pStats->m_RankIndex.NumEntries() + Top - 4;
+			if (Start < 0)
+			{
+				SendChatTarget(ClientID, "[stats] argument too low");
+				return;
+			}
+		}
+		char aBuf[128];
+		SendChatTarget(ClientID, "----------- Top 5 -----------");
+		for (int i = Start; i < Start+5 && i < m_pStats->m_RankIndex.NumEntries(); i++)
+		{
+			const CRankIndex::CEntry *pEntry = m_pStats->m_RankIndex.Entry(i);
+			str_format(aBuf, sizeof(aBuf), "%d. '%s' score %d", i+1, pEntry->m_aName, pEntry->m_Score);
+			SendChatTarget(ClientID, aBuf);
+		}
+		SendChatTarget(ClientID, "-------------------------------");
+		return;
+	}
 	if (m_RankThreadState != RT_IDLE)
 	{
 		SendChatTarget(ClientID, "[stats] rank is currently being requested try agian later.");
@@ -2113,6 +2266,7 @@ void CGameContext::ShowTopScore(int ClientID, int Top)
 	m_RankThreadTop = Top;
 	m_RankThreadReqID =  ClientID;
 	m_RankThreadType = TYPE_TOP;
+	m_RankThreadFormula = m_RankFormula;
 	for (int i = 0; i < 5; i++)
 		m_aRankThreadResult[i][0] = '\0';
 	void *pt = thread_init(TopThread, this);
@@ -2120,24 +2274,75 @@ void CGameContext::ShowTopScore(int ClientID, int Top)
 		SendChatTarget(ClientID, "[stats] failed to spawn thread.");
 }
 
+void CGameContext::ShowWindowTopScore(int ClientID, int Top, int Window)
+{
+	char aBuf[128];
+	if (!m_pStats->m_Windows.HasWindow(Window))
+	{
+		str_format(aBuf, sizeof(aBuf), "[stats] there is no %s leaderboard.", CStatsWindows::WindowName(Window));
+		SendChatTarget(ClientID, aBuf);
+		return;
+	}
+	if (!m_pStats->m_Windows.IsReady())
+	{
+		SendChatTarget(ClientID, "[stats] leaderboards are being built try again later.");
+		return;
+	}
+	const int NumEntries = m_pStats->m_Windows.NumEntries(Window);
+	int Start = maximum(Top-1, 0);
+	if (Top < 0)
+	{
+		Start = NumEntries + Top - 4;
+		if (Start < 0)
+		{
+			SendChatTarget(ClientID, "[stats] argument too low");
+			return;
+		}
+	}
+	str_format(aBuf, sizeof(aBuf), "----------- Top 5 (%s) -----------", CStatsWindows::WindowName(Window));
+	SendChatTarget(ClientID, aBuf);
+	for (int i = Start; i < Start+5 && i < NumEntries; i++)
+	{
+		const CStatsWindows::CEntry *pEntry = m_pStats->m_Windows.Entry(Window, i);
+		str_format(aBuf, sizeof(aBuf), "%d. '%s' score %d", i+1, pEntry->m_aName, pEntry->m_Score);
+		SendChatTarget(ClientID, aBuf);
+	}
+	SendChatTarget(ClientID, "-------------------------------");
+}
+
 void CGameContext::ShowRank(int ClientID, const char *pName)
 {
+	char aName[64];
+	str_copy(aName, pName, sizeof(aName));
+	str_clean_whitespaces_simple(aName);
+	if (m_pStats->m_RankIndex.IsReady())
+	{
+		char aBuf[128];
+		int Rank = m_pStats->m_RankIndex.Find(aName);
+		if (Rank == -1)
+		{
+			str_format(aBuf, sizeof(aBuf), "[stats] player '%s' is not ranked yet.", aName);
+			SendChatTarget(ClientID, aBuf);
+			return;
+		}
+		str_format(aBuf, sizeof(aBuf), "%d. '%s' score %d (requested by '%s')",
+			Rank+1, aName, m_pStats->m_RankIndex.Entry(Rank)->m_Score, Server()->ClientName(ClientID));
+		SendChat(-1, CHAT_ALL, -1, aBuf);
+		return;
+	}
 	if (m_RankThreadState != RT_IDLE)
 	{
 		SendChatTarget(ClientID, "[stats] rank is currently being requested try agian later.");
 		return;
 	}
 	m_RankThreadState = RT_ACTIVE;
-	char aName[64];
-	str_copy(aName, pName, sizeof(aName));
-	str_clean_whitespaces_simple(aName);
-
 	m_RankThreadTop = 0;
 	m_RankThreadReqID = ClientID;
 	m_RankThreadType = TYPE_RANK;
 	str_copy(m_aRankThreadResult[0], "[stats] something went wrong.", sizeof(m_aRankThreadResult[0]));
 	str_copy(m_aRankThreadName, aName, sizeof(m_aRankThreadName));
 	str_copy(m_aRankThreadRequestName, Server()->ClientName(ClientID), sizeof(m_aRankThreadRequestName));
+	m_RankThreadFormula = m_RankFormula;
 	void *pt = thread_init(RankThread, this);
 	if (!pt)
 		SendChatTarget(ClientID, "[stats] failed to spawn thread.");
@@ -2145,149 +2350,123 @@ void CGameContext::ShowRank(int ClientID, const char *pName)
 
 int CGameContext::CalcScore(const CFngStats *pStats)
 {
-	int Score = 0;
-	Score += pStats->m_Freezes;
-	Score += pStats->m_Kills * 3;
-	Score += pStats->m_GoldSpikes * 5;
-	Score += pStats->m_GreenSpikes * 3;
-	Score += pStats->m_PurpleSpikes * 7;
-	return Score;
+	return m_RankFormula.Score(pStats);
 }
 
 void CGameContext::MergeStats(const CFngStats *pFrom, CFngStats *pTo)
 {
-	str_copy(pTo->m_aName, pFrom->m_aName, sizeof(pTo->m_aName));
-	str_copy(pTo->m_aClan, pFrom->m_aClan, sizeof(pTo->m_aClan));
-	pTo->m_Kills += pFrom->m_Kills;
-	pTo->m_Deaths += pFrom->m_Deaths;
-	pTo->m_GoldSpikes += pFrom->m_GoldSpikes;
-	pTo->m_GreenSpikes += pFrom->m_GreenSpikes;
-	pTo->m_PurpleSpikes += pFrom->m_PurpleSpikes;
-	pTo->m_RifleShots += pFrom->m_RifleShots;
-	pTo->m_Freezes += pFrom->m_Freezes;
-	pTo->m_Frozen += pFrom->m_Frozen;
-	pTo->m_Spree = pFrom->m_Spree;
-	pTo->m_SpreeBest = maximum(pTo->m_SpreeBest, pFrom->m_SpreeBest);
-	pTo->m_Multi = pFrom->m_Multi;
-	pTo->m_MultiBest = maximum(pTo->m_MultiBest, pFrom->m_MultiBest);
-	for (int i = 0; i < MAX_MULTIS; i++)
-		pTo->m_aMultis[i] += pFrom->m_aMultis[i];
-	pTo->m_CfgFlags = pFrom->m_CfgFlags;
-	pTo->m_LastSeen = maximum(pTo->m_LastSeen, pFrom->m_LastSeen);
-	pTo->m_TotalOnlineTime += pFrom->m_TotalOnlineTime;
+	MergeFngStats(pFrom, pTo);
 }
 
-bool CGameContext::SaveStats(int ClientID, bool Failed)
+bool CGameContext::SaveStats(int ClientID, bool Leaving)
 {
 	if (!Config()->m_SvStats)
 		return false;
 	CPlayer *pPlayer = m_apPlayers[ClientID];
 	if (!pPlayer)
 		return false;
-	char aFilename[MAX_FILE_LEN];
-	if (escape_filename(aFilename, sizeof(aFilename), Server()->ClientName(ClientID)))
+	CProfiler::CScope ProfStats(Server()->Profiler(), m_ProfStatsIO);
+	// the rank index gets the record when the write is done
+	return pPlayer->SaveStats(Leaving);
+}
+
+void CGameContext::ReplayStatsJournal()
+{
+	int Saved = m_pStats->ReplayJournal();
+	if (Saved)
+		dbg_msg("stats", "queued round stats of %d players from the journal", Saved);
+}
+
+int CGameContext::LoadStats(int ClientID, const char *pName, CFngStats *pStatsBuf)
+{
+	if (!Config()->m_SvStats)
+		return -1;
+	int err = m_pStats->m_pBackend->Load(pName, pStatsBuf);
+	if (ClientID == -1 || err == 0 || err == 1) // expected error when stats do not exist yet
+		return err;
+	if (err == -2)
+		SendChatTarget(ClientID, "[stats] load failed: escape error.");
+	else
 	{
-		SendChatTarget(ClientID,
-			Failed ?
-			"[stats] save failed: escape error." :
-			"[stats] recover save failed: escape error." // should be impossible to reach
-		);
-		return false;
+		char aBuf[128];
+		str_format(aBuf, sizeof(aBuf), "[stats] load failed: error=%d name='%s'", err, pName);
+		SendChatTarget(ClientID, aBuf);
 	}
-	char aFilePath[2048];
-	str_format(aFilePath, sizeof(aFilePath), "%s/%s.acc", Failed ? Config()->m_SvStatsFailPath : Config()->m_SvStatsPath, aFilename);
-	return pPlayer->SaveStats(aFilePath, Failed);
+	return err;
 }
 
-bool CGameContext::IsFngMagic(const char *pMagic, int Size)
+int CGameContext::LoadStatsCached(const char *pName, CFngStats *pStatsBuf)
 {
-	if (Size < FNG_MAGIC_LEN)
-		return false;
-	for (int i = 0; i < FNG_MAGIC_LEN; i++)
+	if (!Config()->m_SvStats)
+		return -1;
+	int err = 0;
+	int State = m_pStats->m_Cache.Get(pName, pStatsBuf, &err);
+	if (State == CStatsCache::STATE_LOADED)
+		return 0;
+	if (State == CStatsCache::STATE_MISSING)
+		return 1;
+	if (State == CStatsCache::STATE_FAILED)
 	{
-		if (FNG_MAGIC[i] != pMagic[i])
-			return false;
+		// reported once, the next request reads the file again
+		m_pStats->m_Cache.Invalidate(pName);
+		return err;
 	}
-	return true;
+	m_pStats->m_Cache.Prefetch(pName);
+	return -3;
 }
 
-bool CGameContext::IsFngVersion(const char *pVersion, int Size)
+bool CGameContext::AnswerStatsRequest(int ClientID, int Type, const char *pName, bool TimedOut)
 {
-	if (Size < FNG_VERSION_LEN)
+	CFngStats Stats;
+	int err = LoadStatsCached(pName, &Stats);
+	if (err == -3 && !TimedOut)
 		return false;
-	for (int i = 0; i < FNG_VERSION_LEN; i++)
+	if (err == 0)
 	{
-		if (FNG_VERSION[i] != pVersion[i])
-			return false;
+		if (Type == STATS_REQUEST_META)
+			PrintStatsMeta(ClientID, &Stats);
+		else
+			PrintStats(ClientID, &Stats);
+		return true;
 	}
+	char aBuf[128];
+	if (err == -2)
+		str_copy(aBuf, "[stats] load failed: escape error.", sizeof(aBuf));
+	else if (err == -3)
+		str_format(aBuf, sizeof(aBuf), "[stats] loading '%s' timed out.", pName);
+	else if (err > 1)
+		str_format(aBuf, sizeof(aBuf), "[stats] load failed: error=%d name='%s'", err, pName);
+	else
+		str_format(aBuf, sizeof(aBuf), "[stats] player '%s' not found.", pName);
+	SendChatTarget(ClientID, aBuf);
 	return true;
 }
 
-int CGameContext::LoadStats(int ClientID, const char *pName, CFngStats *pStatsBuf)
+void CGameContext::StartStatsRequest(int ClientID, int Type, const char *pName)
 {
-	if (!Config()->m_SvStats)
-		return -1;
-	char aFilename[MAX_FILE_LEN];
-	if (escape_filename(aFilename, sizeof(aFilename), pName))
-	{
-		if (ClientID != -1)
-			SendChatTarget(ClientID, "[stats] load failed: escape error.");
-		return -2;
-	}
-	char aFilePath[MAX_FILE_PATH];
-	str_format(aFilePath, sizeof(aFilePath), "%s/%s.acc", Config()->m_SvStatsPath, aFilename);
-	return LoadStatsFile(ClientID, aFilePath, pStatsBuf);
+	if (ClientID < 0 || ClientID >= MAX_CLIENTS)
+		return;
+	CStatsRequest *pRequest = &m_aStatsRequests[ClientID];
+	str_copy(pRequest->m_aName, pName, sizeof(pRequest->m_aName));
+	str_clean_whitespaces_simple(pRequest->m_aName);
+	// uncached records are loaded in the background, SolofngTick answers then
+	pRequest->m_Type = AnswerStatsRequest(ClientID, Type, pRequest->m_aName, false) ? (int)STATS_REQUEST_NONE : Type;
+	pRequest->m_Timeout = time_get() + STATS_REQUEST_TIMEOUT*time_freq();
 }
 
 int CGameContext::LoadStatsFile(int ClientID, const char *pPath, CFngStats *pStatsBuf)
 {
 	if (!Config()->m_SvStats)
 		return -1;
-	int err = 0;
-	FILE *pFile;
-	pFile = fopen(pPath, "rb");
-	if (!pFile)
-	{
+	int err = ReadStatsFile(pPath, pStatsBuf);
+	if (err == 1)
 		dbg_msg("load", "failed to load file '%s' errno=%d", pPath, errno); // TODO: remove
-		err = 1; goto fail;
-	}
-	char aMagic[4];
-	if (!fread(&aMagic, sizeof(aMagic), 1, pFile))
+	if (err && err != 1 && ClientID != -1) // expected error when stats do not exist yet
 	{
 		char aBuf[128];
-		str_format(aBuf, sizeof(aBuf), "magic='%s'", aMagic);
-		if (ClientID != -1)
-			SendChatTarget(ClientID, aBuf);
-		err = 2; goto fail;
-	}
-	if (!IsFngMagic(aMagic, sizeof(aMagic)))
-	{
-		dbg_msg("stats", "file error magic missmatch '%s' != 'FNG'", aMagic);
-		err = 3; goto fail;
-	}
-	char aVersion[16];
-	str_copy(aVersion, FNG_VERSION, sizeof(aVersion));
-	if (!fread(&aVersion, sizeof(aVersion), 1, pFile))
-	{
-		err = 4; goto fail;
-	}
-	if (!IsFngVersion(aVersion, sizeof(aVersion)))
-	{
-		dbg_msg("stats", "file error version missmatch '%s' != '%s'", aVersion, FNG_VERSION);
-		err = 5; goto fail;
-	}
-	if (!fread(pStatsBuf, sizeof(*pStatsBuf), 1, pFile))
-	{
-		err = 6; goto fail;
-	}
-	if(fclose(pFile))
-		dbg_msg("load", "failed to close file '%s' errno=%d", pPath, errno);
-	return 0;
-	fail:
-	char aBuf[128];
-	str_format(aBuf, sizeof(aBuf), "[stats] load failed: file error=%d path='%s'", err, pPath);
-	if (err != 1 && ClientID != -1) // expected error when stats do not exist yet
+		str_format(aBuf, sizeof(aBuf), "[stats] load failed: file error=%d path='%s'", err, pPath);
 		SendChatTarget(ClientID, aBuf);
+	}
 	return err;
 }
 
@@ -2337,8 +2516,22 @@ int CGameContext::TestSaveStats()
 	return 0;
 }
 
+enum
+{
+	// failed stats that one MergeFailedStats saves
+	MAX_FAILED_MERGES=128,
+};
+
+// a file in the fail path, locked until its stats are saved
+struct CFailedStatsFile
+{
+	char m_aPath[MAX_FILE_PATH];
+	int m_Lock;
+};
+
 void CGameContext::MergeFailedStats(int ClientID)
 {
+	CProfiler::CScope ProfStats(Server()->Profiler(), m_ProfStatsIO);
 	DIR *pDir;
 	struct dirent *pDe;
 	int total = 0;
@@ -2350,111 +2543,57 @@ void CGameContext::MergeFailedStats(int ClientID)
 		SendChatTarget(ClientID, "[stats] failed to open directory.");
 		return;
 	}
-	while ((pDe = readdir(pDir)) != NULL)
+	// the failed stats are saved in one batch, the files stay locked until then
+	// because the stats cache could be merging a failed save into them
+	std::vector<CStatsSave> vSaves;
+	std::vector<CFailedStatsFile> vFiles;
+	while ((pDe = readdir(pDir)) != NULL && vSaves.size() < MAX_FAILED_MERGES)
 	{
-		if (str_endswith(pDe->d_name, ".lck"))
-		{
-			dbg_msg("merge_stats", "file '%s' is locked by write.", pDe->d_name);
-			// err = 1; goto end;
-			continue;
-		}
-		if (!str_comp(pDe->d_name, ".") || !str_comp(pDe->d_name, ".."))
-		{
-			// printf("ignore '%s'.\n", pDe->d_name);
-			continue;
-		}
 		if (!str_endswith(pDe->d_name, ".acc"))
-		{
-			// printf("warning not a .acc file '%s'.\n", pDe->d_name);
 			continue;
-		}
 		total++;
-		char aFilePath[2048];
-		char aSavePath[2048];
-		str_format(aFilePath, sizeof(aFilePath), "%s/%s", Config()->m_SvStatsFailPath, pDe->d_name);
-		str_format(aSavePath, sizeof(aSavePath), "%s/%s", Config()->m_SvStatsPath, pDe->d_name);
-		// printf("load stats '%s' '%s' ... \n", pDe->d_name, aFilePath);
-		CFngStats Stats;
-		int load = LoadStatsFile(-1, aFilePath, &Stats);
-		if (load)
+		CFailedStatsFile File;
+		str_format(File.m_aPath, sizeof(File.m_aPath), "%s/%s", Config()->m_SvStatsFailPath, pDe->d_name);
+		File.m_Lock = LockStatsFile(File.m_aPath);
+		if (File.m_Lock < 0)
 		{
-			dbg_msg("merge_stats", "file '%s' failed to load with err=%d", aFilePath, load);
-			// err = 1; goto end;
+			dbg_msg("merge_stats", "file '%s' is locked by write.", File.m_aPath);
 			continue;
 		}
-		CFngStats *pMergeStats;
-		CFngStats FileStats;
-		bool HasStast = LoadStatsFile(-1, aSavePath, &FileStats) == 0;
-		if (!HasStast)
-		{
-			// just copy failed stats over
-			pMergeStats = &Stats;
-		}
-		else
-		{
-			MergeStats(&Stats, &FileStats);
-			pMergeStats = &FileStats;
-		}
-
-		FILE *pFile;
-	#if defined(CONF_FAMILY_UNIX)
-		int fd;
-		struct stat st0, st1;
-		pFile = fopen(aSavePath, "wb");
-		if(!pFile)
+		CStatsSave Save;
+		int load = LoadStatsFile(-1, File.m_aPath, &Save.m_Round);
+		if (load)
 		{
-			dbg_msg("stats_merge", "save failed: file open '%s' errno=%d", aSavePath, errno);
+			dbg_msg("merge_stats", "file '%s' failed to load with err=%d", File.m_aPath, load);
+			UnlockStatsFile(File.m_aPath, File.m_Lock);
 			continue;
 		}
-		char aLockPath[2048+4];
-		str_format(aLockPath, sizeof(aLockPath), "%s.lck", aSavePath);
-		int trys = 0;
-		int max_trys = 16;
-		// lock file code by user2769258 and Arnaud Le Blanc
-		// https://stackoverflow.com/a/18745264
-		// Not portable! E.g. on Windows st_ino is always 0. – rustyx Nov 8 '17 at 18:35
-		// Windows has own lock system (note by ChillerDragon)
-		while(1)
-		{
-			trys++;
-			fd = open(aLockPath, O_CREAT, S_IRUSR|S_IWUSR);
-			flock(fd, LOCK_EX);
-
-			fstat(fd, &st0);
-			stat(aLockPath, &st1);
-			if(st0.st_ino == st1.st_ino) break;
+		str_copy(Save.m_aName, Save.m_Round.m_aName, sizeof(Save.m_aName));
+		Save.m_JournalSlot = -1;
+		Save.m_HasMerged = false;
+		Save.m_Result = CStatsSave::RESULT_OK;
+		vSaves.push_back(Save);
+		vFiles.push_back(File);
+	}
+	closedir(pDir);
 
-			dbg_msg("stats_merge", "wait for locked file %d/%d...", trys, max_trys);
-			close(fd);
-			if (trys > max_trys)
+	if (!vSaves.empty())
+		m_pStats->m_pBackend->Save(&vSaves[0], vSaves.size());
+	for (unsigned i = 0; i < vSaves.size(); i++)
+	{
+		if (vSaves[i].m_Result == CStatsSave::RESULT_OK)
+		{
+			merged++;
+			m_pStats->m_Cache.Invalidate(vSaves[i].m_aName);
+			dbg_msg("merge_stats", "saved failed stats of '%s'", vSaves[i].m_aName);
+			if (remove(vFiles[i].m_aPath))
 			{
-				pFile = NULL;
-				dbg_msg("stats_merge", "save failed: file locked '%s'", aSavePath);
-				continue;
+				dbg_msg("merge_stats", "error: failed to remove stats file! '%s'", vFiles[i].m_aPath);
+				exit(1);
 			}
 		}
-	#endif
-		fwrite(&FNG_MAGIC, sizeof(FNG_MAGIC), 1, pFile);
-		fwrite(&FNG_VERSION, sizeof(FNG_VERSION), 1, pFile);
-		fwrite(pMergeStats, sizeof(*pMergeStats), 1, pFile);
-		if(fclose(pFile))
-		{
-			dbg_msg("stats_merge", "save failed: file close '%s' errno=%d", aSavePath, errno);
-			continue;
-		}
-	#if defined(CONF_FAMILY_UNIX)
-		unlink(aLockPath);
-		flock(fd, LOCK_UN);
-	#endif
-		merged++;
-		dbg_msg("merge_stats", "saved stats to file '%s' (%s)", aSavePath, HasStast ? "merge" : "new");
-		if (remove(aFilePath))
-		{
-			dbg_msg("merge_stats", "error: failed to remove stats file! '%s'", aFilePath);
-			exit(1);
-		}
+		UnlockStatsFile(vFiles[i].m_aPath, vFiles[i].m_Lock);
 	}
-	closedir(pDir);
 	char aBuf[128];
 	str_format(aBuf, sizeof(aBuf), "[stats] merged %d/%d failed stats to main database.", merged, total);
 	SendChatTarget(ClientID, aBuf);
@@ -2534,5 +2673,7 @@ const char *CGameContext::Version() const { return GAME_VERSION; }
 const char *CGameContext::NetVersion() const { return GAME_NETVERSION; }
 const char *CGameContext::NetVersionHashUsed() const { return GAME_NETVERSION_HASH_FORCED; }
 const char *CGameContext::NetVersionHashReal() const { return GAME_NETVERSION_HASH; }
+const char *CGameContext::GetItemName(int Type) const { return m_NetObjHandler.GetObjName(Type); }
+const char *CGameContext::GetMsgName(int Type) const { return m_NetObjHandler.GetMsgName(Type); }
 
 IGameServer *CreateGameServer() { return new CGameContext; }
@@ -43,6 +43,11 @@ class CGameContext : public IGameServer
 	class IConsole *m_pConsole;
 	CLayers m_Layers;
 	CCollision m_Collision;
+	// layers of the map the server preloaded, see OnMapPreload. only valid
+	// for the map with this name and sha256
+	CLayers m_PreloadLayers;
+	char m_aPreloadMap[64];
+	SHA256_DIGEST m_PreloadSha256;
 	CNetObjHandler m_NetObjHandler;
 	CTuningParams m_Tuning;
 
@@ -80,6 +85,7 @@ public:
 	class CConfig *Config() { return m_pConfig; }
 	class IConsole *Console() { return m_pConsole; }
 	CCollision *Collision() { return &m_Collision; }
+	CLayers *Layers() { return &m_Layers; }
 	CTuningParams *Tuning() { return &m_Tuning; }
 
 	CGameContext();
@@ -175,6 +181,8 @@ public:
 	virtual void OnInit();
 	virtual void OnConsoleInit();
 	virtual void OnShutdown();
+	virtual void OnMapPreload(class IMap *pMap, const char *pMapName, SHA256_DIGEST Sha256);
+	virtual void OnMapPreloadDrop();
 
 	virtual void OnTick();
 	virtual void OnPreSnap();
@@ -201,11 +209,11 @@ public:
 	virtual const char *NetVersion() const;
 	virtual const char *NetVersionHashUsed() const;
 	virtual const char *NetVersionHashReal() const;
+	virtual const char *GetItemName(int Type) const;
+	virtual const char *GetMsgName(int Type) const;
 
 	// solofng
 
-	int m_StatSaveFails;
-	int m_StatSaveCriticalFails;
 	void RankThreadTick();
 	void SolofngTick();
 	static void RankThread(void *pArg);
@@ -227,23 +235,58 @@ public:
 	char m_aRankThreadResult[5][128];
 	int m_RankThreadState;
 	void *m_pRankThread;
+	int m_ProfStatsIO; // profiler zone of the stats file access
+	// profiler zones of the parts of a tick, the entity types have their own in the world
+	int m_ProfTickStats;
+	int m_ProfTickWorld;
+	int m_ProfTickController;
+	int m_ProfTickPlayers;
+	int m_ProfTickVotes;
+	int m_ProfKillLog; // the kill line on the console, inside the entity ticks
+	// survives Clear() like the vote option heap
+	CStatsService *m_pStats;
+	enum
+	{
+		STATS_REQUEST_NONE=0,
+		STATS_REQUEST_STATS,
+		STATS_REQUEST_META,
+		// seconds a chat command waits for the stats record
+		STATS_REQUEST_TIMEOUT=10,
+	};
+	// a chat command that waits for the stats record to be loaded
+	struct CStatsRequest
+	{
+		int m_Type;
+		char m_aName[64];
+		int64 m_Timeout;
+	};
+	CStatsRequest m_aStatsRequests[MAX_CLIENTS];
+	// returns false while the record is loading and TimedOut is not set
+	bool AnswerStatsRequest(int ClientID, int Type, const char *pName, bool TimedOut);
+	void StartStatsRequest(int ClientID, int Type, const char *pName);
+	CRankFormula m_RankFormula;
+	CRankFormula m_RankThreadFormula; // copy for the running rank thread
+	static void ConchainRankFormula(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	class IEngine *m_pEngine; // only set with sv_stats
+	// saves the round stats a crashed server or the last map left in the journal
+	void ReplayStatsJournal();
 	void PrintStats(int ClientID, const CFngStats *pStats);
-	bool IsFngMagic(const char *pMagic, int Size);
-	bool IsFngVersion(const char *pVersion, int Size);
 	void MergeStats(const CFngStats *pFrom, CFngStats *pTo);
 	/*
 		Function: SaveStats
-			Merges round stats with stats file
-			And then deletes the round stats
+			Merges round stats with the cached stats record,
+			queues the write to the stats file
+			and then deletes the round stats
 
 		Parameters:
 			ClientID - id of stats player
-			Failed - is this a recover attempt of a failed stat save
+			Leaving - the client drops, no new round stats are started
 	*/
-	bool SaveStats(int ClientID, bool Failed = false);
+	bool SaveStats(int ClientID, bool Leaving = false);
 	/*
 	Function: LoadStats
-		Loads fng stats from file
+		Loads fng stats from file, blocks on the stats backend.
+		Only used by the rank thread, see LoadStatsCached
 
 	Parameters:
 		ClientID - id to print result messages to
@@ -262,6 +305,9 @@ public:
 		 6 - failed to read stats struct
 	*/
 	int LoadStats(int ClientID, const char *pName, CFngStats *pStatsBuf);
+	// same as LoadStats but never reads on the calling thread. answers from the stats
+	// cache and starts loading records that are not cached, -3 while they load
+	int LoadStatsCached(const char *pName, CFngStats *pStatsBuf);
 	int LoadStatsFile(int ClientID, const char *pPath, CFngStats *pStatsBuf);
 	/*
 		Function: ShowStats
@@ -302,7 +348,9 @@ public:
 			pName - unescaped ingame name of stats player
 	*/
 	void ShowRank(int ClientID, const char *pName);
-	void ShowTopScore(int ClientID, int Top = 1);
+	// Window is one of CStatsWindows::WINDOW_* or -1 for all time
+	void ShowTopScore(int ClientID, int Top = 1, int Window = -1);
+	void ShowWindowTopScore(int ClientID, int Top, int Window);
 	int CalcScore(const CFngStats *pStats);
 	int TestSavePath(const char *pPath);
 	int TestSaveStats();
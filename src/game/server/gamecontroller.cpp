@@ -615,6 +615,10 @@ void IGameController::SetGameState(EGameState GameState, int Timer)
 			m_GameStateTimer = Timer*Server()->TickSpeed();
 			m_SuddenDeath = 0;
 			GameServer()->m_World.m_Paused = true;
+
+			// the rotation may have changed since the match started
+			if(GameState == IGS_END_MATCH && m_MatchCount >= m_GameInfo.m_MatchNum-1)
+				PreloadNextMap();
 		}
 	}
 }
@@ -627,6 +631,10 @@ void IGameController::StartMatch()
 	m_aTeamscore[TEAM_RED] = 0;
 	m_aTeamscore[TEAM_BLUE] = 0;
 
+	// the last match on this map, get the next one ready meanwhile
+	if(m_MatchCount >= m_GameInfo.m_MatchNum-1)
+		PreloadNextMap();
+
 	// start countdown if there're enough players, otherwise do warmup till there're
 	if(HasEnoughPlayers())
 		SetGameState(IGS_START_COUNTDOWN);
@@ -914,6 +922,7 @@ static bool IsSeparator(char c) { return c == ';' || c == ' ' || c == ',' || c =
 void IGameController::ChangeMap(const char *pToMap)
 {
 	str_copy(m_aMapWish, pToMap, sizeof(m_aMapWish));
+	PreloadNextMap();
 
 	m_MatchCount = m_GameInfo.m_MatchNum-1;
 	if(m_GameState == IGS_WARMUP_GAME || m_GameState == IGS_WARMUP_USER)
@@ -927,20 +936,16 @@ void IGameController::ChangeMap(const char *pToMap)
 	}
 }
 
-void IGameController::CycleMap()
+// the map CycleMap changes to, false if there is none
+bool IGameController::NextMap(char *pMapName, int Size) const
 {
 	if(m_aMapWish[0] != 0)
 	{
-		char aBuf[256];
-		str_format(aBuf, sizeof(aBuf), "rotating map to %s", m_aMapWish);
-		GameServer()->Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "game", aBuf);
-		str_copy(Config()->m_SvMap, m_aMapWish, sizeof(Config()->m_SvMap));
-		m_aMapWish[0] = 0;
-		m_MatchCount = 0;
-		return;
+		str_copy(pMapName, m_aMapWish, Size);
+		return true;
 	}
 	if(!str_length(Config()->m_SvMaprotation))
-		return;
+		return false;
 
 	// handle maprotation
 	const char *pMapRotation = Config()->m_SvMaprotation;
@@ -988,12 +993,29 @@ void IGameController::CycleMap()
 	while(IsSeparator(aBuf[i]))
 		i++;
 
+	str_copy(pMapName, &aBuf[i], Size);
+	return true;
+}
+
+void IGameController::PreloadNextMap()
+{
+	char aMapName[128];
+	if(NextMap(aMapName, sizeof(aMapName)))
+		Server()->PreloadMap(aMapName);
+}
+
+void IGameController::CycleMap()
+{
+	char aMapName[128];
+	if(!NextMap(aMapName, sizeof(aMapName)))
+		return;
+	m_aMapWish[0] = 0;
 	m_MatchCount = 0;
 
-	char aBufMsg[256];
-	str_format(aBufMsg, sizeof(aBufMsg), "rotating map to %s", &aBuf[i]);
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "rotating map to %s", aMapName);
 	GameServer()->Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "game", aBuf);
-	str_copy(Config()->m_SvMap, &aBuf[i], sizeof(Config()->m_SvMap));
+	str_copy(Config()->m_SvMap, aMapName, sizeof(Config()->m_SvMap));
 }
 
 // spawn
@@ -1252,8 +1274,18 @@ void IGameController::Com_Top5(IConsole::IResult *pResult, void *pContext)
 		pSelf->GameServer()->SendChatTarget(pComContext->m_ClientID, "[stats] deactivated by admin.");
 		return;
 	}
-	int Top = atoi(pComContext->m_pArgs);
-	pSelf->GameServer()->ShowTopScore(pComContext->m_ClientID, Top);
+	// "/top5 week 6" shows the places 6 to 10 of this week
+	int Window = -1;
+	int Top = 0;
+	if(pResult->NumArguments() > 0)
+	{
+		Window = CStatsWindows::FindWindow(pResult->GetString(0));
+		if(Window == -1)
+			Top = pResult->GetInteger(0);
+		else if(pResult->NumArguments() > 1)
+			Top = pResult->GetInteger(1);
+	}
+	pSelf->GameServer()->ShowTopScore(pComContext->m_ClientID, Top, Window);
 }
 
 void IGameController::Com_Rank(IConsole::IResult *pResult, void *pContext)
@@ -1389,10 +1421,10 @@ void IGameController::Com_Admin(IConsole::IResult *pResult, void *pContext)
 		pSelf->GameServer()->SendChatTarget(ClientID, "missing permission.");
 		return;
 	}
-	if(pSelf->GameServer()->m_StatSaveFails || pSelf->GameServer()->m_StatSaveCriticalFails)
+	if(pSelf->GameServer()->m_pStats->m_Cache.m_SaveFails || pSelf->GameServer()->m_pStats->m_Cache.m_CriticalSaveFails)
 	{
 		char aBuf[128];
-		str_format(aBuf, sizeof(aBuf), "[stats] fails: %d critical fails: %d", pSelf->GameServer()->m_StatSaveFails, pSelf->GameServer()->m_StatSaveCriticalFails);
+		str_format(aBuf, sizeof(aBuf), "[stats] fails: %d critical fails: %d", pSelf->GameServer()->m_pStats->m_Cache.m_SaveFails, pSelf->GameServer()->m_pStats->m_Cache.m_CriticalSaveFails);
 		pSelf->GameServer()->SendChatTarget(ClientID, aBuf);
 	}
 	else
@@ -1440,7 +1472,7 @@ void IGameController::RegisterChatCommands(CCommandManager *pManager)
 	pManager->AddCommand("info", "info about the server", "", Com_Help, this);
 	pManager->AddCommand("cmdlist", "info about sever commands", "", Com_Cmdlist, this);
 	pManager->AddCommand("stats", "show stats", "?r", Com_Stats, this);
-	pManager->AddCommand("top5", "show global top player scores", "?i", Com_Top5, this);
+	pManager->AddCommand("top5", "show global top player scores, optionally of today, week or season", "?s?i", Com_Top5, this);
 	pManager->AddCommand("rank", "show players global rank", "?r", Com_Rank, this);
 	pManager->AddCommand("save", "save current round stats", "", Com_Save, this);
 	pManager->AddCommand("round", "show current round stats", "?s", Com_Round, this);
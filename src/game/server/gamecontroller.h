@@ -69,6 +69,8 @@ class IGameController
 	// map
 	char m_aMapWish[128];
 
+	bool NextMap(char *pMapName, int Size) const;
+	void PreloadNextMap();
 	void CycleMap();
 
 	// spawn
@@ -1,11 +1,17 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 
+#include <algorithm>
+
+#include <engine/shared/config.h>
+#include <engine/shared/profiler.h>
+
 #include "entities/character.h"
 #include "entity.h"
 #include "gamecontext.h"
 #include "gamecontroller.h"
 #include "gameworld.h"
+#include "player.h"
 
 
 //////////////////////////////////////////////////
@@ -20,7 +26,15 @@ CGameWorld::CGameWorld()
 	m_Paused = false;
 	m_ResetRequested = false;
 	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
 		m_apFirstEntityTypes[i] = 0;
+		m_aProfTick[i] = -1;
+		m_aProfSnap[i] = -1;
+	}
+	m_ProfTickDefered = -1;
+	m_ProfTickCleanup = -1;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		m_aSnapCount[i] = 0;
 }
 
 CGameWorld::~CGameWorld()
@@ -36,6 +50,21 @@ void CGameWorld::SetGameServer(CGameContext *pGameServer)
 	m_pGameServer = pGameServer;
 	m_pConfig = m_pGameServer->Config();
 	m_pServer = m_pGameServer->Server();
+
+	m_ProfTickDefered = Server()->Profiler()->RegisterZone("tick_defered");
+	m_ProfTickCleanup = Server()->Profiler()->RegisterZone("tick_cleanup");
+
+	static const char *s_apEntTypeNames[NUM_ENTTYPES] = { "projectile", "laser", "pickup", "character", "flag" };
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		char aName[CProfiler::MAX_ZONE_NAME];
+		str_format(aName, sizeof(aName), "tick_%s", s_apEntTypeNames[i]);
+		m_aProfTick[i] = Server()->Profiler()->RegisterZone(aName);
+#if defined(CONF_PROFILE_ENTITIES)
+		str_format(aName, sizeof(aName), "snap_%s", s_apEntTypeNames[i]);
+		m_aProfSnap[i] = Server()->Profiler()->RegisterZone(aName);
+#endif
+	}
 }
 
 CEntity *CGameWorld::FindFirst(int Type)
@@ -109,13 +138,32 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 //
 void CGameWorld::Snap(int SnappingClient)
 {
+	// the world is snapped first, the far items of the whole snapshot get their budget here
+	if(SnappingClient != -1)
+	{
+		int Budget = Config()->m_SvSnapBudget ? Config()->m_SvSnapBudget : -1;
+		m_aSnapCount[SnappingClient]++;
+
+		// the server lowers it for clients on bad links
+		int LinkBudget = Server()->SnapBudget(SnappingClient);
+		if(LinkBudget != -1 && (Budget == -1 || LinkBudget < Budget))
+			Budget = LinkBudget;
+
+		m_aFarItems[SnappingClient].Prepare(m_aSnapCount[SnappingClient], Config()->m_SvSnapFarInterval, &Budget);
+	}
+
 	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+#if defined(CONF_PROFILE_ENTITIES)
+		CProfiler::CScope Prof(Server()->Profiler(), m_aProfSnap[i]);
+#endif
 		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 			pEnt->Snap(SnappingClient);
 			pEnt = m_pNextTraverseEntity;
 		}
+	}
 }
 
 void CGameWorld::PostSnap()
@@ -129,6 +177,144 @@ void CGameWorld::PostSnap()
 		}
 }
 
+int CGameWorld::NetworkRelevance(int SnappingClient, vec2 CheckPos)
+{
+	if(SnappingClient == -1)
+		return RELEVANCE_NEAR;
+	return RelevanceAt(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, CheckPos);
+}
+
+int CGameWorld::RelevanceAt(vec2 ViewPos, vec2 CheckPos)
+{
+	float dx = absolute(ViewPos.x-CheckPos.x);
+	float dy = absolute(ViewPos.y-CheckPos.y);
+
+	// the client shows at most 1500x1050 at the default zoom
+	if(dx <= 900.0f && dy <= 650.0f)
+		return RELEVANCE_NEAR;
+
+	if(dx > 1000.0f || dy > 800.0f || distance(ViewPos, CheckPos) > 1100.0f)
+		return RELEVANCE_NONE;
+	return RELEVANCE_FAR;
+}
+
+void CGameWorld::CFarItems::Prepare(int SnapCount, int Interval, int *pBudget)
+{
+	m_SnapCount = SnapCount;
+
+	// forget the items that left the far area
+	int NumItems = 0;
+	for(int i = 0; i < m_NumItems; i++)
+	{
+		if(m_aItems[i].m_LastSeen >= SnapCount-1)
+			m_aItems[NumItems++] = m_aItems[i];
+	}
+	m_NumItems = NumItems;
+	std::sort(m_aItems, m_aItems+m_NumItems, CompareKey);
+	m_NumSorted = m_NumItems;
+
+	// the due items, the ones refreshed longest ago first
+	int aDue[MAX_ITEMS];
+	int NumDue = 0;
+	for(int i = 0; i < m_NumItems; i++)
+	{
+		m_aItems[i].m_Granted = false;
+		if(SnapCount - m_aItems[i].m_LastRefresh < Interval)
+			continue;
+		int j = NumDue++;
+		for(; j > 0 && m_aItems[aDue[j-1]].m_LastRefresh > m_aItems[i].m_LastRefresh; j--)
+			aDue[j] = aDue[j-1];
+		aDue[j] = i;
+	}
+
+	// near items don't count against the budget, smaller items can still fit after a big one didn't
+	for(int i = 0; i < NumDue; i++)
+	{
+		CItem *pItem = &m_aItems[aDue[i]];
+		if(*pBudget != -1)
+		{
+			if(*pBudget < pItem->m_Size)
+				continue;
+			*pBudget -= pItem->m_Size;
+		}
+		pItem->m_Granted = true;
+	}
+}
+
+CGameWorld::CFarItems::CItem *CGameWorld::CFarItems::Find(int Key)
+{
+	CItem Search;
+	Search.m_Key = Key;
+	CItem *pItem = std::lower_bound(m_aItems, m_aItems+m_NumSorted, Search, CompareKey);
+	if(pItem != m_aItems+m_NumSorted && pItem->m_Key == Key)
+		return pItem;
+
+	// the ones added in this snapshot
+	for(int i = m_NumSorted; i < m_NumItems; i++)
+	{
+		if(m_aItems[i].m_Key == Key)
+			return &m_aItems[i];
+	}
+	return 0;
+}
+
+bool CGameWorld::CFarItems::Refresh(int Type, int ID, int Size, int Interval)
+{
+	CItem *pItem = Find((Type<<16)|ID);
+	if(!pItem)
+	{
+		if(m_NumItems == MAX_ITEMS)
+			return true;
+
+		// the item was near or not in the snapshot before, start its turns staggered
+		pItem = &m_aItems[m_NumItems++];
+		pItem->m_Key = (Type<<16)|ID;
+		pItem->m_Size = Size;
+		pItem->m_LastRefresh = m_SnapCount - (Type+ID)%Interval;
+		pItem->m_LastSeen = m_SnapCount;
+		pItem->m_Granted = false;
+		return false;
+	}
+
+	pItem->m_Size = Size;
+	pItem->m_LastSeen = m_SnapCount;
+	if(!pItem->m_Granted)
+		return false;
+	pItem->m_Granted = false;
+	pItem->m_LastRefresh = m_SnapCount;
+	return true;
+}
+
+void CGameWorld::CFarItems::Refreshed(int Type, int ID)
+{
+	CItem *pItem = Find((Type<<16)|ID);
+	if(pItem)
+	{
+		pItem->m_Granted = false;
+		pItem->m_LastRefresh = m_SnapCount;
+	}
+}
+
+void *CGameWorld::SnapNewItem(int SnappingClient, int Relevance, int Type, int ID, int Size, int ValidSince, bool *pRepeated)
+{
+	*pRepeated = false;
+	if(SnappingClient != -1 && Relevance == RELEVANCE_FAR)
+	{
+		if(!m_aFarItems[SnappingClient].Refresh(Type, ID, Size, Config()->m_SvSnapFarInterval))
+		{
+			void *pItem = Server()->SnapRepeatItem(SnappingClient, Type, ID, Size, ValidSince);
+			if(pItem)
+			{
+				*pRepeated = true;
+				return pItem;
+			}
+			m_aFarItems[SnappingClient].Refreshed(Type, ID);
+		}
+	}
+
+	return Server()->SnapNewItem(Type, ID, Size);
+}
+
 void CGameWorld::Reset()
 {
 	// reset all entities
@@ -166,19 +352,26 @@ void CGameWorld::RemoveEntities()
 void CGameWorld::Tick()
 {
 	if(m_ResetRequested)
+	{
+		CProfiler::CScope Prof(Server()->Profiler(), m_ProfTickCleanup);
 		Reset();
+	}
 
 	if(!m_Paused)
 	{
 		// update all objects
 		for(int i = 0; i < NUM_ENTTYPES; i++)
+		{
+			CProfiler::CScope Prof(Server()->Profiler(), m_aProfTick[i]);
 			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 				pEnt->Tick();
 				pEnt = m_pNextTraverseEntity;
 			}
+		}
 
+		CProfiler::CScope Prof(Server()->Profiler(), m_ProfTickDefered);
 		for(int i = 0; i < NUM_ENTTYPES; i++)
 			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 			{
@@ -199,6 +392,7 @@ void CGameWorld::Tick()
 			}
 	}
 
+	CProfiler::CScope Prof(Server()->Profiler(), m_ProfTickCleanup);
 	RemoveEntities();
 }
 
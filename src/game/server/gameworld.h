@@ -26,6 +26,80 @@ public:
 		NUM_ENTTYPES
 	};
 
+	enum
+	{
+		RELEVANCE_NONE=0,
+		RELEVANCE_FAR,
+		RELEVANCE_NEAR,
+	};
+
+	/*
+		Class: CFarItems
+			The far items of one client and when they were last
+			refreshed. At the start of a snapshot the due items are
+			granted the budget, most stale first, items which didn't
+			fit stay due and go first in the next snapshot.
+	*/
+	class CFarItems
+	{
+	public:
+		enum
+		{
+			// the characters, player infos and flags
+			MAX_ITEMS=2*MAX_CLIENTS+8,
+		};
+
+		CFarItems() { Reset(); }
+		void Reset() { m_NumItems = 0; m_NumSorted = 0; m_SnapCount = 0; }
+
+		/*
+			Function: Prepare
+				Starts a snapshot. Forgets the items that weren't in
+				the last one and grants the budget to the due ones.
+
+			Arguments:
+				SnapCount - Snapshots sent to the client so far.
+				Interval - Snapshots between the refreshes of an item.
+				pBudget - Bytes left for this snapshot, -1 for no limit.
+		*/
+		void Prepare(int SnapCount, int Interval, int *pBudget);
+
+		/*
+			Function: Refresh
+				Decides if a far item gets fresh data in this snapshot.
+				Items seen for the first time are staggered by type and
+				id and repeat their data from before.
+
+			Returns:
+				True if the item is refreshed, false if it repeats.
+		*/
+		bool Refresh(int Type, int ID, int Size, int Interval);
+
+		/*
+			Function: Refreshed
+				Marks an item as refreshed after it couldn't repeat.
+		*/
+		void Refreshed(int Type, int ID);
+
+	private:
+		struct CItem
+		{
+			int m_Key;
+			int m_Size;
+			int m_LastRefresh;
+			int m_LastSeen;
+			bool m_Granted;
+		};
+
+		static bool CompareKey(const CItem &a, const CItem &b) { return a.m_Key < b.m_Key; }
+		CItem *Find(int Key);
+
+		CItem m_aItems[MAX_ITEMS];
+		int m_NumItems;
+		int m_NumSorted;
+		int m_SnapCount;
+	};
+
 private:
 	void Reset();
 	void RemoveEntities();
@@ -37,6 +111,15 @@ private:
 	class CConfig *m_pConfig;
 	class IServer *m_pServer;
 
+	int m_aSnapCount[MAX_CLIENTS];
+	CFarItems m_aFarItems[MAX_CLIENTS];
+
+	// profiler zones of the tick and snap of each entity type, the snap ones only in the bench
+	int m_aProfTick[NUM_ENTTYPES];
+	int m_aProfSnap[NUM_ENTTYPES];
+	int m_ProfTickDefered;
+	int m_ProfTickCleanup; // reset and removal of the entities
+
 public:
 	class CGameContext *GameServer() { return m_pGameServer; }
 	class CConfig *Config() { return m_pConfig; }
@@ -141,6 +224,48 @@ public:
 	
 	void PostSnap();
 
+	/*
+		Function: NetworkRelevance
+			Rates how relevant a position is for a client. Near positions
+			are on the client's screen, far ones just around it.
+
+		Arguments:
+			SnappingClient - ID of the client which snapshot is
+				being generated, -1 for demo recording.
+			CheckPos - Position to rate.
+
+		Returns:
+			RELEVANCE_NONE if the position doesn't have to be in the
+			snapshot, RELEVANCE_FAR or RELEVANCE_NEAR otherwise.
+	*/
+	int NetworkRelevance(int SnappingClient, vec2 CheckPos);
+
+	/*
+		Function: RelevanceAt
+			Rates a position against the position a client views,
+			see NetworkRelevance.
+	*/
+	static int RelevanceAt(vec2 ViewPos, vec2 CheckPos);
+
+	/*
+		Function: SnapNewItem
+			Creates a snapshot item for an object of the given relevance.
+			Far items are only refreshed every sv_snap_far_interval
+			snapshots and while the client's sv_snap_budget lasts, else
+			they repeat the data from the client's last snapshot, see
+			CFarItems.
+
+		Arguments:
+			ValidSince - Tick the object's current data starts at,
+				older snapshots are not repeated from.
+			pRepeated - Set when the item holds repeated data and
+				must not be filled again.
+
+		Returns:
+			The item or 0 if it couldn't be created.
+	*/
+	void *SnapNewItem(int SnappingClient, int Relevance, int Type, int ID, int Size, int ValidSince, bool *pRepeated);
+
 	/*
 		Function: tick
 			Calls tick on all the entities in the world to progress
@@ -3,6 +3,7 @@
 
 #include "stdio.h"
 #include "errno.h"
+#include <engine/shared/config.h>
 #include <game/version.h>
 #include "entities/character.h"
 #include "entities/flag.h"
@@ -11,18 +12,12 @@
 
 #include "player.h"
 
-#if defined(CONF_FAMILY_UNIX)
-#include <fcntl.h>
-#include <sys/file.h>
-#include <unistd.h>
-#include <sys/stat.h>
-#endif
-
 MACRO_ALLOC_POOL_ID_IMPL(CPlayer, MAX_CLIENTS)
 
 IServer *CPlayer::Server() const { return m_pGameServer->Server(); }
 
 CPlayer::CPlayer(CGameContext *pGameServer, int ClientID, bool Dummy, bool AsSpec)
+: m_RoundStats(*pGameServer->m_pStats->m_Journal.Stats(ClientID))
 {
 	m_pGameServer = pGameServer;
 	m_RespawnTick = Server()->Tick();
@@ -47,6 +42,7 @@ CPlayer::CPlayer(CGameContext *pGameServer, int ClientID, bool Dummy, bool AsSpe
 	// solofng
 
 	m_InitedRoundStats = false;
+	m_CfgFlagsLoaded = false;
 	m_JoinTime = time(NULL);
 }
 
@@ -84,6 +80,31 @@ void CPlayer::Tick()
 		}
 	}
 
+	// keep the journal current, a crash saves the stats with it
+	if(m_InitedRoundStats && Server()->Tick()%Server()->TickSpeed() == 0)
+	{
+		m_RoundStats.m_TotalOnlineTime = time(NULL) - m_JoinTime;
+		m_RoundStats.m_LastSeen = time(NULL);
+
+		// the stats record is loaded in the background
+		if(!m_CfgFlagsLoaded)
+		{
+			CFngStats Stats;
+			int State = GameServer()->m_pStats->m_Cache.Get(Server()->ClientName(m_ClientID), &Stats);
+			if(State == CStatsCache::STATE_EMPTY)
+				GameServer()->m_pStats->m_Cache.Prefetch(Server()->ClientName(m_ClientID));
+			else
+			{
+				// a failed load leaves them unknown, the save keeps what the record has
+				if(State == CStatsCache::STATE_LOADED)
+					m_RoundStats.m_CfgFlags = Stats.m_CfgFlags|CFG_KNOWN;
+				else if(State == CStatsCache::STATE_MISSING)
+					m_RoundStats.m_CfgFlags |= CFG_KNOWN;
+				m_CfgFlagsLoaded = true;
+			}
+		}
+	}
+
 	if(m_pCharacter && !m_pCharacter->IsAlive())
 	{
 		delete m_pCharacter;
@@ -154,8 +175,15 @@ void CPlayer::Snap(int SnappingClient)
 	if(!IsDummy() && !Server()->ClientIngame(m_ClientID))
 		return;
 
-	CNetObj_PlayerInfo *pPlayerInfo = static_cast<CNetObj_PlayerInfo *>(Server()->SnapNewItem(NETOBJTYPE_PLAYERINFO, m_ClientID, sizeof(CNetObj_PlayerInfo)));
-	if(!pPlayerInfo)
+	// players off the client's screen only need a scoreboard entry, refresh it less often
+	int Relevance = CGameWorld::RELEVANCE_NEAR;
+	if(SnappingClient != -1 && SnappingClient != m_ClientID &&
+		(!GetCharacter() || GameServer()->m_World.NetworkRelevance(SnappingClient, GetCharacter()->GetPos()) != CGameWorld::RELEVANCE_NEAR))
+		Relevance = CGameWorld::RELEVANCE_FAR;
+
+	bool Repeated;
+	CNetObj_PlayerInfo *pPlayerInfo = static_cast<CNetObj_PlayerInfo *>(GameServer()->m_World.SnapNewItem(SnappingClient, Relevance, NETOBJTYPE_PLAYERINFO, m_ClientID, sizeof(CNetObj_PlayerInfo), 0, &Repeated));
+	if(!pPlayerInfo || Repeated)
 		return;
 
 	pPlayerInfo->m_PlayerFlags = m_PlayerFlags&PLAYERFLAG_CHATTING;
@@ -491,13 +519,15 @@ void CPlayer::TryRespawn()
 void CPlayer::SetConfig(int Cfg)
 {
 	InitRoundStats();
-	m_RoundStats.m_CfgFlags |= Cfg;
+	m_CfgFlagsLoaded = true;
+	m_RoundStats.m_CfgFlags |= Cfg|CFG_KNOWN;
 }
 
 void CPlayer::UnsetConfig(int Cfg)
 {
 	InitRoundStats();
-	m_RoundStats.m_CfgFlags &= ~(Cfg);
+	m_CfgFlagsLoaded = true;
+	m_RoundStats.m_CfgFlags = (m_RoundStats.m_CfgFlags&~Cfg)|CFG_KNOWN;
 }
 
 bool CPlayer::IsConfig(int Cfg)
@@ -606,11 +636,19 @@ void CPlayer::InitRoundStats()
 	if (m_InitedRoundStats)
 		return;
 	m_InitedRoundStats = true;
+	// no file access on the tick, Tick() takes the config flags once the record is loaded
 	CFngStats Stats;
-	bool HasStats = true;
-	if (GameServer()->LoadStats(-1, Server()->ClientName(m_ClientID), &Stats) != 0)
-		HasStats = false;
-	dbg_msg("stats", "init round stats ClientID=%d HasStats=%d", m_ClientID, HasStats);
+	int State = GameServer()->Config()->m_SvStats ? GameServer()->m_pStats->m_Cache.Get(Server()->ClientName(m_ClientID), &Stats) : CStatsCache::STATE_MISSING;
+	m_CfgFlagsLoaded = State != CStatsCache::STATE_EMPTY;
+	dbg_msg("stats", "init round stats ClientID=%d State=%d", m_ClientID, State);
+	if(State == CStatsCache::STATE_LOADED)
+		ResetRoundStats(Stats.m_CfgFlags|CFG_KNOWN);
+	else
+		ResetRoundStats(State == CStatsCache::STATE_MISSING ? CFG_KNOWN : 0);
+}
+
+void CPlayer::ResetRoundStats(int CfgFlags)
+{
 	// mem_zero probably redundants all the explicit 0 intializations but what ever
 	mem_zero(&m_RoundStats, sizeof(m_RoundStats));
 	str_copy(m_RoundStats.m_aName, Server()->ClientName(m_ClientID), sizeof(m_RoundStats.m_aName));
@@ -633,97 +671,37 @@ void CPlayer::InitRoundStats()
 		m_RoundStats.m_aMultis[i] = 0;
 	}
 	m_RoundStats.m_Tmp = 0;
-	m_RoundStats.m_CfgFlags = 0;
-	if (HasStats)
-		m_RoundStats.m_CfgFlags = Stats.m_CfgFlags;
+	m_RoundStats.m_CfgFlags = CfgFlags;
 	m_RoundStats.m_Unused2 = 0;
 	m_RoundStats.m_FirstSeen = 0;
 	m_RoundStats.m_LastSeen = time(NULL);
+	GameServer()->m_pStats->m_Journal.SetUsed(m_ClientID, true);
 }
 
-bool CPlayer::SaveStats(const char *pFilePath, bool Failed)
+bool CPlayer::SaveStats(bool Leaving)
 {
 	InitRoundStats();
 	// 'foo's killingspree was ended by 'foo'
 	// disconnect, round end etc is basically a selfkill
 	HandleSpreeDeath(Server()->ClientName(m_ClientID));
-	CFngStats *pMergeStats;
-	CFngStats FileStats;
 	m_RoundStats.m_TotalOnlineTime = time(NULL) - m_JoinTime;
-	bool HasStast = GameServer()->LoadStats(m_ClientID, Server()->ClientName(m_ClientID), &FileStats) == 0;
-	if (!HasStast)
+	// the stats file is written in the background, see CStatsCache
+	if (!GameServer()->m_pStats->m_Cache.Save(Server()->ClientName(m_ClientID), &m_RoundStats))
 	{
-		// just write round stats to file
-		m_RoundStats.m_FirstSeen = time(NULL);
-		pMergeStats = &m_RoundStats;
-	}
-	else
-	{
-		GameServer()->MergeStats(&m_RoundStats, &FileStats);
-		pMergeStats = &FileStats;
-	}
-
-	FILE *pFile;
-#if defined(CONF_FAMILY_UNIX)
-	int fd;
-	struct stat st0, st1;
-	pFile = fopen(pFilePath, "wb");
-	if(!pFile)
-	{
-		dbg_msg("stats", "save failed: file open '%s' errno=%d", pFilePath, errno);
-		GameServer()->SendChatTarget(m_ClientID, "[stats] save failed.");
+		GameServer()->SendChatTarget(m_ClientID, "[stats] save failed: escape error.");
 		return false;
 	}
-	char aLockPath[2048+4];
-	str_format(aLockPath, sizeof(aLockPath), "%s.lck", pFilePath);
-	int trys = 0;
-	int max_trys = 16;
-	// lock file code by user2769258 and Arnaud Le Blanc
-	// https://stackoverflow.com/a/18745264
-	// Not portable! E.g. on Windows st_ino is always 0. – rustyx Nov 8 '17 at 18:35
-	// Windows has own lock system (note by ChillerDragon)
-	while(1)
+	GameServer()->m_pStats->m_Windows.OnSave(&m_RoundStats);
+	dbg_msg("stats", "queued save ClientID=%d name='%s'", m_ClientID, Server()->ClientName(m_ClientID));
+	// the queued save has its own journal slot now
+	m_JoinTime = time(NULL); // the online time until now is saved
+	if (Leaving)
 	{
-		trys++;
-		fd = open(aLockPath, O_CREAT, S_IRUSR|S_IWUSR);
-		flock(fd, LOCK_EX);
-
-		fstat(fd, &st0);
-		stat(aLockPath, &st1);
-		if(st0.st_ino == st1.st_ino) break;
-
-		dbg_msg("stats", "wait for locked file %d/%d...", trys, max_trys);
-		close(fd);
-		if (trys > max_trys)
-		{
-			dbg_msg("stats", "error: locked file (trys %d/%d) failed=%d path='%s'", trys, max_trys, Failed, aLockPath);
-			pFile = NULL;
-			GameServer()->m_StatSaveFails++;
-			if (Failed)
-			{
-				GameServer()->m_StatSaveCriticalFails++;
-				GameServer()->SendChatTarget(m_ClientID, "[stats] save failed: file locked.");
-				return false;
-			}
-			return GameServer()->SaveStats(m_ClientID, true);
-		}
+		m_InitedRoundStats = false;
+		GameServer()->m_pStats->m_Journal.SetUsed(m_ClientID, false);
+		return true;
 	}
-#endif
-	fwrite(&FNG_MAGIC, sizeof(FNG_MAGIC), 1, pFile);
-	fwrite(&FNG_VERSION, sizeof(FNG_VERSION), 1, pFile);
-	fwrite(pMergeStats, sizeof(*pMergeStats), 1, pFile);
-	if(fclose(pFile))
-	{
-		dbg_msg("stats", "save failed: file close '%s' errno=%d", pFilePath, errno);
-		GameServer()->SendChatTarget(m_ClientID, "[stats] save failed.");
-		return false;
-	}
-#if defined(CONF_FAMILY_UNIX)
-	unlink(aLockPath);
-	flock(fd, LOCK_UN);
-#endif
-	dbg_msg("stats", "saved ClientID=%d to file '%s' (%s)", m_ClientID, pFilePath, HasStast ? "merge" : "new");
-	m_InitedRoundStats = false;
-	InitRoundStats(); // Refresh/Delete round stats
+	// Refresh/Delete round stats, the config stays
+	ResetRoundStats(m_RoundStats.m_CfgFlags);
 	return true;
 }
@@ -142,7 +142,8 @@ private:
 
 	// should never be written to directly
 	// make sure InitRoundStats() is called first
-	CFngStats m_RoundStats;
+	// lives in the stats journal slot of the client, see CStatsJournal
+	CFngStats &m_RoundStats;
 
 public:
 
@@ -150,8 +151,11 @@ public:
 	time_t m_JoinTime;
 	const CFngStats *GetRoundStats() { return &m_RoundStats; }
 	bool m_InitedRoundStats;
+	// the config flags of the stats record are in the round stats
+	bool m_CfgFlagsLoaded;
 	void InitRoundStats();
-	bool SaveStats(const char *pFilePath, bool Failed = false);
+	void ResetRoundStats(int CfgFlags);
+	bool SaveStats(bool Leaving = false);
 
 	void SetConfig(int Cfg);
 	void UnsetConfig(int Cfg);
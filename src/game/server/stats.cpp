@@ -1 +1,2046 @@
 // TODO: move crap from player.cpp and gamecontext.cpp here
+#include <stdio.h>
+#include <errno.h>
+#include <algorithm>
+#include <vector>
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/engine.h>
+#include <game/version.h>
+#include <statssrv/statssrv.h>
+
+#if defined(CONF_FAMILY_UNIX)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(CONF_SIMD_SSE2)
+	#include <emmintrin.h>
+#elif defined(CONF_SIMD_NEON)
+	#include <arm_neon.h>
+#endif
+
+#include "stats.h"
+
+int ReadStatsFile(const char *pPath, CFngStats *pStats)
+{
+	FILE *pFile = fopen(pPath, "rb");
+	if (!pFile)
+		return 1;
+	int err = 0;
+	char aMagic[FNG_MAGIC_LEN];
+	char aVersion[FNG_VERSION_LEN];
+	if (!fread(&aMagic, sizeof(aMagic), 1, pFile))
+		err = 2;
+	else if (mem_comp(aMagic, FNG_MAGIC, sizeof(aMagic)))
+	{
+		dbg_msg("stats", "file error magic missmatch '%.4s' != 'FNG'", aMagic);
+		err = 3;
+	}
+	else if (!fread(&aVersion, sizeof(aVersion), 1, pFile))
+		err = 4;
+	else if (mem_comp(aVersion, FNG_VERSION, sizeof(aVersion)))
+	{
+		dbg_msg("stats", "file error version missmatch '%.16s' != '%s'", aVersion, FNG_VERSION);
+		err = 5;
+	}
+	else if (!fread(pStats, sizeof(*pStats), 1, pFile))
+		err = 6;
+	if (fclose(pFile))
+		dbg_msg("load", "failed to close file '%s' errno=%d", pPath, errno);
+	return err;
+}
+
+bool WriteStatsFile(const char *pPath, const CFngStats *pStats)
+{
+	FILE *pFile = fopen(pPath, "wb");
+	if (!pFile)
+	{
+		dbg_msg("stats", "save failed: file open '%s' errno=%d", pPath, errno);
+		return false;
+	}
+	fwrite(&FNG_MAGIC, sizeof(FNG_MAGIC), 1, pFile);
+	fwrite(&FNG_VERSION, sizeof(FNG_VERSION), 1, pFile);
+	fwrite(pStats, sizeof(*pStats), 1, pFile);
+	if (fclose(pFile))
+	{
+		dbg_msg("stats", "save failed: file close '%s' errno=%d", pPath, errno);
+		return false;
+	}
+	return true;
+}
+
+int LockStatsFile(const char *pPath)
+{
+#if defined(CONF_FAMILY_UNIX)
+	char aLockPath[MAX_FILE_PATH+4];
+	str_format(aLockPath, sizeof(aLockPath), "%s.lck", pPath);
+	// same lock file dance as CPlayer::SaveStats, the lock file
+	// could have been unlinked by its last owner while we waited
+	for (int trys = 1; trys <= 16; trys++)
+	{
+		int fd = open(aLockPath, O_CREAT, S_IRUSR|S_IWUSR);
+		if (fd < 0)
+			return -1;
+		flock(fd, LOCK_EX);
+		struct stat st0, st1;
+		fstat(fd, &st0);
+		if (stat(aLockPath, &st1) == 0 && st0.st_ino == st1.st_ino)
+			return fd;
+		dbg_msg("stats", "wait for locked file %d/16...", trys);
+		close(fd);
+	}
+	return -1;
+#else
+	return 0;
+#endif
+}
+
+void UnlockStatsFile(const char *pPath, int Lock)
+{
+#if defined(CONF_FAMILY_UNIX)
+	char aLockPath[MAX_FILE_PATH+4];
+	str_format(aLockPath, sizeof(aLockPath), "%s.lck", pPath);
+	unlink(aLockPath);
+	flock(Lock, LOCK_UN);
+	close(Lock);
+#endif
+}
+
+void MergeFngStats(const CFngStats *pFrom, CFngStats *pTo)
+{
+	str_copy(pTo->m_aName, pFrom->m_aName, sizeof(pTo->m_aName));
+	str_copy(pTo->m_aClan, pFrom->m_aClan, sizeof(pTo->m_aClan));
+	pTo->m_Kills += pFrom->m_Kills;
+	pTo->m_Deaths += pFrom->m_Deaths;
+	pTo->m_GoldSpikes += pFrom->m_GoldSpikes;
+	pTo->m_GreenSpikes += pFrom->m_GreenSpikes;
+	pTo->m_PurpleSpikes += pFrom->m_PurpleSpikes;
+	pTo->m_RifleShots += pFrom->m_RifleShots;
+	pTo->m_Freezes += pFrom->m_Freezes;
+	pTo->m_Frozen += pFrom->m_Frozen;
+	pTo->m_Spree = pFrom->m_Spree;
+	pTo->m_SpreeBest = maximum(pTo->m_SpreeBest, pFrom->m_SpreeBest);
+	pTo->m_Multi = pFrom->m_Multi;
+	pTo->m_MultiBest = maximum(pTo->m_MultiBest, pFrom->m_MultiBest);
+	for (int i = 0; i < MAX_MULTIS; i++)
+		pTo->m_aMultis[i] += pFrom->m_aMultis[i];
+	if(pFrom->m_CfgFlags&CFG_KNOWN)
+		pTo->m_CfgFlags = pFrom->m_CfgFlags;
+	pTo->m_LastSeen = maximum(pTo->m_LastSeen, pFrom->m_LastSeen);
+	pTo->m_TotalOnlineTime += pFrom->m_TotalOnlineTime;
+}
+
+bool MergeStatsFile(const char *pPath, const CFngStats *pStats, CFngStats *pMerged)
+{
+	int Lock = LockStatsFile(pPath);
+	if (Lock < 0)
+	{
+		dbg_msg("stats", "error: locked file path='%s'", pPath);
+		return false;
+	}
+	CFngStats Merged;
+	if (ReadStatsFile(pPath, &Merged) == 0)
+		MergeFngStats(pStats, &Merged);
+	else
+	{
+		Merged = *pStats;
+		Merged.m_FirstSeen = time(NULL);
+	}
+	bool Saved = WriteStatsFile(pPath, &Merged);
+	UnlockStatsFile(pPath, Lock);
+	if (pMerged)
+		*pMerged = Merged;
+	return Saved;
+}
+
+static const char s_aJournalMagic[4] = {'F', 'N', 'G', 'J'};
+
+CStatsJournal::CStatsJournal()
+{
+	m_pHeader = 0;
+	m_pSlots = m_aMemSlots;
+	m_File = -1;
+	mem_zero(m_aMemSlots, sizeof(m_aMemSlots));
+}
+
+CStatsJournal::~CStatsJournal()
+{
+	Close();
+}
+
+bool CStatsJournal::Open(const char *pPath)
+{
+	Close();
+#if defined(CONF_FAMILY_UNIX)
+	int fd = open(pPath, O_RDWR|O_CREAT, S_IRUSR|S_IWUSR);
+	if (fd < 0)
+	{
+		dbg_msg("stats", "failed to open journal '%s' errno=%d", pPath, errno);
+		return false;
+	}
+	const unsigned Size = sizeof(CHeader) + NUM_SLOTS*sizeof(CSlot);
+	// a version 1 journal is the header and the client slots
+	const unsigned OldSize = sizeof(CHeader) + MAX_CLIENTS*sizeof(CSlot);
+	struct stat st;
+	bool Fresh = fstat(fd, &st) || (st.st_size != (off_t)Size && st.st_size != (off_t)OldSize);
+	if ((Fresh || st.st_size != (off_t)Size) && ftruncate(fd, Size))
+	{
+		dbg_msg("stats", "failed to resize journal '%s' errno=%d", pPath, errno);
+		close(fd);
+		return false;
+	}
+	void *pData = mmap(0, Size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (pData == MAP_FAILED)
+	{
+		dbg_msg("stats", "failed to map journal '%s' errno=%d", pPath, errno);
+		close(fd);
+		return false;
+	}
+	m_File = fd;
+	m_pHeader = (CHeader *)pData;
+	m_pSlots = (CSlot *)(m_pHeader+1);
+
+	// the client slots of version 1 are kept, the pending slots start empty
+	bool Upgrade = !mem_comp(m_pHeader->m_aMagic, s_aJournalMagic, sizeof(s_aJournalMagic)) && m_pHeader->m_Version == 1 &&
+		m_pHeader->m_NumSlots == MAX_CLIENTS && m_pHeader->m_SlotSize == (int)sizeof(CSlot);
+	if (!Fresh && Upgrade)
+	{
+		mem_zero(&m_pSlots[MAX_CLIENTS], MAX_PENDING*sizeof(CSlot));
+		m_pHeader->m_Version = JOURNAL_VERSION;
+		m_pHeader->m_NumSlots = NUM_SLOTS;
+	}
+	else if (Fresh || mem_comp(m_pHeader->m_aMagic, s_aJournalMagic, sizeof(s_aJournalMagic)) ||
+		m_pHeader->m_Version != JOURNAL_VERSION || m_pHeader->m_NumSlots != NUM_SLOTS || m_pHeader->m_SlotSize != (int)sizeof(CSlot))
+	{
+		if (!Fresh)
+			dbg_msg("stats", "journal '%s' is from another version, starting a new one", pPath);
+		mem_zero(pData, Size);
+		mem_copy(m_pHeader->m_aMagic, s_aJournalMagic, sizeof(s_aJournalMagic));
+		m_pHeader->m_Version = JOURNAL_VERSION;
+		m_pHeader->m_NumSlots = NUM_SLOTS;
+		m_pHeader->m_SlotSize = sizeof(CSlot);
+	}
+	return true;
+#else
+	dbg_msg("stats", "journal is not supported on this platform");
+	return false;
+#endif
+}
+
+void CStatsJournal::Close()
+{
+#if defined(CONF_FAMILY_UNIX)
+	if (m_pHeader)
+	{
+		munmap(m_pHeader, sizeof(CHeader) + NUM_SLOTS*sizeof(CSlot));
+		close(m_File);
+	}
+#endif
+	m_pHeader = 0;
+	m_pSlots = m_aMemSlots;
+	m_File = -1;
+}
+
+int CStatsJournal::Keep(const CFngStats *pStats)
+{
+	for (int i = MAX_CLIENTS; i < NUM_SLOTS; i++)
+	{
+		if (m_pSlots[i].m_Used)
+			continue;
+		m_pSlots[i].m_Stats = *pStats;
+		m_pSlots[i].m_Used = 1;
+		return i;
+	}
+	return -1;
+}
+
+CStatsFileBackend::CStatsFileBackend()
+{
+	m_aPath[0] = 0;
+}
+
+void CStatsFileBackend::Init(const char *pStatsPath)
+{
+	str_copy(m_aPath, pStatsPath, sizeof(m_aPath));
+}
+
+bool CStatsFileBackend::RecordPath(const char *pName, char *pBuf, int BufSize) const
+{
+	char aFilename[MAX_FILE_LEN];
+	if (escape_filename(aFilename, sizeof(aFilename), pName))
+		return false;
+	str_format(pBuf, BufSize, "%s/%s.acc", m_aPath, aFilename);
+	return true;
+}
+
+int CStatsFileBackend::Load(const char *pName, CFngStats *pStats)
+{
+	char aFilePath[MAX_FILE_PATH];
+	if (!RecordPath(pName, aFilePath, sizeof(aFilePath)))
+		return -2;
+	return ReadStatsFile(aFilePath, pStats);
+}
+
+void CStatsFileBackend::Save(CStatsSave *pSaves, int Num)
+{
+	for (int i = 0; i < Num; i++)
+	{
+		CStatsSave *pSave = &pSaves[i];
+		char aFilePath[MAX_FILE_PATH];
+		// another server or a stats tool could have written the file since the
+		// cache read it, so the round stats always go into what is there now
+		bool Saved = RecordPath(pSave->m_aName, aFilePath, sizeof(aFilePath)) && MergeStatsFile(aFilePath, &pSave->m_Round, &pSave->m_Merged);
+		pSave->m_HasMerged = Saved;
+		pSave->m_Result = Saved ? CStatsSave::RESULT_OK : CStatsSave::RESULT_FAILED;
+		if (Saved)
+			dbg_msg("stats", "saved '%s' to file '%s'", pSave->m_aName, aFilePath);
+	}
+}
+
+CStatsServerBackend::CStatsServerBackend()
+{
+	mem_zero(&m_Addr, sizeof(m_Addr));
+	mem_zero(&m_Socket, sizeof(m_Socket));
+	m_Connected = false;
+	m_NextConnect = 0;
+	m_Lock = lock_create();
+	m_Token = 0;
+	m_SaveSeq = 0;
+}
+
+CStatsServerBackend::~CStatsServerBackend()
+{
+	Disconnect();
+	lock_destroy(m_Lock);
+}
+
+bool CStatsServerBackend::Init(const char *pAddress)
+{
+	if (net_host_lookup(pAddress, &m_Addr, NETTYPE_ALL) != 0)
+	{
+		dbg_msg("stats", "invalid stats server address '%s'", pAddress);
+		return false;
+	}
+	if (!m_Addr.port)
+		m_Addr.port = STATSSRV_PORT;
+	secure_random_fill(&m_Token, sizeof(m_Token));
+	return true;
+}
+
+bool CStatsServerBackend::Connect()
+{
+	if (time_get() < m_NextConnect)
+		return false;
+	m_NextConnect = time_get() + RECONNECT_DELAY*time_freq();
+	NETADDR BindAddr;
+	mem_zero(&BindAddr, sizeof(BindAddr));
+	BindAddr.type = m_Addr.type;
+	m_Socket = net_tcp_create(BindAddr);
+	if (m_Socket.type == NETTYPE_INVALID)
+		return false;
+	if (net_tcp_connect(m_Socket, &m_Addr) != 0)
+	{
+		char aAddr[NETADDR_MAXSTRSIZE];
+		net_addr_str(&m_Addr, aAddr, sizeof(aAddr), true);
+		dbg_msg("stats", "failed to connect to the stats server %s", aAddr);
+		net_tcp_close(m_Socket);
+		return false;
+	}
+	m_Connected = true;
+	char aHello[sizeof(FNG_VERSION) + sizeof(int)];
+	const int Protocol = STATSSRV_PROTOCOL;
+	mem_copy(aHello, FNG_VERSION, sizeof(FNG_VERSION));
+	mem_copy(aHello + sizeof(FNG_VERSION), &Protocol, sizeof(Protocol));
+	int Accepted = 0;
+	if (!Send(STATSSRV_HELLO, aHello, sizeof(aHello)) || !Recv(STATSSRV_HELLO, &Accepted, sizeof(Accepted)))
+		return false;
+	if (!Accepted)
+	{
+		dbg_msg("stats", "the stats server does not have stats version '%s' and protocol %d", FNG_VERSION, Protocol);
+		Disconnect();
+		return false;
+	}
+	dbg_msg("stats", "connected to the stats server");
+	return true;
+}
+
+void CStatsServerBackend::Disconnect()
+{
+	if (!m_Connected)
+		return;
+	net_tcp_close(m_Socket);
+	m_Connected = false;
+}
+
+bool CStatsServerBackend::Send(const unsigned char *pType, const void *pData, int Size)
+{
+	// one send for the header and the data, so they go out in one segment
+	std::vector<char> vBuf(sizeof(CStatsSrvHeader) + Size);
+	CStatsSrvHeader *pHeader = (CStatsSrvHeader *)&vBuf[0];
+	mem_copy(pHeader->m_aType, pType, sizeof(pHeader->m_aType));
+	pHeader->m_Size = Size;
+	mem_copy(&vBuf[sizeof(CStatsSrvHeader)], pData, Size);
+	for (unsigned Sent = 0; Sent < vBuf.size(); )
+	{
+		int Bytes = net_tcp_send(m_Socket, &vBuf[Sent], vBuf.size() - Sent);
+		if (Bytes <= 0)
+		{
+			dbg_msg("stats", "lost the connection to the stats server");
+			Disconnect();
+			return false;
+		}
+		Sent += Bytes;
+	}
+	return true;
+}
+
+static bool RecvStatsSrv(NETSOCKET Socket, void *pData, int Size)
+{
+	// a stats server that hangs must not block the jobs forever
+	const int64 Timeout = time_get() + 5*time_freq();
+	for (int Received = 0; Received < Size; )
+	{
+		if (!net_socket_read_wait(Socket, 100))
+		{
+			if (time_get() > Timeout)
+				return false;
+			continue;
+		}
+		int Bytes = net_tcp_recv(Socket, (char *)pData + Received, Size - Received);
+		if (Bytes <= 0)
+			return false;
+		Received += Bytes;
+	}
+	return true;
+}
+
+bool CStatsServerBackend::Recv(const unsigned char *pType, void *pData, int Size)
+{
+	CStatsSrvHeader Header;
+	if (!RecvStatsSrv(m_Socket, &Header, sizeof(Header)) || mem_comp(Header.m_aType, pType, sizeof(Header.m_aType)) ||
+		Header.m_Size != Size || !RecvStatsSrv(m_Socket, pData, Size))
+	{
+		dbg_msg("stats", "lost the connection to the stats server");
+		Disconnect();
+		return false;
+	}
+	return true;
+}
+
+int CStatsServerBackend::Load(const char *pName, CFngStats *pStats)
+{
+	char aFilename[MAX_FILE_LEN];
+	if (escape_filename(aFilename, sizeof(aFilename), pName))
+		return -2;
+	char aName[MAX_NAME_LENGTH];
+	mem_zero(aName, sizeof(aName));
+	str_copy(aName, pName, sizeof(aName));
+	char aReply[sizeof(CFngStats) + sizeof(int)];
+	int Result = -3;
+	lock_wait(m_Lock);
+	if ((m_Connected || Connect()) && Send(STATSSRV_LOAD, aName, sizeof(aName)) && Recv(STATSSRV_RECORD, aReply, sizeof(aReply)))
+	{
+		mem_copy(pStats, aReply, sizeof(*pStats));
+		mem_copy(&Result, aReply + sizeof(*pStats), sizeof(Result));
+	}
+	lock_unlock(m_Lock);
+	return Result;
+}
+
+void CStatsServerBackend::Save(CStatsSave *pSaves, int Num)
+{
+	// always the round stats, other servers could have changed the record
+	std::vector<CFngStats> vRounds;
+	for (int i = 0; i < Num; i++)
+	{
+		vRounds.push_back(pSaves[i].m_Round);
+		str_copy(vRounds.back().m_aName, pSaves[i].m_aName, sizeof(vRounds.back().m_aName));
+		pSaves[i].m_Result = CStatsSave::RESULT_FAILED;
+	}
+	lock_wait(m_Lock);
+	for (int Start = 0; Start < Num; Start += STATSSRV_MAX_SAVES)
+	{
+		CStatsSrvSaveID ID;
+		mem_zero(&ID, sizeof(ID));
+		ID.m_Token = m_Token;
+		ID.m_Seq = ++m_SaveSeq;
+		ID.m_Num = minimum(Num - Start, (int)STATSSRV_MAX_SAVES);
+		std::vector<char> vMsg(sizeof(ID) + ID.m_Num*sizeof(CFngStats));
+		mem_copy(&vMsg[0], &ID, sizeof(ID));
+		mem_copy(&vMsg[sizeof(ID)], &vRounds[Start], ID.m_Num*sizeof(CFngStats));
+
+		// the stats server could have the save already when the answer times out,
+		// it drops the repeated one. only a save the stats server had before it
+		// became unreachable still ends up in the fail path as well
+		bool Saved = false;
+		for (int Try = 0; Try < SAVE_TRIES && !Saved && (m_Connected || Connect()); Try++)
+		{
+			CStatsSrvSaveID Answer;
+			if (!Send(STATSSRV_SAVE, &vMsg[0], vMsg.size()) || !Recv(STATSSRV_SAVED, &Answer, sizeof(Answer)))
+				continue;
+			Saved = !mem_comp(&Answer, &ID, sizeof(ID));
+			if (!Saved)
+			{
+				dbg_msg("stats", "the stats server answered another save");
+				Disconnect();
+			}
+		}
+		if (!Saved)
+			break;
+		for (int i = Start; i < Start+ID.m_Num; i++)
+			pSaves[i].m_Result = CStatsSave::RESULT_OK;
+		dbg_msg("stats", "saved %d round stats on the stats server", ID.m_Num);
+	}
+	lock_unlock(m_Lock);
+}
+
+CStatsCache::CStatsCache()
+{
+	m_pEngine = 0;
+	m_pBackend = 0;
+	m_pJournal = 0;
+	m_pRankIndex = 0;
+	m_aFailPath[0] = 0;
+	m_UseCounter = 0;
+	for (int i = 0; i < NUM_ENTRIES; i++)
+	{
+		m_aEntries[i].m_pCache = this;
+		m_aEntries[i].m_aName[0] = 0;
+		m_aEntries[i].m_Hash = 0;
+		m_aEntries[i].m_State = STATE_EMPTY;
+		m_aEntries[i].m_LastUse = 0;
+		m_aEntries[i].m_Loading = false;
+		m_aEntries[i].m_DiscardLoad = false;
+		m_aEntries[i].m_NumWrites = 0;
+		m_aEntries[i].m_LoadResult = 0;
+	}
+	m_WriteHead = 0;
+	m_WriteJobEnd = 0;
+	m_WriteTail = 0;
+	m_SaveFails = 0;
+	m_CriticalSaveFails = 0;
+}
+
+CStatsCache::~CStatsCache()
+{
+	// the jobs write into the entries
+	for (int i = 0; i < NUM_ENTRIES; i++)
+		while (m_aEntries[i].m_Loading && m_aEntries[i].m_Job.Status() != CJob::STATE_DONE)
+			thread_sleep(1);
+	Flush();
+}
+
+void CStatsCache::Init(IEngine *pEngine, IStatsBackend *pBackend, const char *pFailPath, CStatsJournal *pJournal, CRankIndex *pRankIndex)
+{
+	m_pEngine = pEngine;
+	m_pBackend = pBackend;
+	m_pJournal = pJournal;
+	m_pRankIndex = pRankIndex;
+	str_copy(m_aFailPath, pFailPath, sizeof(m_aFailPath));
+}
+
+CStatsCache::CEntry *CStatsCache::Find(const char *pName)
+{
+	unsigned Hash = str_quickhash(pName);
+	for (int i = 0; i < NUM_ENTRIES; i++)
+	{
+		CEntry *pEntry = &m_aEntries[i];
+		if (pEntry->m_Hash != Hash || (pEntry->m_State == STATE_EMPTY && !pEntry->m_Loading && !pEntry->m_NumWrites))
+			continue;
+		if (!str_comp(pEntry->m_aName, pName))
+		{
+			pEntry->m_LastUse = ++m_UseCounter;
+			return pEntry;
+		}
+	}
+	return 0;
+}
+
+CStatsCache::CEntry *CStatsCache::Alloc(const char *pName)
+{
+	// entries with a running load or queued writes can not be reused
+	CEntry *pOldest = 0;
+	for (int i = 0; i < NUM_ENTRIES; i++)
+	{
+		CEntry *pEntry = &m_aEntries[i];
+		if (pEntry->m_Loading || pEntry->m_NumWrites)
+			continue;
+		if (pEntry->m_State == STATE_EMPTY)
+		{
+			pOldest = pEntry;
+			break;
+		}
+		if (!pOldest || pEntry->m_LastUse < pOldest->m_LastUse)
+			pOldest = pEntry;
+	}
+	if (!pOldest)
+		return 0;
+	str_copy(pOldest->m_aName, pName, sizeof(pOldest->m_aName));
+	pOldest->m_Hash = str_quickhash(pName);
+	pOldest->m_State = STATE_EMPTY;
+	pOldest->m_DiscardLoad = false;
+	pOldest->m_LastUse = ++m_UseCounter;
+	return pOldest;
+}
+
+int CStatsCache::LoadJob(void *pUser)
+{
+	CEntry *pEntry = (CEntry *)pUser;
+	pEntry->m_LoadResult = pEntry->m_pCache->m_pBackend->Load(pEntry->m_aName, &pEntry->m_LoadStats);
+	return 0;
+}
+
+void CStatsCache::Prefetch(const char *pName)
+{
+	if (!m_pEngine || !pName[0] || Find(pName))
+		return;
+	CEntry *pEntry = Alloc(pName);
+	if (!pEntry)
+		return;
+	pEntry->m_Loading = true;
+	m_pEngine->AddJob(&pEntry->m_Job, LoadJob, pEntry);
+}
+
+int CStatsCache::Get(const char *pName, CFngStats *pStats, int *pError)
+{
+	CEntry *pEntry = Find(pName);
+	if (!pEntry)
+		return STATE_EMPTY;
+	if (pEntry->m_State == STATE_LOADED)
+		*pStats = pEntry->m_Stats;
+	else if (pEntry->m_State == STATE_FAILED && pError)
+		*pError = pEntry->m_LoadResult;
+	return pEntry->m_State;
+}
+
+void CStatsCache::Set(const char *pName, const CFngStats *pStats)
+{
+	CEntry *pEntry = Find(pName);
+	if (!pEntry && !(pEntry = Alloc(pName)))
+		return;
+	// the file does not have the queued round stats yet
+	if (pEntry->m_NumWrites)
+		return;
+	pEntry->m_Stats = *pStats;
+	pEntry->m_State = STATE_LOADED;
+	pEntry->m_DiscardLoad = true;
+}
+
+void CStatsCache::SetMissing(const char *pName)
+{
+	CEntry *pEntry = Find(pName);
+	if (!pEntry && !(pEntry = Alloc(pName)))
+		return;
+	if (pEntry->m_NumWrites)
+		return;
+	pEntry->m_State = STATE_MISSING;
+	pEntry->m_DiscardLoad = true;
+}
+
+void CStatsCache::Invalidate(const char *pName)
+{
+	CEntry *pEntry = Find(pName);
+	if (!pEntry)
+		return;
+	pEntry->m_State = STATE_EMPTY;
+	pEntry->m_DiscardLoad = true;
+}
+
+bool CStatsCache::Save(const char *pName, const CFngStats *pRound, int JournalSlot)
+{
+	char aFilename[MAX_FILE_LEN];
+	if (escape_filename(aFilename, sizeof(aFilename), pName))
+		return false;
+	if (JournalSlot < 0 && m_pJournal && (JournalSlot = m_pJournal->Keep(pRound)) < 0)
+		dbg_msg("stats", "journal is full, the round stats of '%s' are not kept until saved", pName);
+
+	// the job owns the ring, later saves wait behind the ones that did not fit
+	CStatsSave Overflow;
+	bool Full = m_WriteTail - m_WriteHead == MAX_WRITES || !m_vOverflow.empty();
+	CStatsSave *pWrite = Full ? &Overflow : &m_aWrites[m_WriteTail % MAX_WRITES];
+	str_copy(pWrite->m_aName, pName, sizeof(pWrite->m_aName));
+	pWrite->m_Round = *pRound;
+	pWrite->m_Result = CStatsSave::RESULT_OK;
+	pWrite->m_JournalSlot = JournalSlot;
+	pWrite->m_HasMerged = false;
+	CEntry *pEntry = Find(pName);
+	if (pEntry && pEntry->m_State == STATE_FAILED)
+		pEntry->m_State = STATE_EMPTY;
+	if (pEntry && pEntry->m_State != STATE_EMPTY)
+	{
+		// what the file will most likely have, until the write tells
+		if (pEntry->m_State == STATE_MISSING)
+		{
+			pEntry->m_Stats = *pRound;
+			pEntry->m_Stats.m_FirstSeen = time(NULL);
+		}
+		else
+			MergeFngStats(pRound, &pEntry->m_Stats);
+		pEntry->m_State = STATE_LOADED;
+	}
+	else if (!pEntry)
+	{
+		// the record is not known yet, the entry stays empty until the file has the round stats
+		pEntry = Alloc(pName);
+	}
+	if (pEntry)
+	{
+		pEntry->m_DiscardLoad = true;
+		pEntry->m_NumWrites++;
+	}
+	if (Full)
+		m_vOverflow.push_back(Overflow);
+	else
+		m_WriteTail++;
+
+	if (m_pEngine)
+		StartWriteJob();
+	else
+		Flush();
+	return true;
+}
+
+void CStatsCache::DoWrites(CStatsSave *pWrites, int Num)
+{
+	m_pBackend->Save(pWrites, Num);
+	for (int i = 0; i < Num; i++)
+	{
+		CStatsSave *pWrite = &pWrites[i];
+		if (pWrite->m_Result == CStatsSave::RESULT_OK)
+			continue;
+		// keep the round stats for MergeFailedStats
+		char aFilename[MAX_FILE_LEN];
+		char aFilePath[MAX_FILE_PATH];
+		escape_filename(aFilename, sizeof(aFilename), pWrite->m_aName);
+		str_format(aFilePath, sizeof(aFilePath), "%s/%s.acc", m_aFailPath, aFilename);
+		dbg_msg("stats", "save failed name='%s' trying fail path", pWrite->m_aName);
+		pWrite->m_Result = MergeStatsFile(aFilePath, &pWrite->m_Round) ? CStatsSave::RESULT_FAILED : CStatsSave::RESULT_LOST;
+		if (pWrite->m_Result == CStatsSave::RESULT_LOST)
+			dbg_msg("stats", "error: lost round stats of '%s'", pWrite->m_aName);
+	}
+}
+
+int CStatsCache::WriteJob(void *pUser)
+{
+	CStatsCache *pSelf = (CStatsCache *)pUser;
+	// the backend gets the queued writes in at most two runs, the ring can wrap
+	for (int i = pSelf->m_WriteHead; i < pSelf->m_WriteJobEnd; )
+	{
+		int Num = minimum(pSelf->m_WriteJobEnd - i, MAX_WRITES - i % MAX_WRITES);
+		pSelf->DoWrites(&pSelf->m_aWrites[i % MAX_WRITES], Num);
+		i += Num;
+	}
+	return 0;
+}
+
+void CStatsCache::FinishWrite(CStatsSave *pWrite)
+{
+	CEntry *pEntry = Find(pWrite->m_aName);
+	if (pEntry && pEntry->m_NumWrites)
+		pEntry->m_NumWrites--;
+	// lost round stats stay in the journal for the next start
+	if (pWrite->m_JournalSlot >= 0 && pWrite->m_Result != CStatsSave::RESULT_LOST)
+		m_pJournal->SetUsed(pWrite->m_JournalSlot, false);
+	if (pWrite->m_Result == CStatsSave::RESULT_OK)
+	{
+		// the stats server doesn't send the merged record back, its saves reach the index with the next rebuild
+		if (m_pRankIndex && pWrite->m_HasMerged)
+			m_pRankIndex->OnSave(&pWrite->m_Merged);
+		// the file could have had more than the cache knew
+		if (pEntry && pWrite->m_HasMerged && !pEntry->m_NumWrites)
+		{
+			pEntry->m_Stats = pWrite->m_Merged;
+			pEntry->m_State = STATE_LOADED;
+		}
+		return;
+	}
+	m_SaveFails++;
+	if (pWrite->m_Result == CStatsSave::RESULT_LOST)
+		m_CriticalSaveFails++;
+	// the cached record has round stats that are not in the stats file
+	Invalidate(pWrite->m_aName);
+}
+
+void CStatsCache::FinishWriteJob()
+{
+	for (int i = m_WriteHead; i < m_WriteJobEnd; i++)
+		FinishWrite(&m_aWrites[i % MAX_WRITES]);
+	m_WriteHead = m_WriteJobEnd;
+}
+
+void CStatsCache::StartWriteJob()
+{
+	if (m_WriteJobEnd != m_WriteHead || m_WriteTail == m_WriteHead)
+		return;
+	m_WriteJobEnd = m_WriteTail;
+	m_pEngine->AddJob(&m_WriteJob, WriteJob, this);
+}
+
+void CStatsCache::QueueOverflow()
+{
+	unsigned Num = 0;
+	for (; Num < m_vOverflow.size() && m_WriteTail - m_WriteHead < MAX_WRITES; Num++)
+		m_aWrites[m_WriteTail++ % MAX_WRITES] = m_vOverflow[Num];
+	m_vOverflow.erase(m_vOverflow.begin(), m_vOverflow.begin() + Num);
+}
+
+void CStatsCache::Flush()
+{
+	if (m_WriteJobEnd != m_WriteHead)
+	{
+		while (m_WriteJob.Status() != CJob::STATE_DONE)
+			thread_sleep(1);
+		FinishWriteJob();
+	}
+	do
+	{
+		QueueOverflow();
+		m_WriteJobEnd = m_WriteTail;
+		WriteJob(this);
+		FinishWriteJob();
+	}
+	while (!m_vOverflow.empty());
+}
+
+void CStatsCache::Update()
+{
+	for (int i = 0; i < NUM_ENTRIES; i++)
+	{
+		CEntry *pEntry = &m_aEntries[i];
+		if (!pEntry->m_Loading || pEntry->m_Job.Status() != CJob::STATE_DONE)
+			continue;
+		pEntry->m_Loading = false;
+		if (pEntry->m_DiscardLoad)
+			continue;
+		if (pEntry->m_LoadResult == 0)
+		{
+			pEntry->m_Stats = pEntry->m_LoadStats;
+			pEntry->m_State = STATE_LOADED;
+		}
+		else if (pEntry->m_LoadResult == 1)
+			pEntry->m_State = STATE_MISSING;
+		else
+			pEntry->m_State = STATE_FAILED;
+	}
+
+	if (m_WriteJobEnd != m_WriteHead && m_WriteJob.Status() == CJob::STATE_DONE)
+		FinishWriteJob();
+	QueueOverflow();
+	if (m_pEngine)
+		StartWriteJob();
+}
+
+CStatsService::CStatsService()
+{
+	m_Inited = false;
+	m_Replayed = false;
+	m_pBackend = &m_FileBackend;
+	m_NextSnapshot = 0;
+}
+
+void CStatsService::Init(IEngine *pEngine, const char *pStatsPath, const char *pFailPath, const char *pServer, const char *pJournal)
+{
+	m_Inited = true;
+	m_FileBackend.Init(pStatsPath);
+	m_pBackend = &m_FileBackend;
+	if (pServer[0] && m_ServerBackend.Init(pServer))
+	{
+		m_pBackend = &m_ServerBackend;
+		dbg_msg("stats", "rank, top and leaderboards read '%s', it has to be the stats server's directory", pStatsPath);
+	}
+	m_Cache.Init(pEngine, m_pBackend, pFailPath, &m_Journal, &m_RankIndex);
+	if (pJournal[0])
+		m_Journal.Open(pJournal);
+}
+
+int CStatsService::ReplayJournal()
+{
+	// the pending slots are queued already after the first map
+	int NumSlots = m_Replayed ? (int)MAX_CLIENTS : (int)CStatsJournal::NUM_SLOTS;
+	m_Replayed = true;
+	int Saved = 0;
+	for (int i = 0; i < NumSlots; i++)
+	{
+		if (!m_Journal.IsUsed(i))
+			continue;
+		CFngStats *pStats = m_Journal.Stats(i);
+		bool Pending = i >= MAX_CLIENTS;
+		if (!Pending)
+		{
+			// the round ended for the player, same as in CPlayer::SaveStats
+			if (pStats->m_Spree > pStats->m_SpreeBest)
+				pStats->m_SpreeBest = pStats->m_Spree;
+			pStats->m_Spree = 0;
+		}
+		if (!m_Cache.Save(pStats->m_aName, pStats, Pending ? i : -1))
+		{
+			dbg_msg("stats", "journal replay failed: escape error name='%s'", pStats->m_aName);
+			if (Pending)
+				m_Journal.SetUsed(i, false);
+		}
+		else
+			Saved++;
+		if (!Pending)
+			m_Journal.SetUsed(i, false);
+	}
+	return Saved;
+}
+
+static const char s_aSnapshotMagic[4] = {'F', 'N', 'G', 'C'};
+
+static const char *s_apColumnNames[CStatsSnapshot::NUM_COLUMNS] = {
+	"kills",
+	"deaths",
+	"gold_spikes",
+	"green_spikes",
+	"purple_spikes",
+	"rifle_shots",
+	"freezes",
+	"frozen",
+	"spree_best",
+	"multi_best",
+	"first_seen",
+	"last_seen",
+	"online_time",
+};
+
+struct CStatsSnapshotBuilder
+{
+	const char *m_pStatsDir;
+	std::vector<int> m_aColumns[CStatsSnapshot::NUM_COLUMNS];
+	std::vector<int> m_NameOffsets;
+	std::vector<char> m_Names;
+};
+
+static int SnapshotListCallback(const char *pName, int IsDir, int DirType, void *pUser)
+{
+	CStatsSnapshotBuilder *pBuilder = (CStatsSnapshotBuilder *)pUser;
+	if (IsDir || !str_endswith(pName, ".acc"))
+		return 0;
+	char aFilePath[MAX_FILE_PATH];
+	str_format(aFilePath, sizeof(aFilePath), "%s/%s", pBuilder->m_pStatsDir, pName);
+	CFngStats Stats;
+	int Err = ReadStatsFile(aFilePath, &Stats);
+	if (Err)
+	{
+		dbg_msg("stats", "snapshot skips '%s' err=%d", aFilePath, Err);
+		return 0;
+	}
+
+	for (int i = 0; i < CStatsSnapshot::NUM_COLUMNS; i++)
+		pBuilder->m_aColumns[i].push_back(CStatsSnapshot::ColumnValue(&Stats, i));
+
+	char aName[MAX_NAME_LENGTH];
+	str_copy(aName, Stats.m_aName, sizeof(aName));
+	pBuilder->m_NameOffsets.push_back(pBuilder->m_Names.size());
+	pBuilder->m_Names.insert(pBuilder->m_Names.end(), aName, aName + str_length(aName) + 1);
+	return 0;
+}
+
+CStatsSnapshot::CStatsSnapshot()
+{
+	m_pHeader = 0;
+	m_pData = 0;
+	m_Size = 0;
+	m_Mapped = false;
+}
+
+CStatsSnapshot::~CStatsSnapshot()
+{
+	Close();
+}
+
+const char *CStatsSnapshot::ColumnName(int Column)
+{
+	return s_apColumnNames[Column];
+}
+
+int CStatsSnapshot::FindColumn(const char *pName)
+{
+	for (int i = 0; i < NUM_COLUMNS; i++)
+		if (!str_comp(s_apColumnNames[i], pName))
+			return i;
+	return -1;
+}
+
+int CStatsSnapshot::ColumnValue(const CFngStats *pStats, int Column)
+{
+	switch (Column)
+	{
+	case COL_KILLS: return pStats->m_Kills;
+	case COL_DEATHS: return pStats->m_Deaths;
+	case COL_GOLD_SPIKES: return pStats->m_GoldSpikes;
+	case COL_GREEN_SPIKES: return pStats->m_GreenSpikes;
+	case COL_PURPLE_SPIKES: return pStats->m_PurpleSpikes;
+	case COL_RIFLE_SHOTS: return pStats->m_RifleShots;
+	case COL_FREEZES: return pStats->m_Freezes;
+	case COL_FROZEN: return pStats->m_Frozen;
+	case COL_SPREE_BEST: return pStats->m_SpreeBest;
+	case COL_MULTI_BEST: return pStats->m_MultiBest;
+	case COL_FIRST_SEEN: return (int)pStats->m_FirstSeen;
+	case COL_LAST_SEEN: return (int)pStats->m_LastSeen;
+	case COL_ONLINE_TIME: return (int)pStats->m_TotalOnlineTime;
+	}
+	return 0;
+}
+
+int CStatsSnapshot::Write(const char *pStatsDir, const char *pPath)
+{
+	CStatsSnapshotBuilder Builder;
+	Builder.m_pStatsDir = pStatsDir;
+	fs_listdir(pStatsDir, SnapshotListCallback, 0, &Builder);
+	const int NumPlayers = Builder.m_NameOffsets.size();
+
+	CHeader Header;
+	mem_zero(&Header, sizeof(Header));
+	mem_copy(Header.m_aMagic, s_aSnapshotMagic, sizeof(Header.m_aMagic));
+	Header.m_Version = SNAPSHOT_VERSION;
+	Header.m_NumPlayers = NumPlayers;
+	Header.m_NumColumns = NUM_COLUMNS;
+	Header.m_Created = time(NULL);
+	int Offset = sizeof(Header);
+	for (int i = 0; i < NUM_COLUMNS; i++)
+	{
+		Offset = (Offset + ALIGNMENT-1) & ~(ALIGNMENT-1);
+		Header.m_aColumnOffsets[i] = Offset;
+		Offset += NumPlayers*sizeof(int);
+	}
+	Offset = (Offset + ALIGNMENT-1) & ~(ALIGNMENT-1);
+	Header.m_NameOffsetsOffset = Offset;
+	Offset += NumPlayers*sizeof(int);
+	Header.m_NamesOffset = Offset;
+	Header.m_NamesSize = Builder.m_Names.size();
+	Header.m_Size = Offset + Header.m_NamesSize;
+
+	std::vector<unsigned char> Data(Header.m_Size, 0);
+	mem_copy(&Data[0], &Header, sizeof(Header));
+	if (NumPlayers)
+	{
+		for (int i = 0; i < NUM_COLUMNS; i++)
+			mem_copy(&Data[Header.m_aColumnOffsets[i]], &Builder.m_aColumns[i][0], NumPlayers*sizeof(int));
+		mem_copy(&Data[Header.m_NameOffsetsOffset], &Builder.m_NameOffsets[0], NumPlayers*sizeof(int));
+		mem_copy(&Data[Header.m_NamesOffset], &Builder.m_Names[0], Header.m_NamesSize);
+	}
+
+	char aTmpPath[MAX_FILE_PATH+4];
+	str_format(aTmpPath, sizeof(aTmpPath), "%s.tmp", pPath);
+	IOHANDLE File = io_open(aTmpPath, IOFLAG_WRITE);
+	if (!File)
+	{
+		dbg_msg("stats", "failed to open snapshot '%s'", aTmpPath);
+		return -1;
+	}
+	bool Written = io_write(File, &Data[0], Data.size()) == Data.size();
+	io_close(File);
+	// rename does not replace existing files on windows
+	if (!Written || (fs_rename(aTmpPath, pPath) && (fs_remove(pPath) || fs_rename(aTmpPath, pPath))))
+	{
+		dbg_msg("stats", "failed to write snapshot '%s'", pPath);
+		fs_remove(aTmpPath);
+		return -1;
+	}
+	return NumPlayers;
+}
+
+bool CStatsSnapshot::Open(const char *pPath)
+{
+	Close();
+#if defined(CONF_FAMILY_UNIX)
+	int fd = open(pPath, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size < (off_t)sizeof(CHeader))
+	{
+		close(fd);
+		return false;
+	}
+	void *pData = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (pData == MAP_FAILED)
+		return false;
+	m_pData = (unsigned char *)pData;
+	m_Size = st.st_size;
+	m_Mapped = true;
+#else
+	IOHANDLE File = io_open(pPath, IOFLAG_READ);
+	if (!File)
+		return false;
+	m_Size = io_length(File);
+	m_pData = (unsigned char *)mem_alloc(maximum(m_Size, 1u), ALIGNMENT);
+	bool Read = io_read(File, m_pData, m_Size) == m_Size;
+	io_close(File);
+	if (!Read || m_Size < sizeof(CHeader))
+	{
+		Close();
+		return false;
+	}
+#endif
+	m_pHeader = (const CHeader *)m_pData;
+
+	// everything the accessors use has to be inside of the file
+	const CHeader *pHeader = m_pHeader;
+	const unsigned ColumnSize = pHeader->m_NumPlayers*sizeof(int);
+	bool Valid = !mem_comp(pHeader->m_aMagic, s_aSnapshotMagic, sizeof(pHeader->m_aMagic)) &&
+		pHeader->m_Version == SNAPSHOT_VERSION && pHeader->m_NumColumns == NUM_COLUMNS &&
+		pHeader->m_Size == (int)m_Size && pHeader->m_NumPlayers >= 0 && pHeader->m_NamesSize >= 0 &&
+		pHeader->m_NameOffsetsOffset >= 0 && pHeader->m_NameOffsetsOffset + ColumnSize <= m_Size &&
+		pHeader->m_NamesOffset >= 0 && pHeader->m_NamesOffset + (unsigned)pHeader->m_NamesSize <= m_Size &&
+		(!pHeader->m_NamesSize || !m_pData[pHeader->m_NamesOffset + pHeader->m_NamesSize - 1]);
+	for (int i = 0; Valid && i < NUM_COLUMNS; i++)
+		Valid = pHeader->m_aColumnOffsets[i] >= 0 && pHeader->m_aColumnOffsets[i] % sizeof(int) == 0 && pHeader->m_aColumnOffsets[i] + ColumnSize <= m_Size;
+	const int *pNameOffsets = Valid ? (const int *)(m_pData + pHeader->m_NameOffsetsOffset) : 0;
+	for (int i = 0; Valid && i < pHeader->m_NumPlayers; i++)
+		Valid = pNameOffsets[i] >= 0 && pNameOffsets[i] < pHeader->m_NamesSize;
+	if (!Valid)
+	{
+		dbg_msg("stats", "invalid snapshot '%s'", pPath);
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void CStatsSnapshot::Close()
+{
+	if (m_pData)
+	{
+#if defined(CONF_FAMILY_UNIX)
+		if (m_Mapped)
+			munmap(m_pData, m_Size);
+		else
+#endif
+			mem_free(m_pData);
+	}
+	m_pHeader = 0;
+	m_pData = 0;
+	m_Size = 0;
+	m_Mapped = false;
+}
+
+const char *CStatsSnapshot::Name(int Index) const
+{
+	const int *pNameOffsets = (const int *)(m_pData + m_pHeader->m_NameOffsetsOffset);
+	return (const char *)(m_pData + m_pHeader->m_NamesOffset + pNameOffsets[Index]);
+}
+
+CStatsSnapshotJob::CStatsSnapshotJob()
+{
+	m_aStatsDir[0] = 0;
+	m_aPath[0] = 0;
+	m_Started = false;
+}
+
+CStatsSnapshotJob::~CStatsSnapshotJob()
+{
+	while (IsRunning())
+		thread_sleep(1);
+}
+
+int CStatsSnapshotJob::Run(void *pUser)
+{
+	CStatsSnapshotJob *pSelf = (CStatsSnapshotJob *)pUser;
+	int64 Start = time_get();
+	int NumPlayers = CStatsSnapshot::Write(pSelf->m_aStatsDir, pSelf->m_aPath);
+	if (NumPlayers >= 0)
+		dbg_msg("stats", "wrote snapshot of %d players to '%s' in %.2fms", NumPlayers, pSelf->m_aPath, (time_get()-Start)*1000.0f/time_freq());
+	return NumPlayers;
+}
+
+void CStatsSnapshotJob::Start(IEngine *pEngine, const char *pStatsDir, const char *pPath)
+{
+	if (IsRunning())
+		return;
+	str_copy(m_aStatsDir, pStatsDir, sizeof(m_aStatsDir));
+	str_copy(m_aPath, pPath, sizeof(m_aPath));
+	m_Started = true;
+	pEngine->AddJob(&m_Job, Run, this);
+}
+
+CRankFormula::CRankFormula()
+{
+	mem_zero(m_aWeights, sizeof(m_aWeights));
+	m_aWeights[CStatsSnapshot::COL_FREEZES] = 1;
+	m_aWeights[CStatsSnapshot::COL_KILLS] = 3;
+	m_aWeights[CStatsSnapshot::COL_GOLD_SPIKES] = 5;
+	m_aWeights[CStatsSnapshot::COL_GREEN_SPIKES] = 3;
+	m_aWeights[CStatsSnapshot::COL_PURPLE_SPIKES] = 7;
+	m_Constant = 0;
+	m_NumTerms = 0;
+	for (int i = 0; i < CStatsSnapshot::NUM_COLUMNS; i++)
+		if (m_aWeights[i])
+			m_aTerms[m_NumTerms++] = i;
+}
+
+bool CRankFormula::Compile(const char *pFormula, char *pError, int ErrorSize)
+{
+	int aWeights[CStatsSnapshot::NUM_COLUMNS] = {0};
+	int Constant = 0;
+	const char *p = str_skip_whitespaces_const(pFormula);
+	int Sign = 1;
+	if (*p == '-' || *p == '+')
+	{
+		Sign = *p == '-' ? -1 : 1;
+		p = str_skip_whitespaces_const(p+1);
+	}
+	while (1)
+	{
+		// one product
+		int Factor = 1;
+		int Column = -1;
+		while (1)
+		{
+			p = str_skip_whitespaces_const(p);
+			if (*p >= '0' && *p <= '9')
+			{
+				int Number = 0;
+				for (; *p >= '0' && *p <= '9'; p++)
+				{
+					Number = Number*10 + (*p - '0');
+					if (Number > MAX_WEIGHT)
+					{
+						str_copy(pError, "number too large", ErrorSize);
+						return false;
+					}
+				}
+				if (Number && Factor > MAX_WEIGHT/Number)
+				{
+					str_copy(pError, "product too large", ErrorSize);
+					return false;
+				}
+				Factor *= Number;
+			}
+			else if ((*p >= 'a' && *p <= 'z') || *p == '_')
+			{
+				char aName[32];
+				int Length = 0;
+				for (; (*p >= 'a' && *p <= 'z') || *p == '_'; p++)
+					if (Length < (int)sizeof(aName)-1)
+						aName[Length++] = *p;
+				aName[Length] = 0;
+				int Found = CStatsSnapshot::FindColumn(aName);
+				if (Found == -1)
+				{
+					str_format(pError, ErrorSize, "unknown column '%s'", aName);
+					return false;
+				}
+				if (Column != -1)
+				{
+					str_copy(pError, "only one column per product", ErrorSize);
+					return false;
+				}
+				Column = Found;
+			}
+			else
+			{
+				str_format(pError, ErrorSize, "expected a number or a column at '%s'", p);
+				return false;
+			}
+			p = str_skip_whitespaces_const(p);
+			if (*p != '*')
+				break;
+			p++;
+		}
+		// both are at most MAX_WEIGHT, the sum can not overflow
+		int *pWeight = Column == -1 ? &Constant : &aWeights[Column];
+		*pWeight += Sign*Factor;
+		if (*pWeight > MAX_WEIGHT || *pWeight < -MAX_WEIGHT)
+		{
+			str_copy(pError, "weight too large", ErrorSize);
+			return false;
+		}
+
+		if (!*p)
+			break;
+		if (*p != '+' && *p != '-')
+		{
+			str_format(pError, ErrorSize, "unexpected '%c'", *p);
+			return false;
+		}
+		Sign = *p == '-' ? -1 : 1;
+		p++;
+	}
+
+	mem_copy(m_aWeights, aWeights, sizeof(m_aWeights));
+	m_Constant = Constant;
+	m_NumTerms = 0;
+	for (int i = 0; i < CStatsSnapshot::NUM_COLUMNS; i++)
+		if (m_aWeights[i])
+			m_aTerms[m_NumTerms++] = i;
+	return true;
+}
+
+bool CRankFormula::operator==(const CRankFormula &Other) const
+{
+	return m_Constant == Other.m_Constant && !mem_comp(m_aWeights, Other.m_aWeights, sizeof(m_aWeights));
+}
+
+// the weights are bounded, 64 bits hold any sum of the int columns
+static int ClampScore(int64 Score)
+{
+	return (int)clamp(Score, -(int64)0x7fffffff - 1, (int64)0x7fffffff);
+}
+
+int CRankFormula::Score(const CFngStats *pStats) const
+{
+	int64 Score = m_Constant;
+	for (int i = 0; i < m_NumTerms; i++)
+		Score += (int64)m_aWeights[m_aTerms[i]] * CStatsSnapshot::ColumnValue(pStats, m_aTerms[i]);
+	return ClampScore(Score);
+}
+
+int CRankFormula::Score(const int *pValues) const
+{
+	int64 Score = m_Constant;
+	for (int i = 0; i < m_NumTerms; i++)
+		Score += (int64)m_aWeights[m_aTerms[i]] * pValues[m_aTerms[i]];
+	return ClampScore(Score);
+}
+
+#if defined(CONF_SIMD_SSE2)
+// signed 32x32 bit products of the even lanes into two 64 bit lanes. sse2 only
+// multiplies unsigned, a negative factor adds the other one times 2^32
+static inline __m128i MulEven64(__m128i a, __m128i b)
+{
+	__m128i Fix = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(a, 31), b), _mm_and_si128(_mm_srai_epi32(b, 31), a));
+	return _mm_sub_epi64(_mm_mul_epu32(a, b), _mm_slli_epi64(Fix, 32));
+}
+#endif
+
+void CRankFormula::Score(const CStatsSnapshot *pSnapshot, int *pScores) const
+{
+	// the sums of big weights don't fit into 32 bits, clamped like the other scores
+	const int Num = pSnapshot->NumPlayers();
+	std::vector<int64> vSums(Num, (int64)m_Constant);
+	int64 *pSums = Num ? &vSums[0] : 0;
+	for (int t = 0; t < m_NumTerms; t++)
+	{
+		const int *pColumn = pSnapshot->Column(m_aTerms[t]);
+		const int Weight = m_aWeights[m_aTerms[t]];
+		int i = 0;
+#if defined(CONF_SIMD_SSE2)
+		const __m128i W = _mm_set1_epi32(Weight);
+		for (; i+4 <= Num; i += 4)
+		{
+			__m128i Value = _mm_loadu_si128((const __m128i *)(pColumn+i));
+			__m128i Even = MulEven64(Value, W);
+			__m128i Odd = MulEven64(_mm_srli_si128(Value, 4), W);
+			__m128i *pSum = (__m128i *)(pSums+i);
+			_mm_storeu_si128(pSum, _mm_add_epi64(_mm_loadu_si128(pSum), _mm_unpacklo_epi64(Even, Odd)));
+			_mm_storeu_si128(pSum+1, _mm_add_epi64(_mm_loadu_si128(pSum+1), _mm_unpackhi_epi64(Even, Odd)));
+		}
+#elif defined(CONF_SIMD_NEON)
+		const int32x2_t W = vdup_n_s32(Weight);
+		for (; i+4 <= Num; i += 4)
+		{
+			int32x4_t Value = vld1q_s32(pColumn+i);
+			vst1q_s64(pSums+i, vmlal_s32(vld1q_s64(pSums+i), vget_low_s32(Value), W));
+			vst1q_s64(pSums+i+2, vmlal_s32(vld1q_s64(pSums+i+2), vget_high_s32(Value), W));
+		}
+#endif
+		for (; i < Num; i++)
+			pSums[i] += (int64)pColumn[i] * Weight;
+	}
+	for (int i = 0; i < Num; i++)
+		pScores[i] = ClampScore(pSums[i]);
+}
+
+CRankIndex::CRankIndex()
+{
+	m_pEngine = 0;
+	m_aStatsDir[0] = 0;
+	m_Ready = false;
+	m_Building = false;
+	m_AbortBuild = false;
+	m_RebuildPending = false;
+	m_NextBuild = 0;
+}
+
+CRankIndex::~CRankIndex()
+{
+	// only on shutdown, the build stops at the next file
+	m_AbortBuild = true;
+	while (m_Building && m_Job.Status() != CJob::STATE_DONE)
+		thread_sleep(1);
+}
+
+void CRankIndex::Init(IEngine *pEngine, const char *pStatsDir, const CRankFormula &Formula)
+{
+	if (m_pEngine)
+	{
+		SetFormula(Formula);
+		return;
+	}
+	m_pEngine = pEngine;
+	str_copy(m_aStatsDir, pStatsDir, sizeof(m_aStatsDir));
+	m_Formula = Formula;
+	StartBuild();
+}
+
+static bool CompareRankEntries(const CRankIndex::CEntry &a, const CRankIndex::CEntry &b)
+{
+	if (a.m_Score != b.m_Score)
+		return a.m_Score > b.m_Score;
+	return str_comp(a.m_aName, b.m_aName) < 0;
+}
+
+void CRankIndex::Sort(std::vector<CEntry> *pEntries)
+{
+	std::sort(pEntries->begin(), pEntries->end(), CompareRankEntries);
+}
+
+struct CRankIndexBuilder
+{
+	const char *m_pStatsDir;
+	const CRankFormula *m_pFormula;
+	std::vector<CRankIndex::CEntry> *m_pEntries;
+	volatile bool *m_pAbort;
+};
+
+static int RankListCallback(const char *pName, int IsDir, int DirType, void *pUser)
+{
+	CRankIndexBuilder *pBuilder = (CRankIndexBuilder *)pUser;
+	if (*pBuilder->m_pAbort)
+		return 1;
+	if (IsDir || !str_endswith(pName, ".acc"))
+		return 0;
+	char aFilePath[MAX_FILE_PATH];
+	str_format(aFilePath, sizeof(aFilePath), "%s/%s", pBuilder->m_pStatsDir, pName);
+	CFngStats Stats;
+	if (ReadStatsFile(aFilePath, &Stats))
+		return 0;
+	CRankIndex::CEntry Entry;
+	str_copy(Entry.m_aName, Stats.m_aName, sizeof(Entry.m_aName));
+	Entry.m_Score = pBuilder->m_pFormula->Score(&Stats);
+	pBuilder->m_pEntries->push_back(Entry);
+	return 0;
+}
+
+int CRankIndex::BuildJob(void *pUser)
+{
+	CRankIndex *pSelf = (CRankIndex *)pUser;
+	int64 Start = time_get();
+	CRankIndexBuilder Builder;
+	Builder.m_pStatsDir = pSelf->m_aStatsDir;
+	Builder.m_pFormula = &pSelf->m_BuildFormula;
+	Builder.m_pEntries = &pSelf->m_vBuild;
+	Builder.m_pAbort = &pSelf->m_AbortBuild;
+	pSelf->m_vBuild.clear();
+	fs_listdir(pSelf->m_aStatsDir, RankListCallback, 0, &Builder);
+	Sort(&pSelf->m_vBuild);
+	dbg_msg("stats", "built rank index of %d players in %.2fms", (int)pSelf->m_vBuild.size(), (time_get()-Start)*1000.0f/time_freq());
+	return 0;
+}
+
+void CRankIndex::StartBuild()
+{
+	m_BuildFormula = m_Formula;
+	m_Building = true;
+	m_RebuildPending = false;
+	m_NextBuild = time_get() + REBUILD_INTERVAL*time_freq();
+	m_pEngine->AddJob(&m_Job, BuildJob, this);
+}
+
+void CRankIndex::SetFormula(const CRankFormula &Formula)
+{
+	if (m_pEngine && Formula == m_Formula)
+		return;
+	m_Formula = Formula;
+	if (!m_pEngine)
+		return;
+	// the running build uses the old formula, start over when it is done
+	if (m_Building)
+		m_RebuildPending = true;
+	else
+		StartBuild();
+}
+
+void CRankIndex::Apply(const CFngStats *pStats)
+{
+	int Rank = Find(pStats->m_aName);
+	if (Rank != -1)
+		m_vEntries.erase(m_vEntries.begin() + Rank);
+	CEntry Entry;
+	str_copy(Entry.m_aName, pStats->m_aName, sizeof(Entry.m_aName));
+	Entry.m_Score = m_IndexFormula.Score(pStats);
+	m_vEntries.insert(std::lower_bound(m_vEntries.begin(), m_vEntries.end(), Entry, CompareRankEntries), Entry);
+}
+
+void CRankIndex::OnSave(const CFngStats *pStats)
+{
+	if (m_Building)
+		m_vBuildUpdates.push_back(*pStats);
+	if (m_Ready)
+		Apply(pStats);
+}
+
+void CRankIndex::Update()
+{
+	// other servers and the stats tools change files behind the index
+	if (m_pEngine && !m_Building && time_get() > m_NextBuild)
+		StartBuild();
+	if (!m_Building || m_Job.Status() != CJob::STATE_DONE)
+		return;
+	m_Building = false;
+	if (m_RebuildPending)
+	{
+		StartBuild();
+		return;
+	}
+	m_vEntries.swap(m_vBuild);
+	m_vBuild.clear();
+	m_IndexFormula = m_BuildFormula;
+	m_Ready = true;
+	// the build could have read the files before these saves
+	for (unsigned i = 0; i < m_vBuildUpdates.size(); i++)
+		Apply(&m_vBuildUpdates[i]);
+	m_vBuildUpdates.clear();
+}
+
+int CRankIndex::Find(const char *pName) const
+{
+	for (unsigned i = 0; i < m_vEntries.size(); i++)
+		if (!str_comp(m_vEntries[i].m_aName, pName))
+			return i;
+	return -1;
+}
+
+static const char *s_apWindowNames[CStatsWindows::NUM_WINDOWS] = {
+	"today",
+	"week",
+	"season",
+};
+
+enum
+{
+	WINDOW_FILE_LOG=0, // <date>.log, the saves of one day
+	WINDOW_FILE_DAY, // <date>.sum
+	WINDOW_FILE_WEEK, // week-<date of the monday>.sum
+};
+
+struct CWindowFile
+{
+	int m_Day;
+	int m_Type;
+};
+
+static bool CompareWindowFiles(const CWindowFile &a, const CWindowFile &b)
+{
+	if (a.m_Day != b.m_Day)
+		return a.m_Day < b.m_Day;
+	return a.m_Type < b.m_Type;
+}
+
+static int WindowListCallback(const char *pName, int IsDir, int DirType, void *pUser)
+{
+	std::vector<CWindowFile> *pFiles = (std::vector<CWindowFile> *)pUser;
+	if (IsDir)
+		return 0;
+	CWindowFile File;
+	File.m_Type = WINDOW_FILE_DAY;
+	if (str_startswith(pName, "week-"))
+	{
+		File.m_Type = WINDOW_FILE_WEEK;
+		pName += 5;
+	}
+	char aDate[11];
+	str_copy(aDate, pName, sizeof(aDate));
+	File.m_Day = CStatsWindows::ParseDay(aDate);
+	if (File.m_Day == -1 || str_length(pName) != 14)
+		return 0;
+	if (File.m_Type == WINDOW_FILE_DAY && !str_comp(pName+10, ".log"))
+		File.m_Type = WINDOW_FILE_LOG;
+	else if (str_comp(pName+10, ".sum"))
+		return 0;
+	pFiles->push_back(File);
+	return 0;
+}
+
+static bool CompareWindowEntries(const CStatsWindows::CEntry &a, const CStatsWindows::CEntry &b)
+{
+	if (a.m_Score != b.m_Score)
+		return a.m_Score > b.m_Score;
+	return str_comp(a.m_aName, b.m_aName) < 0;
+}
+
+CStatsWindows::CStatsWindows()
+{
+	m_pEngine = 0;
+	m_aDir[0] = 0;
+	m_SeasonStart = -1;
+	m_BoardDay = -1;
+	m_Ready = false;
+	m_NextBuild = 0;
+	m_Building = false;
+	m_BuildDay = -1;
+	m_RescorePending = false;
+	m_SeasonBaseWeek = -1;
+}
+
+CStatsWindows::~CStatsWindows()
+{
+	while (m_Building && m_Job.Status() != CJob::STATE_DONE)
+		thread_sleep(1);
+	if (m_aDir[0])
+		AppendRecords(m_vPending);
+}
+
+const char *CStatsWindows::WindowName(int Window)
+{
+	return s_apWindowNames[Window];
+}
+
+int CStatsWindows::FindWindow(const char *pName)
+{
+	for (int i = 0; i < NUM_WINDOWS; i++)
+		if (!str_comp_nocase(s_apWindowNames[i], pName))
+			return i;
+	return -1;
+}
+
+// civil date <-> day number, see http://howardhinnant.github.io/date_algorithms.html
+int CStatsWindows::ParseDay(const char *pDate)
+{
+	int Year, Month, Day;
+	if (str_length(pDate) != 10 || pDate[4] != '-' || pDate[7] != '-' ||
+		sscanf(pDate, "%4d-%2d-%2d", &Year, &Month, &Day) != 3 ||
+		Year < 1970 || Month < 1 || Month > 12 || Day < 1 || Day > 31)
+		return -1;
+	Year -= Month <= 2;
+	const int Era = Year / 400;
+	const int YearOfEra = Year - Era*400;
+	const int DayOfYear = (153*(Month + (Month > 2 ? -3 : 9)) + 2)/5 + Day-1;
+	const int DayOfEra = YearOfEra*365 + YearOfEra/4 - YearOfEra/100 + DayOfYear;
+	return Era*146097 + DayOfEra - 719468;
+}
+
+void CStatsWindows::FormatDay(int Day, char *pBuf, int BufSize)
+{
+	Day += 719468;
+	const int Era = Day / 146097;
+	const int DayOfEra = Day - Era*146097;
+	const int YearOfEra = (DayOfEra - DayOfEra/1460 + DayOfEra/36524 - DayOfEra/146096) / 365;
+	const int DayOfYear = DayOfEra - (365*YearOfEra + YearOfEra/4 - YearOfEra/100);
+	const int MonthIndex = (5*DayOfYear + 2)/153;
+	const int Month = MonthIndex < 10 ? MonthIndex+3 : MonthIndex-9;
+	const int Year = YearOfEra + Era*400 + (Month <= 2);
+	str_format(pBuf, BufSize, "%04d-%02d-%02d", Year, Month, DayOfYear - (153*MonthIndex + 2)/5 + 1);
+}
+
+void CStatsWindows::Init(IEngine *pEngine, const char *pStatsDir, const char *pSeasonStart, const CRankFormula &Formula)
+{
+	// the boards are kept over map changes
+	if (m_pEngine)
+	{
+		SetFormula(Formula);
+		return;
+	}
+	m_pEngine = pEngine;
+	str_format(m_aDir, sizeof(m_aDir), "%s/windows", pStatsDir);
+	fs_makedir(m_aDir);
+	m_Formula = Formula;
+	m_SeasonStart = -1;
+	if (pSeasonStart[0])
+	{
+		int Day = ParseDay(pSeasonStart);
+		if (Day == -1)
+			dbg_msg("stats", "invalid season start '%s', expected YYYY-MM-DD", pSeasonStart);
+		else
+			m_SeasonStart = WeekStart(Day);
+	}
+}
+
+void CStatsWindows::DayPath(int Day, const char *pExt, char *pBuf, int BufSize) const
+{
+	char aDate[16];
+	FormatDay(Day, aDate, sizeof(aDate));
+	str_format(pBuf, BufSize, "%s/%s.%s", m_aDir, aDate, pExt);
+}
+
+void CStatsWindows::WeekPath(int Week, char *pBuf, int BufSize) const
+{
+	char aDate[16];
+	FormatDay(Week, aDate, sizeof(aDate));
+	str_format(pBuf, BufSize, "%s/week-%s.sum", m_aDir, aDate);
+}
+
+bool CStatsWindows::ReadRecords(const char *pPath, std::vector<CRecord> *pRecords)
+{
+	FILE *pFile = fopen(pPath, "rb");
+	if (!pFile)
+		return false;
+	CRecord Record;
+	while (fread(&Record, sizeof(Record), 1, pFile) == 1)
+	{
+		Record.m_aName[sizeof(Record.m_aName)-1] = 0;
+		pRecords->push_back(Record);
+	}
+	fclose(pFile);
+	return true;
+}
+
+static bool WriteWindowRecords(const char *pPath, const char *pMode, const void *pRecords, int Size)
+{
+	FILE *pFile = fopen(pPath, pMode);
+	if (!pFile)
+	{
+		dbg_msg("stats", "failed to open '%s' errno=%d", pPath, errno);
+		return false;
+	}
+	bool Written = !Size || fwrite(pRecords, Size, 1, pFile) == 1;
+	if (fclose(pFile) || !Written)
+	{
+		dbg_msg("stats", "failed to write '%s' errno=%d", pPath, errno);
+		return false;
+	}
+	return true;
+}
+
+void CStatsWindows::AppendRecords(const std::vector<CRecord> &vRecords) const
+{
+	// the saves are in order, so every day is one run of records. days that
+	// could be rolled up already are closed, their saves go to the oldest open day
+	const int OpenDay = Today() - (ROLLUP_DELAY-1);
+	for (unsigned Start = 0, End; Start < vRecords.size(); Start = End)
+	{
+		const int Day = maximum(vRecords[Start].m_Day, OpenDay);
+		for (End = Start+1; End < vRecords.size() && maximum(vRecords[End].m_Day, OpenDay) == Day; End++);
+		char aPath[MAX_FILE_PATH];
+		DayPath(Day, "log", aPath, sizeof(aPath));
+		int Lock = LockStatsFile(aPath);
+		if (Lock < 0)
+		{
+			dbg_msg("stats", "error: locked file path='%s'", aPath);
+			continue;
+		}
+		WriteWindowRecords(aPath, "ab", &vRecords[Start], (End-Start)*sizeof(CRecord));
+		UnlockStatsFile(aPath, Lock);
+	}
+}
+
+void CStatsWindows::MergeValues(const int *pFrom, int *pTo)
+{
+	for (int i = 0; i < CStatsSnapshot::NUM_COLUMNS; i++)
+	{
+		switch (i)
+		{
+		case CStatsSnapshot::COL_SPREE_BEST:
+		case CStatsSnapshot::COL_MULTI_BEST:
+		case CStatsSnapshot::COL_LAST_SEEN:
+			pTo[i] = maximum(pTo[i], pFrom[i]);
+			break;
+		case CStatsSnapshot::COL_FIRST_SEEN:
+			pTo[i] = pTo[i] ? minimum(pTo[i], pFrom[i]) : pFrom[i];
+			break;
+		default:
+			pTo[i] += pFrom[i];
+		}
+	}
+}
+
+static bool CompareWindowNames(const CStatsWindows::CEntry &a, const CStatsWindows::CEntry &b)
+{
+	return str_comp(a.m_aName, b.m_aName) < 0;
+}
+
+void CStatsWindows::AddRecords(const std::vector<CRecord> &vRecords, std::vector<CEntry> *pEntries)
+{
+	for (unsigned i = 0; i < vRecords.size(); i++)
+	{
+		CEntry Entry;
+		str_copy(Entry.m_aName, vRecords[i].m_aName, sizeof(Entry.m_aName));
+		Entry.m_Score = 0;
+		mem_copy(Entry.m_aValues, vRecords[i].m_aValues, sizeof(Entry.m_aValues));
+		pEntries->push_back(Entry);
+	}
+}
+
+void CStatsWindows::Combine(std::vector<CEntry> *pEntries)
+{
+	std::sort(pEntries->begin(), pEntries->end(), CompareWindowNames);
+	unsigned Num = 0;
+	for (unsigned i = 0; i < pEntries->size(); i++)
+	{
+		if (Num && !str_comp((*pEntries)[Num-1].m_aName, (*pEntries)[i].m_aName))
+			MergeValues((*pEntries)[i].m_aValues, (*pEntries)[Num-1].m_aValues);
+		else
+			(*pEntries)[Num++] = (*pEntries)[i];
+	}
+	pEntries->resize(Num);
+}
+
+void CStatsWindows::Rank(std::vector<CEntry> *pBoard, const CRankFormula *pFormula)
+{
+	for (unsigned i = 0; i < pBoard->size(); i++)
+		(*pBoard)[i].m_Score = pFormula->Score((*pBoard)[i].m_aValues);
+	std::sort(pBoard->begin(), pBoard->end(), CompareWindowEntries);
+}
+
+bool CStatsWindows::RollUp(const char *pFrom, const char *pTo, int Day)
+{
+	// always locked in the order log, day, week
+	int FromLock = LockStatsFile(pFrom);
+	if (FromLock < 0)
+		return false;
+	int ToLock = LockStatsFile(pTo);
+	if (ToLock < 0)
+	{
+		UnlockStatsFile(pFrom, FromLock);
+		return false;
+	}
+	bool Done = false;
+	std::vector<CRecord> vFrom;
+	// another server could have rolled it up already
+	if (ReadRecords(pFrom, &vFrom))
+	{
+		// a roll up that crashed before removing pFrom has its day in pTo already
+		std::vector<CRecord> vTo;
+		std::vector<CRecord> vRecords;
+		ReadRecords(pTo, &vTo);
+		for (unsigned i = 0; i < vTo.size(); i++)
+			if (vTo[i].m_Day != Day)
+				vRecords.push_back(vTo[i]);
+		std::vector<CEntry> vEntries;
+		AddRecords(vFrom, &vEntries);
+		Combine(&vEntries);
+		for (unsigned i = 0; i < vEntries.size(); i++)
+		{
+			CRecord Record;
+			str_copy(Record.m_aName, vEntries[i].m_aName, sizeof(Record.m_aName));
+			Record.m_Day = Day;
+			mem_copy(Record.m_aValues, vEntries[i].m_aValues, sizeof(Record.m_aValues));
+			vRecords.push_back(Record);
+		}
+		char aTmpPath[MAX_FILE_PATH+4];
+		str_format(aTmpPath, sizeof(aTmpPath), "%s.tmp", pTo);
+		Done = WriteWindowRecords(aTmpPath, "wb", vRecords.empty() ? 0 : &vRecords[0], vRecords.size()*sizeof(CRecord)) &&
+			(!fs_rename(aTmpPath, pTo) || (!fs_remove(pTo) && !fs_rename(aTmpPath, pTo)));
+		if (Done)
+			fs_remove(pFrom);
+		else
+		{
+			dbg_msg("stats", "failed to roll '%s' up into '%s'", pFrom, pTo);
+			fs_remove(aTmpPath);
+		}
+	}
+	UnlockStatsFile(pTo, ToLock);
+	UnlockStatsFile(pFrom, FromLock);
+	return Done;
+}
+
+void CStatsWindows::ReadDay(int Day, std::vector<CRecord> *pRecords) const
+{
+	// the sum is made from the log, both exist after a crashed roll up
+	char aPath[MAX_FILE_PATH];
+	DayPath(Day, "log", aPath, sizeof(aPath));
+	if (ReadRecords(aPath, pRecords))
+		return;
+	DayPath(Day, "sum", aPath, sizeof(aPath));
+	ReadRecords(aPath, pRecords);
+}
+
+int CStatsWindows::BuildJob(void *pUser)
+{
+	CStatsWindows *pSelf = (CStatsWindows *)pUser;
+	int64 Start = time_get();
+	const int Today = pSelf->m_BuildDay;
+	const int Week = WeekStart(Today);
+	pSelf->AppendRecords(pSelf->m_vFlush);
+	pSelf->m_vFlush.clear();
+
+	// closed days become one record per player, those of finished weeks go into the week
+	std::vector<CWindowFile> vFiles;
+	fs_listdir(pSelf->m_aDir, WindowListCallback, 0, &vFiles);
+	std::sort(vFiles.begin(), vFiles.end(), CompareWindowFiles);
+	bool WeeksChanged = false;
+	char aFrom[MAX_FILE_PATH];
+	char aTo[MAX_FILE_PATH];
+	for (unsigned i = 0; i < vFiles.size(); i++)
+	{
+		const int Day = vFiles[i].m_Day;
+		if (vFiles[i].m_Type == WINDOW_FILE_WEEK || Day > Today - ROLLUP_DELAY)
+			continue;
+		if (vFiles[i].m_Type == WINDOW_FILE_LOG)
+		{
+			pSelf->DayPath(Day, "log", aFrom, sizeof(aFrom));
+			pSelf->DayPath(Day, "sum", aTo, sizeof(aTo));
+			pSelf->RollUp(aFrom, aTo, Day);
+		}
+		if (WeekStart(Day) < Week)
+		{
+			pSelf->DayPath(Day, "sum", aFrom, sizeof(aFrom));
+			pSelf->WeekPath(WeekStart(Day), aTo, sizeof(aTo));
+			WeeksChanged |= pSelf->RollUp(aFrom, aTo, Day);
+		}
+	}
+
+	// the finished weeks of the season only change once a week and when their last days are rolled up
+	const bool Season = pSelf->m_SeasonStart != -1 && pSelf->m_SeasonStart <= Today;
+	if (Season && (WeeksChanged || pSelf->m_SeasonBaseWeek != Week))
+	{
+		pSelf->m_vSeasonBase.clear();
+		vFiles.clear();
+		fs_listdir(pSelf->m_aDir, WindowListCallback, 0, &vFiles);
+		std::sort(vFiles.begin(), vFiles.end(), CompareWindowFiles);
+		std::vector<CRecord> vWeek;
+		std::vector<CRecord> vRecords;
+		for (unsigned i = 0; i < vFiles.size(); i++)
+		{
+			const int FileWeek = WeekStart(vFiles[i].m_Day);
+			if (vFiles[i].m_Type != WINDOW_FILE_WEEK || FileWeek < pSelf->m_SeasonStart || FileWeek >= Week)
+				continue;
+			pSelf->WeekPath(FileWeek, aFrom, sizeof(aFrom));
+			ReadRecords(aFrom, &vWeek);
+		}
+		// days of finished weeks that are not rolled up yet replace their records in the week
+		for (unsigned i = 0; i < vFiles.size(); i++)
+		{
+			const int Day = vFiles[i].m_Day;
+			const int FileWeek = WeekStart(Day);
+			if (vFiles[i].m_Type == WINDOW_FILE_WEEK || FileWeek < pSelf->m_SeasonStart || FileWeek >= Week ||
+				(i && vFiles[i-1].m_Day == Day && vFiles[i-1].m_Type != WINDOW_FILE_WEEK))
+				continue;
+			unsigned Num = 0;
+			for (unsigned r = 0; r < vWeek.size(); r++)
+				if (vWeek[r].m_Day != Day)
+					vWeek[Num++] = vWeek[r];
+			vWeek.resize(Num);
+			pSelf->ReadDay(Day, &vRecords);
+		}
+		AddRecords(vWeek, &pSelf->m_vSeasonBase);
+		AddRecords(vRecords, &pSelf->m_vSeasonBase);
+		Combine(&pSelf->m_vSeasonBase);
+		pSelf->m_SeasonBaseWeek = Week;
+	}
+
+	for (int i = 0; i < NUM_WINDOWS; i++)
+		pSelf->m_avBuild[i].clear();
+	for (int Day = Week; Day <= Today; Day++)
+	{
+		std::vector<CRecord> vRecords;
+		pSelf->ReadDay(Day, &vRecords);
+		AddRecords(vRecords, &pSelf->m_avBuild[WINDOW_WEEK]);
+		if (Day == Today)
+			AddRecords(vRecords, &pSelf->m_avBuild[WINDOW_TODAY]);
+	}
+	Combine(&pSelf->m_avBuild[WINDOW_TODAY]);
+	Combine(&pSelf->m_avBuild[WINDOW_WEEK]);
+	if (Season)
+	{
+		pSelf->m_avBuild[WINDOW_SEASON] = pSelf->m_vSeasonBase;
+		pSelf->m_avBuild[WINDOW_SEASON].insert(pSelf->m_avBuild[WINDOW_SEASON].end(), pSelf->m_avBuild[WINDOW_WEEK].begin(), pSelf->m_avBuild[WINDOW_WEEK].end());
+		Combine(&pSelf->m_avBuild[WINDOW_SEASON]);
+	}
+	for (int i = 0; i < NUM_WINDOWS; i++)
+		Rank(&pSelf->m_avBuild[i], &pSelf->m_BuildFormula);
+	dbg_msg("stats", "built leaderboards of %d/%d/%d players in %.2fms",
+		(int)pSelf->m_avBuild[WINDOW_TODAY].size(), (int)pSelf->m_avBuild[WINDOW_WEEK].size(), (int)pSelf->m_avBuild[WINDOW_SEASON].size(),
+		(time_get()-Start)*1000.0f/time_freq());
+	return 0;
+}
+
+void CStatsWindows::StartBuild()
+{
+	m_vFlush.swap(m_vPending);
+	m_vPending.clear();
+	m_BuildDay = Today();
+	m_BuildFormula = m_Formula;
+	m_RescorePending = false;
+	m_Building = true;
+	m_NextBuild = time_get() + REBUILD_INTERVAL*time_freq();
+	m_pEngine->AddJob(&m_Job, BuildJob, this);
+}
+
+bool CStatsWindows::InWindow(int Window, int Day, int Today) const
+{
+	switch (Window)
+	{
+	case WINDOW_TODAY: return Day == Today;
+	case WINDOW_WEEK: return Day >= WeekStart(Today) && Day <= Today;
+	case WINDOW_SEASON: return m_SeasonStart != -1 && Day >= m_SeasonStart && Day <= Today;
+	}
+	return false;
+}
+
+void CStatsWindows::Apply(int Window, const CRecord *pRecord)
+{
+	std::vector<CEntry> &Board = m_avBoards[Window];
+	CEntry Entry;
+	str_copy(Entry.m_aName, pRecord->m_aName, sizeof(Entry.m_aName));
+	mem_copy(Entry.m_aValues, pRecord->m_aValues, sizeof(Entry.m_aValues));
+	for (unsigned i = 0; i < Board.size(); i++)
+	{
+		if (str_comp(Board[i].m_aName, pRecord->m_aName))
+			continue;
+		MergeValues(Board[i].m_aValues, Entry.m_aValues);
+		Board.erase(Board.begin() + i);
+		break;
+	}
+	Entry.m_Score = m_Formula.Score(Entry.m_aValues);
+	Board.insert(std::lower_bound(Board.begin(), Board.end(), Entry, CompareWindowEntries), Entry);
+}
+
+void CStatsWindows::SetFormula(const CRankFormula &Formula)
+{
+	if (Formula == m_Formula)
+		return;
+	m_Formula = Formula;
+	for (int i = 0; i < NUM_WINDOWS; i++)
+		Rank(&m_avBoards[i], &m_Formula);
+	// the running build scores with the old formula
+	if (m_Building)
+		m_RescorePending = true;
+}
+
+void CStatsWindows::OnSave(const CFngStats *pRound)
+{
+	if (!m_aDir[0])
+		return;
+	CRecord Record;
+	str_copy(Record.m_aName, pRound->m_aName, sizeof(Record.m_aName));
+	Record.m_Day = Today();
+	for (int i = 0; i < CStatsSnapshot::NUM_COLUMNS; i++)
+		Record.m_aValues[i] = CStatsSnapshot::ColumnValue(pRound, i);
+	Record.m_aValues[CStatsSnapshot::COL_FIRST_SEEN] = time(NULL);
+	Record.m_aValues[CStatsSnapshot::COL_LAST_SEEN] = time(NULL);
+	m_vPending.push_back(Record);
+	if (m_Ready)
+	{
+		for (int i = 0; i < NUM_WINDOWS; i++)
+			if (InWindow(i, Record.m_Day, m_BoardDay))
+				Apply(i, &Record);
+	}
+	if (!m_pEngine)
+	{
+		AppendRecords(m_vPending);
+		m_vPending.clear();
+	}
+}
+
+void CStatsWindows::Update()
+{
+	if (m_Building && m_Job.Status() == CJob::STATE_DONE)
+	{
+		m_Building = false;
+		for (int i = 0; i < NUM_WINDOWS; i++)
+		{
+			m_avBoards[i].swap(m_avBuild[i]);
+			m_avBuild[i].clear();
+			if (m_RescorePending)
+				Rank(&m_avBoards[i], &m_Formula);
+		}
+		m_BoardDay = m_BuildDay;
+		m_Ready = true;
+		// saved after the job started, so they are not in the files it read
+		for (unsigned r = 0; r < m_vPending.size(); r++)
+			for (int i = 0; i < NUM_WINDOWS; i++)
+				if (InWindow(i, m_vPending[r].m_Day, m_BoardDay))
+					Apply(i, &m_vPending[r]);
+	}
+	if (m_pEngine && m_aDir[0] && !m_Building && (time_get() >= m_NextBuild || Today() != m_BoardDay))
+		StartBuild();
+}
@@ -1,6 +1,10 @@
 #ifndef GAME_SERVER_STATS_H
 #define GAME_SERVER_STATS_H
 
+#include <vector>
+
+#include <base/system.h>
+#include <engine/shared/jobs.h>
 #include <engine/shared/protocol.h>
 #include "time.h"
 
@@ -17,6 +21,11 @@ enum {
 	CFG_UNUSED4=32,
 	CFG_UNUSED5=64,
 	MAX_CFG_FLAGS,
+
+	// set on round stats when the flags are the player's, a merge only takes
+	// the flags of pFrom with it. round stats that were saved before the
+	// record was loaded leave the stored flags alone
+	CFG_KNOWN=1<<30,
 };
 
 struct CFngStats {
@@ -35,4 +44,693 @@ struct CFngStats {
 		time_t m_FirstSeen, m_LastSeen, m_TotalOnlineTime;
 };
 
+// stats files are FNG_MAGIC, FNG_VERSION and then the struct as is.
+// returns 0 or the error codes of CGameContext::LoadStatsFile
+int ReadStatsFile(const char *pPath, CFngStats *pStats);
+bool WriteStatsFile(const char *pPath, const CFngStats *pStats);
+// takes the .lck file next to the stats file, -1 if it stays locked
+int LockStatsFile(const char *pPath);
+void UnlockStatsFile(const char *pPath, int Lock);
+// adds the counters of pFrom to pTo, the current spree, multi and known config come from pFrom
+void MergeFngStats(const CFngStats *pFrom, CFngStats *pTo);
+// merges pStats into the stats file at pPath under its lock, creates the file if needed.
+// pMerged gets the record that was written
+bool MergeStatsFile(const char *pPath, const CFngStats *pStats, CFngStats *pMerged = 0);
+
+/*
+	Class: CStatsJournal
+		Keeps the round stats of every client slot in a memory mapped file.
+		The players update their stats in place, so the stats that were not
+		saved yet are still on disk after a crash and get saved on the next
+		start. Saved round stats move to a pending slot that is kept until
+		the backend confirmed the write. Without a journal file the slots
+		are plain memory.
+*/
+class CStatsJournal
+{
+public:
+	enum
+	{
+		// the slots of the queued writes follow the client slots
+		MAX_PENDING=256,
+		NUM_SLOTS=MAX_CLIENTS+MAX_PENDING,
+	};
+
+private:
+	struct CHeader
+	{
+		char m_aMagic[4];
+		int m_Version;
+		int m_NumSlots;
+		int m_SlotSize;
+	};
+
+	struct CSlot
+	{
+		int m_Used;
+		int m_Unused;
+		CFngStats m_Stats;
+	};
+
+	enum
+	{
+		// version 1 had no pending slots
+		JOURNAL_VERSION=2,
+	};
+
+	CHeader *m_pHeader;
+	CSlot *m_pSlots;
+	CSlot m_aMemSlots[NUM_SLOTS];
+	int m_File;
+
+public:
+	CStatsJournal();
+	~CStatsJournal();
+
+	bool Open(const char *pPath);
+	void Close();
+	bool IsOpen() const { return m_pHeader != 0; }
+
+	CFngStats *Stats(int Slot) { return &m_pSlots[Slot].m_Stats; }
+	// used slots hold stats that are not in the stats files yet
+	bool IsUsed(int Slot) const { return m_pSlots[Slot].m_Used != 0; }
+	void SetUsed(int Slot, bool Used) { m_pSlots[Slot].m_Used = Used; }
+	// copies pStats to a free pending slot, -1 if there is none
+	int Keep(const CFngStats *pStats);
+};
+
+/*
+	Struct: CStatsSave
+		One save of the round stats of a player.
+*/
+struct CStatsSave
+{
+	enum
+	{
+		RESULT_OK=0,
+		RESULT_FAILED, // the round stats went to the fail path
+		RESULT_LOST,
+	};
+
+	char m_aName[MAX_NAME_LENGTH];
+	int m_Result;
+	// pending journal slot that is released once the round stats are stored, or -1
+	int m_JournalSlot;
+	// always merged into what is in the stats file at the time of the write
+	CFngStats m_Round;
+	// the record after the save, set by backends that know it
+	bool m_HasMerged;
+	CFngStats m_Merged;
+};
+
+/*
+	Class: IStatsBackend
+		Where the stats records are kept. Loads and saves run on
+		the engine job threads, so the backends are thread safe.
+*/
+class IStatsBackend
+{
+public:
+	virtual ~IStatsBackend() {}
+
+	// returns 0 or the error codes of CGameContext::LoadStatsFile, -2 if pName can not be a file name
+	virtual int Load(const char *pName, CFngStats *pStats) = 0;
+	// sets m_Result of every save to RESULT_OK or RESULT_FAILED
+	virtual void Save(CStatsSave *pSaves, int Num) = 0;
+};
+
+/*
+	Class: CStatsFileBackend
+		Reads and writes the stats files in the stats directory.
+		Writes take the lock file of the stats file, which is
+		enough for a single server.
+*/
+class CStatsFileBackend : public IStatsBackend
+{
+	char m_aPath[MAX_FILE_PATH];
+
+public:
+	CStatsFileBackend();
+
+	void Init(const char *pStatsPath);
+	// false if pName can not be a file name
+	bool RecordPath(const char *pName, char *pBuf, int BufSize) const;
+
+	virtual int Load(const char *pName, CFngStats *pStats);
+	virtual void Save(CStatsSave *pSaves, int Num);
+};
+
+/*
+	Class: CStatsServerBackend
+		Loads and saves through a stats server (see statssrv), so
+		several game servers can share one stats directory. Saves
+		only send the round stats, the stats server merges them
+		into the files. Requests from all threads share one
+		connection and are done one after another. A save that
+		times out is sent again with the same id on a new
+		connection, saves only go to the fail path when the stats
+		server can't be reached at all.
+
+		Only saves and record loads go through the server. Rank,
+		top, CRankIndex, CStatsWindows and the snapshots read the
+		local stats path, so all game servers have to run on the
+		stats server's host or mount its directory there. Hosts
+		without access to the stats directory are not supported.
+*/
+class CStatsServerBackend : public IStatsBackend
+{
+	enum
+	{
+		// seconds until a failed connect is tried again, saves go to the fail path meanwhile
+		RECONNECT_DELAY=5,
+		// sends of a save whose answer was lost, the stats server adds it only once
+		SAVE_TRIES=3,
+	};
+
+	NETADDR m_Addr;
+	NETSOCKET m_Socket;
+	bool m_Connected;
+	int64 m_NextConnect;
+	LOCK m_Lock;
+	// tells the saves of this process apart from the ones of other game servers
+	int64 m_Token;
+	int m_SaveSeq;
+
+	bool Connect();
+	void Disconnect();
+	bool Send(const unsigned char *pType, const void *pData, int Size);
+	bool Recv(const unsigned char *pType, void *pData, int Size);
+
+public:
+	CStatsServerBackend();
+	~CStatsServerBackend();
+
+	// pAddress is ip:port, the port defaults to STATSSRV_PORT
+	bool Init(const char *pAddress);
+
+	virtual int Load(const char *pName, CFngStats *pStats);
+	virtual void Save(CStatsSave *pSaves, int Num);
+};
+
+/*
+	Class: CStatsCache
+		Keeps the stats files of the recently seen players in memory.
+		Entries are loaded on the engine job threads when a player
+		enters, so chat commands do not have to read the stats file.
+		Saves add the round stats to the cached record and queue a
+		write that merges them into the stats file under its lock,
+		the writes are done in order by one job at a time, saves that
+		do not fit into the queue wait until they do. The entry takes
+		the written record once its last write is done. When the cache
+		is full the least recently used entry is dropped. Saves the
+		backend fails are merged into the stats files in the fail path.
+		Every queued save keeps its round stats in a pending journal
+		slot until they are stored.
+*/
+class CStatsCache
+{
+public:
+	enum
+	{
+		STATE_EMPTY=0,
+		STATE_LOADED,
+		STATE_MISSING, // there is no stats file for the name
+		STATE_FAILED, // the stats file could not be read
+	};
+
+private:
+	enum
+	{
+		NUM_ENTRIES=256,
+		MAX_WRITES=128,
+	};
+
+	struct CEntry
+	{
+		CStatsCache *m_pCache;
+		char m_aName[MAX_NAME_LENGTH];
+		unsigned m_Hash;
+		int m_State;
+		unsigned m_LastUse;
+		// set while a load job owns m_LoadStats and m_LoadResult
+		bool m_Loading;
+		// the running load could have read the file before the last write
+		bool m_DiscardLoad;
+		// queued writes, with a state of STATE_EMPTY the record was not known for them
+		int m_NumWrites;
+		int m_LoadResult;
+		CFngStats m_LoadStats;
+		CFngStats m_Stats;
+		CJob m_Job;
+	};
+
+	class IEngine *m_pEngine;
+	IStatsBackend *m_pBackend;
+	CStatsJournal *m_pJournal;
+	class CRankIndex *m_pRankIndex;
+	char m_aFailPath[MAX_FILE_PATH];
+	CEntry m_aEntries[NUM_ENTRIES];
+	unsigned m_UseCounter;
+
+	// ring of queued writes, the job owns [m_WriteHead, m_WriteJobEnd)
+	CStatsSave m_aWrites[MAX_WRITES];
+	int m_WriteHead;
+	int m_WriteJobEnd;
+	int m_WriteTail;
+	CJob m_WriteJob;
+	// saves that did not fit into the ring, in order
+	std::vector<CStatsSave> m_vOverflow;
+
+	CEntry *Find(const char *pName);
+	CEntry *Alloc(const char *pName);
+	static int LoadJob(void *pUser);
+	static int WriteJob(void *pUser);
+	void DoWrites(CStatsSave *pWrites, int Num);
+	void FinishWrite(CStatsSave *pWrite);
+	void FinishWriteJob();
+	void StartWriteJob();
+	void QueueOverflow();
+	void Flush();
+
+public:
+	CStatsCache();
+	~CStatsCache();
+
+	int m_SaveFails;
+	int m_CriticalSaveFails;
+
+	// without an engine nothing runs in the background, pJournal and pRankIndex can be empty.
+	// pRankIndex gets the records the writes left in the stats files
+	void Init(class IEngine *pEngine, IStatsBackend *pBackend, const char *pFailPath, CStatsJournal *pJournal, class CRankIndex *pRankIndex);
+
+	// starts loading the stats file of pName in the background
+	void Prefetch(const char *pName);
+	// returns the state of the entry, pStats is only filled for STATE_LOADED
+	// and pError, the error of IStatsBackend::Load, only for STATE_FAILED
+	int Get(const char *pName, CFngStats *pStats, int *pError = 0);
+	// stores what was just read from the stats file
+	void Set(const char *pName, const CFngStats *pStats);
+	void SetMissing(const char *pName);
+	// the stats file was changed behind the cache
+	void Invalidate(const char *pName);
+	/*
+		Function: Save
+			Adds the round stats to the record of pName and
+			queues the write to the stats file.
+
+		Parameters:
+			JournalSlot - pending journal slot that already holds pRound,
+				-1 to copy pRound to a new one
+
+		Returns:
+			false if pName can not be used as file name
+	*/
+	bool Save(const char *pName, const CFngStats *pRound, int JournalSlot = -1);
+	// applies finished loads and writes, call once per tick
+	void Update();
+};
+
+/*
+	Class: CStatsSnapshot
+		Columnar export of a whole stats directory for leaderboards
+		and analytics. Every column is one contiguous int array with
+		an entry per player, followed by a name dictionary. The file
+		is mapped read only, so queries do not touch the stats files.
+		Times are unix seconds truncated to int.
+*/
+class CStatsSnapshot
+{
+public:
+	enum
+	{
+		COL_KILLS=0,
+		COL_DEATHS,
+		COL_GOLD_SPIKES,
+		COL_GREEN_SPIKES,
+		COL_PURPLE_SPIKES,
+		COL_RIFLE_SHOTS,
+		COL_FREEZES,
+		COL_FROZEN,
+		COL_SPREE_BEST,
+		COL_MULTI_BEST,
+		COL_FIRST_SEEN,
+		COL_LAST_SEEN,
+		COL_ONLINE_TIME,
+		NUM_COLUMNS,
+	};
+
+private:
+	enum
+	{
+		SNAPSHOT_VERSION=1,
+		// columns start on a cache line
+		ALIGNMENT=64,
+	};
+
+	struct CHeader
+	{
+		char m_aMagic[4];
+		int m_Version;
+		int m_NumPlayers;
+		int m_NumColumns;
+		int m_Created;
+		int m_aColumnOffsets[NUM_COLUMNS];
+		// one offset into the names per player
+		int m_NameOffsetsOffset;
+		int m_NamesOffset;
+		int m_NamesSize;
+		int m_Size;
+	};
+
+	const CHeader *m_pHeader;
+	unsigned char *m_pData;
+	unsigned m_Size;
+	bool m_Mapped;
+
+public:
+	CStatsSnapshot();
+	~CStatsSnapshot();
+
+	static const char *ColumnName(int Column);
+	// returns -1 for unknown names
+	static int FindColumn(const char *pName);
+	// the value that goes into the column for pStats
+	static int ColumnValue(const CFngStats *pStats, int Column);
+
+	/*
+		Function: Write
+			Reads all stats files in pStatsDir and writes the
+			snapshot to pPath. The file is replaced at once,
+			readers never see a half written snapshot.
+
+		Returns:
+			the number of players or -1 on error
+	*/
+	static int Write(const char *pStatsDir, const char *pPath);
+
+	bool Open(const char *pPath);
+	void Close();
+
+	int NumPlayers() const { return m_pHeader ? m_pHeader->m_NumPlayers : 0; }
+	time_t Created() const { return m_pHeader ? m_pHeader->m_Created : 0; }
+	const int *Column(int Column) const { return (const int *)(m_pData + m_pHeader->m_aColumnOffsets[Column]); }
+	const char *Name(int Index) const;
+};
+
+/*
+	Class: CStatsSnapshotJob
+		Writes a CStatsSnapshot on an engine job thread.
+*/
+class CStatsSnapshotJob
+{
+	CJob m_Job;
+	char m_aStatsDir[MAX_FILE_PATH];
+	char m_aPath[MAX_FILE_PATH];
+	bool m_Started;
+
+	static int Run(void *pUser);
+
+public:
+	CStatsSnapshotJob();
+	~CStatsSnapshotJob();
+
+	bool IsRunning() const { return m_Started && m_Job.Status() != CJob::STATE_DONE; }
+	// does nothing if the last snapshot is still being written
+	void Start(class IEngine *pEngine, const char *pStatsDir, const char *pPath);
+};
+
+/*
+	Class: CRankFormula
+		Linear score over the snapshot columns, for example
+		"freezes + kills*3 + gold_spikes*5". The formula is parsed
+		once into one weight per column and a constant.
+*/
+class CRankFormula
+{
+public:
+	enum
+	{
+		// bound of the numbers, products and weights, scores of any stats fit into 64 bits
+		MAX_WEIGHT=1000000,
+	};
+
+private:
+	int m_aWeights[CStatsSnapshot::NUM_COLUMNS];
+	int m_Constant;
+	// the columns with a weight, Score only looks at those
+	int m_aTerms[CStatsSnapshot::NUM_COLUMNS];
+	int m_NumTerms;
+
+public:
+	// starts with the classic fng score
+	CRankFormula();
+
+	/*
+		Function: Compile
+			Parses sums and differences of products of
+			numbers and at most one column per product.
+
+		Returns:
+			false and the reason in pError on syntax errors
+			or weights above MAX_WEIGHT, the formula is not
+			changed then
+	*/
+	bool Compile(const char *pFormula, char *pError, int ErrorSize);
+	bool operator==(const CRankFormula &Other) const;
+	// clamped to the int range
+	int Score(const CFngStats *pStats) const;
+	// scores one value per snapshot column
+	int Score(const int *pValues) const;
+	// scores every player of the snapshot into pScores, a column at a time
+	void Score(const CStatsSnapshot *pSnapshot, int *pScores) const;
+	const int *Weights() const { return m_aWeights; }
+	int Constant() const { return m_Constant; }
+};
+
+/*
+	Class: CRankIndex
+		Names and scores of all players in the stats directory,
+		sorted from best to worst. Rebuilds run on an engine job
+		every REBUILD_INTERVAL seconds, the old index answers until
+		the new one is swapped in. Records written by the stats
+		cache move their entry in place, the rebuilds pick up the
+		files other servers and the stats tools changed.
+*/
+class CRankIndex
+{
+public:
+	struct CEntry
+	{
+		char m_aName[MAX_NAME_LENGTH];
+		int m_Score;
+	};
+
+private:
+	enum
+	{
+		// seconds between two rebuilds
+		REBUILD_INTERVAL=300,
+	};
+
+	class IEngine *m_pEngine;
+	char m_aStatsDir[MAX_FILE_PATH];
+	CRankFormula m_Formula;
+	// the formula the scores in m_vEntries come from
+	CRankFormula m_IndexFormula;
+	std::vector<CEntry> m_vEntries;
+	bool m_Ready;
+
+	// owned by the job while m_Building is set
+	CJob m_Job;
+	CRankFormula m_BuildFormula;
+	std::vector<CEntry> m_vBuild;
+	bool m_Building;
+	// stops the running build on shutdown
+	volatile bool m_AbortBuild;
+	bool m_RebuildPending;
+	int64 m_NextBuild;
+	// saved while building, the new index gets them on the swap
+	std::vector<CFngStats> m_vBuildUpdates;
+
+	static int BuildJob(void *pUser);
+	static void Sort(std::vector<CEntry> *pEntries);
+	void Apply(const CFngStats *pStats);
+	void StartBuild();
+
+public:
+	CRankIndex();
+	~CRankIndex();
+
+	// starts the first build, later calls only change the formula
+	void Init(class IEngine *pEngine, const char *pStatsDir, const CRankFormula &Formula);
+	// scores everything again with a new formula in the background
+	void SetFormula(const CRankFormula &Formula);
+	// pStats is the record as it is in the stats file now
+	void OnSave(const CFngStats *pStats);
+	// swaps in finished builds and starts the periodic ones, call once per tick
+	void Update();
+
+	bool IsReady() const { return m_Ready; }
+	int NumEntries() const { return m_vEntries.size(); }
+	// 0 is the best player
+	const CEntry *Entry(int Rank) const { return &m_vEntries[Rank]; }
+	// returns the rank or -1
+	int Find(const char *pName) const;
+};
+
+/*
+	Class: CStatsWindows
+		Leaderboards over the stats of today, this week (since monday)
+		and the season (since sv_stats_season_start), all days in utc.
+		Saves append the round stats of a player to a log file of the
+		day in <stats path>/windows. A job rolls days that are two days
+		old up into one record per player (<date>.sum) and those of
+		finished weeks into week-<monday>.sum, then sorts the boards of
+		all windows. The records of a roll up replace the ones of the
+		same day in the target, so a roll up that is repeated after a
+		crash does not count a day twice. Saves move their board
+		entries in place until the next rebuild.
+*/
+class CStatsWindows
+{
+public:
+	enum
+	{
+		WINDOW_TODAY=0,
+		WINDOW_WEEK,
+		WINDOW_SEASON,
+		NUM_WINDOWS,
+	};
+
+	struct CEntry
+	{
+		char m_aName[MAX_NAME_LENGTH];
+		int m_Score;
+		int m_aValues[CStatsSnapshot::NUM_COLUMNS];
+	};
+
+private:
+	enum
+	{
+		// seconds between two rebuilds of the boards
+		REBUILD_INTERVAL=60,
+		// a day log is rolled up this many days after the day, no save can be appended to it then
+		ROLLUP_DELAY=2,
+	};
+
+	// one save in a day log or one player of a day in a rolled up file
+	struct CRecord
+	{
+		char m_aName[MAX_NAME_LENGTH];
+		int m_Day;
+		int m_aValues[CStatsSnapshot::NUM_COLUMNS];
+	};
+
+	class IEngine *m_pEngine;
+	char m_aDir[MAX_FILE_PATH];
+	// first day of the season or -1
+	int m_SeasonStart;
+	CRankFormula m_Formula;
+	std::vector<CEntry> m_avBoards[NUM_WINDOWS];
+	// the day the boards were built for
+	int m_BoardDay;
+	bool m_Ready;
+	// saved since the last job started
+	std::vector<CRecord> m_vPending;
+	int64 m_NextBuild;
+
+	// owned by the job while m_Building is set
+	CJob m_Job;
+	bool m_Building;
+	int m_BuildDay;
+	CRankFormula m_BuildFormula;
+	// the formula changed while building
+	bool m_RescorePending;
+	std::vector<CRecord> m_vFlush;
+	std::vector<CEntry> m_avBuild[NUM_WINDOWS];
+	// the finished weeks of the season, kept by the job
+	std::vector<CEntry> m_vSeasonBase;
+	int m_SeasonBaseWeek;
+
+	static int BuildJob(void *pUser);
+	void StartBuild();
+	void DayPath(int Day, const char *pExt, char *pBuf, int BufSize) const;
+	void WeekPath(int Week, char *pBuf, int BufSize) const;
+	void AppendRecords(const std::vector<CRecord> &vRecords) const;
+	static bool ReadRecords(const char *pPath, std::vector<CRecord> *pRecords);
+	static void AddRecords(const std::vector<CRecord> &vRecords, std::vector<CEntry> *pEntries);
+	// merges the entries of the same player
+	static void Combine(std::vector<CEntry> *pEntries);
+	static void Rank(std::vector<CEntry> *pBoard, const CRankFormula *pFormula);
+	// replaces the records of Day in pTo by the ones of pFrom and removes pFrom
+	static bool RollUp(const char *pFrom, const char *pTo, int Day);
+	// reads the log of Day, or its sum once it is rolled up
+	void ReadDay(int Day, std::vector<CRecord> *pRecords) const;
+	bool InWindow(int Window, int Day, int Today) const;
+	void Apply(int Window, const CRecord *pRecord);
+
+public:
+	CStatsWindows();
+	~CStatsWindows();
+
+	static const char *WindowName(int Window);
+	// returns -1 for unknown names
+	static int FindWindow(const char *pName);
+	// days since 1970-01-01 of a YYYY-MM-DD date or -1
+	static int ParseDay(const char *pDate);
+	static void FormatDay(int Day, char *pBuf, int BufSize);
+	// counters add up, bests and last seen take the maximum, first seen the minimum
+	static void MergeValues(const int *pFrom, int *pTo);
+	static int Today() { return time(NULL) / (24*60*60); }
+	// weeks start on monday, 1970-01-01 was a thursday
+	static int WeekStart(int Day) { return Day - (Day+3) % 7; }
+
+	// later calls only change the formula
+	void Init(class IEngine *pEngine, const char *pStatsDir, const char *pSeasonStart, const CRankFormula &Formula);
+	void SetFormula(const CRankFormula &Formula);
+	void OnSave(const CFngStats *pRound);
+	// swaps in finished boards and starts the next rebuild, call once per tick
+	void Update();
+
+	bool HasWindow(int Window) const { return Window != WINDOW_SEASON || m_SeasonStart != -1; }
+	bool IsReady() const { return m_Ready; }
+	int NumEntries(int Window) const { return m_avBoards[Window].size(); }
+	// 0 is the best player
+	const CEntry *Entry(int Window, int Rank) const { return &m_avBoards[Window][Rank]; }
+};
+
+/*
+	Class: CStatsService
+		Owns the stats journal, backends, cache and the background
+		jobs. The game context gets rebuilt on every map change, the
+		service lives as long as the server, so queued writes, cached
+		records and schedules stay and the stats settings are only
+		read on the first map.
+*/
+class CStatsService
+{
+	bool m_Inited;
+	bool m_Replayed;
+
+public:
+	CStatsJournal m_Journal;
+	CStatsFileBackend m_FileBackend;
+	CStatsServerBackend m_ServerBackend;
+	IStatsBackend *m_pBackend;
+	CRankIndex m_RankIndex;
+	// declared after the journal, backends and rank index, its last writes need them
+	CStatsCache m_Cache;
+	CStatsSnapshotJob m_SnapshotJob;
+	int64 m_NextSnapshot;
+	CStatsWindows m_Windows;
+
+	CStatsService();
+
+	bool IsInited() const { return m_Inited; }
+	// pServer and pJournal can be empty
+	void Init(class IEngine *pEngine, const char *pStatsPath, const char *pFailPath, const char *pServer, const char *pJournal);
+	// queues the round stats the client slots of the journal hold, all slots on the first call
+	int ReplayJournal();
+};
+
 #endif
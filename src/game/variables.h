@@ -120,6 +120,8 @@ MACRO_CONFIG_STR(SvGametype, sv_gametype, 32, "solofng", CFGFLAG_SAVE|CFGFLAG_SE
 MACRO_CONFIG_INT(SvTournamentMode, sv_tournament_mode, 0, 0, 2, CFGFLAG_SAVE|CFGFLAG_SERVER, "Tournament mode. When enabled, players joins the server as spectator (2=additional restricted spectator chat)")
 MACRO_CONFIG_INT(SvPlayerReadyMode, sv_player_ready_mode, 0, 0, 1, CFGFLAG_SAVE|CFGFLAG_SERVER, "When enabled, players can pause/unpause the game and start the game on warmup via their ready state")
 MACRO_CONFIG_INT(SvSpamprotection, sv_spamprotection, 1, 0, 1, CFGFLAG_SAVE|CFGFLAG_SERVER, "Spam protection")
+MACRO_CONFIG_INT(SvSnapFarInterval, sv_snap_far_interval, 3, 1, 50, CFGFLAG_SAVE|CFGFLAG_SERVER, "Refresh players and flags just outside of a client's screen only every this many snapshots")
+MACRO_CONFIG_INT(SvSnapBudget, sv_snap_budget, 0, 0, 65536, CFGFLAG_SAVE|CFGFLAG_SERVER, "Bytes of off-screen items refreshed per snapshot and client (0 for no limit)")
 
 MACRO_CONFIG_INT(SvRespawnDelayTDM, sv_respawn_delay_tdm, 3, 0, 10, CFGFLAG_SAVE|CFGFLAG_SERVER, "Time needed to respawn after death in tdm gametype")
 
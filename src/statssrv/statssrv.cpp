@@ -0,0 +1,361 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <vector>
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <game/server/stats.h>
+#include <game/version.h>
+
+#include "statssrv.h"
+
+// the single writer of a stats directory that several game servers share.
+// the round stats the servers send are summed up per player and written
+// in one batch every FLUSH_INTERVAL ms, the servers get their answer once
+// their round stats are in the files. the last save of every game server
+// is remembered, a game server that sends it again gets only the answer
+
+enum
+{
+	MAX_STATS_CLIENTS=64,
+	FLUSH_INTERVAL=100,
+	// flush earlier when this many players have unsaved round stats
+	MAX_PENDING=1024,
+	MAX_MESSAGE_SIZE=sizeof(CStatsSrvSaveID)+STATSSRV_MAX_SAVES*sizeof(CFngStats),
+	// game servers whose last save is remembered
+	MAX_SENDERS=256,
+};
+
+struct CClient
+{
+	bool m_Used;
+	bool m_Accepted;
+	NETSOCKET m_Socket;
+	NETADDR m_Addr;
+	// set while the last STATSSRV_SAVE waits for the flush
+	bool m_Waiting;
+	CStatsSrvSaveID m_WaitingSave;
+	int m_BufSize;
+	unsigned char m_aBuf[sizeof(CStatsSrvHeader) + MAX_MESSAGE_SIZE];
+};
+
+// the last save of a game server process
+struct CSender
+{
+	CStatsSrvSaveID m_LastSave;
+	bool m_Written;
+	int64 m_LastUse;
+};
+
+static CClient s_aClients[MAX_STATS_CLIENTS];
+static CSender s_aSenders[MAX_SENDERS];
+static int s_NumSenders;
+static CStatsFileBackend s_Files;
+static char s_aFailPath[MAX_FILE_PATH];
+// round stats that are not in the files yet, one entry per player
+static std::vector<CStatsSave> s_vPending;
+static int64 s_FirstPending;
+
+static void Drop(CClient *pClient, const char *pReason)
+{
+	char aAddr[NETADDR_MAXSTRSIZE];
+	net_addr_str(&pClient->m_Addr, aAddr, sizeof(aAddr), true);
+	dbg_msg("statssrv", "dropped %s: %s", aAddr, pReason);
+	net_tcp_close(pClient->m_Socket);
+	pClient->m_Used = false;
+}
+
+static bool Send(CClient *pClient, const unsigned char *pType, const void *pData, int Size)
+{
+	unsigned char aBuf[sizeof(CStatsSrvHeader) + sizeof(CFngStats) + sizeof(int)];
+	CStatsSrvHeader *pHeader = (CStatsSrvHeader *)aBuf;
+	mem_copy(pHeader->m_aType, pType, sizeof(pHeader->m_aType));
+	pHeader->m_Size = Size;
+	mem_copy(aBuf + sizeof(CStatsSrvHeader), pData, Size);
+	// the answers are small, a client that can not take them is gone
+	if (net_tcp_send(pClient->m_Socket, aBuf, sizeof(CStatsSrvHeader) + Size) != (int)sizeof(CStatsSrvHeader) + Size)
+	{
+		Drop(pClient, "send failed");
+		return false;
+	}
+	return true;
+}
+
+static CSender *FindSender(int64 Token)
+{
+	for (int i = 0; i < s_NumSenders; i++)
+		if (s_aSenders[i].m_LastSave.m_Token == Token)
+		{
+			s_aSenders[i].m_LastUse = time_get();
+			return &s_aSenders[i];
+		}
+	// a new game server takes the slot of the one that saved longest ago
+	CSender *pSender = &s_aSenders[0];
+	if (s_NumSenders < MAX_SENDERS)
+		pSender = &s_aSenders[s_NumSenders++];
+	else
+	{
+		for (int i = 1; i < MAX_SENDERS; i++)
+			if (s_aSenders[i].m_LastUse < pSender->m_LastUse)
+				pSender = &s_aSenders[i];
+	}
+	mem_zero(&pSender->m_LastSave, sizeof(pSender->m_LastSave));
+	pSender->m_LastSave.m_Token = Token;
+	pSender->m_Written = true;
+	pSender->m_LastUse = time_get();
+	return pSender;
+}
+
+static CStatsSave *FindPending(const char *pName)
+{
+	for (unsigned i = 0; i < s_vPending.size(); i++)
+		if (!str_comp(s_vPending[i].m_aName, pName))
+			return &s_vPending[i];
+	return 0;
+}
+
+static void Flush()
+{
+	if (s_vPending.empty())
+		return;
+	int64 Start = time_get();
+	s_Files.Save(&s_vPending[0], s_vPending.size());
+	int Failed = 0;
+	for (unsigned i = 0; i < s_vPending.size(); i++)
+	{
+		CStatsSave *pSave = &s_vPending[i];
+		if (pSave->m_Result == CStatsSave::RESULT_OK)
+			continue;
+		// same as the game servers do, MergeFailedStats picks them up
+		char aFilename[MAX_FILE_LEN];
+		char aFilePath[MAX_FILE_PATH];
+		escape_filename(aFilename, sizeof(aFilename), pSave->m_aName);
+		str_format(aFilePath, sizeof(aFilePath), "%s/%s.acc", s_aFailPath, aFilename);
+		if (!MergeStatsFile(aFilePath, &pSave->m_Round))
+			dbg_msg("statssrv", "error: lost round stats of '%s'", pSave->m_aName);
+		Failed++;
+	}
+	dbg_msg("statssrv", "saved %d players (%d failed) in %.2fms", (int)s_vPending.size(), Failed, (time_get()-Start)*1000.0f/time_freq());
+	s_vPending.clear();
+
+	for (int i = 0; i < s_NumSenders; i++)
+		s_aSenders[i].m_Written = true;
+	for (int i = 0; i < MAX_STATS_CLIENTS; i++)
+	{
+		CClient *pClient = &s_aClients[i];
+		if (!pClient->m_Used || !pClient->m_Waiting)
+			continue;
+		pClient->m_Waiting = false;
+		Send(pClient, STATSSRV_SAVED, &pClient->m_WaitingSave, sizeof(pClient->m_WaitingSave));
+	}
+}
+
+static void Load(CClient *pClient, const unsigned char *pData, int Size)
+{
+	char aName[MAX_NAME_LENGTH];
+	str_copy(aName, (const char *)pData, minimum(Size + 1, (int)sizeof(aName)));
+	CFngStats Stats;
+	int Result = s_Files.Load(aName, &Stats);
+	// the answer has the round stats that are not written yet
+	CStatsSave *pPending = FindPending(aName);
+	if (pPending && Result == 0)
+		MergeFngStats(&pPending->m_Round, &Stats);
+	else if (pPending && Result == 1)
+	{
+		Stats = pPending->m_Round;
+		Stats.m_FirstSeen = time(NULL);
+		Result = 0;
+	}
+	unsigned char aReply[sizeof(CFngStats) + sizeof(int)];
+	mem_copy(aReply, &Stats, sizeof(Stats));
+	mem_copy(aReply + sizeof(Stats), &Result, sizeof(Result));
+	Send(pClient, STATSSRV_RECORD, aReply, sizeof(aReply));
+}
+
+static void Save(CClient *pClient, const unsigned char *pData, int Size)
+{
+	CStatsSrvSaveID ID;
+	if (Size < (int)sizeof(ID) || pClient->m_Waiting)
+	{
+		Drop(pClient, "invalid save");
+		return;
+	}
+	mem_copy(&ID, pData, sizeof(ID));
+	if (ID.m_Num < 0 || Size != (int)(sizeof(ID) + ID.m_Num*sizeof(CFngStats)))
+	{
+		Drop(pClient, "invalid save");
+		return;
+	}
+
+	// the game server did not get the answer to its last save
+	CSender *pSender = FindSender(ID.m_Token);
+	if (!mem_comp(&pSender->m_LastSave, &ID, sizeof(ID)))
+	{
+		dbg_msg("statssrv", "repeated save of %d round stats", ID.m_Num);
+		if (pSender->m_Written)
+			Send(pClient, STATSSRV_SAVED, &ID, sizeof(ID));
+		else
+		{
+			pClient->m_Waiting = true;
+			pClient->m_WaitingSave = ID;
+		}
+		return;
+	}
+	pSender->m_LastSave = ID;
+	pSender->m_Written = false;
+
+	if (s_vPending.empty())
+		s_FirstPending = time_get();
+	for (int i = 0; i < ID.m_Num; i++)
+	{
+		CFngStats Round;
+		mem_copy(&Round, pData + sizeof(ID) + i*sizeof(CFngStats), sizeof(Round));
+		Round.m_aName[sizeof(Round.m_aName)-1] = 0;
+		Round.m_aClan[sizeof(Round.m_aClan)-1] = 0;
+		CStatsSave *pPending = FindPending(Round.m_aName);
+		if (pPending)
+		{
+			MergeFngStats(&Round, &pPending->m_Round);
+			continue;
+		}
+		CStatsSave Save;
+		str_copy(Save.m_aName, Round.m_aName, sizeof(Save.m_aName));
+		Save.m_JournalSlot = -1;
+		Save.m_HasMerged = false;
+		Save.m_Result = CStatsSave::RESULT_OK;
+		Save.m_Round = Round;
+		s_vPending.push_back(Save);
+	}
+	pClient->m_Waiting = true;
+	pClient->m_WaitingSave = ID;
+}
+
+static void HandleMessage(CClient *pClient, const CStatsSrvHeader *pHeader, const unsigned char *pData)
+{
+	if (!mem_comp(pHeader->m_aType, STATSSRV_HELLO, sizeof(STATSSRV_HELLO)))
+	{
+		int Protocol = 0;
+		if (pHeader->m_Size == sizeof(FNG_VERSION) + sizeof(Protocol))
+			mem_copy(&Protocol, pData + sizeof(FNG_VERSION), sizeof(Protocol));
+		pClient->m_Accepted = Protocol == STATSSRV_PROTOCOL && !mem_comp(pData, FNG_VERSION, sizeof(FNG_VERSION));
+		int Accepted = pClient->m_Accepted;
+		if (Send(pClient, STATSSRV_HELLO, &Accepted, sizeof(Accepted)) && !Accepted)
+			Drop(pClient, "other stats version or protocol");
+	}
+	else if (!pClient->m_Accepted)
+		Drop(pClient, "no hello");
+	else if (!mem_comp(pHeader->m_aType, STATSSRV_LOAD, sizeof(STATSSRV_LOAD)))
+		Load(pClient, pData, pHeader->m_Size);
+	else if (!mem_comp(pHeader->m_aType, STATSSRV_SAVE, sizeof(STATSSRV_SAVE)))
+		Save(pClient, pData, pHeader->m_Size);
+	else
+		Drop(pClient, "unknown message");
+}
+
+static void Receive(CClient *pClient)
+{
+	while (pClient->m_Used)
+	{
+		int Bytes = net_tcp_recv(pClient->m_Socket, pClient->m_aBuf + pClient->m_BufSize, sizeof(pClient->m_aBuf) - pClient->m_BufSize);
+		if (Bytes == 0 || (Bytes < 0 && !net_would_block()))
+		{
+			Drop(pClient, "connection closed");
+			return;
+		}
+		if (Bytes < 0)
+			return;
+		pClient->m_BufSize += Bytes;
+
+		int Used = 0;
+		while (pClient->m_Used && pClient->m_BufSize - Used >= (int)sizeof(CStatsSrvHeader))
+		{
+			CStatsSrvHeader Header;
+			mem_copy(&Header, pClient->m_aBuf + Used, sizeof(Header));
+			if (Header.m_Size < 0 || Header.m_Size > MAX_MESSAGE_SIZE)
+			{
+				Drop(pClient, "message too big");
+				return;
+			}
+			if (pClient->m_BufSize - Used < (int)sizeof(Header) + Header.m_Size)
+				break;
+			HandleMessage(pClient, &Header, pClient->m_aBuf + Used + sizeof(Header));
+			Used += sizeof(Header) + Header.m_Size;
+		}
+		if (!pClient->m_Used)
+			return;
+		mem_move(pClient->m_aBuf, pClient->m_aBuf + Used, pClient->m_BufSize - Used);
+		pClient->m_BufSize -= Used;
+	}
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	net_init();
+
+	if (argc < 3) // ignore_convention
+	{
+		dbg_msg("usage", "%s <stats path> <fail path> [bind address]", argv[0]); // ignore_convention
+		dbg_msg("usage", "the game servers need sv_stats_server set to the bind address, default 127.0.0.1:%d", STATSSRV_PORT);
+		return -1;
+	}
+	s_Files.Init(argv[1]); // ignore_convention
+	str_copy(s_aFailPath, argv[2], sizeof(s_aFailPath)); // ignore_convention
+
+	NETADDR BindAddr;
+	if (net_host_lookup(argc > 3 ? argv[3] : "127.0.0.1", &BindAddr, NETTYPE_ALL) != 0) // ignore_convention
+	{
+		dbg_msg("statssrv", "invalid bind address");
+		return -1;
+	}
+	if (!BindAddr.port)
+		BindAddr.port = STATSSRV_PORT;
+	NETSOCKET Socket = net_tcp_create(BindAddr);
+	if (Socket.type == NETTYPE_INVALID || net_tcp_listen(Socket, MAX_STATS_CLIENTS))
+	{
+		dbg_msg("statssrv", "couldn't open socket. port %d might already be in use", BindAddr.port);
+		return -1;
+	}
+	net_set_non_blocking(Socket);
+	dbg_msg("statssrv", "started");
+
+	while (1)
+	{
+		NETSOCKET NewSocket;
+		NETADDR Addr;
+		while (net_tcp_accept(Socket, &NewSocket, &Addr) >= 0)
+		{
+			int Slot = -1;
+			for (int i = 0; i < MAX_STATS_CLIENTS && Slot == -1; i++)
+				if (!s_aClients[i].m_Used)
+					Slot = i;
+			if (Slot == -1)
+			{
+				dbg_msg("statssrv", "too many clients");
+				net_tcp_close(NewSocket);
+				continue;
+			}
+			CClient *pClient = &s_aClients[Slot];
+			pClient->m_Used = true;
+			pClient->m_Accepted = false;
+			pClient->m_Socket = NewSocket;
+			pClient->m_Addr = Addr;
+			pClient->m_Waiting = false;
+			pClient->m_BufSize = 0;
+			net_set_non_blocking(NewSocket);
+		}
+
+		for (int i = 0; i < MAX_STATS_CLIENTS; i++)
+			if (s_aClients[i].m_Used)
+				Receive(&s_aClients[i]);
+
+		if (!s_vPending.empty() && (time_get() - s_FirstPending > FLUSH_INTERVAL*time_freq()/1000 || s_vPending.size() >= MAX_PENDING))
+			Flush();
+
+		// be nice to the CPU
+		thread_sleep(1);
+	}
+
+	return 0;
+}
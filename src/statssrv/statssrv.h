@@ -0,0 +1,46 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef STATSSRV_STATSSRV_H
+#define STATSSRV_STATSSRV_H
+#include <base/system.h>
+
+static const int STATSSRV_PORT = 8287;
+
+// every message is a header and m_Size bytes of data over tcp. the data is
+// in host byte order, the stats server runs next to the game servers
+struct CStatsSrvHeader
+{
+	unsigned char m_aType[4];
+	int m_Size;
+};
+
+enum
+{
+	// round stats in one STATSSRV_SAVE
+	STATSSRV_MAX_SAVES=128,
+	// changes with the messages
+	STATSSRV_PROTOCOL=2,
+};
+
+// a game server process and its count of STATSSRV_SAVE messages. a save that
+// is sent again with the same id, because its answer was lost, is only
+// answered and not added to the records a second time
+struct CStatsSrvSaveID
+{
+	int64 m_Token;
+	int m_Seq;
+	int m_Num; // the number of round stats
+};
+
+// FNG_VERSION and an int with STATSSRV_PROTOCOL, answered with an int that is 1
+// if the stats server has the same CFngStats and messages
+static const unsigned char STATSSRV_HELLO[] = {'s', 'h', 'l', 'o'};
+// the name of the player, MAX_NAME_LENGTH bytes
+static const unsigned char STATSSRV_LOAD[] = {'s', 'l', 'o', 'd'};
+// CFngStats and an int with the error of ReadStatsFile
+static const unsigned char STATSSRV_RECORD[] = {'s', 'r', 'e', 'c'};
+// CStatsSrvSaveID and the CFngStats round stats to add to the records
+static const unsigned char STATSSRV_SAVE[] = {'s', 's', 'a', 'v'};
+// the CStatsSrvSaveID of the save, sent once its round stats are written
+static const unsigned char STATSSRV_SAVED[] = {'s', 's', 'v', 'd'};
+#endif
@@ -0,0 +1,166 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/compression.h>
+
+// the plain loops, the batch codec has to stay byte identical
+static long ReferenceCompress(const int *pSrc, int SrcSize, unsigned char *pDst, int DstSize)
+{
+	unsigned char *pStart = pDst;
+	unsigned char *pDstEnd = pDst + DstSize;
+	for(int i = 0; i < SrcSize/4; i++)
+	{
+		if(pDstEnd - pDst < 6)
+			return -1;
+		pDst = CVariableInt::Pack(pDst, pSrc[i]);
+	}
+	return (long)(pDst-pStart);
+}
+
+static long ReferenceDecompress(const unsigned char *pSrc, int SrcSize, int *pDst, int DstSize)
+{
+	const unsigned char *pEnd = pSrc + SrcSize;
+	int *pStart = pDst;
+	int *pDstEnd = pDst + DstSize/4;
+	while(pSrc < pEnd)
+	{
+		if(pDst >= pDstEnd)
+			return -1;
+		pSrc = CVariableInt::Unpack(pSrc, pDst);
+		pDst++;
+	}
+	return (long)((unsigned char *)pDst-(unsigned char *)pStart);
+}
+
+// mostly runs of small values like in snapshot deltas, with some large ones mixed in
+static int RandomInt(unsigned *pSeed, int LargeChance)
+{
+	static const int s_aLarge[] = {64, -65, 8191, 8192, -8193, 1<<20, (1<<27)-1, 1<<27, 0x7fffffff, (int)0x80000000};
+	int Roll = random_seeded(pSeed)%100;
+	if(Roll < LargeChance)
+		return s_aLarge[random_seeded(pSeed)%(sizeof(s_aLarge)/sizeof(s_aLarge[0]))] + (int)(random_seeded(pSeed)%3) - 1;
+	if(Roll < LargeChance*2)
+		return (int)(random_seeded(pSeed)<<17 ^ random_seeded(pSeed)<<2 ^ random_seeded(pSeed));
+	return (int)(random_seeded(pSeed)%128) - 64;
+}
+
+TEST(VariableInt, CompressMatchesReference)
+{
+	static const int s_MaxInts = 1000;
+	int aSrc[s_MaxInts];
+	unsigned char aExpected[s_MaxInts*5+16];
+	unsigned char aGot[s_MaxInts*5+16];
+
+	for(unsigned Seed = 0; Seed < 2000; Seed++)
+	{
+		unsigned State = Seed;
+		int NumInts = random_seeded(&State)%s_MaxInts;
+		int LargeChance = random_seeded(&State)%4 == 0 ? 0 : random_seeded(&State)%20;
+		for(int i = 0; i < NumInts; i++)
+			aSrc[i] = RandomInt(&State, LargeChance);
+
+		// tight destination buffers hit the out of space checks
+		int DstSize = random_seeded(&State)%2 ? (int)sizeof(aGot) : (int)(random_seeded(&State)%(NumInts*2+16));
+		long Expected = ReferenceCompress(aSrc, NumInts*4, aExpected, DstSize);
+		long Got = CVariableInt::Compress(aSrc, NumInts*4, aGot, DstSize);
+		ASSERT_EQ(Got, Expected) << "seed " << Seed;
+		if(Expected > 0)
+		{
+			ASSERT_EQ(mem_comp(aGot, aExpected, Expected), 0) << "seed " << Seed;
+		}
+	}
+}
+
+TEST(VariableInt, DecompressMatchesReference)
+{
+	static const int s_MaxBytes = 2000;
+	unsigned char aSrc[s_MaxBytes];
+	int aExpected[s_MaxBytes];
+	int aGot[s_MaxBytes];
+
+	for(unsigned Seed = 0; Seed < 2000; Seed++)
+	{
+		unsigned State = Seed;
+		int NumBytes = random_seeded(&State)%s_MaxBytes + 1;
+		int ExtendChance = random_seeded(&State)%4 == 0 ? 0 : random_seeded(&State)%30;
+		for(int i = 0; i < NumBytes; i++)
+		{
+			aSrc[i] = random_seeded(&State)&0x7f;
+			if((int)(random_seeded(&State)%100) < ExtendChance)
+				aSrc[i] |= 0x80;
+		}
+		aSrc[NumBytes-1] &= 0x7f; // the reference reads past the end otherwise
+
+		int DstSize = random_seeded(&State)%2 ? (int)sizeof(aGot) : (int)(random_seeded(&State)%(NumBytes*4+4));
+		long Expected = ReferenceDecompress(aSrc, NumBytes, aExpected, DstSize);
+		long Got = CVariableInt::Decompress(aSrc, NumBytes, aGot, DstSize);
+		ASSERT_EQ(Got, Expected) << "seed " << Seed;
+		if(Expected > 0)
+		{
+			ASSERT_EQ(mem_comp(aGot, aExpected, Expected), 0) << "seed " << Seed;
+		}
+	}
+}
+
+TEST(VariableInt, RoundTrip)
+{
+	static const int s_NumInts = 4096;
+	int aSrc[s_NumInts];
+	int aGot[s_NumInts];
+	unsigned char aPacked[s_NumInts*5];
+
+	unsigned Seed = 7;
+	for(int i = 0; i < s_NumInts; i++)
+		aSrc[i] = RandomInt(&Seed, i%512 < 256 ? 0 : 10);
+
+	long Size = CVariableInt::Compress(aSrc, sizeof(aSrc), aPacked, sizeof(aPacked));
+	ASSERT_GT(Size, 0);
+	EXPECT_EQ(CVariableInt::Decompress(aPacked, Size, aGot, sizeof(aGot)), (long)sizeof(aSrc));
+	EXPECT_EQ(mem_comp(aGot, aSrc, sizeof(aSrc)), 0);
+}
+
+TEST(VariableInt, Benchmark)
+{
+	static const int s_NumInts = 16384;
+	static const int s_Iterations = 200;
+	static const int s_aLargeChances[] = {0, 2, 10};
+	int *pSrc = new int[s_NumInts];
+	int *pOut = new int[s_NumInts];
+	unsigned char *pPacked = new unsigned char[s_NumInts*5];
+
+	for(unsigned n = 0; n < sizeof(s_aLargeChances)/sizeof(s_aLargeChances[0]); n++)
+	{
+		unsigned Seed = n;
+		for(int i = 0; i < s_NumInts; i++)
+			pSrc[i] = RandomInt(&Seed, s_aLargeChances[n]);
+
+		long Size = 0;
+		int64 aTimes[5];
+		aTimes[0] = time_get();
+		for(int i = 0; i < s_Iterations; i++)
+			Size = ReferenceCompress(pSrc, s_NumInts*4, pPacked, s_NumInts*5);
+		aTimes[1] = time_get();
+		for(int i = 0; i < s_Iterations; i++)
+			CVariableInt::Compress(pSrc, s_NumInts*4, pPacked, s_NumInts*5);
+		aTimes[2] = time_get();
+		for(int i = 0; i < s_Iterations; i++)
+			ReferenceDecompress(pPacked, Size, pOut, s_NumInts*4);
+		aTimes[3] = time_get();
+		for(int i = 0; i < s_Iterations; i++)
+			CVariableInt::Decompress(pPacked, Size, pOut, s_NumInts*4);
+		aTimes[4] = time_get();
+
+		// throughput of the unpacked ints
+		char aName[64];
+		str_format(aName, sizeof(aName), "varint %2d%% large compress", s_aLargeChances[n]*2);
+		PrintBenchmark(aName, aTimes[2]-aTimes[1], aTimes[1]-aTimes[0], s_Iterations, s_NumInts*4.0);
+		str_format(aName, sizeof(aName), "varint %2d%% large decompress", s_aLargeChances[n]*2);
+		PrintBenchmark(aName, aTimes[4]-aTimes[3], aTimes[3]-aTimes[2], s_Iterations, s_NumInts*4.0);
+	}
+
+	delete [] pPacked;
+	delete [] pOut;
+	delete [] pSrc;
+}
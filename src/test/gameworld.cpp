@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <game/server/gameworld.h>
+
+TEST(GameWorld, RelevanceTiers)
+{
+	vec2 View(1000.0f, 1000.0f);
+	EXPECT_EQ(CGameWorld::RelevanceAt(View, View), (int)CGameWorld::RELEVANCE_NEAR);
+	EXPECT_EQ(CGameWorld::RelevanceAt(View, View+vec2(900.0f, 650.0f)), (int)CGameWorld::RELEVANCE_NEAR);
+	EXPECT_EQ(CGameWorld::RelevanceAt(View, View-vec2(900.0f, 650.0f)), (int)CGameWorld::RELEVANCE_NEAR);
+
+	// just off the screen
+	EXPECT_EQ(CGameWorld::RelevanceAt(View, View+vec2(901.0f, 0.0f)), (int)CGameWorld::RELEVANCE_FAR);
+	EXPECT_EQ(CGameWorld::RelevanceAt(View, View-vec2(0.0f, 651.0f)), (int)CGameWorld::RELEVANCE_FAR);
+	EXPECT_EQ(CGameWorld::RelevanceAt(View, View+vec2(1000.0f, 0.0f)), (int)CGameWorld::RELEVANCE_FAR);
+
+	// outside of the old clip area
+	EXPECT_EQ(CGameWorld::RelevanceAt(View, View+vec2(1001.0f, 0.0f)), (int)CGameWorld::RELEVANCE_NONE);
+	EXPECT_EQ(CGameWorld::RelevanceAt(View, View+vec2(0.0f, 801.0f)), (int)CGameWorld::RELEVANCE_NONE);
+	EXPECT_EQ(CGameWorld::RelevanceAt(View, View+vec2(950.0f, 750.0f)), (int)CGameWorld::RELEVANCE_NONE);
+}
+
+// one snapshot of a client with the given far items, returns the refreshed ones as bits
+static unsigned SnapFarItems(CGameWorld::CFarItems *pItems, int SnapCount, int NumItems, int Size, int Interval, int Budget)
+{
+	pItems->Prepare(SnapCount, Interval, &Budget);
+	unsigned Refreshed = 0;
+	for(int ID = 0; ID < NumItems; ID++)
+	{
+		if(pItems->Refresh(0, ID, Size, Interval))
+			Refreshed |= 1<<ID;
+	}
+	return Refreshed;
+}
+
+TEST(GameWorld, FarItemsTakeTurns)
+{
+	static const int s_Interval = 4;
+	CGameWorld::CFarItems Items;
+
+	// the first snapshot repeats the data from before
+	EXPECT_EQ(SnapFarItems(&Items, 1, 8, 100, s_Interval, -1), 0u);
+
+	// every item is refreshed exactly once per interval, neighbouring ids in different snapshots
+	unsigned All = 0;
+	for(int SnapCount = 2; SnapCount < 2+s_Interval; SnapCount++)
+	{
+		unsigned Refreshed = SnapFarItems(&Items, SnapCount, 8, 100, s_Interval, -1);
+		EXPECT_EQ(Refreshed&All, 0u);
+		EXPECT_EQ(Refreshed&0xf, 1u<<((s_Interval-SnapCount+1)%s_Interval));
+		All |= Refreshed;
+	}
+	EXPECT_EQ(All, 0xffu);
+}
+
+TEST(GameWorld, FarItemBudget)
+{
+	CGameWorld::CFarItems Items;
+	SnapFarItems(&Items, 1, 4, 40, 1, -1);
+
+	// over the budget, the item repeats and the budget stays for smaller ones
+	int Budget = 100;
+	Items.Prepare(2, 1, &Budget);
+	EXPECT_EQ(Budget, 20);
+	EXPECT_TRUE(Items.Refresh(0, 0, 40, 1));
+	EXPECT_TRUE(Items.Refresh(0, 1, 40, 1));
+	EXPECT_FALSE(Items.Refresh(0, 2, 40, 1));
+	EXPECT_FALSE(Items.Refresh(0, 3, 20, 1));
+
+	// the item sizes are from the last snapshot
+	Budget = 100;
+	Items.Prepare(3, 1, &Budget);
+	EXPECT_EQ(Budget, 0);
+	EXPECT_TRUE(Items.Refresh(0, 2, 40, 1));
+	EXPECT_TRUE(Items.Refresh(0, 3, 20, 1));
+
+	// items that are not due don't use the budget
+	Budget = 100;
+	Items.Prepare(4, 5, &Budget);
+	EXPECT_EQ(Budget, 100);
+}
+
+TEST(GameWorld, FarItemsDontStarve)
+{
+	// the budget fits one item per snapshot, every item is due every snapshot
+	static const int s_NumItems = 6;
+	CGameWorld::CFarItems Items;
+	SnapFarItems(&Items, 1, s_NumItems, 100, 1, -1);
+
+	int aLastRefresh[s_NumItems] = {0};
+	for(int SnapCount = 2; SnapCount < 2+4*s_NumItems; SnapCount++)
+	{
+		unsigned Refreshed = SnapFarItems(&Items, SnapCount, s_NumItems, 100, 1, 100);
+		int Num = 0;
+		for(int ID = 0; ID < s_NumItems; ID++)
+		{
+			if(Refreshed&(1<<ID))
+			{
+				Num++;
+				aLastRefresh[ID] = SnapCount;
+			}
+		}
+		EXPECT_EQ(Num, 1);
+
+		// the one that lost on the budget goes first in the next snapshot, nobody waits longer than a round
+		for(int ID = 0; ID < s_NumItems && SnapCount >= 1+s_NumItems; ID++)
+			EXPECT_GT(aLastRefresh[ID], SnapCount-s_NumItems);
+	}
+}
+
+TEST(GameWorld, FarItemsLeaving)
+{
+	CGameWorld::CFarItems Items;
+	SnapFarItems(&Items, 1, 2, 100, 2, -1);
+
+	// item 1 goes near for a snapshot and starts its turns again when it's back
+	SnapFarItems(&Items, 2, 1, 100, 2, -1);
+	SnapFarItems(&Items, 3, 1, 100, 2, -1);
+	int Budget = -1;
+	Items.Prepare(4, 2, &Budget);
+	EXPECT_FALSE(Items.Refresh(0, 1, 100, 2));
+
+	// an item refreshed because its repeat failed waits a full interval
+	Items.Refreshed(0, 1);
+	Items.Prepare(5, 2, &Budget);
+	EXPECT_FALSE(Items.Refresh(0, 1, 100, 2));
+	Items.Prepare(6, 2, &Budget);
+	EXPECT_TRUE(Items.Refresh(0, 1, 100, 2));
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/linkquality.h>
+
+TEST(RttEstimator, Queueing)
+{
+	CRttEstimator Rtt;
+	EXPECT_EQ(Rtt.Rtt(), -1);
+	EXPECT_FALSE(Rtt.Queueing());
+
+	int64 Now = 1;
+	for(int i = 0; i < 20; i++)
+		Rtt.AddSample(50, Now += time_freq()/10);
+	EXPECT_EQ(Rtt.Rtt(), 50);
+	EXPECT_EQ(Rtt.MinRtt(), 50);
+	EXPECT_FALSE(Rtt.Queueing());
+
+	for(int i = 0; i < 40; i++)
+		Rtt.AddSample(400, Now += time_freq()/10);
+	EXPECT_EQ(Rtt.MinRtt(), 50);
+	EXPECT_TRUE(Rtt.Queueing());
+}
+
+TEST(RttEstimator, MinimumFollowsRouteChange)
+{
+	CRttEstimator Rtt;
+	int64 Now = 1;
+	Rtt.AddSample(20, Now);
+
+	// a longer route for good, the old minimum lasts at most two windows
+	for(int i = 0; i < 2*CRttEstimator::MIN_WINDOW*10+10; i++)
+		Rtt.AddSample(300, Now += time_freq()/10);
+	EXPECT_EQ(Rtt.MinRtt(), 300);
+	EXPECT_FALSE(Rtt.Queueing());
+}
+
+TEST(RttEstimator, StaleMinimum)
+{
+	CRttEstimator Rtt;
+	int64 Now = 1;
+	Rtt.AddSample(20, Now);
+
+	// no samples for a long time
+	Now += 3*CRttEstimator::MIN_WINDOW*time_freq();
+	Rtt.AddSample(250, Now);
+	EXPECT_EQ(Rtt.MinRtt(), 250);
+}
+
+TEST(SnapRateGovernor, BackOff)
+{
+	CSnapRateGovernor Governor;
+	EXPECT_EQ(Governor.Interval(), (int)CSnapRateGovernor::INTERVAL_INIT);
+	EXPECT_EQ(Governor.Budget(), -1);
+
+	// nothing changes before the first ack
+	Governor.Update(100, true, false);
+	EXPECT_EQ(Governor.Interval(), (int)CSnapRateGovernor::INTERVAL_INIT);
+	EXPECT_EQ(Governor.Budget(), -1);
+	EXPECT_EQ(Governor.Loss(), 50);
+
+	Governor.Update(100, false, true);
+	EXPECT_EQ(Governor.Interval(), 8);
+	EXPECT_EQ(Governor.Budget(), CSnapRateGovernor::BUDGET_MAX/2);
+
+	for(int i = 0; i < 20; i++)
+		Governor.Update(100, false, true);
+	EXPECT_EQ(Governor.Interval(), (int)CSnapRateGovernor::INTERVAL_MAX);
+	EXPECT_EQ(Governor.Budget(), (int)CSnapRateGovernor::BUDGET_MIN);
+}
+
+TEST(SnapRateGovernor, QueueingBacksOff)
+{
+	CSnapRateGovernor Governor;
+	Governor.Update(0, true, true);
+	EXPECT_GT(Governor.Interval(), (int)CSnapRateGovernor::INTERVAL_INIT);
+	EXPECT_NE(Governor.Budget(), -1);
+}
+
+TEST(SnapRateGovernor, Recovery)
+{
+	CSnapRateGovernor Governor;
+	for(int i = 0; i < 10; i++)
+		Governor.Update(100, false, true);
+
+	// a loss in between doesn't change anything
+	for(int i = 0; i < 8; i++)
+		Governor.Update(0, false, true);
+	int Interval = Governor.Interval();
+	Governor.Update(10, false, true);
+	EXPECT_EQ(Governor.Interval(), Interval);
+
+	for(int i = 0; i < 20; i++)
+		Governor.Update(0, false, true);
+	EXPECT_EQ(Governor.Interval(), 1);
+	EXPECT_EQ(Governor.Budget(), -1);
+	EXPECT_EQ(Governor.Loss(), 0);
+}
+
+TEST(SnapRateGovernor, MissingDeltaBase)
+{
+	CSnapRateGovernor Governor;
+	for(int i = 0; i < 20; i++)
+		Governor.Update(0, false, true);
+	EXPECT_EQ(Governor.Interval(), 1);
+	Governor.MissingDeltaBase();
+	EXPECT_EQ(Governor.Interval(), 4);
+	for(int i = 0; i < 10; i++)
+		Governor.MissingDeltaBase();
+	EXPECT_EQ(Governor.Interval(), (int)CSnapRateGovernor::INTERVAL_MAX);
+}
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+#include <base/system.h>
+
+enum
+{
+	NUM_THREADS=4,
+	NUM_LINES=500,
+};
+
+static int s_NumLines;
+static int s_aNextLine[NUM_THREADS];
+static bool s_InOrder;
+
+static void CountingLogger(const char *pLine)
+{
+	const char *pMsg = str_find(pLine, "logtest ");
+	if(!pMsg)
+		return;
+	int Thread, Line;
+	if(sscanf(pMsg, "logtest %d %d", &Thread, &Line) != 2 || Thread < 0 || Thread >= NUM_THREADS)
+		return;
+	if(Line != s_aNextLine[Thread])
+		s_InOrder = false;
+	s_aNextLine[Thread] = Line+1;
+	s_NumLines++;
+}
+
+static void LogLines(void *pUser)
+{
+	int Thread = *(int *)pUser;
+	for(int i = 0; i < NUM_LINES; i++)
+		dbg_msg("test", "logtest %d %d", Thread, i);
+}
+
+class Logger : public ::testing::Test
+{
+protected:
+	Logger()
+	{
+		static bool s_Registered = false;
+		if(!s_Registered)
+		{
+			dbg_logger(CountingLogger);
+			s_Registered = true;
+		}
+		dbg_logger_async(1000);
+
+		s_NumLines = 0;
+		s_InOrder = true;
+		for(int i = 0; i < NUM_THREADS; i++)
+			s_aNextLine[i] = 0;
+	}
+
+	~Logger()
+	{
+		// the other tests expect their lines right away
+		dbg_logger_sync();
+	}
+};
+
+TEST_F(Logger, Async)
+{
+	unsigned Dropped = dbg_logger_dropped();
+	int aThreadIDs[NUM_THREADS];
+	void *apThreads[NUM_THREADS];
+	for(int i = 0; i < NUM_THREADS; i++)
+	{
+		aThreadIDs[i] = i;
+		apThreads[i] = thread_init(LogLines, &aThreadIDs[i]);
+	}
+	for(int i = 0; i < NUM_THREADS; i++)
+		thread_wait(apThreads[i]);
+	dbg_logger_flush();
+
+	EXPECT_TRUE(s_InOrder);
+	EXPECT_EQ(s_NumLines + (int)(dbg_logger_dropped()-Dropped), NUM_THREADS*NUM_LINES);
+}
+
+TEST_F(Logger, AsyncOverflow)
+{
+	unsigned Dropped = dbg_logger_dropped();
+	int Thread = 0;
+	for(int i = 0; i < 20; i++)
+		LogLines(&Thread);
+	dbg_logger_flush();
+
+	// lines only get lost when the ring is full and every loss is counted
+	EXPECT_EQ(s_NumLines + (int)(dbg_logger_dropped()-Dropped), 20*NUM_LINES);
+	EXPECT_GT(dbg_logger_dropped(), Dropped);
+}
+
+TEST_F(Logger, Sync)
+{
+	dbg_logger_sync();
+	unsigned Dropped = dbg_logger_dropped();
+	int Thread = 0;
+	for(int i = 0; i < 20; i++)
+		LogLines(&Thread);
+
+	// written right away, nothing gets dropped
+	EXPECT_EQ(s_NumLines, 20*NUM_LINES);
+	EXPECT_EQ(dbg_logger_dropped(), Dropped);
+}
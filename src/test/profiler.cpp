@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include <engine/shared/profiler.h>
+
+TEST(Profiler, RegisterZone)
+{
+	CProfiler Profiler;
+	int Zone = Profiler.RegisterZone("tick");
+	EXPECT_EQ(Zone, 0);
+	EXPECT_EQ(Profiler.RegisterZone("snap"), 1);
+	EXPECT_EQ(Profiler.RegisterZone("tick"), Zone);
+	EXPECT_EQ(Profiler.NumZones(), 2);
+	EXPECT_STREQ(Profiler.ZoneName(1), "snap");
+
+	char aName[16];
+	for(int i = Profiler.NumZones(); i < CProfiler::MAX_ZONES; i++)
+	{
+		str_format(aName, sizeof(aName), "zone%d", i);
+		EXPECT_EQ(Profiler.RegisterZone(aName), i);
+	}
+	EXPECT_EQ(Profiler.RegisterZone("overflow"), -1);
+}
+
+TEST(Profiler, Percentiles)
+{
+	CProfiler Profiler;
+	int Zone = Profiler.RegisterZone("tick");
+
+	// 1..1000 microseconds
+	for(int i = 1; i <= 1000; i++)
+		Profiler.Add(Zone, (int64)i*time_freq()/1000000);
+
+	EXPECT_EQ(Profiler.Count(Zone), 1000);
+	EXPECT_EQ(Profiler.Total(Zone), 500500);
+	EXPECT_EQ(Profiler.Max(Zone), 1000);
+
+	// the buckets are a quarter octave wide, so the estimate is at most 25% high
+	int64 P50 = Profiler.Percentile(Zone, 50);
+	EXPECT_GE(P50, 500);
+	EXPECT_LE(P50, 625);
+	int64 P99 = Profiler.Percentile(Zone, 99);
+	EXPECT_GE(P99, 990);
+	EXPECT_LE(P99, 1000);
+	EXPECT_EQ(Profiler.Percentile(Zone, 100), 1000);
+
+	Profiler.Reset();
+	EXPECT_EQ(Profiler.Count(Zone), 0);
+	EXPECT_EQ(Profiler.Percentile(Zone, 50), 0);
+	EXPECT_EQ(Profiler.NumZones(), 1);
+}
+
+TEST(Profiler, InvalidZone)
+{
+	CProfiler Profiler;
+	Profiler.Add(-1, 100);
+	Profiler.Add(0, 100);
+	EXPECT_EQ(Profiler.NumZones(), 0);
+}
@@ -0,0 +1,358 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/snapshot.h>
+
+static const int s_aSizes[] = {0, 4, 8, 12, 20, 64};
+
+// adds NumItems items with random keys, some of them duplicated
+static void AddItems(CSnapshotBuilder *pBuilder, int NumItems, unsigned Seed, int *pItemSizes = 0)
+{
+	pBuilder->Init();
+	for(int i = 0; i < NumItems; i++)
+	{
+		int Type = random_seeded(&Seed)%24;
+		int ID = random_seeded(&Seed)%(NumItems/4+1);
+		int Size = s_aSizes[random_seeded(&Seed)%(sizeof(s_aSizes)/sizeof(s_aSizes[0]))];
+		int *pData = (int *)pBuilder->NewItem(Type, ID, Size);
+		ASSERT_TRUE(pData);
+		if(pItemSizes)
+			pItemSizes[i] = (int)sizeof(CSnapshotItem) + Size;
+		for(int d = 0; d < Size/4; d++)
+			pData[d] = i*16+d;
+	}
+}
+
+// the previous bubble sort, the output has to stay byte identical
+static int ReferenceFinish(CSnapshotBuilder *pBuilder, int NumItems, const int *pItemSizes, char *pOut)
+{
+	int aKeys[1024], aIndices[1024], aSizes[1024];
+	int DataSize = 0;
+	for(int i = 0; i < NumItems; i++)
+	{
+		aKeys[i] = pBuilder->GetItem(i)->Key();
+		aIndices[i] = i;
+		aSizes[i] = pItemSizes[i];
+		DataSize += aSizes[i];
+	}
+
+	bool Sorting = true;
+	while(Sorting)
+	{
+		Sorting = false;
+		for(int i = 1; i < NumItems; i++)
+		{
+			if(aKeys[i-1] > aKeys[i])
+			{
+				Sorting = true;
+				int Tmp = aKeys[i]; aKeys[i] = aKeys[i-1]; aKeys[i-1] = Tmp;
+				Tmp = aIndices[i]; aIndices[i] = aIndices[i-1]; aIndices[i-1] = Tmp;
+				Tmp = aSizes[i]; aSizes[i] = aSizes[i-1]; aSizes[i-1] = Tmp;
+			}
+		}
+	}
+
+	int *pHeader = (int *)pOut;
+	pHeader[0] = DataSize;
+	pHeader[1] = NumItems;
+	int *pKeys = pHeader+2;
+	int *pOffsets = pKeys+NumItems;
+	char *pData = (char *)(pOffsets+NumItems);
+	int Offset = 0;
+	for(int i = 0; i < NumItems; i++)
+	{
+		pKeys[i] = aKeys[i];
+		pOffsets[i] = Offset;
+		mem_copy(pData+Offset, pBuilder->GetItem(aIndices[i]), aSizes[i]);
+		Offset += aSizes[i];
+	}
+	return sizeof(int)*(2+2*NumItems) + DataSize;
+}
+
+static void ExpectSameAsReference(int NumItems, unsigned Seed)
+{
+	CSnapshotBuilder *pBuilder = new CSnapshotBuilder;
+	char *pExpected = new char[CSnapshot::MAX_SIZE];
+	char *pGot = new char[CSnapshot::MAX_SIZE];
+	mem_zero(pExpected, CSnapshot::MAX_SIZE);
+	mem_zero(pGot, CSnapshot::MAX_SIZE);
+
+	int aItemSizes[1024];
+	AddItems(pBuilder, NumItems, Seed, aItemSizes);
+	int ExpectedSize = ReferenceFinish(pBuilder, NumItems, aItemSizes, pExpected);
+	int Size = pBuilder->Finish(pGot);
+
+	EXPECT_EQ(Size, ExpectedSize);
+	EXPECT_EQ(mem_comp(pGot, pExpected, ExpectedSize), 0);
+
+	const CSnapshot *pSnap = (const CSnapshot *)pGot;
+	for(int i = 1; i < pSnap->NumItems(); i++)
+		EXPECT_LE(pSnap->GetItem(i-1)->Key(), pSnap->GetItem(i)->Key());
+
+	delete [] pGot;
+	delete [] pExpected;
+	delete pBuilder;
+}
+
+TEST(SnapshotBuilder, FinishEmpty)
+{
+	ExpectSameAsReference(0, 1);
+}
+
+TEST(SnapshotBuilder, FinishSingle)
+{
+	ExpectSameAsReference(1, 2);
+}
+
+TEST(SnapshotBuilder, FinishMatchesReference)
+{
+	for(unsigned Seed = 0; Seed < 20; Seed++)
+	{
+		ExpectSameAsReference(100, Seed);
+		ExpectSameAsReference(500, Seed);
+		ExpectSameAsReference(1000, Seed);
+	}
+}
+
+TEST(SnapshotBuilder, FinishBenchmark)
+{
+	static const int s_aNumItems[] = {100, 500, 1000};
+	static const int s_Iterations = 50;
+	CSnapshotBuilder *pBuilder = new CSnapshotBuilder;
+	char *pOut = new char[CSnapshot::MAX_SIZE];
+
+	for(unsigned n = 0; n < sizeof(s_aNumItems)/sizeof(s_aNumItems[0]); n++)
+	{
+		int aItemSizes[1024];
+		AddItems(pBuilder, s_aNumItems[n], n, aItemSizes);
+
+		int64 Start = time_get();
+		for(int i = 0; i < s_Iterations; i++)
+			ReferenceFinish(pBuilder, s_aNumItems[n], aItemSizes, pOut);
+		int64 Mid = time_get();
+		for(int i = 0; i < s_Iterations; i++)
+			pBuilder->Finish(pOut);
+		int64 End = time_get();
+
+		char aName[64];
+		str_format(aName, sizeof(aName), "finish with %4d items", s_aNumItems[n]);
+		PrintBenchmark(aName, End-Mid, Mid-Start, s_Iterations);
+	}
+
+	delete [] pOut;
+	delete pBuilder;
+}
+
+TEST(SnapshotBuilder, RepeatItem)
+{
+	CSnapshotBuilder *pBuilder = new CSnapshotBuilder;
+	char *pOut = new char[CSnapshot::MAX_SIZE];
+	CSnapshotStorage Storage;
+	Storage.Init();
+
+	// nothing to repeat without a snapshot
+	pBuilder->Init();
+	EXPECT_FALSE(pBuilder->RepeatItem(&Storage, 3, 7, 8, 0));
+
+	int *pData = (int *)pBuilder->NewItem(3, 7, 8);
+	pData[0] = 11;
+	pData[1] = 12;
+	Storage.Add(10, 0, pBuilder->Finish(pOut), pOut, 0);
+
+	pBuilder->Init();
+	int *pRepeated = (int *)pBuilder->RepeatItem(&Storage, 3, 7, 8, 10);
+	ASSERT_TRUE(pRepeated);
+	EXPECT_EQ(pRepeated[0], 11);
+	EXPECT_EQ(pRepeated[1], 12);
+	// other id, other size or a snapshot that is too old
+	EXPECT_FALSE(pBuilder->RepeatItem(&Storage, 3, 8, 8, 10));
+	EXPECT_FALSE(pBuilder->RepeatItem(&Storage, 3, 7, 4, 10));
+	EXPECT_FALSE(pBuilder->RepeatItem(&Storage, 3, 7, 8, 11));
+
+	CSnapshot *pSnap = (CSnapshot *)pOut;
+	pBuilder->Finish(pOut);
+	ASSERT_EQ(pSnap->NumItems(), 1);
+	EXPECT_EQ(pSnap->GetItem(0)->Key(), (3<<16)|7);
+
+	Storage.PurgeAll();
+	delete [] pOut;
+	delete pBuilder;
+}
+
+// builds a snapshot with unique keys, Change alters the data, drops and adds items
+static int BuildDeltaSnap(CSnapshotBuilder *pBuilder, char *pOut, int NumItems, unsigned Seed, int Change)
+{
+	static const int s_aMagnitudes[] = {0, 1, 63, 64, 8191, 8192, 1<<20, 1<<27, 0x7fffffff};
+	unsigned ChangeSeed = Seed*7u + Change;
+	pBuilder->Init();
+	for(int i = 0; i < NumItems + (Change ? NumItems/10 : 0); i++)
+	{
+		unsigned ItemSeed = Seed + i;
+		int Size = s_aSizes[random_seeded(&ItemSeed)%(sizeof(s_aSizes)/sizeof(s_aSizes[0]))];
+		bool New = i >= NumItems;
+		if(Change && !New && random_seeded(&ChangeSeed)%10 == 0)
+			continue;
+		int *pData = (int *)pBuilder->NewItem(i%24, i/24, Size);
+		if(!pData)
+			return -1;
+		for(int d = 0; d < Size/4; d++)
+		{
+			pData[d] = (int)random_seeded(&ItemSeed);
+			if(Change && random_seeded(&ChangeSeed)%3 == 0)
+			{
+				int Magnitude = s_aMagnitudes[random_seeded(&ChangeSeed)%(sizeof(s_aMagnitudes)/sizeof(s_aMagnitudes[0]))];
+				pData[d] += random_seeded(&ChangeSeed)%2 ? Magnitude : -Magnitude;
+			}
+		}
+	}
+	return pBuilder->Finish(pOut);
+}
+
+static int ReferenceDataRate(const CSnapshot *pFrom, const CSnapshot *pTo)
+{
+	int Rate = 0;
+	for(int i = 0; i < pTo->NumItems(); i++)
+	{
+		const CSnapshotItem *pItem = pTo->GetItem(i);
+		int Size = pTo->GetItemSize(i);
+		int FromIndex = pFrom->GetItemIndex(pItem->Key());
+		if(FromIndex == -1)
+		{
+			Rate += Size*8;
+			continue;
+		}
+
+		const int *pPast = pFrom->GetItem(FromIndex)->Data();
+		int ItemRate = 0;
+		bool Changed = false;
+		for(int d = 0; d < Size/4; d++)
+		{
+			int Diff = pItem->Data()[d]-pPast[d];
+			unsigned char aBuf[16];
+			Changed |= Diff != 0;
+			ItemRate += Diff ? (int)(CVariableInt::Pack(aBuf, Diff)-aBuf)*8 : 1;
+		}
+		if(Changed)
+			Rate += ItemRate;
+	}
+	return Rate;
+}
+
+TEST(SnapshotDelta, RoundTrip)
+{
+	CSnapshotBuilder *pBuilder = new CSnapshotBuilder;
+	char *pFrom = new char[CSnapshot::MAX_SIZE];
+	char *pTo = new char[CSnapshot::MAX_SIZE];
+	char *pGot = new char[CSnapshot::MAX_SIZE];
+	char *pDelta = new char[CSnapshot::MAX_SIZE*2];
+
+	for(unsigned Seed = 0; Seed < 20; Seed++)
+	{
+		CSnapshotDelta *pSnapshotDelta = new CSnapshotDelta;
+		CSnapshotDelta *pReceiverDelta = new CSnapshotDelta;
+		int NumItems = 50 + Seed*40;
+		ASSERT_GT(BuildDeltaSnap(pBuilder, pFrom, NumItems, Seed, 0), 0);
+		int ToSize = BuildDeltaSnap(pBuilder, pTo, NumItems, Seed, 1);
+		ASSERT_GT(ToSize, 0);
+
+		// the demo recorder doesn't count
+		ASSERT_GT(pSnapshotDelta->CreateDelta((CSnapshot *)pFrom, (CSnapshot *)pTo, pDelta), 0);
+		for(int Type = 0; Type < 24; Type++)
+			EXPECT_EQ(pSnapshotDelta->GetDataUpdates(Type), 0u);
+
+		int DeltaSize = pSnapshotDelta->CreateDelta((CSnapshot *)pFrom, (CSnapshot *)pTo, pDelta, true);
+		ASSERT_GT(DeltaSize, 0);
+		int Size = pReceiverDelta->UnpackDelta((CSnapshot *)pFrom, (CSnapshot *)pGot, pDelta, DeltaSize);
+		ASSERT_EQ(Size, ToSize);
+		EXPECT_EQ(mem_comp(pGot, pTo, ToSize), 0);
+
+		// both sides account the same data rate
+		int Rate = 0;
+		int SentRate = 0;
+		for(int Type = 0; Type < 24; Type++)
+		{
+			Rate += pReceiverDelta->GetDataRate(Type);
+			SentRate += pSnapshotDelta->GetDataRate(Type);
+			EXPECT_EQ(pSnapshotDelta->GetDataUpdates(Type), pReceiverDelta->GetDataUpdates(Type));
+		}
+		EXPECT_EQ(Rate, ReferenceDataRate((CSnapshot *)pFrom, (CSnapshot *)pTo));
+		EXPECT_EQ(SentRate, Rate);
+
+		// nothing changed
+		EXPECT_EQ(pSnapshotDelta->CreateDelta((CSnapshot *)pTo, (CSnapshot *)pTo, pDelta), 0);
+		delete pReceiverDelta;
+		delete pSnapshotDelta;
+	}
+
+	delete [] pDelta;
+	delete [] pGot;
+	delete [] pTo;
+	delete [] pFrom;
+	delete pBuilder;
+}
+
+TEST(SnapshotDelta, CrowdedKeys)
+{
+	// more keys than the old hash list kept per bucket
+	CSnapshotBuilder *pBuilder = new CSnapshotBuilder;
+	CSnapshotDelta *pSnapshotDelta = new CSnapshotDelta;
+	char *pSnap = new char[CSnapshot::MAX_SIZE];
+	char *pDelta = new char[CSnapshot::MAX_SIZE*2];
+
+	pBuilder->Init();
+	for(int i = 0; i < 200; i++)
+		((int *)pBuilder->NewItem(1, i*16, 4))[0] = i;
+	pBuilder->Finish(pSnap);
+
+	EXPECT_EQ(pSnapshotDelta->CreateDelta((CSnapshot *)pSnap, (CSnapshot *)pSnap, pDelta), 0);
+
+	delete [] pDelta;
+	delete [] pSnap;
+	delete pSnapshotDelta;
+	delete pBuilder;
+}
+
+TEST(SnapshotDelta, Benchmark)
+{
+	static const int s_aNumItems[] = {100, 300, 1000};
+	static const int s_Iterations = 200;
+	CSnapshotBuilder *pBuilder = new CSnapshotBuilder;
+	CSnapshotDelta *pSnapshotDelta = new CSnapshotDelta;
+	char *pFrom = new char[CSnapshot::MAX_SIZE];
+	char *pTo = new char[CSnapshot::MAX_SIZE];
+	char *pGot = new char[CSnapshot::MAX_SIZE];
+	char *pDelta = new char[CSnapshot::MAX_SIZE*2];
+
+	for(unsigned n = 0; n < sizeof(s_aNumItems)/sizeof(s_aNumItems[0]); n++)
+	{
+		// leave room for the added items
+		int NumItems = s_aNumItems[n]*9/10;
+		BuildDeltaSnap(pBuilder, pFrom, NumItems, n, 0);
+		int ToSize = BuildDeltaSnap(pBuilder, pTo, NumItems, n, 1);
+
+		int DeltaSize = 0;
+		int64 Start = time_get();
+		for(int i = 0; i < s_Iterations; i++)
+			DeltaSize = pSnapshotDelta->CreateDelta((CSnapshot *)pFrom, (CSnapshot *)pTo, pDelta);
+		int64 Mid = time_get();
+		for(int i = 0; i < s_Iterations; i++)
+			pSnapshotDelta->UnpackDelta((CSnapshot *)pFrom, (CSnapshot *)pGot, pDelta, DeltaSize);
+		int64 End = time_get();
+
+		char aName[64];
+		str_format(aName, sizeof(aName), "delta with %4d items create", s_aNumItems[n]);
+		PrintBenchmark(aName, Mid-Start, 0, s_Iterations, ToSize);
+		str_format(aName, sizeof(aName), "delta with %4d items unpack", s_aNumItems[n]);
+		PrintBenchmark(aName, End-Mid, 0, s_Iterations, ToSize);
+	}
+
+	delete [] pDelta;
+	delete [] pGot;
+	delete [] pTo;
+	delete [] pFrom;
+	delete pSnapshotDelta;
+	delete pBuilder;
+}
@@ -0,0 +1,85 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/soundmix.h>
+
+// the plain loop of the mixer, the vector paths have to give the same sums
+static void ReferenceMixFrames(int *pOut, const short *pIn, int Step, unsigned Frames, int Lvol, int Rvol)
+{
+	for(unsigned s = 0; s < Frames; s++)
+	{
+		pOut[s*2] += pIn[s*Step]*Lvol;
+		pOut[s*2+1] += pIn[s*Step+Step-1]*Rvol;
+	}
+}
+
+static void FillSamples(short *pData, int Num, unsigned Seed)
+{
+	for(int i = 0; i < Num; i++)
+		pData[i] = (short)(random_seeded(&Seed)*2-0x7fff);
+	// the extremes too
+	if(Num > 1)
+	{
+		pData[0] = -0x8000;
+		pData[1] = 0x7fff;
+	}
+}
+
+TEST(SoundMix, MatchesReference)
+{
+	static const int s_aVolumes[] = {0, 1, 128, 255, 0x7fff, -5, 0x8000};
+	static const unsigned s_aFrames[] = {0, 1, 3, 4, 7, 8, 9, 31, 512};
+	short aIn[2*512+1];
+	int aOut[2*512], aExpected[2*512];
+
+	for(int Step = 1; Step <= 2; Step++)
+		for(unsigned f = 0; f < sizeof(s_aFrames)/sizeof(s_aFrames[0]); f++)
+			for(unsigned l = 0; l < sizeof(s_aVolumes)/sizeof(s_aVolumes[0]); l++)
+				for(unsigned r = 0; r < sizeof(s_aVolumes)/sizeof(s_aVolumes[0]); r++)
+				{
+					unsigned Seed = Step*1000+f*100+l*10+r;
+					FillSamples(aIn, sizeof(aIn)/sizeof(aIn[0]), Seed);
+					for(int i = 0; i < 2*512; i++)
+						aOut[i] = aExpected[i] = (int)random_seeded(&Seed)-0x4000;
+
+					// the voices don't start aligned in the sample data
+					ReferenceMixFrames(aExpected, aIn+1, Step, s_aFrames[f], s_aVolumes[l], s_aVolumes[r]);
+					MixFrames(aOut, aIn+1, Step, s_aFrames[f], s_aVolumes[l], s_aVolumes[r]);
+					ASSERT_EQ(mem_comp(aOut, aExpected, sizeof(aOut)), 0) << "step=" << Step << " frames=" << s_aFrames[f]
+						<< " lvol=" << s_aVolumes[l] << " rvol=" << s_aVolumes[r];
+				}
+}
+
+TEST(SoundMix, Benchmark)
+{
+	// one mix pass with every voice of the client playing
+	static const int s_NumVoices = 64;
+	static const unsigned s_Frames = 512;
+	static const int s_Iterations = 200;
+	short *pIn = new short[s_NumVoices*s_Frames*2];
+	int *pOut = new int[s_Frames*2];
+	FillSamples(pIn, s_NumVoices*s_Frames*2, 1);
+	mem_zero(pOut, s_Frames*2*sizeof(int));
+
+	for(int Step = 1; Step <= 2; Step++)
+	{
+		int64 Start = time_get();
+		for(int i = 0; i < s_Iterations; i++)
+			for(int v = 0; v < s_NumVoices; v++)
+				ReferenceMixFrames(pOut, pIn+v*s_Frames*2, Step, s_Frames, 200, 100);
+		int64 Mid = time_get();
+		for(int i = 0; i < s_Iterations; i++)
+			for(int v = 0; v < s_NumVoices; v++)
+				MixFrames(pOut, pIn+v*s_Frames*2, Step, s_Frames, 200, 100);
+		int64 End = time_get();
+
+		char aName[64];
+		str_format(aName, sizeof(aName), "mix %d %s voices", s_NumVoices, Step == 1 ? "mono" : "stereo");
+		PrintBenchmark(aName, End-Mid, Mid-Start, s_Iterations);
+	}
+
+	delete [] pOut;
+	delete [] pIn;
+}
@@ -0,0 +1,232 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <game/server/stats.h>
+
+TEST(RankFormula, Default)
+{
+	CRankFormula Formula;
+	EXPECT_EQ(Formula.Weights()[CStatsSnapshot::COL_KILLS], 3);
+	EXPECT_EQ(Formula.Weights()[CStatsSnapshot::COL_FREEZES], 1);
+	EXPECT_EQ(Formula.Weights()[CStatsSnapshot::COL_DEATHS], 0);
+	EXPECT_EQ(Formula.Constant(), 0);
+}
+
+TEST(RankFormula, Compile)
+{
+	CRankFormula Formula;
+	char aError[128];
+	ASSERT_TRUE(Formula.Compile(" - deaths*2 + kills + 3*4*kills + 10 - 2 ", aError, sizeof(aError)));
+	EXPECT_EQ(Formula.Weights()[CStatsSnapshot::COL_KILLS], 13);
+	EXPECT_EQ(Formula.Weights()[CStatsSnapshot::COL_DEATHS], -2);
+	EXPECT_EQ(Formula.Weights()[CStatsSnapshot::COL_FREEZES], 0);
+	EXPECT_EQ(Formula.Constant(), 8);
+
+	CFngStats Stats;
+	mem_zero(&Stats, sizeof(Stats));
+	Stats.m_Kills = 5;
+	Stats.m_Deaths = 7;
+	EXPECT_EQ(Formula.Score(&Stats), 5*13 - 7*2 + 8);
+
+	ASSERT_TRUE(Formula.Compile("0*kills", aError, sizeof(aError)));
+	EXPECT_EQ(Formula.Weights()[CStatsSnapshot::COL_KILLS], 0);
+	EXPECT_EQ(Formula.Score(&Stats), 0);
+}
+
+TEST(RankFormula, Errors)
+{
+	static const char *s_apInvalid[] = {
+		"",
+		"kills +",
+		"kills * deaths",
+		"kills2",
+		"kils",
+		"kills / 2",
+		"(kills)",
+		"10000000*kills",
+		"1000*1001*kills",
+		"1000000*kills + kills",
+		"-1000000 - 1",
+	};
+	CRankFormula Formula;
+	char aError[128];
+	ASSERT_TRUE(Formula.Compile("kills", aError, sizeof(aError)));
+	for(unsigned i = 0; i < sizeof(s_apInvalid)/sizeof(s_apInvalid[0]); i++)
+	{
+		aError[0] = 0;
+		EXPECT_FALSE(Formula.Compile(s_apInvalid[i], aError, sizeof(aError))) << s_apInvalid[i];
+		EXPECT_TRUE(aError[0]) << s_apInvalid[i];
+	}
+	// failed compiles keep the formula
+	CRankFormula Kills;
+	ASSERT_TRUE(Kills.Compile("kills", aError, sizeof(aError)));
+	EXPECT_TRUE(Formula == Kills);
+}
+
+TEST(RankFormula, Bounds)
+{
+	CRankFormula Formula;
+	char aError[128];
+	ASSERT_TRUE(Formula.Compile("1000*1000*first_seen - 1000000*deaths + 1000000", aError, sizeof(aError)));
+	EXPECT_EQ(Formula.Weights()[CStatsSnapshot::COL_FIRST_SEEN], (int)CRankFormula::MAX_WEIGHT);
+
+	// scores clamp instead of overflowing
+	CFngStats Stats;
+	mem_zero(&Stats, sizeof(Stats));
+	Stats.m_FirstSeen = 1700000000;
+	EXPECT_EQ(Formula.Score(&Stats), 0x7fffffff);
+	Stats.m_FirstSeen = 0;
+	Stats.m_Deaths = 1000000;
+	EXPECT_EQ(Formula.Score(&Stats), -0x7fffffff - 1);
+}
+
+TEST(StatsWindows, ParseDay)
+{
+	EXPECT_EQ(CStatsWindows::ParseDay("1970-01-01"), 0);
+	EXPECT_EQ(CStatsWindows::ParseDay("2000-03-01"), 11017);
+	EXPECT_EQ(CStatsWindows::ParseDay("2024-02-29"), 19782);
+	EXPECT_EQ(CStatsWindows::ParseDay("2100-12-31"), 47846);
+
+	EXPECT_EQ(CStatsWindows::ParseDay(""), -1);
+	EXPECT_EQ(CStatsWindows::ParseDay("1969-12-31"), -1);
+	EXPECT_EQ(CStatsWindows::ParseDay("2024-13-01"), -1);
+	EXPECT_EQ(CStatsWindows::ParseDay("2024-00-10"), -1);
+	EXPECT_EQ(CStatsWindows::ParseDay("2024-01-32"), -1);
+	EXPECT_EQ(CStatsWindows::ParseDay("2024/01/01"), -1);
+	EXPECT_EQ(CStatsWindows::ParseDay("2024-1-01"), -1);
+	EXPECT_EQ(CStatsWindows::ParseDay("2024-01-011"), -1);
+}
+
+TEST(StatsWindows, FormatDay)
+{
+	char aDate[16];
+	CStatsWindows::FormatDay(0, aDate, sizeof(aDate));
+	EXPECT_STREQ(aDate, "1970-01-01");
+	CStatsWindows::FormatDay(19782, aDate, sizeof(aDate));
+	EXPECT_STREQ(aDate, "2024-02-29");
+	CStatsWindows::FormatDay(47846, aDate, sizeof(aDate));
+	EXPECT_STREQ(aDate, "2100-12-31");
+
+	// every day of a few leap cycles survives the round trip
+	for(int Day = 0; Day < 366*12; Day++)
+	{
+		CStatsWindows::FormatDay(Day, aDate, sizeof(aDate));
+		ASSERT_EQ(CStatsWindows::ParseDay(aDate), Day) << aDate;
+	}
+}
+
+TEST(StatsWindows, WeekStart)
+{
+	// 1970-01-01 was a thursday, the week started on monday 1969-12-29
+	EXPECT_EQ(CStatsWindows::WeekStart(0), -3);
+	EXPECT_EQ(CStatsWindows::WeekStart(3), -3);
+	EXPECT_EQ(CStatsWindows::WeekStart(4), 4);
+	// sunday 2026-10-18 and monday 2026-10-19
+	EXPECT_EQ(CStatsWindows::WeekStart(20744), 20738);
+	EXPECT_EQ(CStatsWindows::WeekStart(20745), 20745);
+	for(int Day = 20745; Day < 20745+7; Day++)
+		EXPECT_EQ(CStatsWindows::WeekStart(Day), 20745);
+}
+
+TEST(StatsCache, SaveBeforeLoadKeepsConfig)
+{
+	CTestInfo Info;
+	ASSERT_EQ(fs_makedir(Info.m_aFilename), 0);
+	CStatsFileBackend Backend;
+	Backend.Init(Info.m_aFilename);
+	char aPath[MAX_FILE_PATH];
+	ASSERT_TRUE(Backend.RecordPath("player", aPath, sizeof(aPath)));
+
+	CFngStats Stats;
+	mem_zero(&Stats, sizeof(Stats));
+	str_copy(Stats.m_aName, "player", sizeof(Stats.m_aName));
+	Stats.m_Kills = 5;
+	Stats.m_CfgFlags = CFG_VANILLA_HAMMER;
+	ASSERT_TRUE(WriteStatsFile(aPath, &Stats));
+
+	// the round ended before the record was loaded, the config flags are not known
+	CStatsCache Cache;
+	Cache.Init(0, &Backend, Info.m_aFilename, 0, 0);
+	CFngStats Round;
+	mem_zero(&Round, sizeof(Round));
+	str_copy(Round.m_aName, "player", sizeof(Round.m_aName));
+	Round.m_Kills = 2;
+	ASSERT_TRUE(Cache.Save("player", &Round));
+	ASSERT_EQ(ReadStatsFile(aPath, &Stats), 0);
+	EXPECT_EQ(Stats.m_Kills, 7);
+	EXPECT_EQ(Stats.m_CfgFlags&CFG_VANILLA_HAMMER, CFG_VANILLA_HAMMER);
+	ASSERT_EQ(Cache.Get("player", &Stats), (int)CStatsCache::STATE_LOADED);
+	EXPECT_EQ(Stats.m_CfgFlags&CFG_VANILLA_HAMMER, CFG_VANILLA_HAMMER);
+
+	// the player changed them
+	Round.m_CfgFlags = CFG_KNOWN;
+	ASSERT_TRUE(Cache.Save("player", &Round));
+	ASSERT_EQ(ReadStatsFile(aPath, &Stats), 0);
+	EXPECT_EQ(Stats.m_Kills, 9);
+	EXPECT_EQ(Stats.m_CfgFlags&CFG_VANILLA_HAMMER, 0);
+
+	fs_remove(aPath);
+	fs_remove(Info.m_aFilename);
+}
+
+TEST(RankFormula, SnapshotScores)
+{
+	CTestInfo Info;
+	ASSERT_EQ(fs_makedir(Info.m_aFilename), 0);
+	CStatsFileBackend Backend;
+	Backend.Init(Info.m_aFilename);
+
+	// not a multiple of the vector width, with values that overflow 32 bit sums
+	static const int s_NumPlayers = 11;
+	CFngStats aStats[s_NumPlayers];
+	unsigned Seed = 1;
+	for(int i = 0; i < s_NumPlayers; i++)
+	{
+		mem_zero(&aStats[i], sizeof(aStats[i]));
+		str_format(aStats[i].m_aName, sizeof(aStats[i].m_aName), "player%d", i);
+		aStats[i].m_Kills = random_seeded(&Seed)*(i+1);
+		aStats[i].m_Deaths = random_seeded(&Seed);
+		aStats[i].m_Freezes = random_seeded(&Seed);
+	}
+	aStats[0].m_Kills = 0x7fffffff;
+	aStats[1].m_Deaths = 0x7fffffff;
+	aStats[2].m_Kills = -0x7fffffff;
+	aStats[3].m_Freezes = -1;
+	char aPath[MAX_FILE_PATH];
+	for(int i = 0; i < s_NumPlayers; i++)
+	{
+		ASSERT_TRUE(Backend.RecordPath(aStats[i].m_aName, aPath, sizeof(aPath)));
+		ASSERT_TRUE(WriteStatsFile(aPath, &aStats[i]));
+	}
+	char aSnapshotPath[MAX_FILE_PATH];
+	str_format(aSnapshotPath, sizeof(aSnapshotPath), "%s.snap", Info.m_aFilename);
+	ASSERT_EQ(CStatsSnapshot::Write(Info.m_aFilename, aSnapshotPath), s_NumPlayers);
+	CStatsSnapshot Snapshot;
+	ASSERT_TRUE(Snapshot.Open(aSnapshotPath));
+
+	static const char *s_apFormulas[] = {"score", "kills*1000000 - deaths*1000000 + 7", "kills - freezes*3", "42"};
+	for(unsigned f = 0; f < sizeof(s_apFormulas)/sizeof(s_apFormulas[0]); f++)
+	{
+		CRankFormula Formula;
+		char aError[128];
+		ASSERT_TRUE(!str_comp(s_apFormulas[f], "score") || Formula.Compile(s_apFormulas[f], aError, sizeof(aError))) << aError;
+		int aScores[s_NumPlayers];
+		Formula.Score(&Snapshot, aScores);
+		for(int i = 0; i < s_NumPlayers; i++)
+		{
+			int Player = str_toint(Snapshot.Name(i)+str_length("player"));
+			EXPECT_EQ(aScores[i], Formula.Score(&aStats[Player])) << s_apFormulas[f] << " " << Snapshot.Name(i);
+		}
+	}
+
+	Snapshot.Close();
+	fs_remove(aSnapshotPath);
+	for(int i = 0; i < s_NumPlayers; i++)
+	{
+		Backend.RecordPath(aStats[i].m_aName, aPath, sizeof(aPath));
+		fs_remove(aPath);
+	}
+	fs_remove(Info.m_aFilename);
+}
@@ -1,5 +1,6 @@
 #include "test.h"
 #include <gtest/gtest.h>
+#include <stdio.h>
 
 #include <base/system.h>
 
@@ -17,6 +18,29 @@ void CTestInfo::Filename(char *pBuffer, int BufferLength, const char *pSuffix)
 	str_format(pBuffer, BufferLength, "%s%s", m_aFilenamePrefix, pSuffix);
 }
 
+static void FormatBenchmarkTime(char *pBuf, int BufSize, int64 Time, int Iterations, double Bytes)
+{
+	double Seconds = Time/(double)time_freq();
+	if(Bytes > 0)
+		str_format(pBuf, BufSize, "%9.2fus %8.1f MB/s", Seconds*1000000.0/Iterations, Bytes*Iterations/(1024.0*1024.0)/Seconds);
+	else
+		str_format(pBuf, BufSize, "%9.2fus", Seconds*1000000.0/Iterations);
+}
+
+void PrintBenchmark(const char *pName, int64 Time, int64 ReferenceTime, int Iterations, double Bytes)
+{
+	char aTime[64];
+	FormatBenchmarkTime(aTime, sizeof(aTime), Time, Iterations, Bytes);
+	if(ReferenceTime)
+	{
+		char aReference[64];
+		FormatBenchmarkTime(aReference, sizeof(aReference), ReferenceTime, Iterations, Bytes);
+		printf("%-36s %s (plain %s)\n", pName, aTime, aReference);
+	}
+	else
+		printf("%-36s %s\n", pName, aTime);
+}
+
 int main(int argc, char **argv)
 {
 	::testing::InitGoogleTest(&argc, argv);
@@ -1,5 +1,7 @@
 #ifndef TEST_TEST_H
 #define TEST_TEST_H
+#include <base/system.h>
+
 class CTestInfo
 {
 public:
@@ -8,4 +10,8 @@ public:
 	char m_aFilenamePrefix[64];
 	char m_aFilename[64];
 };
+
+// prints the time per iteration of a benchmarked code path, and its throughput if Bytes is set.
+// the reference is the plain implementation it is measured against, or 0
+void PrintBenchmark(const char *pName, int64 Time, int64 ReferenceTime, int Iterations, double Bytes = 0);
 #endif // TEST_TEST_H
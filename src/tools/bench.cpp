@@ -0,0 +1,443 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <stdlib.h> // srand
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/config.h>
+#include <engine/console.h>
+#include <engine/map.h>
+#include <engine/server.h>
+#include <engine/storage.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/config.h>
+#include <engine/shared/profiler.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/snapshot.h>
+
+#include <generated/protocol.h>
+#include <game/layers.h>
+#include <game/version.h>
+#include <game/server/gamecontext.h>
+#include <game/server/gamecontroller.h>
+
+#include "botinput.h"
+
+// runs the game server on a map with scripted players and no network,
+// to see what a tick and its snapshots cost
+
+class CBenchServer : public IServer
+{
+	enum
+	{
+		MAX_IDS=16*1024,
+	};
+
+	IGameServer *m_pGameServer;
+
+	CSnapshotBuilder m_SnapshotBuilder;
+	CSnapshotDelta m_SnapshotDelta;
+	CSnapshotStorage m_aSnapshots[MAX_CLIENTS];
+
+	// freed ids are handed out again last in first out, the server delays that a bit
+	int m_aFreeIDs[MAX_IDS];
+	int m_NumFreeIDs;
+	int m_NextID;
+
+	int m_ProfInput;
+	int m_ProfTick;
+	int m_ProfSnap;
+	int m_ProfSnapBuild;
+	int m_ProfSnapDelta;
+	int m_ProfSnapCompress;
+
+public:
+	CProfiler m_Profiler;
+
+	bool m_aIngame[MAX_CLIENTS];
+	char m_aaNames[MAX_CLIENTS][MAX_NAME_LENGTH];
+	CNetObj_PlayerInput m_aInputs[MAX_CLIENTS];
+	unsigned m_aSeeds[MAX_CLIENTS];
+
+	int m_NumMsgs;
+	int m_NumSnaps;
+	int64 m_SnapBytes;
+
+	CBenchServer()
+	{
+		m_CurrentGameTick = 0;
+		m_TickSpeed = SERVER_TICK_SPEED;
+		m_pGameServer = 0;
+		m_NumFreeIDs = 0;
+		m_NextID = 0;
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			m_aSnapshots[i].Init();
+			m_aIngame[i] = false;
+			str_format(m_aaNames[i], sizeof(m_aaNames[i]), "bench%d", i);
+			mem_zero(&m_aInputs[i], sizeof(m_aInputs[i]));
+			m_aSeeds[i] = 0;
+		}
+		m_NumMsgs = 0;
+		m_NumSnaps = 0;
+		m_SnapBytes = 0;
+
+		// same names as the server uses, so the numbers compare with the perf command
+		m_ProfInput = m_Profiler.RegisterZone("input");
+		m_ProfTick = m_Profiler.RegisterZone("tick");
+		m_ProfSnap = m_Profiler.RegisterZone("snap");
+		m_ProfSnapBuild = m_Profiler.RegisterZone("snap_build");
+		m_ProfSnapDelta = m_Profiler.RegisterZone("snap_delta");
+		m_ProfSnapCompress = m_Profiler.RegisterZone("snap_compress");
+	}
+
+	void SetGameServer(IGameServer *pGameServer) { m_pGameServer = pGameServer; }
+
+	virtual const char *ClientName(int ClientID) const { return m_aIngame[ClientID] ? m_aaNames[ClientID] : "(invalid)"; }
+	virtual const char *ClientClan(int ClientID) const { return ""; }
+	virtual int ClientCountry(int ClientID) const { return -1; }
+	virtual bool ClientIngame(int ClientID) const { return ClientID >= 0 && ClientID < MAX_CLIENTS && m_aIngame[ClientID]; }
+	virtual int GetClientInfo(int ClientID, CClientInfo *pInfo) const
+	{
+		if(!ClientIngame(ClientID))
+			return 0;
+		pInfo->m_pName = m_aaNames[ClientID];
+		pInfo->m_Latency = 0;
+		return 1;
+	}
+	virtual void GetClientAddr(int ClientID, char *pAddrStr, int Size) const { str_format(pAddrStr, Size, "bench:%d", ClientID); }
+	virtual int GetClientVersion(int ClientID) const { return CLIENT_VERSION; }
+
+	// the game still packs its messages, they just go nowhere
+	virtual int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
+	{
+		m_NumMsgs++;
+		return 0;
+	}
+
+	virtual void SetClientName(int ClientID, char const *pName) { str_copy(m_aaNames[ClientID], pName, sizeof(m_aaNames[ClientID])); }
+	virtual void SetClientClan(int ClientID, char const *pClan) {}
+	virtual void SetClientCountry(int ClientID, int Country) {}
+	virtual void SetClientScore(int ClientID, int Score) {}
+
+	virtual int SnapNewID()
+	{
+		if(m_NumFreeIDs)
+			return m_aFreeIDs[--m_NumFreeIDs];
+		dbg_assert(m_NextID < MAX_IDS, "id error");
+		return m_NextID++;
+	}
+
+	virtual void SnapFreeID(int ID)
+	{
+		dbg_assert(ID >= 0 && ID < MAX_IDS && m_NumFreeIDs < MAX_IDS, "id error");
+		m_aFreeIDs[m_NumFreeIDs++] = ID;
+	}
+
+	virtual void *SnapNewItem(int Type, int ID, int Size)
+	{
+		dbg_assert(Type >= 0 && Type <=0xffff, "incorrect type");
+		dbg_assert(ID >= 0 && ID <=0xffff, "incorrect id");
+		return m_SnapshotBuilder.NewItem(Type, ID, Size);
+	}
+
+	virtual void *SnapRepeatItem(int ClientID, int Type, int ID, int Size, int MinTick)
+	{
+		return m_SnapshotBuilder.RepeatItem(&m_aSnapshots[ClientID], Type, ID, Size, MinTick);
+	}
+
+	virtual int SnapBudget(int ClientID) const { return -1; }
+	virtual void SnapSetStaticsize(int ItemType, int Size) { m_SnapshotDelta.SetStaticsize(ItemType, Size); }
+
+	virtual void SetRconCID(int ClientID) {}
+	virtual bool IsAuthed(int ClientID) const { return false; }
+	virtual bool IsAuthedMod(int ClientID) const { return false; }
+	virtual bool IsAuthedAdmin(int ClientID) const { return false; }
+	virtual bool IsBanned(int ClientID) { return false; }
+	virtual void Kick(int ClientID, const char *pReason) { dbg_msg("bench", "game wanted to kick %d (%s), ignored", ClientID, pReason); }
+
+	virtual void DemoRecorder_HandleAutoStart() {}
+	virtual bool DemoRecorder_IsRecording() { return false; }
+
+	virtual CProfiler *Profiler() { return &m_Profiler; }
+	virtual void PreloadMap(const char *pMapName) {}
+	virtual void GetMapInfo(char *pMapName, int MapNameSize, SHA256_DIGEST *pSha256) const { str_copy(pMapName, "", MapNameSize); *pSha256 = SHA256_ZEROED; }
+
+	void Join(int ClientID, unsigned Seed)
+	{
+		m_aIngame[ClientID] = true;
+		m_aSeeds[ClientID] = Seed;
+		m_pGameServer->OnClientConnected(ClientID, false);
+		m_pGameServer->OnClientEnter(ClientID);
+	}
+
+	// like the fake_client, but new decisions are made by ticks instead of time
+	void UpdateInput(int ClientID)
+	{
+		unsigned *pSeed = &m_aSeeds[ClientID];
+		UpdateBotInput(&m_aInputs[ClientID], pSeed, random_seeded(pSeed)%25 == 0);
+	}
+
+	void RunTick()
+	{
+		m_CurrentGameTick++;
+
+		{
+			CProfiler::CScope ProfInput(&m_Profiler, m_ProfInput);
+			for(int i = 0; i < MAX_CLIENTS; i++)
+			{
+				if(!m_aIngame[i])
+					continue;
+				UpdateInput(i);
+				m_pGameServer->OnClientDirectInput(i, &m_aInputs[i]);
+				m_pGameServer->OnClientPredictedInput(i, &m_aInputs[i]);
+			}
+		}
+
+		{
+			CProfiler::CScope ProfTick(&m_Profiler, m_ProfTick);
+			m_pGameServer->OnTick();
+		}
+	}
+
+	// like CServer::DoSnapshot, every snapshot is acked right away
+	void DoSnapshot()
+	{
+		CProfiler::CScope ProfSnap(&m_Profiler, m_ProfSnap);
+
+		m_pGameServer->OnPreSnap();
+
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			if(!m_aIngame[i])
+				continue;
+
+			char aData[CSnapshot::MAX_SIZE];
+			CSnapshot *pData = (CSnapshot*)aData;
+			char aDeltaData[CSnapshot::MAX_SIZE];
+			char aCompData[CSnapshot::MAX_SIZE];
+			int SnapshotSize;
+			static CSnapshot EmptySnap;
+			EmptySnap.Clear();
+
+			{
+				CProfiler::CScope ProfBuild(&m_Profiler, m_ProfSnapBuild);
+				m_SnapshotBuilder.Init();
+				m_pGameServer->OnSnap(i);
+				SnapshotSize = m_SnapshotBuilder.Finish(pData);
+				pData->Crc();
+			}
+
+			CSnapshot *pDeltashot = m_aSnapshots[i].m_pLast ? m_aSnapshots[i].m_pLast->m_pSnap : &EmptySnap;
+			int DeltaSize;
+			{
+				CProfiler::CScope ProfDelta(&m_Profiler, m_ProfSnapDelta);
+				DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+			}
+
+			if(DeltaSize)
+			{
+				CProfiler::CScope ProfCompress(&m_Profiler, m_ProfSnapCompress);
+				m_SnapBytes += CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
+			}
+			m_NumSnaps++;
+
+			m_aSnapshots[i].PurgeAll();
+			m_aSnapshots[i].Add(m_CurrentGameTick, 0, SnapshotSize, pData, 0);
+		}
+
+		m_pGameServer->OnPostSnap();
+	}
+};
+
+// theme maps and the like have no spawns, put some on the floor so the characters have somewhere to go
+static void AddSpawns(CGameContext *pGameServer, int Wanted)
+{
+	CMapItemLayerTilemap *pTileMap = pGameServer->Layers()->GameLayer();
+	CTile *pTiles = (CTile *)pGameServer->Layers()->Map()->GetData(pTileMap->m_Data);
+	for(int i = 0; i < pTileMap->m_Width*pTileMap->m_Height; i++)
+	{
+		int Index = pTiles[i].m_Index-ENTITY_OFFSET;
+		if(Index == ENTITY_SPAWN || Index == ENTITY_SPAWN_RED || Index == ENTITY_SPAWN_BLUE)
+			return;
+	}
+
+	const CCollision *pCollision = pGameServer->Collision();
+	int Num = 0;
+	int Stride = maximum(1, pCollision->GetWidth()*pCollision->GetHeight()/(Wanted*4));
+	for(int i = 0; i < pCollision->GetWidth()*pCollision->GetHeight() && Num < Wanted; i += Stride)
+	{
+		vec2 Pos((i%pCollision->GetWidth())*32.0f+16.0f, (i/pCollision->GetWidth())*32.0f+16.0f);
+		if(pCollision->CheckPoint(Pos) || pCollision->CheckPoint(Pos, TILE_DEATH))
+			continue;
+
+		// stand on the floor below if there is one, else they just fall
+		for(vec2 Below = Pos; Below.y < pCollision->GetHeight()*32.0f; Below.y += 32.0f)
+		{
+			if(pCollision->CheckPoint(Below, TILE_DEATH))
+				break;
+			if(pCollision->CheckPoint(Below))
+			{
+				Pos.y = Below.y-32.0f;
+				break;
+			}
+		}
+
+		pGameServer->m_pController->OnEntity(ENTITY_SPAWN, Pos);
+		Num++;
+	}
+	dbg_msg("bench", "map has no spawns, added %d", Num);
+}
+
+static void Report(CBenchServer *pServer, int Ticks, int64 Time)
+{
+	CProfiler *pProfiler = &pServer->m_Profiler;
+	dbg_msg("bench", "total=%dns/tick msgs=%d/tick snaps=%d avgsnap=%dB",
+		(int)(Time*1000000000/time_freq()/Ticks), pServer->m_NumMsgs/Ticks, pServer->m_NumSnaps,
+		(int)(pServer->m_SnapBytes/maximum(1, pServer->m_NumSnaps)));
+
+	// the clock only has microseconds on unix, but the error averages out over many ticks.
+	// zones nest: the tick_* zones are inside tick, the entity type ticks, tick_defered and
+	// tick_cleanup inside tick_world and kill_log inside the entity ticks
+	for(int i = 0; i < pProfiler->NumZones(); i++)
+	{
+		if(!pProfiler->Count(i))
+			continue;
+		dbg_msg("bench", "  %-16s %9dns/tick calls=%-6d p50=%dus p99=%dus max=%dus", pProfiler->ZoneName(i),
+			(int)(pProfiler->Total(i)*1000/Ticks), pProfiler->Count(i),
+			(int)pProfiler->Percentile(i, 50), (int)pProfiler->Percentile(i, 99), (int)pProfiler->Max(i));
+	}
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	int NumPlayers = 16;
+	int NumTicks = 5000;
+	int NumWarmup = 250;
+	unsigned Seed = 1;
+	const char *pMap = 0;
+	int FirstCommand = argc;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(str_comp(argv[i], "-n") == 0 && i+1 < argc)
+			NumPlayers = clamp(str_toint(argv[++i]), 1, (int)MAX_CLIENTS);
+		else if(str_comp(argv[i], "-t") == 0 && i+1 < argc)
+			NumTicks = maximum(1, str_toint(argv[++i]));
+		else if(str_comp(argv[i], "-w") == 0 && i+1 < argc)
+			NumWarmup = maximum(0, str_toint(argv[++i]));
+		else if(str_comp(argv[i], "-s") == 0 && i+1 < argc)
+			Seed = str_toint(argv[++i]);
+		else if(argv[i][0] != '-')
+		{
+			pMap = argv[i];
+			FirstCommand = i+1;
+			break;
+		}
+		else
+		{
+			dbg_msg("usage", "%s [-n players] [-t ticks] [-w warmup ticks] [-s seed] [map [commands...]]", argv[0]);
+			return -1;
+		}
+	}
+
+	CBenchServer *pServer = new CBenchServer;
+	IKernel *pKernel = IKernel::Create();
+	IEngineMap *pEngineMap = CreateEngineMap();
+	CGameContext *pGameServer = static_cast<CGameContext *>(CreateGameServer());
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER|CFGFLAG_ECON);
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
+	IConfigManager *pConfigManager = CreateConfigManager();
+	pServer->SetGameServer(pGameServer);
+
+	{
+		bool RegisterFail = false;
+
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IServer*>(pServer));
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IEngineMap*>(pEngineMap)); // register as both
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IMap*>(pEngineMap));
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IGameServer*>(pGameServer));
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pConsole);
+		RegisterFail = RegisterFail || !pStorage || !pKernel->RegisterInterface(pStorage);
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pConfigManager);
+
+		if(RegisterFail)
+			return -1;
+	}
+
+	pConfigManager->Init(CFGFLAG_SERVER|CFGFLAG_ECON);
+	pConsole->Init();
+	pGameServer->OnConsoleInit();
+
+	// nothing of the benchmark should end up in the stats, the paths still have to be writable
+	CConfig *pConfig = pConfigManager->Values();
+	pConfig->m_SvStats = 0;
+	pStorage->GetCompletePath(IStorage::TYPE_SAVE, "", pConfig->m_SvStatsPath, sizeof(pConfig->m_SvStatsPath));
+	str_copy(pConfig->m_SvStatsFailPath, pConfig->m_SvStatsPath, sizeof(pConfig->m_SvStatsFailPath));
+	pConfig->m_SvMaxClients = MAX_CLIENTS;
+	pConfig->m_SvPlayerSlots = MAX_CLIENTS;
+	for(int i = FirstCommand; i < argc; i++)
+		pConsole->ExecuteLine(argv[i]);
+	pConfigManager->RestoreStrings();
+
+	// a bare name is looked up like the default maps of the repository
+	char aMapFile[IO_MAX_PATH_LENGTH];
+	if(!pMap)
+		pMap = pConfig->m_SvMap;
+	if(str_endswith(pMap, ".map"))
+		str_copy(aMapFile, pMap, sizeof(aMapFile));
+	else
+		str_format(aMapFile, sizeof(aMapFile), "datasrc/maps/%s.map", pMap);
+	if(!pEngineMap->Load(aMapFile))
+	{
+		dbg_msg("bench", "could not load map '%s'. the maps are a git submodule, see datasrc/maps", aMapFile);
+		return -1;
+	}
+
+	srand(Seed);
+	pGameServer->OnInit();
+	AddSpawns(pGameServer, NumPlayers);
+	for(int i = 0; i < NumPlayers; i++)
+		pServer->Join(i, Seed+i*7919);
+
+	dbg_msg("bench", "map=%s gametype=%s players=%d ticks=%d warmup=%d seed=%u", aMapFile, pGameServer->GameType(), NumPlayers, NumTicks, NumWarmup, Seed);
+
+	int64 Start = 0;
+	for(int t = 0; t < NumWarmup+NumTicks; t++)
+	{
+		if(t == NumWarmup)
+		{
+			pServer->m_Profiler.Reset();
+			pServer->m_NumMsgs = 0;
+			pServer->m_NumSnaps = 0;
+			pServer->m_SnapBytes = 0;
+			Start = time_get();
+		}
+
+		pServer->RunTick();
+		if(pConfig->m_SvHighBandwidth || (pServer->Tick()%2) == 0)
+			pServer->DoSnapshot();
+	}
+	Report(pServer, NumTicks, time_get()-Start);
+
+	int NumAlive = 0;
+	for(int i = 0; i < NumPlayers; i++)
+		if(pGameServer->GetPlayerChar(i))
+			NumAlive++;
+	dbg_msg("bench", "characters alive at the end: %d/%d", NumAlive, NumPlayers);
+
+	pGameServer->OnShutdown();
+
+	delete pKernel;
+	delete pEngineMap;
+	delete pGameServer;
+	delete pConsole;
+	delete pStorage;
+	delete pConfigManager;
+	delete pServer;
+
+	return 0;
+}
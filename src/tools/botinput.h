@@ -0,0 +1,32 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef TOOLS_BOTINPUT_H
+#define TOOLS_BOTINPUT_H
+
+#include <base/math.h>
+
+#include <generated/protocol.h>
+
+// the scripted players of the bench and the fake_client: run, jump and swing
+// around for a while when Decide is set, aim moves a bit every input and they
+// shoot now and then
+inline void UpdateBotInput(CNetObj_PlayerInput *pInput, unsigned *pSeed, bool Decide)
+{
+	if(Decide)
+	{
+		pInput->m_Direction = (int)(random_seeded(pSeed)%3)-1;
+		pInput->m_Jump = random_seeded(pSeed)%4 == 0;
+		if(random_seeded(pSeed)%3 == 0)
+			pInput->m_Hook ^= 1;
+	}
+
+	pInput->m_TargetX = clamp(pInput->m_TargetX + (int)(random_seeded(pSeed)%61)-30, -400, 400);
+	pInput->m_TargetY = clamp(pInput->m_TargetY + (int)(random_seeded(pSeed)%61)-30, -400, 400);
+	if(pInput->m_TargetX == 0 && pInput->m_TargetY == 0)
+		pInput->m_TargetX = 1;
+	if(pInput->m_Fire&1 || random_seeded(pSeed)%10 == 0)
+		pInput->m_Fire++;
+	pInput->m_WantedWeapon = WEAPON_LASER+1;
+}
+
+#endif
@@ -0,0 +1,634 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <stdio.h> // sscanf
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/storage.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/linereader.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/snapshot.h>
+
+#include <generated/protocol.h>
+#include <game/gamecore.h>
+#include <game/version.h>
+#include <game/server/stats.h>
+
+// goes through server demos and rebuilds the fng stats of the players in them,
+// to backfill the stats store for games played while stats were off or lost.
+// the spike colors and rifle shots are not in the demo directly: the colors come
+// from the score the killer got for the kill and every new laser is counted as a
+// shot of the closest character
+
+enum
+{
+	MAX_IDS=16*1024,
+	SPIKE_SCORE=3,
+	SHOT_DISTANCE=64,
+};
+
+static const char *s_pJournalName = "replayed_demos.txt";
+
+struct CDemoEntry
+{
+	char m_aPath[512];
+	bool operator<(const CDemoEntry &Other) const { return str_comp(m_aPath, Other.m_aPath) < 0; }
+	bool operator==(const CDemoEntry &Other) const { return str_comp(m_aPath, Other.m_aPath) == 0; }
+};
+
+static bool StatsNameLess(const CFngStats &a, const CFngStats &b)
+{
+	return str_comp(a.m_aName, b.m_aName) < 0;
+}
+
+// adds up the stats of the same player from two demos
+static void AddReplayStats(const CFngStats *pFrom, CFngStats *pTo)
+{
+	time_t FirstSeen = minimum(pFrom->m_FirstSeen, pTo->m_FirstSeen);
+	time_t LastKillTime = maximum(pFrom->m_LastKillTime, pTo->m_LastKillTime);
+	MergeFngStats(pFrom, pTo);
+	pTo->m_FirstSeen = FirstSeen;
+	pTo->m_LastKillTime = LastKillTime;
+}
+
+class CReplay : public CDemoPlayer::IListener
+{
+	struct CClient
+	{
+		int m_Stats; // index in m_vStats, -1 if the client is not there
+		int m_Score;
+		int m_Spree;
+		int m_Multi;
+		time_t m_LastKillTime;
+		int m_PendingKills;
+		int m_PendingFreezes;
+		int m_X, m_Y;
+		bool m_HasCharacter;
+		bool m_Seen;
+	};
+
+	CNetObjHandler m_NetObjHandler;
+	CSnapshotDelta m_SnapshotDelta;
+	CDemoPlayer m_DemoPlayer;
+
+	CClient m_aClients[MAX_CLIENTS];
+	bool m_aLasers[MAX_IDS];
+	bool m_aNewLasers[MAX_IDS];
+	std::vector<int> m_vOnlineTicks;
+	time_t m_StartTime;
+	int m_LastSnapTick;
+
+	// the server records a message once for every client it is sent to
+	CNetMsg_Sv_KillMsg m_LastKill;
+	int m_LastKillTick;
+
+	void ResetClient(int ClientID)
+	{
+		CClient *pClient = &m_aClients[ClientID];
+		pClient->m_Stats = -1;
+		pClient->m_Score = 0;
+		pClient->m_Spree = 0;
+		pClient->m_Multi = 0;
+		pClient->m_LastKillTime = 0;
+		pClient->m_PendingKills = 0;
+		pClient->m_PendingFreezes = 0;
+		pClient->m_HasCharacter = false;
+	}
+
+	time_t TickTime(int Tick) const
+	{
+		return m_StartTime + (Tick-m_DemoPlayer.BaseInfo()->m_FirstTick)/SERVER_TICK_SPEED;
+	}
+
+	CFngStats *Stats(int ClientID)
+	{
+		if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_Stats < 0)
+			return 0;
+		return &m_vStats[m_aClients[ClientID].m_Stats];
+	}
+
+	int FindStats(const char *pName)
+	{
+		for(unsigned i = 0; i < m_vStats.size(); i++)
+			if(str_comp(m_vStats[i].m_aName, pName) == 0)
+				return i;
+
+		CFngStats Stats;
+		mem_zero(&Stats, sizeof(Stats));
+		str_copy(Stats.m_aName, pName, sizeof(Stats.m_aName));
+		m_vStats.push_back(Stats);
+		m_vOnlineTicks.push_back(0);
+		return m_vStats.size()-1;
+	}
+
+	void EndSpree(int ClientID)
+	{
+		CFngStats *pStats = Stats(ClientID);
+		if(pStats)
+			pStats->m_SpreeBest = maximum(pStats->m_SpreeBest, m_aClients[ClientID].m_Spree);
+		m_aClients[ClientID].m_Spree = 0;
+	}
+
+	void OnKill(int Killer, int Victim, int Tick)
+	{
+		CFngStats *pVictim = Stats(Victim);
+		if(pVictim)
+		{
+			pVictim->m_Deaths++;
+			EndSpree(Victim);
+		}
+
+		CFngStats *pKiller = Stats(Killer);
+		if(!pKiller)
+			return;
+		CClient *pClient = &m_aClients[Killer];
+		pKiller->m_Kills++;
+		pClient->m_PendingKills++;
+		pClient->m_Spree++;
+
+		// same as CPlayer::HandleMulti
+		time_t Now = TickTime(Tick);
+		if(Now - pClient->m_LastKillTime > 5)
+			pClient->m_Multi = 1;
+		else
+		{
+			pClient->m_Multi++;
+			pKiller->m_MultiBest = maximum(pKiller->m_MultiBest, pClient->m_Multi);
+			pKiller->m_aMultis[minimum(pClient->m_Multi-2, MAX_MULTIS-1)]++;
+		}
+		pClient->m_LastKillTime = Now;
+		pKiller->m_LastKillTime = Now;
+	}
+
+	// the kill message says ninja for every spike, the color is in the score
+	// the killer got on top of the score for the kill and its freezes
+	void ResolveSpikes(int ClientID, int NewScore)
+	{
+		CClient *pClient = &m_aClients[ClientID];
+		CFngStats *pStats = Stats(ClientID);
+		int Kills = pClient->m_PendingKills;
+		int Extra = NewScore - pClient->m_Score - Kills*SPIKE_SCORE - pClient->m_PendingFreezes;
+		pClient->m_PendingKills = 0;
+		pClient->m_PendingFreezes = 0;
+		if(!pStats || Kills == 0 || Extra <= 0)
+			return;
+
+		for(int Gold = 0; Gold <= Kills; Gold++)
+			for(int Green = 0; Gold+Green <= Kills; Green++)
+				for(int Purple = 0; Gold+Green+Purple <= Kills; Purple++)
+					if(Gold*5 + Green*3 + Purple*7 == Extra)
+					{
+						pStats->m_GoldSpikes += Gold;
+						pStats->m_GreenSpikes += Green;
+						pStats->m_PurpleSpikes += Purple;
+						return;
+					}
+	}
+
+public:
+	std::vector<CFngStats> m_vStats;
+
+	CReplay() : m_DemoPlayer(&m_SnapshotDelta)
+	{
+		for(int i = 0; i < NUM_NETOBJTYPES; i++)
+			m_SnapshotDelta.SetStaticsize(i, m_NetObjHandler.GetObjSize(i));
+		m_DemoPlayer.SetListener(this);
+	}
+
+	bool Run(IStorage *pStorage, IConsole *pConsole, const char *pPath)
+	{
+		m_vStats.clear();
+		m_vOnlineTicks.clear();
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			ResetClient(i);
+			m_aClients[i].m_Seen = false;
+		}
+		mem_zero(m_aLasers, sizeof(m_aLasers));
+		mem_zero(&m_LastKill, sizeof(m_LastKill));
+		m_LastKillTick = -1;
+		m_LastSnapTick = -1;
+
+		if(m_DemoPlayer.Load(pStorage, pConsole, pPath, IStorage::TYPE_ALL, GAME_NETVERSION))
+			return false;
+		if(m_DemoPlayer.GetDemoType() != IDemoPlayer::DEMOTYPE_SERVER)
+		{
+			dbg_msg("demo_stats", "'%s' is not a server demo", pPath);
+			m_DemoPlayer.Stop();
+			return false;
+		}
+
+		struct tm Start;
+		mem_zero(&Start, sizeof(Start));
+		if(sscanf(m_DemoPlayer.Info()->m_Header.m_aTimestamp, "%d-%d-%d_%d-%d-%d",
+			&Start.tm_year, &Start.tm_mon, &Start.tm_mday, &Start.tm_hour, &Start.tm_min, &Start.tm_sec) != 6)
+		{
+			dbg_msg("demo_stats", "'%s' has no valid timestamp", pPath);
+			m_DemoPlayer.Stop();
+			return false;
+		}
+		Start.tm_year -= 1900;
+		Start.tm_mon -= 1;
+		Start.tm_isdst = -1;
+		m_StartTime = mktime(&Start);
+
+		m_DemoPlayer.Play();
+		while(m_DemoPlayer.IsPlaying() && !m_DemoPlayer.BaseInfo()->m_Paused)
+			m_DemoPlayer.NextFrame();
+		m_DemoPlayer.Stop();
+
+		// the demo ending is like a disconnect for everyone
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			EndSpree(i);
+		for(unsigned i = 0; i < m_vStats.size(); i++)
+			m_vStats[i].m_TotalOnlineTime = m_vOnlineTicks[i]/SERVER_TICK_SPEED;
+		return true;
+	}
+
+	virtual void OnDemoPlayerSnapshot(void *pData, int Size)
+	{
+		// the player hands out the last snapshot again on ticks with only messages
+		int Tick = m_DemoPlayer.Info()->m_Info.m_CurrentTick;
+		if(Tick == m_LastSnapTick)
+			return;
+		int Ticks = m_LastSnapTick < 0 ? 1 : Tick-m_LastSnapTick;
+
+		CSnapshot *pSnap = (CSnapshot *)pData;
+		bool aPresent[MAX_CLIENTS] = {false};
+		int aScores[MAX_CLIENTS] = {0};
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			m_aClients[i].m_HasCharacter = false;
+		mem_zero(m_aNewLasers, sizeof(m_aNewLasers));
+
+		for(int i = 0; i < pSnap->NumItems(); i++)
+		{
+			const CSnapshotItem *pItem = pSnap->GetItem(i);
+			int ID = pItem->ID();
+			if(pItem->Type() == NETOBJTYPE_LASER)
+			{
+				if(ID >= 0 && ID < MAX_IDS)
+					m_aNewLasers[ID] = true;
+				continue;
+			}
+			if(ID < 0 || ID >= MAX_CLIENTS)
+				continue;
+
+			if(pItem->Type() == NETOBJTYPE_DE_CLIENTINFO)
+			{
+				const CNetObj_De_ClientInfo *pInfo = (const CNetObj_De_ClientInfo *)pItem->Data();
+				char aName[MAX_NAME_LENGTH];
+				char aClan[MAX_CLAN_LENGTH];
+				IntsToStr(pInfo->m_aName, 4, aName);
+				IntsToStr(pInfo->m_aClan, 3, aClan);
+
+				// a new name is a new player for the stats
+				CFngStats *pStats = Stats(ID);
+				if(!pStats || str_comp(pStats->m_aName, aName) != 0)
+				{
+					EndSpree(ID);
+					ResetClient(ID);
+					m_aClients[ID].m_Stats = FindStats(aName);
+					pStats = Stats(ID);
+					if(!pStats->m_FirstSeen)
+						pStats->m_FirstSeen = TickTime(Tick);
+				}
+				str_copy(pStats->m_aClan, aClan, sizeof(pStats->m_aClan));
+				pStats->m_LastSeen = TickTime(Tick);
+				m_vOnlineTicks[m_aClients[ID].m_Stats] += Ticks;
+				aPresent[ID] = true;
+			}
+			else if(pItem->Type() == NETOBJTYPE_PLAYERINFO)
+				aScores[ID] = ((const CNetObj_PlayerInfo *)pItem->Data())->m_Score;
+			else if(pItem->Type() == NETOBJTYPE_CHARACTER)
+			{
+				const CNetObj_Character *pChar = (const CNetObj_Character *)pItem->Data();
+				m_aClients[ID].m_X = pChar->m_X;
+				m_aClients[ID].m_Y = pChar->m_Y;
+				m_aClients[ID].m_HasCharacter = true;
+			}
+		}
+
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			if(!aPresent[i])
+			{
+				if(m_aClients[i].m_Stats >= 0)
+				{
+					EndSpree(i);
+					ResetClient(i);
+				}
+				continue;
+			}
+			if(m_aClients[i].m_Seen)
+				ResolveSpikes(i, aScores[i]);
+			m_aClients[i].m_Score = aScores[i];
+			m_aClients[i].m_PendingKills = 0;
+			m_aClients[i].m_PendingFreezes = 0;
+			m_aClients[i].m_Seen = true;
+		}
+
+		// lasers that showed up since the last snapshot
+		for(int i = 0; i < pSnap->NumItems(); i++)
+		{
+			const CSnapshotItem *pItem = pSnap->GetItem(i);
+			if(pItem->Type() != NETOBJTYPE_LASER || pItem->ID() < 0 || pItem->ID() >= MAX_IDS || m_aLasers[pItem->ID()])
+				continue;
+			const CNetObj_Laser *pLaser = (const CNetObj_Laser *)pItem->Data();
+			if(pLaser->m_StartTick <= m_LastSnapTick)
+				continue;
+			int Shooter = -1;
+			int BestDist = SHOT_DISTANCE*SHOT_DISTANCE;
+			for(int c = 0; c < MAX_CLIENTS; c++)
+			{
+				if(!m_aClients[c].m_HasCharacter)
+					continue;
+				int dx = m_aClients[c].m_X - pLaser->m_FromX;
+				int dy = m_aClients[c].m_Y - pLaser->m_FromY;
+				if(dx*dx + dy*dy <= BestDist)
+				{
+					BestDist = dx*dx + dy*dy;
+					Shooter = c;
+				}
+			}
+			if(Stats(Shooter))
+				Stats(Shooter)->m_RifleShots++;
+		}
+		mem_copy(m_aLasers, m_aNewLasers, sizeof(m_aLasers));
+		m_LastSnapTick = Tick;
+	}
+
+	virtual void OnDemoPlayerMessage(void *pData, int Size)
+	{
+		CUnpacker Unpacker;
+		Unpacker.Reset(pData, Size);
+		int Msg = Unpacker.GetInt();
+		int Sys = Msg&1;
+		Msg >>= 1;
+		if(Unpacker.Error() || Sys || Msg != NETMSGTYPE_SV_KILLMSG)
+			return;
+
+		CNetMsg_Sv_KillMsg *pMsg = (CNetMsg_Sv_KillMsg *)m_NetObjHandler.SecureUnpackMsg(Msg, &Unpacker);
+		if(!pMsg)
+			return;
+		int Tick = m_DemoPlayer.Info()->m_Info.m_CurrentTick;
+		if(Tick == m_LastKillTick && mem_comp(pMsg, &m_LastKill, sizeof(m_LastKill)) == 0)
+			return;
+		m_LastKill = *pMsg;
+		m_LastKillTick = Tick;
+
+		if(pMsg->m_Weapon == WEAPON_LASER || pMsg->m_Weapon == WEAPON_GRENADE)
+		{
+			// a freeze, see CCharacter::TakeDamage
+			if(Stats(pMsg->m_Victim))
+				Stats(pMsg->m_Victim)->m_Frozen++;
+			if(pMsg->m_Killer != pMsg->m_Victim && Stats(pMsg->m_Killer))
+			{
+				Stats(pMsg->m_Killer)->m_Freezes++;
+				m_aClients[pMsg->m_Killer].m_PendingFreezes++;
+			}
+		}
+		else if(pMsg->m_Weapon == WEAPON_NINJA && pMsg->m_Killer >= 0)
+			OnKill(pMsg->m_Killer, pMsg->m_Victim, Tick);
+	}
+};
+
+struct CShared
+{
+	IStorage *m_pStorage;
+	IConsole *m_pConsole;
+	std::vector<CDemoEntry> m_vDemos;
+	std::vector<CFngStats> m_vStats;
+	std::vector<CDemoEntry> m_vReplayed;
+	unsigned m_NextDemo;
+	LOCK m_Lock;
+};
+
+static void ReplayThread(void *pUser)
+{
+	CShared *pShared = (CShared *)pUser;
+	CReplay *pReplay = new CReplay;
+	while(1)
+	{
+		lock_wait(pShared->m_Lock);
+		unsigned Demo = pShared->m_NextDemo++;
+		lock_unlock(pShared->m_Lock);
+		if(Demo >= pShared->m_vDemos.size())
+			break;
+
+		const char *pPath = pShared->m_vDemos[Demo].m_aPath;
+		if(!pReplay->Run(pShared->m_pStorage, pShared->m_pConsole, pPath))
+			continue;
+		dbg_msg("demo_stats", "%s: %d players", pPath, (int)pReplay->m_vStats.size());
+
+		lock_wait(pShared->m_Lock);
+		pShared->m_vStats.insert(pShared->m_vStats.end(), pReplay->m_vStats.begin(), pReplay->m_vStats.end());
+		pShared->m_vReplayed.push_back(pShared->m_vDemos[Demo]);
+		lock_unlock(pShared->m_Lock);
+	}
+	delete pReplay;
+}
+
+struct CListDemos
+{
+	const char *m_pDirectory;
+	std::vector<CDemoEntry> *m_pDemos;
+};
+
+static int ListDemoCallback(const char *pName, int IsDir, int StorageType, void *pUser)
+{
+	CListDemos *pList = (CListDemos *)pUser;
+	if(IsDir || !str_endswith(pName, ".demo"))
+		return 0;
+	CDemoEntry Entry;
+	str_format(Entry.m_aPath, sizeof(Entry.m_aPath), "%s/%s", pList->m_pDirectory, pName);
+	pList->m_pDemos->push_back(Entry);
+	return 0;
+}
+
+static void ReadJournal(const char *pPath, std::vector<CDemoEntry> *pReplayed)
+{
+	IOHANDLE File = io_open(pPath, IOFLAG_READ);
+	if(!File)
+		return;
+	CLineReader Reader;
+	Reader.Init(File);
+	while(const char *pLine = Reader.Get())
+	{
+		if(!pLine[0])
+			continue;
+		CDemoEntry Entry;
+		str_copy(Entry.m_aPath, pLine, sizeof(Entry.m_aPath));
+		pReplayed->push_back(Entry);
+	}
+	io_close(File);
+}
+
+static void WriteStats(const char *pStatsPath, const CFngStats *pReplayed)
+{
+	char aFilename[MAX_FILE_LEN];
+	char aPath[MAX_FILE_PATH];
+	if(escape_filename(aFilename, sizeof(aFilename), pReplayed->m_aName))
+	{
+		dbg_msg("demo_stats", "failed to escape name '%s'", pReplayed->m_aName);
+		return;
+	}
+	str_format(aPath, sizeof(aPath), "%s/%s.acc", pStatsPath, aFilename);
+
+	int Lock = LockStatsFile(aPath);
+	if(Lock < 0)
+	{
+		dbg_msg("demo_stats", "'%s' stays locked, skipping", aPath);
+		return;
+	}
+	CFngStats Stats = *pReplayed;
+	CFngStats FileStats;
+	if(ReadStatsFile(aPath, &FileStats) == 0)
+	{
+		// the settings and the running spree of the player stay as they are
+		Stats.m_CfgFlags = FileStats.m_CfgFlags;
+		Stats.m_Spree = FileStats.m_Spree;
+		Stats.m_Multi = FileStats.m_Multi;
+		AddReplayStats(&Stats, &FileStats);
+		Stats = FileStats;
+	}
+	WriteStatsFile(aPath, &Stats);
+	UnlockStatsFile(aPath, Lock);
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	int NumThreads = 4;
+	const char *pStatsPath = "stats";
+	bool DryRun = false;
+	std::vector<CDemoEntry> vArgs;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(str_comp(argv[i], "-j") == 0 && i+1 < argc)
+			NumThreads = clamp(str_toint(argv[++i]), 1, 64);
+		else if(str_comp(argv[i], "-o") == 0 && i+1 < argc)
+			pStatsPath = argv[++i];
+		else if(str_comp(argv[i], "-n") == 0)
+			DryRun = true;
+		else if(argv[i][0] != '-')
+		{
+			CDemoEntry Entry;
+			str_copy(Entry.m_aPath, argv[i], sizeof(Entry.m_aPath));
+			vArgs.push_back(Entry);
+		}
+		else
+		{
+			vArgs.clear();
+			break;
+		}
+	}
+	if(vArgs.empty())
+	{
+		dbg_msg("usage", "%s [-j threads] [-o stats path] [-n] demo|directory...", argv[0]);
+		dbg_msg("usage", "demos are relative to the storage paths, -n prints the stats without saving them");
+		return -1;
+	}
+
+	IConsole *pConsole = CreateConsole(0);
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
+	if(!pStorage)
+		return -1;
+	// the demo player keeps the maps of the demos there
+	pStorage->CreateFolder("downloadedmaps", IStorage::TYPE_SAVE);
+
+	CShared Shared;
+	Shared.m_pStorage = pStorage;
+	Shared.m_pConsole = pConsole;
+	Shared.m_NextDemo = 0;
+	for(unsigned i = 0; i < vArgs.size(); i++)
+	{
+		if(str_endswith(vArgs[i].m_aPath, ".demo"))
+			Shared.m_vDemos.push_back(vArgs[i]);
+		else
+		{
+			CListDemos List = { vArgs[i].m_aPath, &Shared.m_vDemos };
+			pStorage->ListDirectory(IStorage::TYPE_ALL, vArgs[i].m_aPath, ListDemoCallback, &List);
+		}
+	}
+	std::sort(Shared.m_vDemos.begin(), Shared.m_vDemos.end());
+	Shared.m_vDemos.erase(std::unique(Shared.m_vDemos.begin(), Shared.m_vDemos.end()), Shared.m_vDemos.end());
+
+	// demos that went into the stats already are left out
+	char aJournalPath[MAX_FILE_PATH];
+	str_format(aJournalPath, sizeof(aJournalPath), "%s/%s", pStatsPath, s_pJournalName);
+	std::vector<CDemoEntry> vJournal;
+	ReadJournal(aJournalPath, &vJournal);
+	std::sort(vJournal.begin(), vJournal.end());
+	unsigned NumDemos = Shared.m_vDemos.size();
+	for(unsigned i = 0; i < Shared.m_vDemos.size();)
+	{
+		if(std::binary_search(vJournal.begin(), vJournal.end(), Shared.m_vDemos[i]))
+			Shared.m_vDemos.erase(Shared.m_vDemos.begin()+i);
+		else
+			i++;
+	}
+	dbg_msg("demo_stats", "%d demos, %d replayed already", NumDemos, NumDemos-(int)Shared.m_vDemos.size());
+
+	Shared.m_Lock = lock_create();
+	int64 StartTime = time_get();
+	std::vector<void *> vThreads;
+	for(int i = 0; i < minimum(NumThreads, (int)Shared.m_vDemos.size()); i++)
+		vThreads.push_back(thread_init(ReplayThread, &Shared));
+	for(unsigned i = 0; i < vThreads.size(); i++)
+		thread_wait(vThreads[i]);
+	lock_destroy(Shared.m_Lock);
+	dbg_msg("demo_stats", "replayed %d demos in %.2fs", (int)Shared.m_vReplayed.size(), (time_get()-StartTime)/(float)time_freq());
+
+	// one entry per player
+	std::vector<CFngStats> &vStats = Shared.m_vStats;
+	std::stable_sort(vStats.begin(), vStats.end(), StatsNameLess);
+	unsigned Num = 0;
+	for(unsigned i = 0; i < vStats.size(); i++)
+	{
+		if(Num > 0 && str_comp(vStats[Num-1].m_aName, vStats[i].m_aName) == 0)
+			AddReplayStats(&vStats[i], &vStats[Num-1]);
+		else
+			vStats[Num++] = vStats[i];
+	}
+	vStats.resize(Num);
+
+	for(unsigned i = 0; i < vStats.size(); i++)
+	{
+		const CFngStats *pStats = &vStats[i];
+		if(DryRun)
+			dbg_msg("demo_stats", "'%s' kills=%d deaths=%d spikes=%d/%d/%d shots=%d freezes=%d frozen=%d spree=%d multi=%d online=%ds",
+				pStats->m_aName, pStats->m_Kills, pStats->m_Deaths, pStats->m_GoldSpikes, pStats->m_GreenSpikes, pStats->m_PurpleSpikes,
+				pStats->m_RifleShots, pStats->m_Freezes, pStats->m_Frozen, pStats->m_SpreeBest, pStats->m_MultiBest, (int)pStats->m_TotalOnlineTime);
+		else
+			WriteStats(pStatsPath, pStats);
+	}
+
+	if(!DryRun && !Shared.m_vReplayed.empty())
+	{
+		vJournal.insert(vJournal.end(), Shared.m_vReplayed.begin(), Shared.m_vReplayed.end());
+		IOHANDLE File = io_open(aJournalPath, IOFLAG_WRITE);
+		if(File)
+		{
+			for(unsigned i = 0; i < vJournal.size(); i++)
+			{
+				io_write(File, vJournal[i].m_aPath, str_length(vJournal[i].m_aPath));
+				io_write_newline(File);
+			}
+			io_close(File);
+		}
+		dbg_msg("demo_stats", "merged %d players into '%s'", (int)vStats.size(), pStatsPath);
+	}
+
+	delete pStorage;
+	delete pConsole;
+	return 0;
+}
@@ -0,0 +1,550 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/message.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/config.h>
+#include <engine/shared/network.h>
+#include <engine/shared/profiler.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/snapshot.h>
+
+#include <generated/protocol.h>
+#include <game/version.h>
+
+#include "botinput.h"
+
+// headless clients that join a server and play randomly, for load tests.
+// with -d they download the map first, like a client that doesn't have it
+
+enum
+{
+	MAX_BOTS=256,
+
+	// the server only gives the items of the first release a static size, see CGameContext::OnInit
+	OLD_NUM_NETOBJTYPES=23,
+};
+
+static CConfig s_Config;
+static CSnapshotDelta s_SnapshotDelta;
+static CProfiler s_Profiler;
+static int s_ProfConnect;
+static int s_ProfPing;
+static int s_ProfSnapInterval;
+static int s_ProfInputTiming;
+static int s_ProfMapDownload;
+static bool s_DownloadMap;
+
+class CBot
+{
+public:
+	enum
+	{
+		STATE_OFFLINE=0,
+		STATE_CONNECTING,
+		STATE_LOADING,
+		STATE_ONLINE,
+		STATE_INGAME,
+	};
+
+	CNetClient m_Net;
+	int m_Index;
+	int m_State;
+	unsigned m_Seed;
+	int64 m_ConnectTime;
+
+	// snapshots
+	CSnapshotStorage m_Snapshots;
+	char m_aSnapshotIncomingData[CSnapshot::MAX_SIZE];
+	unsigned m_SnapshotParts;
+	int m_CurrentRecvTick;
+	int m_AckGameTick;
+	int64 m_LastSnapTime;
+	int m_NumSnaps;
+	int m_NumCrcErrors;
+
+	// input
+	CNetObj_PlayerInput m_Input;
+	int64 m_NextInputTime;
+	int64 m_NextDecision;
+	int m_LastInputTick;
+
+	int64 m_PingTime;
+
+	// map download, like the real client does it
+	int m_MapSize;
+	int m_MapAmount;
+	int m_MapChunk;
+	int m_MapChunkNum;
+	int m_MapChunkSize;
+	int64 m_MapDownloadStart;
+
+	bool Start(int Index, const NETADDR *pAddr, unsigned Seed)
+	{
+		NETADDR BindAddr;
+		mem_zero(&BindAddr, sizeof(BindAddr));
+		BindAddr.type = pAddr->type;
+		if(!m_Net.Open(BindAddr, &s_Config, 0, 0, NETCREATE_FLAG_RANDOMPORT))
+			return false;
+
+		m_Index = Index;
+		m_Seed = Seed;
+		m_Snapshots.Init();
+		m_SnapshotParts = 0;
+		m_CurrentRecvTick = 0;
+		m_AckGameTick = -1;
+		m_LastSnapTime = 0;
+		m_NumSnaps = 0;
+		m_NumCrcErrors = 0;
+		mem_zero(&m_Input, sizeof(m_Input));
+		m_NextInputTime = 0;
+		m_NextDecision = 0;
+		m_LastInputTick = 0;
+		m_PingTime = 0;
+		m_MapSize = 0;
+		m_MapAmount = 0;
+
+		NETADDR Addr = *pAddr;
+		m_Net.Connect(&Addr);
+		m_State = STATE_CONNECTING;
+		m_ConnectTime = time_get();
+		return true;
+	}
+
+	void SendMsg(CMsgPacker *pMsg, int Flags)
+	{
+		CNetChunk Packet;
+		mem_zero(&Packet, sizeof(Packet));
+		Packet.m_ClientID = 0;
+		Packet.m_pData = pMsg->Data();
+		Packet.m_DataSize = pMsg->Size();
+		if(Flags&MSGFLAG_VITAL)
+			Packet.m_Flags |= NETSENDFLAG_VITAL;
+		if(Flags&MSGFLAG_FLUSH)
+			Packet.m_Flags |= NETSENDFLAG_FLUSH;
+		m_Net.Send(&Packet);
+	}
+
+	template<class T>
+	void SendPackMsg(T *pMsg, int Flags)
+	{
+		CMsgPacker Packer(pMsg->MsgID(), false);
+		if(pMsg->Pack(&Packer))
+			return;
+		SendMsg(&Packer, Flags);
+	}
+
+	void SendStartInfo()
+	{
+		static const char *s_apSkinParts[NUM_SKINPARTS] = { "standard", "", "", "standard", "standard", "standard" };
+		char aName[MAX_NAME_LENGTH];
+		str_format(aName, sizeof(aName), "bot%d", m_Index);
+
+		CNetMsg_Cl_StartInfo Msg;
+		Msg.m_pName = aName;
+		Msg.m_pClan = "load";
+		Msg.m_Country = -1;
+		for(int p = 0; p < NUM_SKINPARTS; p++)
+		{
+			Msg.m_apSkinPartNames[p] = s_apSkinParts[p];
+			Msg.m_aUseCustomColors[p] = 1;
+			Msg.m_aSkinPartColors[p] = random_seeded(&m_Seed)<<8;
+		}
+		SendPackMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+	}
+
+	// the tick the server is at now, guessed from the last snapshot
+	int PredTick(int64 Now) const
+	{
+		return m_CurrentRecvTick + (int)((Now-m_LastSnapTime)*SERVER_TICK_SPEED/time_freq()) + 2;
+	}
+
+	void UpdateInput(int64 Now)
+	{
+		// a decision holds for 0.1 to 1 seconds
+		bool Decide = Now >= m_NextDecision;
+		if(Decide)
+			m_NextDecision = Now + time_freq()*(100+random_seeded(&m_Seed)%900)/1000;
+		UpdateBotInput(&m_Input, &m_Seed, Decide);
+	}
+
+	void SendInput(int64 Now)
+	{
+		int Tick = PredTick(Now);
+		if(Tick <= m_LastInputTick)
+			return;
+		m_LastInputTick = Tick;
+
+		UpdateInput(Now);
+
+		CMsgPacker Msg(NETMSG_INPUT, true);
+		Msg.AddInt(m_AckGameTick);
+		Msg.AddInt(Tick);
+		Msg.AddInt(sizeof(m_Input));
+		const int *pData = (const int *)&m_Input;
+		for(unsigned i = 0; i < sizeof(m_Input)/sizeof(int); i++)
+			Msg.AddInt(pData[i]);
+		int PingCorrection = 0;
+		int64 TagTime;
+		if(m_Snapshots.Get(m_AckGameTick, &TagTime, 0, 0) >= 0)
+			PingCorrection = (int)(((Now-TagTime)*1000)/time_freq());
+		Msg.AddInt(PingCorrection);
+		SendMsg(&Msg, MSGFLAG_FLUSH);
+	}
+
+	void OnSnapshot(int Msg, CUnpacker *pUnpacker)
+	{
+		int NumParts = 1;
+		int Part = 0;
+		int GameTick = pUnpacker->GetInt();
+		int DeltaTick = GameTick-pUnpacker->GetInt();
+		int PartSize = 0;
+		int Crc = 0;
+
+		if(Msg == NETMSG_SNAP)
+		{
+			NumParts = pUnpacker->GetInt();
+			Part = pUnpacker->GetInt();
+		}
+		if(Msg != NETMSG_SNAPEMPTY)
+		{
+			Crc = pUnpacker->GetInt();
+			PartSize = pUnpacker->GetInt();
+		}
+		const char *pData = (const char *)pUnpacker->GetRaw(PartSize);
+
+		if(pUnpacker->Error() || NumParts < 1 || NumParts > CSnapshot::MAX_PARTS || Part < 0 || Part >= NumParts || PartSize < 0 || PartSize > MAX_SNAPSHOT_PACKSIZE)
+			return;
+		if(GameTick < m_CurrentRecvTick)
+			return;
+		if(GameTick != m_CurrentRecvTick)
+		{
+			m_SnapshotParts = 0;
+			m_CurrentRecvTick = GameTick;
+		}
+
+		mem_copy(m_aSnapshotIncomingData + Part*MAX_SNAPSHOT_PACKSIZE, pData, PartSize);
+		m_SnapshotParts |= 1<<Part;
+		if(m_SnapshotParts != (unsigned)((1<<NumParts)-1))
+			return;
+		m_SnapshotParts = 0;
+
+		// find the snapshot the server made the delta against
+		static CSnapshot s_EmptySnap;
+		CSnapshot *pDeltaShot = &s_EmptySnap;
+		s_EmptySnap.Clear();
+		if(DeltaTick >= 0 && m_Snapshots.Get(DeltaTick, 0, &pDeltaShot, 0) < 0)
+		{
+			m_AckGameTick = -1;
+			return;
+		}
+
+		char aDeltaData[CSnapshot::MAX_SIZE];
+		char aSnap[CSnapshot::MAX_SIZE];
+		CSnapshot *pSnap = (CSnapshot *)aSnap;
+		const void *pDeltaData = s_SnapshotDelta.EmptyDelta();
+		int DeltaSize = sizeof(int)*3;
+		int CompleteSize = (NumParts-1)*MAX_SNAPSHOT_PACKSIZE + PartSize;
+		if(CompleteSize)
+		{
+			DeltaSize = CVariableInt::Decompress(m_aSnapshotIncomingData, CompleteSize, aDeltaData, sizeof(aDeltaData));
+			if(DeltaSize < 0)
+				return;
+			pDeltaData = aDeltaData;
+		}
+
+		int SnapSize = s_SnapshotDelta.UnpackDelta(pDeltaShot, pSnap, pDeltaData, DeltaSize);
+		if(SnapSize < 0 || (Msg != NETMSG_SNAPEMPTY && pSnap->Crc() != Crc))
+		{
+			if(++m_NumCrcErrors%10 == 0)
+				m_AckGameTick = -1;
+			return;
+		}
+
+		int64 Now = time_get();
+		if(m_LastSnapTime)
+			s_Profiler.Add(s_ProfSnapInterval, Now-m_LastSnapTime);
+		m_LastSnapTime = Now;
+		m_NumSnaps++;
+
+		m_Snapshots.PurgeUntil(DeltaTick);
+		m_Snapshots.Add(GameTick, Now, SnapSize, pSnap, 0);
+		m_AckGameTick = GameTick;
+	}
+
+	void OnMessage(CNetChunk *pChunk)
+	{
+		CUnpacker Unpacker;
+		Unpacker.Reset(pChunk->m_pData, pChunk->m_DataSize);
+		int Msg = Unpacker.GetInt();
+		int Sys = Msg&1;
+		Msg >>= 1;
+		if(Unpacker.Error())
+			return;
+
+		if(!Sys)
+		{
+			if(Msg == NETMSGTYPE_SV_READYTOENTER && m_State == STATE_ONLINE)
+			{
+				CMsgPacker Packer(NETMSG_ENTERGAME, true);
+				SendMsg(&Packer, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+				m_State = STATE_INGAME;
+				s_Profiler.Add(s_ProfConnect, time_get()-m_ConnectTime);
+			}
+			return;
+		}
+
+		if(Msg == NETMSG_MAP_CHANGE)
+		{
+			Unpacker.GetString();
+			Unpacker.GetInt();
+			int MapSize = Unpacker.GetInt();
+			int ChunkNum = Unpacker.GetInt();
+			int ChunkSize = Unpacker.GetInt();
+			m_State = STATE_LOADING;
+			m_Snapshots.PurgeAll();
+			m_AckGameTick = -1;
+			m_CurrentRecvTick = 0;
+			if(s_DownloadMap && !Unpacker.Error() && MapSize > 0 && ChunkNum > 0 && ChunkSize > 0)
+			{
+				m_MapSize = MapSize;
+				m_MapAmount = 0;
+				m_MapChunk = 0;
+				m_MapChunkNum = ChunkNum;
+				m_MapChunkSize = ChunkSize;
+				m_MapDownloadStart = time_get();
+				CMsgPacker Packer(NETMSG_REQUEST_MAP_DATA, true);
+				SendMsg(&Packer, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+			}
+			else
+			{
+				// pretend to have the map
+				CMsgPacker Packer(NETMSG_READY, true);
+				SendMsg(&Packer, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+			}
+		}
+		else if(Msg == NETMSG_MAP_DATA && m_MapAmount < m_MapSize)
+		{
+			int Size = minimum(m_MapChunkSize, m_MapSize-m_MapAmount);
+			Unpacker.GetRaw(Size);
+			if(Unpacker.Error())
+				return;
+			m_MapAmount += Size;
+			if(m_MapAmount == m_MapSize)
+			{
+				s_Profiler.Add(s_ProfMapDownload, time_get()-m_MapDownloadStart);
+				CMsgPacker Packer(NETMSG_READY, true);
+				SendMsg(&Packer, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+			}
+			else if(++m_MapChunk%m_MapChunkNum == 0)
+			{
+				CMsgPacker Packer(NETMSG_REQUEST_MAP_DATA, true);
+				SendMsg(&Packer, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+			}
+		}
+		else if(Msg == NETMSG_CON_READY)
+		{
+			SendStartInfo();
+			m_State = STATE_ONLINE;
+		}
+		else if(Msg == NETMSG_SNAP || Msg == NETMSG_SNAPSINGLE || Msg == NETMSG_SNAPEMPTY)
+			OnSnapshot(Msg, &Unpacker);
+		else if(Msg == NETMSG_INPUTTIMING)
+		{
+			Unpacker.GetInt();
+			int TimeLeft = Unpacker.GetInt();
+			if(!Unpacker.Error())
+				s_Profiler.Add(s_ProfInputTiming, maximum(TimeLeft, 0)*time_freq()/1000);
+		}
+		else if(Msg == NETMSG_PING_REPLY && m_PingTime)
+		{
+			s_Profiler.Add(s_ProfPing, time_get()-m_PingTime);
+			m_PingTime = 0;
+		}
+	}
+
+	void Update(int64 Now)
+	{
+		if(m_State == STATE_OFFLINE)
+			return;
+
+		m_Net.Update();
+		if(m_Net.State() == NETSTATE_OFFLINE)
+		{
+			dbg_msg("fake_client", "bot%d disconnected: %s", m_Index, m_Net.ErrorString());
+			m_State = STATE_OFFLINE;
+			return;
+		}
+
+		if(m_State == STATE_CONNECTING && m_Net.State() == NETSTATE_ONLINE)
+		{
+			CMsgPacker Msg(NETMSG_INFO, true);
+			Msg.AddString(GAME_NETVERSION, 128);
+			Msg.AddString(s_Config.m_Password, 128);
+			Msg.AddInt(CLIENT_VERSION);
+			SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+			m_State = STATE_LOADING;
+		}
+
+		CNetChunk Packet;
+		while(m_Net.Recv(&Packet))
+		{
+			if(!(Packet.m_Flags&NETSENDFLAG_CONNLESS))
+				OnMessage(&Packet);
+		}
+
+		if(m_State == STATE_INGAME && m_LastSnapTime)
+		{
+			SendInput(Now);
+			if(!m_PingTime && random_seeded(&m_Seed)%SERVER_TICK_SPEED == 0)
+			{
+				CMsgPacker Msg(NETMSG_PING, true);
+				SendMsg(&Msg, MSGFLAG_FLUSH);
+				m_PingTime = Now;
+			}
+		}
+	}
+};
+
+static void Report(CBot **ppBots, int NumBots, int64 Span)
+{
+	int aNumStates[CBot::STATE_INGAME+1] = {0};
+	int NumSnaps = 0;
+	int NumCrcErrors = 0;
+	for(int i = 0; i < NumBots; i++)
+	{
+		aNumStates[ppBots[i]->m_State]++;
+		NumSnaps += ppBots[i]->m_NumSnaps;
+		NumCrcErrors += ppBots[i]->m_NumCrcErrors;
+		ppBots[i]->m_NumSnaps = 0;
+		ppBots[i]->m_NumCrcErrors = 0;
+	}
+
+	NETSTATS Stats;
+	net_stats(&Stats);
+	static NETSTATS s_Prev;
+	int Seconds = maximum(1, (int)(Span/time_freq()));
+
+	dbg_msg("fake_client", "ingame=%d joining=%d offline=%d snaps=%d/s crcerrors=%d recv=%dB/s send=%dB/s",
+		aNumStates[CBot::STATE_INGAME], aNumStates[CBot::STATE_CONNECTING]+aNumStates[CBot::STATE_LOADING]+aNumStates[CBot::STATE_ONLINE],
+		aNumStates[CBot::STATE_OFFLINE], NumSnaps/Seconds, NumCrcErrors,
+		(Stats.recv_bytes-s_Prev.recv_bytes)/Seconds, (Stats.sent_bytes-s_Prev.sent_bytes)/Seconds);
+	s_Prev = Stats;
+
+	for(int i = 0; i < s_Profiler.NumZones(); i++)
+	{
+		if(!s_Profiler.Count(i))
+			continue;
+		dbg_msg("fake_client", "  %-13s count=%d avg=%dus p50=%dus p99=%dus max=%dus", s_Profiler.ZoneName(i), s_Profiler.Count(i),
+			(int)(s_Profiler.Total(i)/s_Profiler.Count(i)), (int)s_Profiler.Percentile(i, 50), (int)s_Profiler.Percentile(i, 99), (int)s_Profiler.Max(i));
+	}
+	s_Profiler.Reset();
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	int NumBots = 16;
+	int Duration = 0;
+	int JoinInterval = 100;
+	unsigned Seed = 1;
+	const char *pAddress = "localhost:8303";
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(str_comp(argv[i], "-n") == 0 && i+1 < argc)
+			NumBots = clamp(str_toint(argv[++i]), 1, (int)MAX_BOTS);
+		else if(str_comp(argv[i], "-t") == 0 && i+1 < argc)
+			Duration = str_toint(argv[++i]);
+		else if(str_comp(argv[i], "-j") == 0 && i+1 < argc)
+			JoinInterval = str_toint(argv[++i]);
+		else if(str_comp(argv[i], "-s") == 0 && i+1 < argc)
+			Seed = str_toint(argv[++i]);
+		else if(str_comp(argv[i], "-d") == 0)
+			s_DownloadMap = true;
+		else if(str_comp(argv[i], "-p") == 0 && i+1 < argc)
+			str_copy(s_Config.m_Password, argv[++i], sizeof(s_Config.m_Password));
+		else if(argv[i][0] != '-')
+			pAddress = argv[i];
+		else
+		{
+			dbg_msg("usage", "%s [-n bots] [-t seconds] [-j join interval ms] [-s seed] [-p password] [-d] [host[:port]]", argv[0]);
+			return -1;
+		}
+	}
+
+	NETADDR Addr;
+	if(net_host_lookup(pAddress, &Addr, NETTYPE_ALL) != 0)
+	{
+		dbg_msg("fake_client", "could not resolve '%s'", pAddress);
+		return -1;
+	}
+	if(!Addr.port)
+		Addr.port = 8303;
+
+	if(secure_random_init() != 0)
+	{
+		dbg_msg("fake_client", "could not initialize secure RNG");
+		return -1;
+	}
+
+	CNetObjHandler NetObjHandler;
+	for(int i = 0; i < OLD_NUM_NETOBJTYPES; i++)
+		s_SnapshotDelta.SetStaticsize(i, NetObjHandler.GetObjSize(i));
+
+	s_ProfConnect = s_Profiler.RegisterZone("connect");
+	s_ProfPing = s_Profiler.RegisterZone("ping");
+	s_ProfSnapInterval = s_Profiler.RegisterZone("snap_interval");
+	s_ProfInputTiming = s_Profiler.RegisterZone("input_margin");
+	s_ProfMapDownload = s_Profiler.RegisterZone("map_download");
+
+	CBot *apBots[MAX_BOTS];
+	int NumStarted = 0;
+	int64 Start = time_get();
+	int64 NextJoin = Start;
+	int64 NextReport = Start + time_freq()*5;
+	int64 LastReport = Start;
+
+	while(!Duration || time_get() < Start + time_freq()*Duration)
+	{
+		int64 Now = time_get();
+
+		// join one after another, a burst of connects is a different test
+		if(NumStarted < NumBots && Now >= NextJoin)
+		{
+			CBot *pBot = new CBot;
+			if(!pBot->Start(NumStarted, &Addr, Seed+NumStarted*7919))
+			{
+				dbg_msg("fake_client", "could not open a socket for bot%d", NumStarted);
+				delete pBot;
+				break;
+			}
+			apBots[NumStarted++] = pBot;
+			NextJoin = Now + time_freq()*JoinInterval/1000;
+		}
+
+		for(int i = 0; i < NumStarted; i++)
+			apBots[i]->Update(Now);
+
+		if(Now >= NextReport)
+		{
+			Report(apBots, NumStarted, Now-LastReport);
+			LastReport = Now;
+			NextReport = Now + time_freq()*5;
+		}
+
+		thread_sleep(1);
+	}
+
+	Report(apBots, NumStarted, time_get()-LastReport);
+	for(int i = 0; i < NumStarted; i++)
+	{
+		apBots[i]->m_Net.Close();
+		apBots[i]->m_Snapshots.PurgeAll();
+		delete apBots[i];
+	}
+	return 0;
+}
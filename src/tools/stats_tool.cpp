@@ -0,0 +1,223 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <algorithm>
+#include <vector>
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <game/server/stats.h>
+
+#if defined(CONF_SIMD_SSE2)
+	#include <emmintrin.h>
+#elif defined(CONF_SIMD_NEON)
+	#include <arm_neon.h>
+#endif
+
+// queries over the columnar stats snapshot (see CStatsSnapshot) that the server
+// writes with sv_stats_snapshot, or that "export" builds from a stats directory.
+// the scans run over whole columns, so they never load the stats records.
+// scores use the weights of a compiled CRankFormula
+
+static void MinMax(const int *pValues, int Num, int *pMin, int *pMax)
+{
+	int Min = Num ? pValues[0] : 0;
+	int Max = Min;
+	int i = 0;
+#if defined(CONF_SIMD_SSE2)
+	if(Num >= 4)
+	{
+		// no signed 32 bit min/max before sse4.1, select with the compare masks
+		__m128i VMin = _mm_loadu_si128((const __m128i *)pValues);
+		__m128i VMax = VMin;
+		for(i = 4; i+4 <= Num; i += 4)
+		{
+			__m128i Value = _mm_loadu_si128((const __m128i *)(pValues+i));
+			__m128i Less = _mm_cmplt_epi32(Value, VMin);
+			__m128i Greater = _mm_cmpgt_epi32(Value, VMax);
+			VMin = _mm_or_si128(_mm_and_si128(Less, Value), _mm_andnot_si128(Less, VMin));
+			VMax = _mm_or_si128(_mm_and_si128(Greater, Value), _mm_andnot_si128(Greater, VMax));
+		}
+		int aMin[4], aMax[4];
+		_mm_storeu_si128((__m128i *)aMin, VMin);
+		_mm_storeu_si128((__m128i *)aMax, VMax);
+		for(int k = 0; k < 4; k++)
+		{
+			Min = minimum(Min, aMin[k]);
+			Max = maximum(Max, aMax[k]);
+		}
+	}
+#elif defined(CONF_SIMD_NEON)
+	if(Num >= 4)
+	{
+		int32x4_t VMin = vld1q_s32(pValues);
+		int32x4_t VMax = VMin;
+		for(i = 4; i+4 <= Num; i += 4)
+		{
+			int32x4_t Value = vld1q_s32(pValues+i);
+			VMin = vminq_s32(VMin, Value);
+			VMax = vmaxq_s32(VMax, Value);
+		}
+		for(int k = 0; k < 4; k++)
+		{
+			Min = minimum(Min, (int)vgetq_lane_s32(VMin, 0));
+			Max = maximum(Max, (int)vgetq_lane_s32(VMax, 0));
+			VMin = vextq_s32(VMin, VMin, 1);
+			VMax = vextq_s32(VMax, VMax, 1);
+		}
+	}
+#endif
+	for(; i < Num; i++)
+	{
+		Min = minimum(Min, pValues[i]);
+		Max = maximum(Max, pValues[i]);
+	}
+	*pMin = Min;
+	*pMax = Max;
+}
+
+// fills vValues with a column or the score of a rank formula, "score" is the default formula
+static bool LoadValues(const CStatsSnapshot *pSnapshot, const char *pName, std::vector<int> &vValues)
+{
+	vValues.resize(pSnapshot->NumPlayers());
+	int Column = CStatsSnapshot::FindColumn(pName);
+	if(Column != -1)
+	{
+		if(!vValues.empty())
+			mem_copy(&vValues[0], pSnapshot->Column(Column), vValues.size()*sizeof(int));
+		return true;
+	}
+	CRankFormula Formula;
+	char aError[128];
+	if(str_comp(pName, "score") != 0 && !Formula.Compile(pName, aError, sizeof(aError)))
+	{
+		dbg_msg("stats_tool", "invalid column or formula '%s': %s", pName, aError);
+		return false;
+	}
+	if(!vValues.empty())
+		Formula.Score(pSnapshot, &vValues[0]);
+	return true;
+}
+
+class CCompareValues
+{
+	const int *m_pValues;
+public:
+	CCompareValues(const int *pValues) : m_pValues(pValues) {}
+	bool operator()(int a, int b) const { return m_pValues[a] > m_pValues[b] || (m_pValues[a] == m_pValues[b] && a < b); }
+};
+
+static int Top(const CStatsSnapshot *pSnapshot, const char *pColumn, int Num)
+{
+	std::vector<int> vValues;
+	if(!LoadValues(pSnapshot, pColumn, vValues))
+		return -1;
+	if(vValues.empty())
+		return 0;
+	Num = minimum(Num, (int)vValues.size());
+	std::vector<int> vOrder(vValues.size());
+	for(unsigned i = 0; i < vOrder.size(); i++)
+		vOrder[i] = i;
+	std::partial_sort(vOrder.begin(), vOrder.begin()+Num, vOrder.end(), CCompareValues(&vValues[0]));
+	for(int i = 0; i < Num; i++)
+		dbg_msg("stats_tool", "%d. '%s' %s: %d", i+1, pSnapshot->Name(vOrder[i]), pColumn, vValues[vOrder[i]]);
+	return 0;
+}
+
+static int Percentiles(const CStatsSnapshot *pSnapshot, const char *pColumn, const char **ppArgs, int NumArgs)
+{
+	std::vector<int> vValues;
+	if(!LoadValues(pSnapshot, pColumn, vValues))
+		return -1;
+	if(vValues.empty())
+		return 0;
+	for(int i = 0; i < NumArgs; i++)
+	{
+		float Percentile = clamp(str_tofloat(ppArgs[i]), 0.0f, 100.0f);
+		int Index = minimum((int)(Percentile/100.0f*vValues.size()), (int)vValues.size()-1);
+		std::nth_element(vValues.begin(), vValues.begin()+Index, vValues.end());
+		dbg_msg("stats_tool", "p%g %s: %d", Percentile, pColumn, vValues[Index]);
+	}
+	return 0;
+}
+
+static int Histogram(const CStatsSnapshot *pSnapshot, const char *pColumn, int NumBuckets)
+{
+	std::vector<int> vValues;
+	if(!LoadValues(pSnapshot, pColumn, vValues))
+		return -1;
+	if(vValues.empty())
+		return 0;
+	int Min, Max;
+	MinMax(&vValues[0], vValues.size(), &Min, &Max);
+	const int64 Range = (int64)Max - Min + 1;
+	NumBuckets = (int)minimum((int64)NumBuckets, Range);
+	std::vector<int> vBuckets(NumBuckets, 0);
+	for(unsigned i = 0; i < vValues.size(); i++)
+		vBuckets[(int)(((int64)vValues[i] - Min) * NumBuckets / Range)]++;
+	for(int b = 0; b < NumBuckets; b++)
+	{
+		int64 From = Min + Range*b/NumBuckets;
+		int64 To = Min + Range*(b+1)/NumBuckets - 1;
+		dbg_msg("stats_tool", "%lld..%lld: %d", From, To, vBuckets[b]);
+	}
+	return 0;
+}
+
+static void Usage(const char *pProgram)
+{
+	dbg_msg("usage", "%s export <stats dir> <snapshot>", pProgram);
+	dbg_msg("usage", "%s top <snapshot> [n] [column]", pProgram);
+	dbg_msg("usage", "%s percentile <snapshot> <column> <percent>...", pProgram);
+	dbg_msg("usage", "%s hist <snapshot> <column> [buckets]", pProgram);
+	char aColumns[256] = "score";
+	for(int i = 0; i < CStatsSnapshot::NUM_COLUMNS; i++)
+	{
+		str_append(aColumns, " ", sizeof(aColumns));
+		str_append(aColumns, CStatsSnapshot::ColumnName(i), sizeof(aColumns));
+	}
+	dbg_msg("usage", "columns: %s", aColumns);
+	dbg_msg("usage", "a column can also be a rank formula like sv_rank_formula, e.g. \"kills*2 - deaths\"");
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+
+	if(argc < 4 && !(argc == 3 && str_comp(argv[1], "top") == 0))
+	{
+		Usage(argv[0]);
+		return -1;
+	}
+
+	if(str_comp(argv[1], "export") == 0)
+	{
+		int64 Start = time_get();
+		int NumPlayers = CStatsSnapshot::Write(argv[2], argv[3]);
+		if(NumPlayers < 0)
+			return -1;
+		dbg_msg("stats_tool", "wrote %d players to '%s' in %.2fms", NumPlayers, argv[3], (time_get()-Start)*1000.0f/time_freq());
+		return 0;
+	}
+
+	CStatsSnapshot Snapshot;
+	if(!Snapshot.Open(argv[2]))
+	{
+		dbg_msg("stats_tool", "failed to open snapshot '%s'", argv[2]);
+		return -1;
+	}
+	time_t Created = Snapshot.Created();
+	char aCreated[64];
+	strftime(aCreated, sizeof(aCreated), "%F %T", localtime(&Created));
+	dbg_msg("stats_tool", "snapshot of %d players from %s", Snapshot.NumPlayers(), aCreated);
+
+	if(str_comp(argv[1], "top") == 0)
+		return Top(&Snapshot, argc > 4 ? argv[4] : "score", argc > 3 ? maximum(1, str_toint(argv[3])) : 5);
+	if(str_comp(argv[1], "percentile") == 0 && argc > 4)
+		return Percentiles(&Snapshot, argv[3], argv+4, argc-4);
+	if(str_comp(argv[1], "hist") == 0)
+		return Histogram(&Snapshot, argv[3], argc > 4 ? clamp(str_toint(argv[4]), 1, 1000) : 10);
+
+	Usage(argv[0]);
+	return -1;
+}